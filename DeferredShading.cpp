@@ -18,6 +18,7 @@ DeferredShading::DeferredShading(UINT width, UINT height)
 	WorldViewProj		= GBufferFX->GetParameterByName(0, "gWorldViewProj");
 	FarClipDist			= GBufferFX->GetParameterByName(0, "gFarClipDist");
 	mtrl				= GBufferFX->GetParameterByName(0, "gMtrl");
+	Dequant				= GBufferFX->GetParameterByName(0, "gDequant");
 
 	errors = 0;
 	HR(D3DXCreateEffectFromFileEx(gd3dDevice, "FX/DeferredShading.fx", 0, 0, 0, 
@@ -35,6 +35,7 @@ public:
 	D3DXHANDLE WorldViewProj;
 	D3DXHANDLE FarClipDist;
 	D3DXHANDLE mtrl;
+	D3DXHANDLE Dequant;
 
 	ID3DXEffect* DeferredShadingFX;
 	D3DXHANDLE DeferredShadingTech;
@@ -0,0 +1,267 @@
+
+#include"GBufferUtil.fx"
+// Mirrors sdf/DistanceFieldAO.cpp, the cone table, weights and step distances come from the same functions.
+#define AO_CONES 8
+#define AO_STEPS 10
+
+texture3D gSDF0;
+texture2D gDepthMap;
+texture2D gGBuffer0;
+texture2D gConeVisibility0;
+texture2D gConeVisibility1;
+
+cbuffer cbPerFrame
+{
+	float4x4 gInvView;
+	float3 gFarPlane;			// far window width / far z, -far window height / far z, far z
+	float2 gRes;				// full resolution
+	float2 gLowRes;				// traced resolution
+	float gDownsample;
+	float gSurfaceBias;
+	float gConeTan;
+	float gCullDistance;
+	float gDepthThreshold;
+	float gNormalPower;
+	float4 gConeDirections[AO_CONES];
+	float4 gConeWeights[AO_CONES / 4];
+	float gStepDistances[AO_STEPS];
+};
+
+cbuffer cbPerModel
+{
+	float4x4 gSDFToWordInv0;
+	float3 gSDFBounds0;
+	float gSDFRes0;
+};
+
+sampler TexDepth = sampler_state
+{
+	Texture = <gDepthMap>;
+	MinFilter = POINT;
+	MagFilter = POINT;
+	MipFilter = POINT;
+	AddressU  = CLAMP;
+    AddressV  = CLAMP;
+};
+
+sampler TexGBuffer0 = sampler_state
+{
+	Texture = <gGBuffer0>;
+	MinFilter = POINT;
+	MagFilter = POINT;
+	MipFilter = POINT;
+	AddressU  = CLAMP;
+    AddressV  = CLAMP;
+};
+
+sampler TexSDF = sampler_state
+{
+	Texture = <gSDF0>;
+	MinFilter = LINEAR;
+	MagFilter = LINEAR;
+	MipFilter = LINEAR;
+	AddressU  = CLAMP;
+    AddressV  = CLAMP;
+	AddressW  = CLAMP;
+};
+
+sampler TexCone0 = sampler_state
+{
+	Texture = <gConeVisibility0>;
+	MinFilter = POINT;
+	MagFilter = POINT;
+	MipFilter = POINT;
+	AddressU  = CLAMP;
+    AddressV  = CLAMP;
+};
+
+sampler TexCone1 = sampler_state
+{
+	Texture = <gConeVisibility1>;
+	MinFilter = POINT;
+	MagFilter = POINT;
+	MipFilter = POINT;
+	AddressU  = CLAMP;
+    AddressV  = CLAMP;
+};
+
+struct PixelInput
+{
+	float4 position		: POSITION;
+	float2 texCoords	: TEXCOORD0;
+};
+
+PixelInput VS(float3 pos : POSITION, float2 tex : TEXCOORD)
+{
+	PixelInput vout;
+	vout.position = float4(pos.xy, 1.0f, 1.0f);
+	vout.texCoords = tex;
+	return vout;
+}
+
+// Full resolution pixel a traced texel stands for, texel I is traced at pixel I * Downsample + Downsample / 2
+float2 GetTracedPixel(float2 lowPixel)
+{
+	return min(lowPixel * gDownsample + floor(gDownsample * 0.5f), gRes - 1);
+}
+
+float2 GetPixelUV(float2 pixel, float2 res)
+{
+	return (pixel + 0.5f) / res;
+}
+
+float GetDepth(float2 uv)
+{
+	return tex2Dlod(TexDepth, float4(uv, 0, 0)).r;
+}
+
+float3 GetWorldNormal(float2 uv)
+{
+	return GetNormal(tex2Dlod(TexGBuffer0, float4(uv, 0, 0)));
+}
+
+float3 GetWorldPosition(float2 uv, float z)
+{
+	float3 P = float3((uv - float2(0.5f, 0.5f)) * z * gFarPlane.xy, z);
+	return mul(float4(P, 1.0f), gInvView).xyz;
+}
+
+// Distance in the volume's space, analytic to its box outside of it
+float SampleLocalDistance(float3 local)
+{
+	float3 clamped = clamp(local, 0, gSDFBounds0);
+	return tex3Dlod(TexSDF, float4(clamped / gSDFBounds0, 0)).r * gSDFRes0 + length(local - clamped);
+}
+
+void GetTangentBasis(float3 normal, out float3 tangent, out float3 bitangent)
+{
+	float3 up = abs(normal.z) < 0.999f ? float3(0, 0, 1) : float3(1, 0, 0);
+	tangent = normalize(cross(up, normal));
+	bitangent = cross(normal, tangent);
+}
+
+// One object's visibility per cone, the render targets keep the min over objects
+void ConePS(PixelInput pin
+	, out float4 c0 : COLOR0
+	, out float4 c1 : COLOR1)
+{
+	float2 uv = GetPixelUV(GetTracedPixel(floor(pin.texCoords * gLowRes)), gRes);
+	float z = GetDepth(uv);
+	clip(z);
+	clip(gFarPlane.z - z);
+
+	float3 normalW = GetWorldNormal(uv);
+	float3 posW = GetWorldPosition(uv, z);
+	float3 local = mul(float4(posW, 1.0f), gSDFToWordInv0).xyz;
+	float3 boxDelta = max(max(-local, local - gSDFBounds0), 0);
+	clip(gCullDistance - length(boxDelta));
+
+	float3 tangent, bitangent;
+	GetTangentBasis(normalW, tangent, bitangent);
+	float3 localOrigin = mul(float4(posW + normalW * gSurfaceBias, 1.0f), gSDFToWordInv0).xyz;
+	float3 localDirections[AO_CONES];
+	[unroll]
+	for (int cone = 0; cone < AO_CONES; cone++)
+	{
+		float3 d = gConeDirections[cone].xyz;
+		localDirections[cone] = mul(tangent * d.x + bitangent * d.y + normalW * d.z, (float3x3)gSDFToWordInv0);
+	}
+
+	float4 visibility0 = 1.0f.rrrr;
+	float4 visibility1 = 1.0f.rrrr;
+	[loop]
+	for (int i = 0; i < AO_STEPS; i++)
+	{
+		float stepDistance = gStepDistances[i];
+		float distanceToVisibility = 1.0f / (stepDistance * gConeTan);
+		float4 d0, d1;
+		[unroll]
+		for (int j = 0; j < 4; j++)
+		{
+			d0[j] = SampleLocalDistance(localOrigin + localDirections[j] * stepDistance);
+			d1[j] = SampleLocalDistance(localOrigin + localDirections[j + 4] * stepDistance);
+		}
+		visibility0 = min(visibility0, max(d0 * distanceToVisibility, 0));
+		visibility1 = min(visibility1, max(d1 * distanceToVisibility, 0));
+	}
+	c0 = visibility0;
+	c1 = visibility1;
+}
+
+float GetTexelVisibility(float2 lowUV)
+{
+	float4 uv = float4(lowUV, 0, 0);
+	return dot(tex2Dlod(TexCone0, uv), gConeWeights[0]) + dot(tex2Dlod(TexCone1, uv), gConeWeights[1]);
+}
+
+// Bilateral upsample of the cone targets, weighted by depth and normal similarity like UpsampleDistanceFieldAO
+float4 UpsamplePS(PixelInput pin) : COLOR
+{
+	float2 pixel = floor(pin.texCoords * gRes);
+	float2 uv = GetPixelUV(pixel, gRes);
+	float z = GetDepth(uv);
+	float3 normalW = GetWorldNormal(uv);
+
+	float2 low = (pixel - floor(gDownsample * 0.5f)) / gDownsample;
+	float2 low0 = clamp(floor(low), 0, gLowRes - 1);
+	float2 low1 = min(low0 + 1, gLowRes - 1);
+	float2 f = saturate(low - low0);
+	float2 lowPixels[4] = { low0, float2(low1.x, low0.y), float2(low0.x, low1.y), low1 };
+	float bilinear[4] = { (1 - f.x) * (1 - f.y), f.x * (1 - f.y), (1 - f.x) * f.y, f.x * f.y };
+
+	float totalWeight = 0;
+	float total = 0;
+	float closestDelta = 3.40282e+038f;
+	float closest = 1.0f;
+	[unroll]
+	for (int i = 0; i < 4; i++)
+	{
+		float2 sampleUV = GetPixelUV(GetTracedPixel(lowPixels[i]), gRes);
+		float sampleZ = GetDepth(sampleUV);
+		float3 sampleNormal = GetWorldNormal(sampleUV);
+		float visibility = GetTexelVisibility(GetPixelUV(lowPixels[i], gLowRes));
+		float depthWeight = max(1.0f - abs(sampleZ - z) / (z * gDepthThreshold), 0);
+		float normalWeight = pow(max(dot(normalW, sampleNormal), 0), gNormalPower);
+		float weight = bilinear[i] * depthWeight * normalWeight;
+		totalWeight += weight;
+		total += weight * visibility;
+		if (abs(sampleZ - z) < closestDelta)
+		{
+			closestDelta = abs(sampleZ - z);
+			closest = visibility;
+		}
+	}
+
+	// No similar sample, e.g. a thin object only seen at full resolution
+	float result = totalWeight > 1e-4f ? total / totalWeight : closest;
+	return float4(result.rrr, 1.0f);
+}
+
+technique DistanceFieldAOConeTech
+{
+	pass P0
+	{
+		ZENABLE				= FALSE;
+		ZWRITEENABLE		= FALSE;
+		STENCILENABLE		= FALSE;
+		ALPHABLENDENABLE	= TRUE;
+		BLENDOP				= MIN;
+		SRCBLEND			= ONE;
+		DESTBLEND			= ONE;
+		vertexShader = compile vs_3_0 VS();
+        pixelShader  = compile ps_3_0 ConePS();
+	}
+};
+
+technique DistanceFieldAOUpsampleTech
+{
+	pass P0
+	{
+		ZENABLE				= FALSE;
+		ZWRITEENABLE		= FALSE;
+		STENCILENABLE		= FALSE;
+		ALPHABLENDENABLE	= FALSE;
+		vertexShader = compile vs_3_0 VS();
+        pixelShader  = compile ps_3_0 UpsamplePS();
+	}
+};
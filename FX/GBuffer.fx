@@ -1,5 +1,6 @@
 
 #include "GBufferUtil.fx"
+#include "PackedVertex.fx"
 
 
 
@@ -35,6 +36,7 @@ struct VertexOut
 VertexOut VS(VertexIn vin)
 {
 	VertexOut vout;
+	DequantVertex(vin.PosL, vin.NormalL, vin.Tex);
 	vout.NormalW = mul(vin.NormalL, (float3x3)gWorldInvTranspose);
 	// Transform to homogeneous clip space.
 	vout.PosH = mul(float4(vin.PosL, 1.0f), gWorldViewProj);
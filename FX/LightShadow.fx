@@ -4,6 +4,8 @@
 // Does lighting and shadowing with shadow maps.
 //=============================================================================
 
+#include "PackedVertex.fx"
+
 uniform extern float4x4 gLightWVP;
 
 static const float SHADOW_EPSILON = 0.00005f;
@@ -92,6 +94,9 @@ void LightShadowVS(float3 posL         : POSITION0,
                    out float2 oTex0    : TEXCOORD3,
                    out float4 oProjTex : TEXCOORD4)
 {
+	// Packed models are quantized, see PackedVertex.fx
+	DequantVertex(posL, normalL, tex0);
+
 	// Transform to homogeneous clip space.
 	oPosH = mul(float4(posL, 1.0f), gWVP);
 	
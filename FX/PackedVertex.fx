@@ -0,0 +1,31 @@
+//=============================================================================
+// PackedVertex.fx
+//
+// Decodes the quantized vertices of packed meshes, see VertexPackedPNT.
+// The SHORT4/SHORT2 elements arrive as integers, the 1/32767 is folded
+// into the constants. Float vertices are drawn with the identity defaults.
+//=============================================================================
+
+// [0] position scale, w scales the octahedral normal, 0 for float normals
+// [1] position bias
+// [2] uv scale in xy, uv bias in zw
+uniform extern float4 gDequant[3] = { 1.0f, 1.0f, 1.0f, 0.0f,
+                                      0.0f, 0.0f, 0.0f, 0.0f,
+                                      1.0f, 1.0f, 0.0f, 0.0f };
+
+float3 DecodeOctahedral(float2 e)
+{
+	// Unfold the lower half of the octahedron
+	float3 n = float3(e, 1.0f - abs(e.x) - abs(e.y));
+	if (n.z < 0.0f)
+		n.xy = (1.0f - abs(e.yx)) * (e >= 0.0f ? 1.0f : -1.0f);
+	return normalize(n);
+}
+
+void DequantVertex(inout float3 posL, inout float3 normalL, inout float2 tex)
+{
+	posL = posL * gDequant[0].xyz + gDequant[1].xyz;
+	if (gDequant[0].w > 0.0f)
+		normalL = DecodeOctahedral(normalL.xy * gDequant[0].w);
+	tex = tex * gDequant[2].xy + gDequant[2].zw;
+}
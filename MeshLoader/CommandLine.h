@@ -0,0 +1,19 @@
+#ifndef COMMAND_LINE_H
+#define COMMAND_LINE_H
+#include <string>
+#include <string.h>
+
+//value after "option" up to the next space, e.g. "-meshcache=" in "-meshcache=a.obj", empty if it is not there
+inline std::string get_command_line_option(const char* cmdLine, const char* option)
+{
+	const char* found = strstr(cmdLine, option);
+	if (!found)
+		return std::string();
+	found += strlen(option);
+	const char* end = found;
+	while (*end && *end != ' ')
+		end++;
+	return std::string(found, end);
+}
+
+#endif //COMMAND_LINE_H
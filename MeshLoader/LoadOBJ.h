@@ -16,9 +16,15 @@ public:
 	OBJLoader();
 	~OBJLoader();
 
+	//maps the file and parses chunks of it on all cores, faces of any size are fanned into triangles
+	//and corners are deduplicated into the vertices appended after the existing ones
 	bool Load(string file_name,
 		std::vector<VertexXYZNUV>& vertices,
 		std::vector<UINT>& indices);
+	//line by line parser Load replaced, triangles with v/t/n corners only, kept as the benchmark baseline
+	bool LoadReference(string file_name,
+		std::vector<VertexXYZNUV>& vertices,
+		std::vector<UINT>& indices);
 	bool LoadDir(string file_name,
 		std::vector<VertexXYZNUV>& vertices,
 		std::vector<UINT>& indices);
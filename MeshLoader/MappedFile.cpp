@@ -0,0 +1,64 @@
+#include "MappedFile.h"
+
+CMappedFile::CMappedFile()
+	: m_file(INVALID_HANDLE_VALUE)
+	, m_mapping(NULL)
+	, m_data(NULL)
+	, m_size(0)
+{
+}
+
+CMappedFile::~CMappedFile()
+{
+	Close();
+}
+
+bool CMappedFile::Open(const std::string& file_name)
+{
+	Close();
+
+	m_file = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD size_high = 0;
+	DWORD size = GetFileSize(m_file, &size_high);
+	// Empty files cannot be mapped, and the formats read this way never exceed 4GB
+	if (size == INVALID_FILE_SIZE || size == 0 || size_high != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m_mapping)
+	{
+		Close();
+		return false;
+	}
+
+	m_data = (const uchar*)MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!m_data)
+	{
+		Close();
+		return false;
+	}
+	m_size = size;
+	return true;
+}
+
+void CMappedFile::Close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+
+	m_file = INVALID_HANDLE_VALUE;
+	m_mapping = NULL;
+	m_data = NULL;
+	m_size = 0;
+}
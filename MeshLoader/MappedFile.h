@@ -0,0 +1,31 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+#include "baseDefine.h"
+
+/**
+*  Read-only view of a whole file, mapped once so its sections can be
+*  parsed in place instead of read field by field.
+*/
+class CMappedFile
+{
+public:
+	CMappedFile();
+	~CMappedFile();
+
+	bool Open(const std::string& file_name);
+	void Close();
+
+	const uchar* GetData() const { return m_data; }
+	uint32 GetSize() const { return m_size; }
+
+private:
+	CMappedFile(const CMappedFile&);
+	CMappedFile& operator=(const CMappedFile&);
+
+	HANDLE		 m_file;
+	HANDLE		 m_mapping;
+	const uchar* m_data;
+	uint32		 m_size;
+};
+
+#endif //MAPPED_FILE_H
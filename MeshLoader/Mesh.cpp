@@ -1,14 +1,20 @@
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshOptimize.h"
 #include "baseDefine.h"
 #include <algorithm>
+#include <string.h>
 
 CMesh::CMesh()
+	: m_loaded_bytes(0)
+	, m_optimized(false)
+	, m_cache(NULL)
 {
 }
 
 CMesh::~CMesh()
 {
-
+	delete m_cache;
 }
 
 //"D:/res/scene/common/wj/wjmy/slj_wjmy0390_wb.model"
@@ -27,6 +33,7 @@ bool CMesh::Init(std::string file_name, std::string dir, XMFLOAT3& pos)
 			sub.m_group_info.startVertex = 0;
 			sub.m_group_info.vertices = m_mesh_vertex.size();
 			m_submesh_list.push_back(sub);
+			optimize(file_name);
 			return true;
 		}
 		return false;
@@ -34,6 +41,13 @@ bool CMesh::Init(std::string file_name, std::string dir, XMFLOAT3& pos)
 	if (file_name.length() >= 4 &&
 		file_name.substr(file_name.length() - 4, 4) == ".obj")
 	{
+		const string cache_path = get_mesh_cache_path(file_name);
+		if (bUseMeshCache && load_cache(cache_path))
+		{
+			XMStoreFloat4x4(&m_world_transform, XMMatrixTranslation(pos.x, pos.y, pos.z));
+			return true;
+		}
+
 		OBJLoader objloader;
 		if (objloader.Load(file_name, m_mesh_vertex, m_index_list))
 		{
@@ -43,6 +57,10 @@ bool CMesh::Init(std::string file_name, std::string dir, XMFLOAT3& pos)
 			sub.m_group_info.startVertex = 0;
 			sub.m_group_info.vertices = m_mesh_vertex.size();
 			m_submesh_list.push_back(sub);
+			m_source_files.push_back(file_name);
+			optimize(file_name);
+			if (bUseMeshCache)
+				CMeshCache::Write(cache_path, *this, m_source_files, bPackMeshes ? MESH_CACHE_PACKED : MESH_CACHE_INTERLEAVED);
 			XMStoreFloat4x4(&m_world_transform, XMMatrixTranslation(pos.x, pos.y, pos.z));
 			return true;
 		}
@@ -51,12 +69,20 @@ bool CMesh::Init(std::string file_name, std::string dir, XMFLOAT3& pos)
 	if (file_name.length() >= 6 &&
 		file_name.substr(file_name.length() - 6, 6) == ".model")
 	{
+		const string cache_path = get_mesh_cache_path(file_name);
+		if (bUseMeshCache && load_cache(cache_path))
+		{
+			XMStoreFloat4x4(&m_world_transform, XMMatrixTranslation(pos.x, pos.y, pos.z));
+			return true;
+		}
+
 		TiXmlDocument doc(file_name.c_str());
 		if (!doc.LoadFile())
 		{
 			assert(0);
 			return false;
 		}
+		m_source_files.push_back(file_name);
 		TiXmlElement *vis = doc.RootElement()->FirstChildElement("nodelessVisual");
 		if (vis == NULL)
 		{
@@ -74,6 +100,9 @@ bool CMesh::Init(std::string file_name, std::string dir, XMFLOAT3& pos)
 			return false;
 		}
 		read_visual_material(file_name);
+		optimize(file_name);
+		if (bUseMeshCache)
+			CMeshCache::Write(cache_path, *this, m_source_files, bPackMeshes ? MESH_CACHE_PACKED : MESH_CACHE_INTERLEAVED);
 		//create_gpu_data();
 
 		//create_mesh();
@@ -85,6 +114,118 @@ bool CMesh::Init(std::string file_name, std::string dir, XMFLOAT3& pos)
 	
 }
 
+bool CMesh::load_cache(const string& cache_path)
+{
+	CMeshCache* cache = new CMeshCache();
+	if (!cache->Open(cache_path) || !cache->IsCurrent())
+	{
+		delete cache;
+		return false;
+	}
+
+	//caches written before optimizing was turned on are rebuilt
+	const mesh_cache_header& header = cache->GetHeader();
+	if (bOptimizeMeshes && !(header.flags & MESH_CACHE_OPTIMIZED))
+	{
+		delete cache;
+		return false;
+	}
+	m_optimized = (header.flags & MESH_CACHE_OPTIMIZED) != 0;
+	delete m_cache;
+	m_cache = cache;
+	//packed caches load packed, their submesh groups are already the packed ranges
+	if (header.layout == MESH_CACHE_PACKED)
+		m_packed.Assign(cache->GetPackedVertices(), header.vertex_count, cache->GetPackedIndices(), header.index_count,
+			cache->GetPackedSubmeshes(), header.packed_count);
+
+	const mesh_cache_submesh* subs = cache->GetSubmeshes();
+	m_submesh_list.reserve(m_submesh_list.size() + header.submesh_count);
+	for (uint32 i = 0; i < header.submesh_count; i++)
+	{
+		submesh sub(this);
+		sub.m_group_info = subs[i].group;
+		sub.m_mat.m_specular_power = subs[i].specular_power;
+		sub.m_mat.m_diffuse_power = subs[i].diffuse_power;
+		sub.m_mat.m_specular_tex_s = subs[i].specular_tex_s;
+		sub.m_twoSided = subs[i].two_sided != 0;
+		sub.m_alphaTest = subs[i].alpha_test != 0;
+		sub.m_alphaRef = subs[i].alpha_ref;
+
+		//masks are per submesh in the cache, so they are not shared through CTextureCache;
+		//they are copied since a CTGALoader owns its image, they are one byte per texel
+		const uchar* mask = cache->GetAlphaMask(subs[i]);
+		if (mask)
+		{
+			TEXTURE_PTR tex(new CTGALoader());
+			tex->imageWidth = subs[i].mask_width;
+			tex->imageHeight = subs[i].mask_height;
+			tex->byteCount = 1;
+			tex->depth = 8;
+			tex->ctType = 3;
+			tex->size = (uint32)tex->imageWidth * tex->imageHeight;
+			tex->image = new uchar[tex->size];
+			memcpy(tex->image, mask, tex->size);
+			sub.m_diffuse = tex;
+		}
+		m_submesh_list.push_back(sub);
+	}
+
+	m_loaded_bytes += cache->GetSize();
+	return true;
+}
+
+vertex_streams CMesh::GetVertexStreams() const
+{
+	if (IsPacked())
+		return get_interleaved_streams(NULL, 0);
+	if (m_cache)
+		return m_cache->GetVertexStreams();
+	return get_interleaved_streams(m_mesh_vertex.empty() ? NULL : &m_mesh_vertex[0], m_mesh_vertex.size());
+}
+
+uint32 CMesh::GetVertexCount() const
+{
+	return IsPacked() ? m_packed.GetVertexCount() : GetVertexStreams().count;
+}
+
+const UINT* CMesh::GetIndices() const
+{
+	if (IsPacked())
+		return NULL;
+	if (m_cache)
+		return m_cache->GetIndices();
+	return m_index_list.empty() ? NULL : &m_index_list[0];
+}
+
+uint32 CMesh::GetIndexCount() const
+{
+	if (IsPacked())
+		return m_packed.GetIndexCount();
+	if (m_cache)
+		return m_cache->GetHeader().index_count;
+	return m_index_list.size();
+}
+
+bool CMesh::Pack()
+{
+	if (!m_packed.IsEmpty())
+		return true;
+
+	if (!m_packed.Build(GetVertexStreams(), GetIndices(), GetIndexCount(), m_submesh_list))
+		return false;
+
+	vector<group_info> groups;
+	get_packed_groups(m_packed.GetSubmeshes(), m_packed.GetSubmeshCount(), m_submesh_list.size(), groups);
+	for (size_t i = 0; i < m_submesh_list.size(); i++)
+		m_submesh_list[i].m_group_info = groups[i];
+	MESH_VERTEX().swap(m_mesh_vertex);
+	INDEX_LIST().swap(m_index_list);
+	//the packed mesh owns everything now, an unpacked cache it was built from is not read any more
+	delete m_cache;
+	m_cache = NULL;
+	return true;
+}
+
 void CMesh::clear_cpu_data()
 {
 	VERTEX_LIST temp_vertex_list;
@@ -8,6 +8,7 @@
 #include "ModelFileParse.h"
 #include "TGALoader.h"
 #include "LoadOBJ.h"
+#include "PackedMesh.h"
 using std::vector;
 using std::string;
 typedef vector<submesh> SUBMESH_LIST;
@@ -15,6 +16,11 @@ typedef vector<VertexXYZNUVTB> VERTEX_LIST;
 typedef vector<VertexXYZNUV>   MESH_VERTEX;
 typedef vector<UINT> INDEX_LIST;
 
+class CMeshCache;
+
+//diffuse textures are loaded as alpha planes, all the sdf bake and mesh caches read of them
+extern bool bLoadDiffuseAlphaOnly;
+
 class CMesh
 {
 public:
@@ -24,11 +30,43 @@ public:
 	bool Init(string file_name, string dir, XMFLOAT3 & pos);
 	int  getid(){ return m_id; }
 	VERTEX_LIST& GetVertexList() { return m_vertex_list; }
+	/** What the loaders build, both stay empty while the mesh is read from a mesh cache, see GetVertexStreams. */
 	INDEX_LIST& GetIndexList(){ return m_index_list; }
 	MESH_VERTEX& GetMeshVertex(){ return m_mesh_vertex; };
+	/** Float vertices in place, in the mapped mesh cache the mesh was loaded from or in GetMeshVertex.
+	*   Empty while the mesh is packed, its vertices are decoded from GetPackedMesh then. */
+	vertex_streams GetVertexStreams() const;
+	/** Vertices of either kind. */
+	uint32 GetVertexCount() const;
+	/** 32 bit indices in place like the vertices, NULL if the mesh is packed. */
+	const UINT* GetIndices() const;
+	/** Indices of either size. */
+	uint32 GetIndexCount() const;
+	/** True while the mesh reads from the mesh cache it was loaded from, which stays mapped until then. */
+	bool IsCached() const { return m_cache != NULL; }
 	SUBMESH_LIST& GetSubMeshList(){ return m_submesh_list; };
 	XMFLOAT4X4& GetWorldTrans(){ return m_world_transform; };
+	/** Bytes of model files read by Init, for load throughput. */
+	uint32 GetLoadedBytes() const { return m_loaded_bytes; }
+	/** Files the mesh was built from, a mesh cache of it is stale once one of them changes. */
+	const STRING_VECTOR& GetSourceFiles() const { return m_source_files; }
+	/** True once the index and vertex order were optimized, by optimize or in the mesh cache loaded. */
+	bool IsOptimized() const { return m_optimized; }
+	/** Quantizes the mesh into draws with 16 bit indices, unless a packed cache was loaded, and releases GetMeshVertex
+	*   and GetIndexList. The submesh groups follow the packed draws, a mesh cache read until then is closed.
+	*   Fails and keeps the mesh as it is if the submeshes do not split the index buffer, see CPackedMesh::Build. */
+	bool Pack();
+	/** True if GetPackedMesh holds the vertices and indices, GetVertexStreams and GetIndices are empty then. */
+	bool IsPacked() const { return !m_packed.IsEmpty(); }
+	const CPackedMesh& GetPackedMesh() const { return m_packed; }
+private:
+	CMesh(const CMesh&);
+	CMesh& operator=(const CMesh&);
 protected:
+	//keeps the cache mapped, the mesh reads its vertices and indices from it
+	bool load_cache(const string& cache_path);
+	//reorders each submesh for the vertex cache, overdraw and vertex fetch, see MeshOptimize.h
+	void optimize(const string& name);
 	bool read_primitive(const string& file_name, const string& sub_dir = "");
 	void read_visual_material(const string& file_name);
 protected:
@@ -36,8 +74,8 @@ protected:
 	void parse_renderset(TiXmlElement* renderSetElement);
 	void parse_material(TiXmlElement* material_element, int index);
 	int  pad(unsigned long  size, int padding = 4);
-	bool read_vertex(FILE* fp, sec_info& sec);
-	bool read_indexs(FILE* fp, sec_info& sec);
+	bool read_vertex(const uchar* data, sec_info& sec);
+	bool read_indexs(const uchar* data, sec_info& sec);
 	void clear_cpu_data();
 	
 protected:
@@ -49,6 +87,11 @@ protected:
 	MESH_VERTEX             m_mesh_vertex;
 	string					m_vertex_format;
 	int                          m_id;
+	uint32					m_loaded_bytes;
+	bool					m_optimized;
+	CPackedMesh				m_packed;
+	CMeshCache*				m_cache;
+	STRING_VECTOR			m_source_files;
 	string					dir;
 };
 
@@ -0,0 +1,412 @@
+#include "MeshCache.h"
+#include "Mesh.h"
+#include "CommandLine.h"
+#include <stdio.h>
+#include <string.h>
+
+bool bUseMeshCache = true;
+
+static uint32 align16(uint32 size)
+{
+	return (size + 15) & ~15u;
+}
+
+bool get_mesh_cache_source(const std::string& path, mesh_cache_source& source, bool hash)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) || data.nFileSizeHigh != 0)
+		return false;
+
+	source.write_time = ((uint64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	source.size = data.nFileSizeLow;
+	source.path_size = path.size();
+	source.hash = 14695981039346656037ull;
+	if (hash && source.size)
+	{
+		CMappedFile file;
+		if (!file.Open(path))
+			return false;
+		const uchar* bytes = file.GetData();
+		for (uint32 i = 0; i < file.GetSize(); i++)
+			source.hash = (source.hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return true;
+}
+
+CMeshCache::CMeshCache()
+	: m_header(NULL)
+{
+}
+
+CMeshCache::~CMeshCache()
+{
+	Close();
+}
+
+bool CMeshCache::Open(const std::string& cache_path)
+{
+	Close();
+	if (!m_file.Open(cache_path) || m_file.GetSize() < sizeof(mesh_cache_header))
+	{
+		Close();
+		return false;
+	}
+
+	const mesh_cache_header* header = (const mesh_cache_header*)m_file.GetData();
+	const uint64 size = m_file.GetSize();
+	const bool packed = header->layout == MESH_CACHE_PACKED;
+	const uint64 vertex_size = (uint64)header->vertex_count * (packed ? sizeof(packed_vertex) : sizeof(VertexXYZNUV));
+	const uint64 index_size = (uint64)header->index_count * (packed ? sizeof(uint16) : sizeof(UINT));
+	if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION || header->file_size != size ||
+		(header->layout != MESH_CACHE_INTERLEAVED && header->layout != MESH_CACHE_DEINTERLEAVED && !packed) ||
+		header->source_offset > size ||
+		header->submesh_offset + (uint64)header->submesh_count * sizeof(mesh_cache_submesh) > size ||
+		header->vertex_offset + vertex_size > size ||
+		header->index_offset + index_size > size ||
+		header->mask_offset + (uint64)header->mask_size > size ||
+		(packed && header->packed_offset + (uint64)header->packed_count * sizeof(packed_submesh) > size))
+	{
+		Close();
+		return false;
+	}
+
+	const packed_submesh* draws = packed ? (const packed_submesh*)section(header->packed_offset) : NULL;
+	for (uint32 i = 0; packed && i < header->packed_count; i++)
+	{
+		const packed_submesh& draw = draws[i];
+		if (draw.start_index + (uint64)draw.index_count > header->index_count ||
+			draw.base_vertex + (uint64)draw.vertex_count > header->vertex_count ||
+			draw.vertex_count > PACKED_MESH_MAX_VERTICES || draw.source >= header->submesh_count)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	const mesh_cache_submesh* subs = (const mesh_cache_submesh*)section(header->submesh_offset);
+	for (uint32 i = 0; i < header->submesh_count; i++)
+	{
+		const mesh_cache_submesh& sub = subs[i];
+		if (sub.group.startIndex < 0 || sub.group.primitives < 0 || sub.group.startVertex < 0 || sub.group.vertices < 0 ||
+			sub.group.startIndex + (uint64)sub.group.primitives * 3 > header->index_count ||
+			sub.group.startVertex + (uint64)sub.group.vertices > header->vertex_count ||
+			sub.mask_offset + (uint64)sub.mask_width * sub.mask_height > header->mask_size)
+		{
+			Close();
+			return false;
+		}
+	}
+
+	m_header = header;
+	return true;
+}
+
+void CMeshCache::Close()
+{
+	m_file.Close();
+	m_header = NULL;
+}
+
+bool CMeshCache::IsCurrent() const
+{
+	if (!m_header)
+		return false;
+
+	uint32 offset = m_header->source_offset;
+	for (uint32 i = 0; i < m_header->source_count; i++)
+	{
+		if ((uint64)offset + sizeof(mesh_cache_source) > m_header->file_size)
+			return false;
+		mesh_cache_source cached;
+		memcpy(&cached, section(offset), sizeof(cached));
+		offset += sizeof(cached);
+		if ((uint64)offset + cached.path_size > m_header->file_size)
+			return false;
+		const std::string path((const char*)section(offset), cached.path_size);
+		offset += (cached.path_size + 3) & ~3u;
+
+		//a touched but unchanged file, e.g. after a checkout, only costs a hash
+		mesh_cache_source current;
+		if (!get_mesh_cache_source(path, current, false) || current.size != cached.size)
+			return false;
+		if (current.write_time != cached.write_time &&
+			(!get_mesh_cache_source(path, current, true) || current.hash != cached.hash))
+			return false;
+	}
+	return true;
+}
+
+const VertexXYZNUV* CMeshCache::GetVertices() const
+{
+	return m_header->layout == MESH_CACHE_INTERLEAVED ? (const VertexXYZNUV*)section(m_header->vertex_offset) : NULL;
+}
+
+const XMFLOAT3* CMeshCache::GetPositions() const
+{
+	return m_header->layout == MESH_CACHE_DEINTERLEAVED ? (const XMFLOAT3*)section(m_header->vertex_offset) : NULL;
+}
+
+const XMFLOAT3* CMeshCache::GetNormals() const
+{
+	return m_header->layout == MESH_CACHE_DEINTERLEAVED ? GetPositions() + m_header->vertex_count : NULL;
+}
+
+const XMFLOAT2* CMeshCache::GetUVs() const
+{
+	return m_header->layout == MESH_CACHE_DEINTERLEAVED ? (const XMFLOAT2*)(GetNormals() + m_header->vertex_count) : NULL;
+}
+
+vertex_streams CMeshCache::GetVertexStreams() const
+{
+	if (m_header->layout == MESH_CACHE_PACKED)
+		return get_interleaved_streams(NULL, 0);
+	if (m_header->layout == MESH_CACHE_INTERLEAVED)
+		return get_interleaved_streams(GetVertices(), m_header->vertex_count);
+
+	vertex_streams streams;
+	streams.pos = (const uchar*)GetPositions();
+	streams.normal = (const uchar*)GetNormals();
+	streams.uv = (const uchar*)GetUVs();
+	streams.pos_stride = sizeof(XMFLOAT3);
+	streams.normal_stride = sizeof(XMFLOAT3);
+	streams.uv_stride = sizeof(XMFLOAT2);
+	streams.count = m_header->vertex_count;
+	return streams;
+}
+
+const packed_vertex* CMeshCache::GetPackedVertices() const
+{
+	return m_header->layout == MESH_CACHE_PACKED ? (const packed_vertex*)section(m_header->vertex_offset) : NULL;
+}
+
+const uint16* CMeshCache::GetPackedIndices() const
+{
+	return m_header->layout == MESH_CACHE_PACKED ? (const uint16*)section(m_header->index_offset) : NULL;
+}
+
+const packed_submesh* CMeshCache::GetPackedSubmeshes() const
+{
+	return m_header->layout == MESH_CACHE_PACKED ? (const packed_submesh*)section(m_header->packed_offset) : NULL;
+}
+
+const UINT* CMeshCache::GetIndices() const
+{
+	return m_header->layout != MESH_CACHE_PACKED ? (const UINT*)section(m_header->index_offset) : NULL;
+}
+
+const mesh_cache_submesh* CMeshCache::GetSubmeshes() const
+{
+	return (const mesh_cache_submesh*)section(m_header->submesh_offset);
+}
+
+const uchar* CMeshCache::GetAlphaMask(const mesh_cache_submesh& sub) const
+{
+	return sub.mask_width ? section(m_header->mask_offset + sub.mask_offset) : NULL;
+}
+
+bool CMeshCache::Write(const std::string& cache_path, CMesh& mesh, const STRING_VECTOR& sources, mesh_cache_layout layout)
+{
+	SUBMESH_LIST& submesh_list = mesh.GetSubMeshList();
+	vertex_streams vb = mesh.GetVertexStreams();
+	const UINT* ib = mesh.GetIndices();
+	uint32 index_count = mesh.GetIndexCount();
+	const CPackedMesh* packed = mesh.IsPacked() ? &mesh.GetPackedMesh() : NULL;
+
+	//an unpacked mesh is packed into a copy, whose submesh ranges differ from the mesh's;
+	//a packed mesh written in another layout is decoded, with its 32 bit indices back
+	CPackedMesh built;
+	MESH_VERTEX decoded_vb;
+	INDEX_LIST expanded_ib;
+	std::vector<group_info> groups;
+	if (layout == MESH_CACHE_PACKED && !packed)
+	{
+		if (built.Build(vb, ib, index_count, submesh_list))
+		{
+			packed = &built;
+			index_count = built.GetIndexCount();
+			get_packed_groups(built.GetSubmeshes(), built.GetSubmeshCount(), submesh_list.size(), groups);
+		}
+		else
+		{
+			layout = MESH_CACHE_INTERLEAVED;
+		}
+	}
+	else if (layout != MESH_CACHE_PACKED && packed)
+	{
+		packed->Decode(decoded_vb);
+		vb = get_interleaved_streams(decoded_vb.empty() ? NULL : &decoded_vb[0], decoded_vb.size());
+		expand_packed_indices(packed->GetIndices(), packed->GetSubmeshes(), packed->GetSubmeshCount(), expanded_ib);
+		ib = expanded_ib.empty() ? NULL : &expanded_ib[0];
+		index_count = expanded_ib.size();
+		packed = NULL;
+	}
+	const uint32 vertex_count = packed ? packed->GetVertexCount() : vb.count;
+	if (!vertex_count || !index_count)
+		return false;
+
+	std::vector<uchar> source_data;
+	for (size_t i = 0; i < sources.size(); i++)
+	{
+		mesh_cache_source source;
+		if (!get_mesh_cache_source(sources[i], source, true))
+			return false;
+		const uchar* bytes = (const uchar*)&source;
+		source_data.insert(source_data.end(), bytes, bytes + sizeof(source));
+		source_data.insert(source_data.end(), sources[i].begin(), sources[i].end());
+		source_data.resize((source_data.size() + 3) & ~3u);
+	}
+
+	//only alpha tested submeshes keep their texture, and of it only what the alpha test reads
+	std::vector<mesh_cache_submesh> subs(submesh_list.size());
+	std::vector<uchar> masks;
+	for (size_t i = 0; i < submesh_list.size(); i++)
+	{
+		submesh& src = submesh_list[i];
+		mesh_cache_submesh& sub = subs[i];
+		memset(&sub, 0, sizeof(sub));
+		sub.group = groups.empty() ? src.m_group_info : groups[i];
+		sub.specular_power = src.m_mat.m_specular_power;
+		sub.diffuse_power = src.m_mat.m_diffuse_power;
+		sub.specular_tex_s = src.m_mat.m_specular_tex_s;
+		sub.two_sided = src.m_twoSided;
+		sub.alpha_test = src.m_alphaTest;
+		sub.alpha_ref = src.m_alphaRef;
+
+		const CTGALoader* tex = src.m_diffuse.get();
+		if (src.m_alphaTest && tex && tex->image && tex->byteCount)
+		{
+			const uint32 texels = (uint32)tex->imageWidth * tex->imageHeight;
+			sub.mask_width = tex->imageWidth;
+			sub.mask_height = tex->imageHeight;
+			sub.mask_offset = masks.size();
+			masks.resize(align16(masks.size() + texels));
+			for (uint32 t = 0; t < texels; t++)
+				masks[sub.mask_offset + t] = tex->image[t * tex->byteCount + tex->byteCount - 1];
+		}
+	}
+
+	mesh_cache_header header;
+	memset(&header, 0, sizeof(header));
+	header.version = MESH_CACHE_VERSION;
+	header.layout = layout;
+	header.flags = mesh.IsOptimized() ? MESH_CACHE_OPTIMIZED : 0;
+	uint32 offset = align16(sizeof(header));
+	header.source_count = sources.size();
+	header.source_offset = offset;
+	offset = align16(offset + source_data.size());
+	header.submesh_count = subs.size();
+	header.submesh_offset = offset;
+	offset = align16(offset + subs.size() * sizeof(mesh_cache_submesh));
+	header.vertex_count = vertex_count;
+	header.vertex_offset = offset;
+	offset = align16(offset + vertex_count * (packed ? sizeof(packed_vertex) : sizeof(VertexXYZNUV)));
+	header.index_count = index_count;
+	header.index_offset = offset;
+	offset = align16(offset + index_count * (packed ? sizeof(uint16) : sizeof(UINT)));
+	if (packed)
+	{
+		header.packed_count = packed->GetSubmeshCount();
+		header.packed_offset = offset;
+		offset = align16(offset + header.packed_count * sizeof(packed_submesh));
+	}
+	header.mask_size = masks.size();
+	header.mask_offset = offset;
+	offset += masks.size();
+	header.file_size = offset;
+
+	std::vector<uchar> file_data(offset);
+	uchar* data = &file_data[0];
+	memcpy(data, &header, sizeof(header));
+	if (!source_data.empty())
+		memcpy(data + header.source_offset, &source_data[0], source_data.size());
+	if (!subs.empty())
+		memcpy(data + header.submesh_offset, &subs[0], subs.size() * sizeof(mesh_cache_submesh));
+	if (packed)
+	{
+		memcpy(data + header.vertex_offset, packed->GetVertices(), vertex_count * sizeof(packed_vertex));
+	}
+	else if (layout == MESH_CACHE_DEINTERLEAVED)
+	{
+		XMFLOAT3* positions = (XMFLOAT3*)(data + header.vertex_offset);
+		XMFLOAT3* normals = positions + vertex_count;
+		XMFLOAT2* uvs = (XMFLOAT2*)(normals + vertex_count);
+		for (uint32 i = 0; i < vertex_count; i++)
+		{
+			positions[i] = vb.position(i);
+			normals[i] = vb.normal_at(i);
+			uvs[i] = vb.uv_at(i);
+		}
+	}
+	else if (vb.interleaved())
+	{
+		memcpy(data + header.vertex_offset, vb.interleaved(), vertex_count * sizeof(VertexXYZNUV));
+	}
+	else
+	{
+		VertexXYZNUV* vertices = (VertexXYZNUV*)(data + header.vertex_offset);
+		for (uint32 i = 0; i < vertex_count; i++)
+			vertices[i] = vb.vertex(i);
+	}
+	if (packed)
+	{
+		memcpy(data + header.index_offset, packed->GetIndices(), index_count * sizeof(uint16));
+		memcpy(data + header.packed_offset, packed->GetSubmeshes(), header.packed_count * sizeof(packed_submesh));
+	}
+	else
+	{
+		memcpy(data + header.index_offset, ib, index_count * sizeof(UINT));
+	}
+	if (!masks.empty())
+		memcpy(data + header.mask_offset, &masks[0], masks.size());
+
+	//the magic goes in last, so an interrupted write never looks like a cache
+	FILE* fp = fopen(cache_path.c_str(), "wb");
+	if (!fp)
+		return false;
+	bool ok = fwrite(data, 1, file_data.size(), fp) == file_data.size();
+	const uint32 magic = MESH_CACHE_MAGIC;
+	ok = ok && fflush(fp) == 0 && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&magic, sizeof(magic), 1, fp) == 1;
+	ok = fclose(fp) == 0 && ok;
+	if (!ok)
+		remove(cache_path.c_str());
+	return ok;
+}
+
+bool IsMeshCacheCommandLine(const char* cmdLine)
+{
+	return cmdLine && strstr(cmdLine, "-meshcache=") != NULL;
+}
+
+int RunMeshCacheConverter(const char* cmdLine)
+{
+	std::string list = get_command_line_option(cmdLine, "-meshcache=");
+	const std::string dir = get_command_line_option(cmdLine, "-meshcache-dir=");
+	const std::string layout_name = get_command_line_option(cmdLine, "-meshcache-layout=");
+	const mesh_cache_layout layout = layout_name == "deinterleaved" ? MESH_CACHE_DEINTERLEAVED :
+		(layout_name == "interleaved" ? MESH_CACHE_INTERLEAVED : MESH_CACHE_PACKED);
+
+	//always rebuilt from the sources, whatever caches are already there
+	bUseMeshCache = false;
+	int failed = 0;
+	while (!list.empty())
+	{
+		const size_t separator = list.find(';');
+		const std::string file_name = list.substr(0, separator);
+		list = separator == std::string::npos ? std::string() : list.substr(separator + 1);
+		if (file_name.empty())
+			continue;
+
+		CMesh mesh;
+		XMFLOAT3 pos(0, 0, 0);
+		const std::string cache_path = get_mesh_cache_path(file_name);
+		const bool ok = mesh.Init(file_name, dir, pos) &&
+			CMeshCache::Write(cache_path, mesh, mesh.GetSourceFiles(), layout);
+		failed += ok ? 0 : 1;
+
+		char buffer[512];
+		sprintf(buffer, "%s %s: %u vertices, %u indices, %u sources\n", ok ? "wrote" : "failed", cache_path.c_str(),
+			mesh.GetVertexCount(), mesh.GetIndexCount(), (UINT)mesh.GetSourceFiles().size());
+		OutputDebugStringA(buffer);
+	}
+	return failed ? 1 : 0;
+}
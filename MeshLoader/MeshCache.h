@@ -0,0 +1,146 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+#include "baseDefine.h"
+#include "MappedFile.h"
+#include "submesh.h"
+#include "PackedMesh.h"
+
+class CMesh;
+
+#define MESH_CACHE_MAGIC		0x4348534d	//"MSHC"
+#define MESH_CACHE_VERSION		3
+#define MESH_CACHE_FILE			".meshcache"
+
+//how the vertex section is laid out
+enum mesh_cache_layout
+{
+	//VertexXYZNUV array, copied straight into vertex buffers
+	MESH_CACHE_INTERLEAVED = 0,
+	//positions, then normals, then uvs, each one packed array, positions are what the sdf bake reads
+	MESH_CACHE_DEINTERLEAVED = 1,
+	//packed_vertex array and 16 bit indices of a CPackedMesh, its draws in the packed section
+	MESH_CACHE_PACKED = 2,
+};
+
+//mesh_cache_header::flags
+#define MESH_CACHE_OPTIMIZED	0x1		//triangles and vertices were reordered by CMesh::optimize
+
+//a file the cache was built from, it is stale once any of them changed
+struct mesh_cache_source
+{
+	uint64		  write_time;
+	uint64		  hash;			//FNV-1a of the contents, checked when only the time differs
+	uint32		  size;
+	uint32		  path_size;	//followed by the path, padded to 4 bytes
+};
+
+struct mesh_cache_submesh
+{
+	group_info	  group;
+	float		  specular_power;
+	float		  diffuse_power;
+	float		  specular_tex_s;
+	uchar		  two_sided;
+	uchar		  alpha_test;
+	uchar		  alpha_ref;
+	uchar		  pad;
+	uint16		  mask_width;	//0 if the submesh has no alpha mask
+	uint16		  mask_height;
+	uint32		  mask_offset;	//into the mask section, one alpha byte per texel
+};
+
+//every offset is from the start of the file and 16 byte aligned
+struct mesh_cache_header
+{
+	uint32		  magic;
+	uint32		  version;
+	uint32		  layout;
+	uint32		  file_size;
+	uint32		  source_count;
+	uint32		  source_offset;
+	uint32		  submesh_count;
+	uint32		  submesh_offset;
+	uint32		  vertex_count;
+	uint32		  vertex_offset;
+	uint32		  index_count;
+	uint32		  index_offset;
+	uint32		  mask_size;
+	uint32		  mask_offset;
+	uint32		  flags;
+	uint32		  packed_count;		//packed_submesh draws, only in MESH_CACHE_PACKED
+	uint32		  packed_offset;
+};
+
+//CMesh::Init reads and writes caches next to the source files while this is set
+extern bool bUseMeshCache;
+
+inline std::string get_mesh_cache_path(const std::string& source_path)
+{
+	return source_path + MESH_CACHE_FILE;
+}
+
+//size, write time and optionally the content hash of a source file
+bool get_mesh_cache_source(const std::string& path, mesh_cache_source& source, bool hash);
+
+/**
+*  Binary mesh container built from .model/.primitives/.visual, OBJ and TGA sources.
+*  The file is mapped and every section is used in place, a CMesh loaded from it keeps the
+*  mapping and reads its vertices and indices from it, see CMesh::GetVertexStreams.
+*/
+class CMeshCache
+{
+public:
+	CMeshCache();
+	~CMeshCache();
+
+	//maps the file and checks every section lies inside it
+	bool Open(const std::string& cache_path);
+	void Close();
+
+	//true if no source file changed since the cache was written
+	bool IsCurrent() const;
+
+	const mesh_cache_header& GetHeader() const { return *m_header; }
+	uint32 GetSize() const { return m_file.GetSize(); }
+
+	//NULL unless the layout is MESH_CACHE_INTERLEAVED
+	const VertexXYZNUV* GetVertices() const;
+	//NULL unless the layout is MESH_CACHE_DEINTERLEAVED
+	const XMFLOAT3* GetPositions() const;
+	const XMFLOAT3* GetNormals() const;
+	const XMFLOAT2* GetUVs() const;
+	//the float vertex section in place, empty if the layout is MESH_CACHE_PACKED
+	vertex_streams GetVertexStreams() const;
+
+	//NULL unless the layout is MESH_CACHE_PACKED
+	const packed_vertex* GetPackedVertices() const;
+	const uint16* GetPackedIndices() const;
+	const packed_submesh* GetPackedSubmeshes() const;
+
+	//NULL if the layout is MESH_CACHE_PACKED
+	const UINT* GetIndices() const;
+	const mesh_cache_submesh* GetSubmeshes() const;
+	//alpha bytes of the submesh's diffuse texture, NULL if it has none
+	const uchar* GetAlphaMask(const mesh_cache_submesh& sub) const;
+
+	//writes the mesh and the stamps of its sources, sources that cannot be read fail the write;
+	//meshes CPackedMesh cannot pack are written interleaved instead of packed
+	static bool Write(const std::string& cache_path, CMesh& mesh, const STRING_VECTOR& sources, mesh_cache_layout layout);
+
+private:
+	CMeshCache(const CMeshCache&);
+	CMeshCache& operator=(const CMeshCache&);
+
+	const uchar* section(uint32 offset) const { return m_file.GetData() + offset; }
+
+	CMappedFile				 m_file;
+	const mesh_cache_header* m_header;
+};
+
+//headless converter run instead of the demo window for "-meshcache=a.model;b.obj",
+//"-meshcache-dir=D:/" is the resource dir of .model files, "-meshcache-layout=interleaved" or "deinterleaved" picks
+//another layout than packed
+bool IsMeshCacheCommandLine(const char* cmdLine);
+int RunMeshCacheConverter(const char* cmdLine);
+
+#endif //MESH_CACHE_H
@@ -0,0 +1,377 @@
+#include "MeshOptimize.h"
+#include "Mesh.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+
+bool bOptimizeMeshes = true;
+bool bOptimizeOverdraw = true;
+__declspec(thread) bool parallel_for_serial = false;
+
+//lru cache the triangle order is scored for, larger than the fifo so the order suits any cache size
+#define FORSYTH_CACHE_SIZE		32
+#define FORSYTH_MAX_VALENCE		32
+
+static void get_index_range(const UINT* indices, uint32 index_count, UINT& lo, UINT& hi)
+{
+	lo = indices[0];
+	hi = indices[0];
+	for (uint32 i = 1; i < index_count; i++)
+	{
+		lo = (std::min)(lo, indices[i]);
+		hi = (std::max)(hi, indices[i]);
+	}
+}
+
+float compute_acmr(const UINT* indices, uint32 index_count, uint32 cache_size)
+{
+	if (index_count < 3)
+		return 0.0f;
+	UINT lo, hi;
+	get_index_range(indices, index_count, lo, hi);
+
+	//a vertex is cached while fewer than cache_size misses happened since its own
+	vector<uint32> cached_at(hi - lo + 1, 0);
+	uint32 time = cache_size + 1;
+	uint32 misses = 0;
+	for (uint32 i = 0; i < index_count; i++)
+	{
+		uint32& stamp = cached_at[indices[i] - lo];
+		if (time - stamp > cache_size)
+		{
+			stamp = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (index_count / 3);
+}
+
+void optimize_vertex_cache(UINT* indices, uint32 index_count)
+{
+	const uint32 tri_count = index_count / 3;
+	if (tri_count < 2)
+		return;
+	UINT lo, hi;
+	get_index_range(indices, tri_count * 3, lo, hi);
+	const uint32 vertex_count = hi - lo + 1;
+
+	float cache_scores[FORSYTH_CACHE_SIZE];
+	for (int i = 0; i < FORSYTH_CACHE_SIZE; i++)
+	{
+		//the last triangle's vertices score a little less, so strips do not double back
+		cache_scores[i] = i < 3 ? 0.75f : powf(1.0f - (i - 3) / (float)(FORSYTH_CACHE_SIZE - 3), 1.5f);
+	}
+	float valence_scores[FORSYTH_MAX_VALENCE + 1];
+	valence_scores[0] = 0.0f;
+	for (int i = 1; i <= FORSYTH_MAX_VALENCE; i++)
+	{
+		//vertices with few triangles left are finished first
+		valence_scores[i] = 2.0f / sqrtf((float)i);
+	}
+
+	//triangles of each vertex not emitted yet, the first live[v] of its list
+	vector<uint32> live(vertex_count, 0);
+	for (uint32 i = 0; i < tri_count * 3; i++)
+		live[indices[i] - lo]++;
+	vector<uint32> offsets(vertex_count + 1, 0);
+	for (uint32 v = 0; v < vertex_count; v++)
+		offsets[v + 1] = offsets[v] + live[v];
+	vector<uint32> adjacency(tri_count * 3);
+	vector<uint32> fill(offsets.begin(), offsets.end() - 1);
+	for (uint32 i = 0; i < tri_count * 3; i++)
+		adjacency[fill[indices[i] - lo]++] = i / 3;
+
+	vector<int> cache_pos(vertex_count, -1);
+	vector<float> vertex_score(vertex_count);
+	for (uint32 v = 0; v < vertex_count; v++)
+		vertex_score[v] = live[v] ? valence_scores[(std::min)(live[v], (uint32)FORSYTH_MAX_VALENCE)] : 0.0f;
+	vector<float> tri_score(tri_count);
+	vector<uchar> emitted(tri_count, 0);
+	int best = 0;
+	for (uint32 t = 0; t < tri_count; t++)
+	{
+		tri_score[t] = vertex_score[indices[t * 3] - lo] + vertex_score[indices[t * 3 + 1] - lo] + vertex_score[indices[t * 3 + 2] - lo];
+		if (tri_score[t] > tri_score[best])
+			best = t;
+	}
+
+	vector<UINT> result(tri_count * 3);
+	uint32 cache[FORSYTH_CACHE_SIZE + 3];
+	uint32 cache_count = 0;
+	uint32 scan = 0;
+	for (uint32 out = 0; out < tri_count; out++)
+	{
+		if (best < 0)
+		{
+			//nothing in the cache has triangles left, continue with the next one in source order
+			while (emitted[scan])
+				scan++;
+			best = scan;
+		}
+		const UINT* tri = indices + best * 3;
+		result[out * 3] = tri[0];
+		result[out * 3 + 1] = tri[1];
+		result[out * 3 + 2] = tri[2];
+		emitted[best] = 1;
+
+		//the triangle's vertices move to the front of the cache, pushing the rest back
+		uint32 new_cache[FORSYTH_CACHE_SIZE + 3];
+		uint32 new_count = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const uint32 v = tri[k] - lo;
+			uint32* list = &adjacency[offsets[v]];
+			for (uint32 j = 0; j < live[v]; j++)
+			{
+				if (list[j] == (uint32)best)
+				{
+					list[j] = list[live[v] - 1];
+					break;
+				}
+			}
+			live[v]--;
+			if (std::find(new_cache, new_cache + new_count, v) == new_cache + new_count)
+				new_cache[new_count++] = v;
+		}
+		for (uint32 j = 0; j < cache_count; j++)
+		{
+			if (std::find(new_cache, new_cache + new_count, cache[j]) == new_cache + new_count)
+				new_cache[new_count++] = cache[j];
+		}
+
+		best = -1;
+		float best_score = -1.0f;
+		for (uint32 j = 0; j < new_count; j++)
+		{
+			const uint32 v = new_cache[j];
+			cache_pos[v] = j < FORSYTH_CACHE_SIZE ? (int)j : -1;
+			vertex_score[v] = live[v] ? valence_scores[(std::min)(live[v], (uint32)FORSYTH_MAX_VALENCE)] +
+				(cache_pos[v] >= 0 ? cache_scores[cache_pos[v]] : 0.0f) : 0.0f;
+		}
+		for (uint32 j = 0; j < new_count; j++)
+		{
+			const uint32 v = new_cache[j];
+			const uint32* list = &adjacency[offsets[v]];
+			for (uint32 k = 0; k < live[v]; k++)
+			{
+				const uint32 t = list[k];
+				const UINT* other = indices + t * 3;
+				tri_score[t] = vertex_score[other[0] - lo] + vertex_score[other[1] - lo] + vertex_score[other[2] - lo];
+				if (tri_score[t] > best_score)
+				{
+					best_score = tri_score[t];
+					best = t;
+				}
+			}
+		}
+		cache_count = (std::min)(new_count, (uint32)FORSYTH_CACHE_SIZE);
+		std::copy(new_cache, new_cache + cache_count, cache);
+	}
+	std::copy(result.begin(), result.end(), indices);
+}
+
+struct overdraw_cluster
+{
+	uint32 first;
+	uint32 count;
+	float  sort_key;
+};
+
+static bool draws_before(const overdraw_cluster& a, const overdraw_cluster& b)
+{
+	return a.sort_key > b.sort_key;
+}
+
+void optimize_overdraw(UINT* indices, uint32 index_count, const VertexXYZNUV* vertices, uint32 cache_size)
+{
+	const uint32 tri_count = index_count / 3;
+	if (tri_count < 2)
+		return;
+	UINT lo, hi;
+	get_index_range(indices, tri_count * 3, lo, hi);
+
+	//a triangle missing the cache with all three vertices starts a cluster, so moving
+	//clusters around costs few extra transforms
+	vector<overdraw_cluster> clusters;
+	vector<uint32> cached_at(hi - lo + 1, 0);
+	uint32 time = cache_size + 1;
+	for (uint32 t = 0; t < tri_count; t++)
+	{
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			uint32& stamp = cached_at[indices[t * 3 + k] - lo];
+			if (time - stamp > cache_size)
+			{
+				stamp = time++;
+				misses++;
+			}
+		}
+		if (misses == 3 || clusters.empty())
+		{
+			overdraw_cluster cluster = { t, 0, 0.0f };
+			clusters.push_back(cluster);
+		}
+		clusters.back().count++;
+	}
+	if (clusters.size() < 2)
+		return;
+
+	//area weighted centroids and normals, the cross products are twice the area times the normal
+	vector<float> cluster_data(clusters.size() * 6, 0.0f);
+	float mesh_center[3] = { 0.0f, 0.0f, 0.0f };
+	float mesh_area = 0.0f;
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		float* center = &cluster_data[c * 6];
+		float* normal = center + 3;
+		float area = 0.0f;
+		for (uint32 t = clusters[c].first; t < clusters[c].first + clusters[c].count; t++)
+		{
+			const XMFLOAT3& p0 = vertices[indices[t * 3]].pos_;
+			const XMFLOAT3& p1 = vertices[indices[t * 3 + 1]].pos_;
+			const XMFLOAT3& p2 = vertices[indices[t * 3 + 2]].pos_;
+			const float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+			const float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+			const float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			const float a = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			center[0] += (p0.x + p1.x + p2.x) * a / 3.0f;
+			center[1] += (p0.y + p1.y + p2.y) * a / 3.0f;
+			center[2] += (p0.z + p1.z + p2.z) * a / 3.0f;
+			normal[0] += n[0];
+			normal[1] += n[1];
+			normal[2] += n[2];
+			area += a;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			mesh_center[k] += center[k];
+			if (area > 0.0f)
+				center[k] /= area;
+		}
+		mesh_area += area;
+	}
+	for (int k = 0; k < 3 && mesh_area > 0.0f; k++)
+		mesh_center[k] /= mesh_area;
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		const float* center = &cluster_data[c * 6];
+		const float* normal = center + 3;
+		const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		float key = 0.0f;
+		for (int k = 0; k < 3; k++)
+			key += (center[k] - mesh_center[k]) * normal[k];
+		clusters[c].sort_key = length > 0.0f ? key / length : 0.0f;
+	}
+	std::stable_sort(clusters.begin(), clusters.end(), draws_before);
+
+	vector<UINT> result;
+	result.reserve(tri_count * 3);
+	for (size_t c = 0; c < clusters.size(); c++)
+		result.insert(result.end(), indices + clusters[c].first * 3, indices + (clusters[c].first + clusters[c].count) * 3);
+	std::copy(result.begin(), result.end(), indices);
+}
+
+void optimize_vertex_fetch(UINT* indices, uint32 index_count, VertexXYZNUV* vertices, uint32 first_vertex, uint32 vertex_count)
+{
+	const UINT unused = 0xffffffff;
+	vector<UINT> remap(vertex_count, unused);
+	UINT next = 0;
+	for (uint32 i = 0; i < index_count; i++)
+	{
+		UINT& slot = remap[indices[i] - first_vertex];
+		if (slot == unused)
+			slot = next++;
+		indices[i] = first_vertex + slot;
+	}
+	for (uint32 v = 0; v < vertex_count; v++)
+	{
+		if (remap[v] == unused)
+			remap[v] = next++;
+	}
+
+	vector<VertexXYZNUV> moved(vertex_count);
+	for (uint32 v = 0; v < vertex_count; v++)
+		moved[remap[v]] = vertices[first_vertex + v];
+	std::copy(moved.begin(), moved.end(), vertices + first_vertex);
+}
+
+void CMesh::optimize(const string& name)
+{
+	if (!bOptimizeMeshes || m_index_list.empty() || m_mesh_vertex.empty())
+		return;
+
+	//submeshes with triangles outside the buffers or shared with another submesh are left alone
+	const int index_count = (int)m_index_list.size();
+	const int vertex_count = (int)m_mesh_vertex.size();
+	vector<group_info*> groups;
+	for (size_t i = 0; i < m_submesh_list.size(); i++)
+	{
+		group_info& g = m_submesh_list[i].m_group_info;
+		if (g.startIndex >= 0 && g.primitives > 0 && g.startIndex + g.primitives * 3 <= index_count)
+			groups.push_back(&g);
+	}
+	std::sort(groups.begin(), groups.end(), [](const group_info* a, const group_info* b) { return a->startIndex < b->startIndex; });
+	vector<group_info*> disjoint;
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		const bool overlaps_prev = i > 0 && groups[i - 1]->startIndex + groups[i - 1]->primitives * 3 > groups[i]->startIndex;
+		const bool overlaps_next = i + 1 < groups.size() && groups[i]->startIndex + groups[i]->primitives * 3 > groups[i + 1]->startIndex;
+		if (!overlaps_prev && !overlaps_next)
+			disjoint.push_back(groups[i]);
+	}
+	if (disjoint.empty())
+		return;
+
+	const float acmr_before = compute_acmr(&m_index_list[0], index_count, MESH_OPTIMIZE_FIFO_SIZE);
+	UINT* indices = &m_index_list[0];
+	parallel_for((int)disjoint.size(), [&](int i)
+	{
+		const group_info& g = *disjoint[i];
+		optimize_vertex_cache(indices + g.startIndex, g.primitives * 3);
+		if (bOptimizeOverdraw)
+			optimize_overdraw(indices + g.startIndex, g.primitives * 3, &m_mesh_vertex[0], MESH_OPTIMIZE_FIFO_SIZE);
+	});
+
+	//vertices move only inside ranges no other triangles reach into
+	uint32 covered = 0;
+	for (size_t i = 0; i < disjoint.size(); i++)
+		covered += disjoint[i]->primitives * 3;
+	vector<group_info*> fetch;
+	if (covered == (uint32)index_count)
+	{
+		for (size_t i = 0; i < disjoint.size(); i++)
+		{
+			const group_info& g = *disjoint[i];
+			if (g.startVertex < 0 || g.vertices <= 0 || g.startVertex + g.vertices > vertex_count)
+				continue;
+			UINT lo, hi;
+			get_index_range(indices + g.startIndex, g.primitives * 3, lo, hi);
+			if (lo >= (UINT)g.startVertex && hi < (UINT)(g.startVertex + g.vertices))
+				fetch.push_back(disjoint[i]);
+		}
+		std::sort(fetch.begin(), fetch.end(), [](const group_info* a, const group_info* b) { return a->startVertex < b->startVertex; });
+		for (size_t i = 1; i < fetch.size(); i++)
+		{
+			if (fetch[i - 1]->startVertex + fetch[i - 1]->vertices > fetch[i]->startVertex)
+			{
+				fetch.clear();
+				break;
+			}
+		}
+	}
+	parallel_for((int)fetch.size(), [&](int i)
+	{
+		const group_info& g = *fetch[i];
+		optimize_vertex_fetch(indices + g.startIndex, g.primitives * 3, &m_mesh_vertex[0], g.startVertex, g.vertices);
+	});
+	m_optimized = true;
+
+	const float acmr_after = compute_acmr(indices, index_count, MESH_OPTIMIZE_FIFO_SIZE);
+	char buffer[512];
+	sprintf(buffer, "optimized %s: %u triangles in %u submeshes, ACMR %.3f -> %.3f\n", name.c_str(),
+		(uint32)index_count / 3, (uint32)disjoint.size(), acmr_before, acmr_after);
+	OutputDebugStringA(buffer);
+}
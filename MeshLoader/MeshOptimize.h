@@ -0,0 +1,27 @@
+#ifndef MESH_OPTIMIZE_H
+#define MESH_OPTIMIZE_H
+#include "baseDefine.h"
+
+//fifo size the average cache miss ratio is reported for, about what pre-transform-cache d3d9 parts have
+#define MESH_OPTIMIZE_FIFO_SIZE		16
+
+//CMesh::Init reorders loaded triangles and vertices while set, caches record that they were
+extern bool bOptimizeMeshes;
+//clusters of each submesh are also sorted so outward facing ones draw first
+extern bool bOptimizeOverdraw;
+
+//vertices transformed per triangle with a fifo cache of cache_size, 3 at worst and about 0.5 at best
+float compute_acmr(const UINT* indices, uint32 index_count, uint32 cache_size);
+
+//reorders the triangles for post-transform cache reuse, Forsyth's linear speed greedy order
+void optimize_vertex_cache(UINT* indices, uint32 index_count);
+
+//splits cache optimized triangles where the fifo cache starts over and draws the clusters facing
+//away from the mesh center first, the cache order inside each cluster is kept
+void optimize_overdraw(UINT* indices, uint32 index_count, const VertexXYZNUV* vertices, uint32 cache_size);
+
+//renumbers the vertices of [first_vertex, first_vertex + vertex_count) in the order indices first use
+//them, unused ones go last; every index has to lie in the range
+void optimize_vertex_fetch(UINT* indices, uint32 index_count, VertexXYZNUV* vertices, uint32 first_vertex, uint32 vertex_count);
+
+#endif //MESH_OPTIMIZE_H
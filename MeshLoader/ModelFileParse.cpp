@@ -4,12 +4,15 @@
 #include <memory.h>
 #include <direct.h>
 #include "Mesh.h"
+#include "MappedFile.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <emmintrin.h>
 #include "tinyxml.h"
 //#pragma optimize("", off)
 extern bool  bLoadTexture;
+bool bLoadDiffuseAlphaOnly = true;
 
 int CMesh::pad(unsigned long size, int padding)
 {
@@ -21,7 +24,6 @@ int CMesh::pad(unsigned long size, int padding)
 //file_name = "D:/res/scene/common/db/dbsk/xsc_dbsk0010_wb_large"
 bool CMesh::read_primitive(const std::string& file_name, const std::string& sub_dir)
 {
-	FILE *fp;
 	std::string full_path;
 	get_res_dir(full_path);
 	if (!sub_dir.empty())
@@ -29,107 +31,95 @@ bool CMesh::read_primitive(const std::string& file_name, const std::string& sub_
 	full_path += file_name;
 	full_path += ".primitives"; //primitive file
 
-	fp = fopen(full_path.c_str(), "rb");
-	if (!fp)
+	// The whole container is mapped once, the section index and sections are parsed in place
+	CMappedFile file;
+	if (!file.Open(full_path))
 	{
 		assert(0);
 		//Log::get_instance()->LogMessage("open failed in read_primitive");
 		return false;
 	}
+	const uchar* data = file.GetData();
+	const unsigned long fsize = file.GetSize();
 
 	int MAGIC_NUMBER = 0x42a14e65;
-	unsigned long magic_number = 0;
-
-	fread(&magic_number, 4, 1, fp);
+	uint32 magic_number = 0;
+	uint32 index_size = 0;
+	if (fsize >= 8)
+	{
+		memcpy(&magic_number, data, 4);
+		memcpy(&index_size, data + fsize - 4, 4);
+	}
 
-	if (magic_number != MAGIC_NUMBER)
+	if (magic_number != MAGIC_NUMBER || index_size > fsize - 8)
 	{
 		assert(0);
 		//Log::get_instance()->LogMessage("magic number error read_primitive");
-		fclose(fp);
 		return false;
 	}
-
-	unsigned long index_size = 0;
-	fseek(fp, -4, SEEK_END);
-	fread(&index_size, 4, 1, fp);
 	assert((index_size % 4) == 0);
 
-
-	fseek(fp, -4 - index_size, SEEK_END);
+	const uchar* index_data = data + fsize - 4 - index_size;
 	unsigned long readsize = 0;
 	unsigned long calc_size = 0;
 	calc_size += sizeof(magic_number);
 
 	sec_info_vector sec_list;
-	unsigned long index = 0;
-
-	char sec_file_name[MAX_PATH];//һ㲻ᳬ256;
-	while (readsize < index_size)
+	while (readsize + 4 * 6 <= index_size)
 	{
-		unsigned long nums[6];
-		fread(nums, 4, 6, fp);
+		uint32 nums[6];
+		memcpy(nums, index_data + readsize, 4 * 6);
 		readsize += 4 * 6;
 		unsigned long sec_size = nums[0];
 		unsigned long secname_size = nums[5];
-		std::string scename;
-		memset(sec_file_name, 0, MAX_PATH);
-		fread(sec_file_name, 1, secname_size, fp);
-		readsize += secname_size;
-
-		int pad_size = pad(secname_size);
-		if (pad_size)
-		{
-			int pad_size_content;
-			fread(&pad_size_content, 1, pad_size, fp); // pad to 4bytes
-			readsize += pad_size;
-		}
+		if (secname_size >= MAX_PATH || readsize + secname_size > index_size)
+			return false;
 
 		sec_info new_sec;
-		new_sec.sec_file_name = sec_file_name;
+		new_sec.sec_file_name.assign((const char*)index_data + readsize, strnlen((const char*)index_data + readsize, secname_size));
+		readsize += secname_size;
+		readsize += pad(secname_size); // pad to 4bytes
+
 		new_sec.sec_size = sec_size;
 		new_sec.offset = calc_size;
 		sec_list.push_back(new_sec);
 
 		calc_size += sec_size;
 		calc_size += pad(sec_size);
-
-		index++;
 	}
 
-
 	calc_size += index_size;
 	calc_size += 4;
 
-	fseek(fp, 0, SEEK_END);
-	unsigned long fsize = ftell(fp);
+	// Sections are read straight from the mapping, so they must all lie inside the file
 	assert(fsize == calc_size);
+	if (fsize != calc_size)
+		return false;
 
 	for (size_t i = 0; i < sec_list.size(); i++)
 	{
 		if (sec_list[i].sec_file_name.find(VERTEX) != std::string::npos ||
 			sec_list[i].sec_file_name == VERTEX)
 		{
-			if (!read_vertex(fp, sec_list[i]))
+			if (!read_vertex(data, sec_list[i]))
 			{
 				assert(0);
-				fclose(fp);
 				return false;
 			}
 		}
 		else if (sec_list[i].sec_file_name.find(INDEX) != std::string::npos ||
 			sec_list[i].sec_file_name == INDEX)
 		{
-			if (!read_indexs(fp, sec_list[i]))
+			if (!read_indexs(data, sec_list[i]))
 			{
 				//assert(0);
-				fclose(fp);
 				return false;
 			}
 		}
 	}
 
-	fclose(fp);
+	m_loaded_bytes += fsize;
+	m_source_files.push_back(full_path);
 	return true;
 }
 
@@ -145,9 +135,68 @@ void unpackNormal(uint32 packNromal, XMFLOAT3& ret)
 	ret.z = (float)(z) / 511.0f;
 }
 
-bool CMesh::read_vertex(FILE* fp, sec_info& sec)
+static const vertex_format_info s_vertex_formats[] =
 {
-	if (!fp)
+	//name							stride						tangent	bitangent
+	{ VERTEX_FORMAT_XYZNUVTB,		12 + 4 + 8 + 4 + 4,			24,		28 },
+	{ VERTEX_FORMAT_XYZNUV,			12 + 4 + 8,					-1,		-1 },
+	{ VERTEX_FORMAT_XYZNUV2TB,		12 + 4 + 8 + 8 + 4 + 4,		32,		36 },	//uv2 before tb
+	{ VERTEX_FORMAT_XYZNUVIIIWWTB,	12 + 4 + 8 + 5 + 4 + 4,		29,		33 },	//3 indices, 2 weights before tb
+	{ VERTEX_FORMAT_XYZNUVIIIIWWWTB,	0,							-1,		-1 },
+	{ VERTEX_FORMAT_XYZNUVP2,		12 + 4 + 8 + 16,			-1,		-1 },	//p 8 bit
+	{ VERTEX_FORMAT_XYZNUVTBP2,		12 + 4 + 8 + 4 + 4 + 16,	24,		28 },	//p 8 bit after tb
+};
+
+const vertex_format_info* find_vertex_format(const std::string& name)
+{
+	for (size_t i = 0; i < sizeof(s_vertex_formats) / sizeof(s_vertex_formats[0]); i++)
+	{
+		if (name == s_vertex_formats[i].name)
+			return &s_vertex_formats[i];
+	}
+	return NULL;
+}
+
+void unpackNormals(const uchar* src, uint32 src_stride, XMFLOAT3* dst, uint32 dst_stride, uint32 count)
+{
+	const __m128 scale_xy = _mm_set1_ps(1023.0f);
+	const __m128 scale_z = _mm_set1_ps(511.0f);
+	uchar* out = (uchar*)dst;
+	uint32 i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		uint32 packed[4];
+		for (int j = 0; j < 4; j++)
+			memcpy(&packed[j], src + (i + j) * src_stride, sizeof(uint32));
+		const __m128i p = _mm_loadu_si128((const __m128i*)packed);
+
+		//same sign extending shifts as unpackNormal, on four normals per instruction
+		__m128 x = _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(p, 21), 21)), scale_xy);
+		__m128 y = _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(p, 10), 21)), scale_xy);
+		__m128 z = _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(p, 22)), scale_z);
+
+		//xyz rows to one xyz_ row per normal
+		__m128 w = _mm_setzero_ps();
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		float normals[4][4];
+		_mm_storeu_ps(normals[0], x);
+		_mm_storeu_ps(normals[1], y);
+		_mm_storeu_ps(normals[2], z);
+		_mm_storeu_ps(normals[3], w);
+		for (int j = 0; j < 4; j++)
+			memcpy(out + (i + j) * dst_stride, normals[j], sizeof(XMFLOAT3));
+	}
+	for (; i < count; i++)
+	{
+		uint32 packed;
+		memcpy(&packed, src + i * src_stride, sizeof(uint32));
+		unpackNormal(packed, *(XMFLOAT3*)(out + i * dst_stride));
+	}
+}
+
+bool CMesh::read_vertex(const uchar* data, sec_info& sec)
+{
+	if (!data || sec.sec_size < 64 + sizeof(int))
 	{
 		assert(0);
 		//Log::get_instance()->LogMessage("CMesh::read_vertex file is null");
@@ -156,9 +205,10 @@ bool CMesh::read_vertex(FILE* fp, sec_info& sec)
 	char vertexformat[128];
 	int  vertex_number = 0;
 	memset(vertexformat, 0, 128);
-	fseek(fp, sec.offset, SEEK_SET);
-	fread(&vertexformat, 1, 64, fp);
-	fread(&vertex_number, sizeof(int), 1, fp);
+	const uchar* src = data + sec.offset;
+	memcpy(vertexformat, src, 64);
+	memcpy(&vertex_number, src + 64, sizeof(int));
+	src += 64 + sizeof(int);
 	m_vertex_format = vertexformat;
 
 	std::string vertexFormatClean = "";
@@ -174,20 +224,7 @@ bool CMesh::read_vertex(FILE* fp, sec_info& sec)
 		}
 	}
 
-	bool b_uv2 = false;
-	if (vertexFormatClean.find("2uv") != std::string::npos || vertexFormatClean.find("uv2") != std::string::npos)
-	{
-		b_uv2 = true;
-	}
-
-
-	if (vertexFormatClean != VERTEX_FORMAT_XYZNUVTB &&
-		vertexFormatClean != VERTEX_FORMAT_XYZNUV &&
-		vertexFormatClean != VERTEX_FORMAT_XYZNUV2TB&&
-		vertexFormatClean != VERTEX_FORMAT_XYZNUVIIIWWTB&&
-		vertexFormatClean != VERTEX_FORMAT_XYZNUVIIIIWWWTB&&
-		vertexFormatClean != VERTEX_FORMAT_XYZNUVP2&&
-		vertexFormatClean != VERTEX_FORMAT_XYZNUVTBP2)
+	if (!find_vertex_format(vertexFormatClean))
 	{
 		std::string log = "vertex format has problem: ";
 		log += m_vertex_format;
@@ -197,211 +234,42 @@ bool CMesh::read_vertex(FILE* fp, sec_info& sec)
 		return false;
 	}
 
-	XMFLOAT3 pos;
-	uint32 uint_normal;
-	XMFLOAT3 normal;
-	XMFLOAT2 uv;
-	XMFLOAT2 uv2;
-	uint32 uint_tangent;
-	XMFLOAT3 tangent;
-	uint32 uint_bitangent;
-	XMFLOAT3 bitangent;
-	unsigned char iw[100];
-	if (VERTEX_FORMAT_XYZNUVTB == m_vertex_format)
-	{
-		for (int i = 0; i < vertex_number; i++)
-		{
-			/*
-			VertexXYZNUVTB new_vertex;
-			fread(&new_vertex.pos_, sizeof(D3DXVECTOR3), 1, fp);
-			fread(&uint_normal, sizeof(uint32), 1, fp);
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(D3DXVECTOR2), 1, fp);
-			fread(&uint_tangent, sizeof(uint32), 1, fp);
-			unpackNormal(uint_tangent, new_vertex.tangent_);
-			fread(&uint_bitangent, sizeof(uint32), 1, fp);
-			unpackNormal(uint_bitangent, new_vertex.binormal_);
-			m_vertex_list.push_back(new_vertex);
-			*/
-			//m_mesh_vertex
-			VertexXYZNUV new_vertex;
-			fread(&new_vertex.pos_, sizeof(XMFLOAT3), 1, fp);
-			fread(&uint_normal, sizeof(uint32), 1, fp);
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(XMFLOAT2), 1, fp);
-			fread(&uint_tangent, sizeof(uint32), 1, fp);
-			fread(&uint_bitangent, sizeof(uint32), 1, fp);
-			m_mesh_vertex.push_back(new_vertex);
-		}
-	}
-	else if (VERTEX_FORMAT_XYZNUV == m_vertex_format)
-	{
-		for (int i = 0; i < vertex_number; i++)
-		{
-			/*
-			VertexXYZNUVTB new_vertex;
-			fread(&new_vertex.pos_, sizeof(D3DXVECTOR3), 1, fp);
-			fread(&uint_normal, sizeof(uint32), 1, fp);
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(D3DXVECTOR2), 1, fp);
-			//just make data
-			new_vertex.tangent_ = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
-			new_vertex.binormal_ = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
-			// 		fread(&uint_tangent, sizeof(uint32), 1, fp);
-			// 		unpackNormal(uint_tangent, new_vertex.tangent_);
-			// 		fread(&uint_bitangent, sizeof(uint32), 1, fp);
-			// 		unpackNormal(uint_bitangent, new_vertex.binormal_);
-			m_vertex_list.push_back(new_vertex);
-			*/
-
-			VertexXYZNUV new_vertex;
-			fread(&new_vertex.pos_, sizeof(XMFLOAT3), 1, fp);
-			fread(&uint_normal, sizeof(uint32), 1, fp);
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(XMFLOAT2), 1, fp);
-			m_mesh_vertex.push_back(new_vertex);
-		}
-	}
-
-	else if (VERTEX_FORMAT_XYZNUV2TB == m_vertex_format)
-	{
-		for (int i = 0; i < vertex_number; i++)
-		{
-			/*
-			VertexXYZNUVTB new_vertex;
-			fread(&new_vertex.pos_, sizeof(D3DXVECTOR3), 1, fp);
-			fread(&uint_normal, sizeof(uint32), 1, fp);
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(D3DXVECTOR2), 1, fp);
-			//just read it
-			fread(uv2, sizeof(D3DXVECTOR2), 1, fp);
-
-			fread(&uint_tangent, sizeof(uint32), 1, fp);
-			unpackNormal(uint_tangent, new_vertex.tangent_);
-			fread(&uint_bitangent, sizeof(uint32), 1, fp);
-			unpackNormal(uint_bitangent, new_vertex.binormal_);
-			m_vertex_list.push_back(new_vertex);
-			*/
-
-			VertexXYZNUV new_vertex;
-			fread(&new_vertex.pos_, sizeof(XMFLOAT3), 1, fp);
-			fread(&uint_normal, sizeof(uint32), 1, fp);
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(XMFLOAT2), 1, fp);
-
-			fread(&uv2, sizeof(XMFLOAT2), 1, fp);
-			fread(&uint_tangent, sizeof(uint32), 1, fp);
-			fread(&uint_bitangent, sizeof(uint32), 1, fp);
-
-			m_mesh_vertex.push_back(new_vertex);
-		}
-	}
-	else if (VERTEX_FORMAT_XYZNUVIIIWWTB == m_vertex_format)
-	{
-		for (int i = 0; i < vertex_number; i++)
-		{
-			VertexXYZNUV new_vertex;
-			fread(&new_vertex.pos_, sizeof(XMFLOAT3), 1, fp);
-			fread(&uint_normal, sizeof(uint32), 1, fp);
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(XMFLOAT2), 1, fp);
-
-			fread(iw, sizeof(uchar), 5, fp);
-			fread(&uint_tangent, sizeof(uint32), 1, fp);
-			unpackNormal(uint_tangent, normal);
-			fread(&uint_bitangent, sizeof(uint32), 1, fp);
-			unpackNormal(uint_bitangent, normal);
-
-			m_mesh_vertex.push_back(new_vertex);
-		}
-	}
-	else if (VERTEX_FORMAT_XYZNUVIIIIWWWTB == m_vertex_format)
-	{
-		assert(0);
-		return false;
-	}
-	else if (VERTEX_FORMAT_XYZNUVP2 == m_vertex_format)
-	{
-		//return false;
-		for (int i = 0; i < vertex_number; i++)
-		{
-			VertexXYZNUV new_vertex;
-			fread(&new_vertex.pos_, sizeof(XMFLOAT3), 1, fp);  //12
-			fread(&uint_normal, sizeof(uint32), 1, fp);           //4
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(XMFLOAT2), 1, fp);   //8
-
-			fread(iw, sizeof(uchar), 16, fp);    //p 8 bit
-			m_mesh_vertex.push_back(new_vertex);
-		}
-	}
-	else if (VERTEX_FORMAT_XYZNUVTBP2 == m_vertex_format)
-	{
-		for (int i = 0; i < vertex_number; i++)
-		{
-			VertexXYZNUV new_vertex;
-			fread(&new_vertex.pos_, sizeof(XMFLOAT3), 1, fp);  //12
-			fread(&uint_normal, sizeof(uint32), 1, fp);           //4
-			unpackNormal(uint_normal, new_vertex.normal_);
-			fread(&new_vertex.uv_, sizeof(XMFLOAT2), 1, fp);   //8
-
-			//useless
-			fread(&uint_tangent, sizeof(uint32), 1, fp);
-			fread(&uint_bitangent, sizeof(uint32), 1, fp);
-			fread(iw, sizeof(uchar), 16, fp);    //p 8 bit
-			m_mesh_vertex.push_back(new_vertex);
-		}
-
-	}
-	else
+	const vertex_format_info* format = find_vertex_format(m_vertex_format);
+	if (!format)
 	{
 		std::string log = "not process this format: ";
 		log += m_vertex_format;
 		//Log::get_instance()->LogMessage(log);
 		return false;
 	}
-
-	if (m_mesh_vertex.size() <= 0)
+	if (!format->stride)
+	{
+		assert(0);
 		return false;
+	}
 
-	return true;
+	const uint32 stride = format->stride;
+	if (vertex_number <= 0 || (unsigned long)vertex_number > (sec.sec_size - 64 - sizeof(int)) / stride)
+		return false;
 
-	/*
-	if (b_uv2) //not use this
-	{
-	fread(&pos, sizeof(D3DXVECTOR3), 1, fp);
-	fread(&uint_normal, sizeof(uint32), 1, fp);
-	unpackNormal(uint_normal, normal);
-	fread(uv, sizeof(D3DXVECTOR2), 1, fp);
-	fread(uv2, sizeof(D3DXVECTOR2), 1, fp);
-	fread(&uint_tangent, sizeof(uint32), 1, fp);
-	unpackNormal(uint_tangent, tangent);
-	fread(&uint_bitangent, sizeof(uint32), 1, fp);
-	unpackNormal(uint_bitangent, bitangent);
-	}
-	else
-	{
+	size_t first = m_mesh_vertex.size();
+	m_mesh_vertex.resize(first + vertex_number);
+	VertexXYZNUV* dst = &m_mesh_vertex[first];
 	for (int i = 0; i < vertex_number; i++)
 	{
-	VertexXYZNUVTB new_vertex;
-	fread(&new_vertex.pos_, sizeof(D3DXVECTOR3), 1, fp);
-	fread(&uint_normal, sizeof(uint32), 1, fp);
-	unpackNormal(uint_normal, new_vertex.normal_);
-	fread(&new_vertex.uv_, sizeof(D3DXVECTOR2), 1, fp);
-	fread(&uint_tangent, sizeof(uint32), 1, fp);
-	unpackNormal(uint_tangent, new_vertex.tangent_);
-	fread(&uint_bitangent, sizeof(uint32), 1, fp);
-	unpackNormal(uint_bitangent, new_vertex.binormal_);
-	m_vertex_list.push_back(new_vertex);
-	}
+		memcpy(&dst[i].pos_, src + i * stride, sizeof(XMFLOAT3));
+		memcpy(&dst[i].uv_, src + i * stride + 16, sizeof(XMFLOAT2));
 	}
-	*/
+	//tangent frames are not kept, VertexXYZNUV has no room for them
+	unpackNormals(src + 12, stride, &dst[0].normal_, sizeof(VertexXYZNUV), vertex_number);
+
+	return true;
 }
 
 
-bool CMesh::read_indexs(FILE* fp, sec_info& sec)
+bool CMesh::read_indexs(const uchar* data, sec_info& sec)
 {
-	if (!fp)
+	if (!data || sec.sec_size < 64 + 2 * sizeof(int))
 	{
 		//Log::get_instance()->LogMessage("CMesh::read_indexs file is null");
 		return false;
@@ -410,31 +278,34 @@ bool CMesh::read_indexs(FILE* fp, sec_info& sec)
 	int  index_number = 0;
 	int  group_number = 0;
 	memset(indexFormat, 0, 128);
-	fseek(fp, sec.offset, SEEK_SET);
-	fread(&indexFormat, 1, 64, fp);
-	fread(&index_number, sizeof(int), 1, fp);
-	fread(&group_number, sizeof(int), 1, fp);
+	const uchar* src = data + sec.offset;
+	memcpy(indexFormat, src, 64);
+	memcpy(&index_number, src + 64, sizeof(int));
+	memcpy(&group_number, src + 64 + sizeof(int), sizeof(int));
+	src += 64 + 2 * sizeof(int);
+
+	const unsigned long available = sec.sec_size - 64 - 2 * sizeof(int);
+	if (index_number <= 0 || group_number < 0 ||
+		(unsigned long)index_number > available / sizeof(unsigned short) ||
+		(unsigned long)group_number > (available - index_number * sizeof(unsigned short)) / sizeof(group_info))
+		return false;
 
-	unsigned short index;
-	for (int i = 0; i < index_number; i++)
+	size_t first = m_index_list.size();
+	m_index_list.resize(first + index_number);
+	for (int i = 0; i < index_number; i++, src += sizeof(unsigned short))
 	{
-		fread(&index, sizeof(unsigned short), 1, fp);
-		m_index_list.push_back(index);
+		unsigned short index;
+		memcpy(&index, src, sizeof(unsigned short));
+		m_index_list[first + i] = index;
 	}
-	for (int i = 0; i < group_number; i++)
+	for (int i = 0; i < group_number; i++, src += sizeof(group_info))
 	{
 		submesh new_submesh(this);
-
-		fread(&new_submesh.m_group_info.startIndex, sizeof(int), 1, fp);
-		fread(&new_submesh.m_group_info.primitives, sizeof(int), 1, fp);
-		fread(&new_submesh.m_group_info.startVertex, sizeof(int), 1, fp);
-		fread(&new_submesh.m_group_info.vertices, sizeof(int), 1, fp);
-
+		// startIndex, primitives, startVertex, vertices
+		memcpy(&new_submesh.m_group_info, src, sizeof(group_info));
 		m_submesh_list.push_back(new_submesh);
 	}
 
-	if (m_index_list.size() <= 0)
-		return false;
 	return true;
 }
 
@@ -448,6 +319,7 @@ void CMesh::read_visual_material(const std::string& file_name)
 	TiXmlDocument sceneDoc(full_path.c_str());
 	if (sceneDoc.LoadFile())
 	{
+		m_source_files.push_back(full_path);
 		TiXmlElement* rootElement = sceneDoc.RootElement();
 		TiXmlElement* renderSetElement = rootElement->FirstChildElement();
 		while (renderSetElement)
@@ -524,7 +396,11 @@ void CMesh::parse_material(TiXmlElement* material_element, int index)
 				if (text)
 				{
 					std::string texture_file_name = this->dir + text;
-					sub_mesh.m_diffuse.LoadTGA(texture_file_name);
+					//atlases shared by many models are decoded once
+					sub_mesh.m_diffuse = CTextureCache::get_instance().Acquire(texture_file_name,
+						bLoadDiffuseAlphaOnly ? TGA_LOAD_ALPHA : TGA_LOAD_RGBA);
+					if (sub_mesh.m_diffuse)
+						m_source_files.push_back(texture_file_name);
 				}
 			}
 		}
@@ -585,7 +461,7 @@ void CMesh::parse_material(TiXmlElement* material_element, int index)
 			if (float_value)
 			{
 				std::string alphaTest = float_value->GetText();
-				if (sub_mesh.m_diffuse.image != 0)
+				if (sub_mesh.m_diffuse)
 					sub_mesh.m_alphaTest = alphaTest == "true";
 			}
 		}
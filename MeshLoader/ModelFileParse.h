@@ -46,6 +46,25 @@ struct sec_info
 
 typedef std::vector<sec_info> sec_info_vector;
 
+//byte layout of one vertex format in a .primitives vertex section
+//every format starts with xyz (0), packed normal (12) and uv (16)
+struct vertex_format_info
+{
+	const char*	  name;
+	uint32		  stride;			//0 if the format is not supported
+	int			  tangent_offset;	//-1 if the format has no packed tangent
+	int			  bitangent_offset;
+};
+
+const vertex_format_info* find_vertex_format(const std::string& name);
+
+//11:11:10 packed normal to floats
+void unpackNormal(uint32 packNromal, XMFLOAT3& ret);
+
+//unpacks count normals read src_stride bytes apart into floats written dst_stride bytes apart,
+//four at a time with sse2
+void unpackNormals(const uchar* src, uint32 src_stride, XMFLOAT3* dst, uint32 dst_stride, uint32 count);
+
 struct TexInfosBlock
 {
 	char		texPath[128];
@@ -1,5 +1,8 @@
 #include "LoadOBJ.h"
+#include "MappedFile.h"
+#include "ParallelFor.h"
 #include <map>
+#include <string.h>
 #include "io.h"
 using std::map;
 using std::vector;
@@ -43,7 +46,7 @@ bool OBJLoader::LoadDir(string file_name,
 	return true;
 }
 
-bool OBJLoader::Load(string file_name,
+bool OBJLoader::LoadReference(string file_name,
 	vector<VertexXYZNUV>& vertices,
 	vector<UINT>& indices)
 {
@@ -71,7 +74,7 @@ bool OBJLoader::Load(string file_name,
 			}
 			else if (s[0] == 'f')
 			{
-				UINT i[9];
+				UINT i[9] = { 0 };
 				sscanf(sub.c_str(), "%d/%d/%d %d/%d/%d %d/%d/%d", 
 					i, i + 1, i + 2, i + 3, i + 4, i + 5, i + 6, i + 7, i + 8);
 				for (int ii = 0; ii < 9; ii+=3)
@@ -107,10 +110,13 @@ bool OBJLoader::Load(string file_name,
 		fin.getline(str, 256);
 	}
 
-	USHORT id = vertices.size();
+	UINT id = vertices.size();
 	for (auto i = ibmap.begin(); i != ibmap.end(); i++)
 	{
 		ID u = i->first;
+		//corners it cannot parse come out as 0, which wraps past the end
+		if (u.vid - 1 >= vb.size() || u.tid - 1 >= tb.size() || u.nid - 1 >= nb.size())
+			return false;
 		i->second = id++;
 		VertexXYZNUV vert;
 		vert.pos_ =		vb[u.vid - 1];
@@ -126,4 +132,441 @@ bool OBJLoader::Load(string file_name,
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+/////////////////////////////////////parallel loader/////////////////////////////////////
+
+//a face corner, 0 based, -1 when the corner has no uv or normal
+//negative obj indices count back from the chunk's own elements until the chunk bases are known
+struct obj_corner
+{
+	int v, t, n;
+	uint32 relative; //OBJ_RELATIVE_* bits of the fields still relative to the chunk
+};
+
+#define OBJ_RELATIVE_V 1
+#define OBJ_RELATIVE_T 2
+#define OBJ_RELATIVE_N 4
+
+struct obj_chunk
+{
+	const char* begin;
+	const char* end;
+	bool failed;
+
+	vector<XMFLOAT3> positions;
+	vector<XMFLOAT3> normals;
+	vector<XMFLOAT2> uvs;
+	vector<obj_corner> corners; //three per triangle
+
+	UINT base_v, base_t, base_n;
+
+	//corners deduplicated within the chunk, then mapped to the mesh's vertices
+	vector<obj_corner> unique;
+	vector<UINT> local_indices;
+	vector<UINT> remap;
+};
+
+//open addressing map from corner to vertex index
+class obj_corner_table
+{
+public:
+	obj_corner_table(size_t count)
+	{
+		size_t capacity = 16;
+		while (capacity < count * 2)
+			capacity <<= 1;
+		m_mask = capacity - 1;
+		m_keys.resize(capacity);
+		m_values.resize(capacity, UINT(-1));
+	}
+
+	//index of the corner, next_value if it was not in the table yet
+	UINT find_or_add(const obj_corner& key, UINT next_value)
+	{
+		size_t slot = hash(key) & m_mask;
+		while (m_values[slot] != UINT(-1))
+		{
+			const obj_corner& k = m_keys[slot];
+			if (k.v == key.v && k.t == key.t && k.n == key.n)
+				return m_values[slot];
+			slot = (slot + 1) & m_mask;
+		}
+		m_keys[slot] = key;
+		m_values[slot] = next_value;
+		return next_value;
+	}
+
+private:
+	static size_t hash(const obj_corner& key)
+	{
+		uint32 h = uint32(key.v) * 0x9E3779B1u;
+		h ^= (uint32(key.t) + 0x7F4A7C15u) * 0x85EBCA77u;
+		h ^= (uint32(key.n) + 0x165667B1u) * 0xC2B2AE3Du;
+		return h ^ (h >> 15);
+	}
+
+	size_t m_mask;
+	vector<obj_corner> m_keys;
+	vector<UINT> m_values;
+};
+
+static inline bool is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char* skip_blank(const char* p, const char* end)
+{
+	while (p < end && is_blank(*p))
+		p++;
+	return p;
+}
+
+static const double s_pow10[] =
+{
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+//decimal float without locale or allocation, digits past the 19th only move the exponent
+static const char* parse_float(const char* p, const char* end, float& value)
+{
+	p = skip_blank(p, end);
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		negative = *p++ == '-';
+
+	ull mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	const char* start = p;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+	{
+		if (digits < 19)
+		{
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa)
+				digits++;
+		}
+		else
+			exponent++;
+	}
+	if (p < end && *p == '.')
+	{
+		for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa)
+					digits++;
+				exponent--;
+			}
+		}
+	}
+	if (p == start)
+	{
+		value = 0;
+		return NULL;
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* q = p + 1;
+		bool negative_exponent = false;
+		if (q < end && (*q == '-' || *q == '+'))
+			negative_exponent = *q++ == '-';
+		if (q < end && *q >= '0' && *q <= '9')
+		{
+			int e = 0;
+			for (; q < end && *q >= '0' && *q <= '9'; q++)
+				e = e < 10000 ? e * 10 + (*q - '0') : e;
+			exponent += negative_exponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double d = (double)mantissa;
+	while (exponent > 22)
+	{
+		d *= 1e22;
+		exponent -= 22;
+	}
+	while (exponent < -22)
+	{
+		d /= 1e22;
+		exponent += 22;
+	}
+	d = exponent < 0 ? d / s_pow10[-exponent] : d * s_pow10[exponent];
+	value = (float)(negative ? -d : d);
+	return p;
+}
+
+static const char* parse_int(const char* p, const char* end, int& value)
+{
+	bool negative = false;
+	if (p < end && *p == '-')
+	{
+		negative = true;
+		p++;
+	}
+	const char* start = p;
+	int v = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; p++)
+		v = v * 10 + (*p - '0');
+	if (p == start)
+		return NULL;
+	value = negative ? -v : v;
+	return p;
+}
+
+//1 based or negative obj index to 0 based, negative ones relative to the count parsed so far in the chunk
+static inline bool resolve_index(int index, size_t local_count, int& out, uint32& relative, uint32 relative_bit)
+{
+	if (index > 0)
+	{
+		out = index - 1;
+		return true;
+	}
+	if (index < 0)
+	{
+		out = (int)local_count + index;
+		relative |= relative_bit;
+		return true;
+	}
+	return false;
+}
+
+static void parse_obj_chunk(obj_chunk& chunk)
+{
+	vector<obj_corner> polygon;
+	const char* p = chunk.begin;
+	while (p < chunk.end && !chunk.failed)
+	{
+		const char* line_end = (const char*)memchr(p, '\n', chunk.end - p);
+		if (!line_end)
+			line_end = chunk.end;
+		const char* s = skip_blank(p, line_end);
+		p = line_end + 1;
+
+		if (line_end - s < 2)
+			continue;
+		if (s[0] == 'v' && is_blank(s[1]))
+		{
+			XMFLOAT3 v;
+			const char* q = parse_float(s + 2, line_end, v.x);
+			q = q ? parse_float(q, line_end, v.y) : NULL;
+			q = q ? parse_float(q, line_end, v.z) : NULL;
+			chunk.failed = !q;
+			chunk.positions.push_back(v);
+		}
+		else if (s[0] == 'v' && s[1] == 'n' && line_end - s >= 3 && is_blank(s[2]))
+		{
+			XMFLOAT3 n;
+			const char* q = parse_float(s + 3, line_end, n.x);
+			q = q ? parse_float(q, line_end, n.y) : NULL;
+			q = q ? parse_float(q, line_end, n.z) : NULL;
+			chunk.failed = !q;
+			chunk.normals.push_back(n);
+		}
+		else if (s[0] == 'v' && s[1] == 't' && line_end - s >= 3 && is_blank(s[2]))
+		{
+			//v is optional
+			XMFLOAT2 uv;
+			const char* q = parse_float(s + 3, line_end, uv.x);
+			chunk.failed = !q;
+			if (q && !parse_float(q, line_end, uv.y))
+				uv.y = 0;
+			chunk.uvs.push_back(uv);
+		}
+		else if (s[0] == 'f' && is_blank(s[1]))
+		{
+			//v, v/t, v//n or v/t/n per corner
+			polygon.clear();
+			const char* q = skip_blank(s + 2, line_end);
+			while (q < line_end)
+			{
+				obj_corner c;
+				c.v = c.t = c.n = -1;
+				c.relative = 0;
+				int index = 0;
+				q = parse_int(q, line_end, index);
+				bool ok = q && resolve_index(index, chunk.positions.size(), c.v, c.relative, OBJ_RELATIVE_V);
+				if (ok && q < line_end && *q == '/')
+				{
+					q++;
+					if (q < line_end && *q != '/')
+					{
+						q = parse_int(q, line_end, index);
+						ok = q && resolve_index(index, chunk.uvs.size(), c.t, c.relative, OBJ_RELATIVE_T);
+					}
+					if (ok && q < line_end && *q == '/')
+					{
+						q = parse_int(q + 1, line_end, index);
+						ok = q && resolve_index(index, chunk.normals.size(), c.n, c.relative, OBJ_RELATIVE_N);
+					}
+				}
+				if (!ok || (q < line_end && !is_blank(*q)))
+				{
+					chunk.failed = true;
+					break;
+				}
+				polygon.push_back(c);
+				q = skip_blank(q, line_end);
+			}
+
+			//quads and n-gons as triangle fans
+			for (size_t i = 2; i < polygon.size(); i++)
+			{
+				chunk.corners.push_back(polygon[0]);
+				chunk.corners.push_back(polygon[i - 1]);
+				chunk.corners.push_back(polygon[i]);
+			}
+		}
+	}
+}
+
+//makes the chunk's corners absolute and deduplicates them within the chunk
+static void index_obj_chunk(obj_chunk& chunk, int num_v, int num_t, int num_n)
+{
+	obj_corner_table table(chunk.corners.size());
+	chunk.local_indices.resize(chunk.corners.size());
+	for (size_t i = 0; i < chunk.corners.size(); i++)
+	{
+		obj_corner c = chunk.corners[i];
+		if (c.relative & OBJ_RELATIVE_V)
+			c.v += chunk.base_v;
+		if (c.relative & OBJ_RELATIVE_T)
+			c.t += chunk.base_t;
+		if (c.relative & OBJ_RELATIVE_N)
+			c.n += chunk.base_n;
+		c.relative = 0;
+		if (c.v < 0 || c.v >= num_v || c.t < -1 || c.t >= num_t || c.n < -1 || c.n >= num_n ||
+			((chunk.corners[i].relative & OBJ_RELATIVE_T) && c.t < 0) ||
+			((chunk.corners[i].relative & OBJ_RELATIVE_N) && c.n < 0))
+		{
+			chunk.failed = true;
+			return;
+		}
+
+		UINT id = table.find_or_add(c, (UINT)chunk.unique.size());
+		if (id == chunk.unique.size())
+			chunk.unique.push_back(c);
+		chunk.local_indices[i] = id;
+	}
+}
+
+bool OBJLoader::Load(string file_name,
+	vector<VertexXYZNUV>& vertices,
+	vector<UINT>& indices)
+{
+	CMappedFile file;
+	if (!file.Open(file_name))
+		return false;
+	const char* data = (const char*)file.GetData();
+	const char* end = data + file.GetSize();
+
+	//chunks end on line breaks, a few per core so uneven ones even out
+	const uint32 min_chunk_size = 256 * 1024;
+	uint32 num_chunks = std::thread::hardware_concurrency() * 4;
+	if (num_chunks < 1)
+		num_chunks = 1;
+	if (file.GetSize() / num_chunks < min_chunk_size)
+		num_chunks = file.GetSize() / min_chunk_size + 1;
+	vector<obj_chunk> chunks(num_chunks);
+	const char* begin = data;
+	for (uint32 i = 0; i < num_chunks; i++)
+	{
+		const char* chunk_end = end;
+		if (i + 1 < num_chunks)
+		{
+			chunk_end = data + ull(file.GetSize()) * (i + 1) / num_chunks;
+			if (chunk_end < begin)
+				chunk_end = begin;
+			const char* line_end = (const char*)memchr(chunk_end, '\n', end - chunk_end);
+			chunk_end = line_end ? line_end + 1 : end;
+		}
+		chunks[i].begin = begin;
+		chunks[i].end = chunk_end;
+		chunks[i].failed = false;
+		begin = chunk_end;
+	}
+
+	parallel_for(num_chunks, [&](int i) { parse_obj_chunk(chunks[i]); });
+
+	//negative indices can be resolved once every chunk knows how many elements came before it
+	vector<XMFLOAT3> vb;
+	vector<XMFLOAT3> nb;
+	vector<XMFLOAT2> tb;
+	for (uint32 i = 0; i < num_chunks; i++)
+	{
+		obj_chunk& chunk = chunks[i];
+		if (chunk.failed)
+			return false;
+		chunk.base_v = vb.size();
+		chunk.base_t = tb.size();
+		chunk.base_n = nb.size();
+		vb.insert(vb.end(), chunk.positions.begin(), chunk.positions.end());
+		tb.insert(tb.end(), chunk.uvs.begin(), chunk.uvs.end());
+		nb.insert(nb.end(), chunk.normals.begin(), chunk.normals.end());
+		vector<XMFLOAT3>().swap(chunk.positions);
+		vector<XMFLOAT2>().swap(chunk.uvs);
+		vector<XMFLOAT3>().swap(chunk.normals);
+	}
+
+	parallel_for(num_chunks, [&](int i) { index_obj_chunk(chunks[i], (int)vb.size(), (int)tb.size(), (int)nb.size()); });
+
+	//corners unique within their chunk are few enough to merge serially, in file order
+	size_t num_unique = 0;
+	size_t num_indices = 0;
+	for (uint32 i = 0; i < num_chunks; i++)
+	{
+		if (chunks[i].failed)
+			return false;
+		num_unique += chunks[i].unique.size();
+		num_indices += chunks[i].local_indices.size();
+	}
+
+	obj_corner_table table(num_unique);
+	const UINT first_vertex = vertices.size();
+	vertices.reserve(vertices.size() + num_unique);
+	for (uint32 i = 0; i < num_chunks; i++)
+	{
+		obj_chunk& chunk = chunks[i];
+		chunk.remap.resize(chunk.unique.size());
+		for (size_t u = 0; u < chunk.unique.size(); u++)
+		{
+			const obj_corner& c = chunk.unique[u];
+			const UINT next = (UINT)vertices.size();
+			const UINT id = table.find_or_add(c, next - first_vertex) + first_vertex;
+			if (id == next)
+			{
+				VertexXYZNUV vert;
+				vert.pos_ = vb[c.v];
+				vert.uv_ = c.t >= 0 ? tb[c.t] : XMFLOAT2(0, 0);
+				vert.normal_ = c.n >= 0 ? nb[c.n] : XMFLOAT3(0, 0, 0);
+				vertices.push_back(vert);
+			}
+			chunk.remap[u] = id;
+		}
+	}
+
+	const size_t first_index = indices.size();
+	indices.resize(first_index + num_indices);
+	vector<size_t> index_offsets(num_chunks);
+	size_t offset = first_index;
+	for (uint32 i = 0; i < num_chunks; i++)
+	{
+		index_offsets[i] = offset;
+		offset += chunks[i].local_indices.size();
+	}
+	parallel_for(num_chunks, [&](int i)
+	{
+		const obj_chunk& chunk = chunks[i];
+		UINT* out = indices.data() + index_offsets[i];
+		for (size_t j = 0; j < chunk.local_indices.size(); j++)
+			out[j] = chunk.remap[chunk.local_indices[j]];
+	});
+
+	return true;
+}
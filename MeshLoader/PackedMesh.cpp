@@ -0,0 +1,388 @@
+#include "PackedMesh.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
+bool bPackMeshes = true;
+
+static float sign_not_zero(float v)
+{
+	return v < 0.0f ? -1.0f : 1.0f;
+}
+
+static short to_snorm16(float v)
+{
+	v = v < -1.0f ? -1.0f : (v > 1.0f ? 1.0f : v);
+	return (short)floorf(v * 32767.0f + 0.5f);
+}
+
+void encode_octahedral(const XMFLOAT3& normal, short out[2])
+{
+	//project onto the octahedron, then fold the lower half over the upper one
+	const float l1 = fabsf(normal.x) + fabsf(normal.y) + fabsf(normal.z);
+	if (l1 <= 0.0f)
+	{
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+	float x = normal.x / l1;
+	float y = normal.y / l1;
+	if (normal.z < 0.0f)
+	{
+		const float folded_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+		y = (1.0f - fabsf(x)) * sign_not_zero(y);
+		x = folded_x;
+	}
+	out[0] = to_snorm16(x);
+	out[1] = to_snorm16(y);
+}
+
+void decode_normal(const packed_vertex& v, XMFLOAT3& normal)
+{
+	float x = v.normal[0] / 32767.0f;
+	float y = v.normal[1] / 32767.0f;
+	const float z = 1.0f - fabsf(x) - fabsf(y);
+	if (z < 0.0f)
+	{
+		const float unfolded_x = (1.0f - fabsf(y)) * sign_not_zero(x);
+		y = (1.0f - fabsf(x)) * sign_not_zero(y);
+		x = unfolded_x;
+	}
+	const float length = sqrtf(x * x + y * y + z * z);
+	normal.x = x / length;
+	normal.y = y / length;
+	normal.z = z / length;
+}
+
+//position and uv bounds of the vertices quantized with the same scale and bias
+struct quantize_bounds
+{
+	float		  pos_min[3];
+	float		  pos_max[3];
+	float		  uv_min[2];
+	float		  uv_max[2];
+
+	quantize_bounds()
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			pos_min[k] = FLT_MAX;
+			pos_max[k] = -FLT_MAX;
+		}
+		for (int k = 0; k < 2; k++)
+		{
+			uv_min[k] = FLT_MAX;
+			uv_max[k] = -FLT_MAX;
+		}
+	}
+
+	void add(const XMFLOAT3& pos, const XMFLOAT2& uv)
+	{
+		const float p[3] = { pos.x, pos.y, pos.z };
+		const float t[2] = { uv.x, uv.y };
+		for (int k = 0; k < 3; k++)
+		{
+			pos_min[k] = (std::min)(pos_min[k], p[k]);
+			pos_max[k] = (std::max)(pos_max[k], p[k]);
+		}
+		for (int k = 0; k < 2; k++)
+		{
+			uv_min[k] = (std::min)(uv_min[k], t[k]);
+			uv_max[k] = (std::max)(uv_max[k], t[k]);
+		}
+	}
+
+	void set_dequant(packed_submesh& sub) const
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			sub.pos_scale[k] = (pos_max[k] - pos_min[k]) * 0.5f / 32767.0f;
+			sub.pos_bias[k] = (pos_min[k] + pos_max[k]) * 0.5f;
+		}
+		for (int k = 0; k < 2; k++)
+		{
+			sub.uv_scale[k] = (uv_max[k] - uv_min[k]) * 0.5f / 32767.0f;
+			sub.uv_bias[k] = (uv_min[k] + uv_max[k]) * 0.5f;
+		}
+	}
+};
+
+static short quantize(float v, float scale, float bias)
+{
+	return scale > 0.0f ? to_snorm16((v - bias) / (scale * 32767.0f)) : 0;
+}
+
+static void quantize_vertex(const packed_submesh& sub, const vertex_streams& vb, uint32 i, packed_vertex& out)
+{
+	const XMFLOAT3& pos = vb.position(i);
+	const XMFLOAT2& uv = vb.uv_at(i);
+	out.pos[0] = quantize(pos.x, sub.pos_scale[0], sub.pos_bias[0]);
+	out.pos[1] = quantize(pos.y, sub.pos_scale[1], sub.pos_bias[1]);
+	out.pos[2] = quantize(pos.z, sub.pos_scale[2], sub.pos_bias[2]);
+	out.pos[3] = 0;
+	encode_octahedral(vb.normal_at(i), out.normal);
+	out.uv[0] = quantize(uv.x, sub.uv_scale[0], sub.uv_bias[0]);
+	out.uv[1] = quantize(uv.y, sub.uv_scale[1], sub.uv_bias[1]);
+}
+
+void get_packed_groups(const packed_submesh* draws, uint32 draw_count, uint32 source_count, std::vector<group_info>& groups)
+{
+	group_info empty = { 0, 0, 0, 0 };
+	groups.assign(source_count, empty);
+	std::vector<bool> found(source_count, false);
+	for (uint32 s = 0; s < draw_count; s++)
+	{
+		const packed_submesh& sub = draws[s];
+		if (sub.source >= source_count)
+			continue;
+		group_info& g = groups[sub.source];
+		if (!found[sub.source])
+		{
+			//the draws of one submesh are built one after another
+			g.startIndex = sub.start_index;
+			g.startVertex = sub.base_vertex;
+			found[sub.source] = true;
+		}
+		g.primitives += sub.index_count / 3;
+		g.vertices += sub.vertex_count;
+	}
+}
+
+void expand_packed_indices(const uint16* indices, const packed_submesh* draws, uint32 draw_count, std::vector<UINT>& out)
+{
+	out.clear();
+	for (uint32 s = 0; s < draw_count; s++)
+	{
+		const packed_submesh& sub = draws[s];
+		out.resize((std::max)((uint32)out.size(), sub.start_index + sub.index_count));
+		for (uint32 i = sub.start_index; i < sub.start_index + sub.index_count; i++)
+			out[i] = sub.base_vertex + indices[i];
+	}
+}
+
+CPackedMesh::CPackedMesh()
+	: m_vertices(NULL)
+	, m_vertex_count(0)
+	, m_indices(NULL)
+	, m_index_count(0)
+	, m_submeshes(NULL)
+	, m_submesh_count(0)
+{
+}
+
+bool CPackedMesh::Build(const vertex_streams& vb, const UINT* ib, uint32 index_count, const std::vector<submesh>& submesh_list)
+{
+	Clear();
+	if (!vb.count || !index_count || submesh_list.empty())
+		return false;
+
+	//every triangle has to belong to exactly one submesh
+	std::vector<std::pair<int, int> > ranges;
+	for (size_t s = 0; s < submesh_list.size(); s++)
+	{
+		const group_info& g = submesh_list[s].m_group_info;
+		if (g.startIndex < 0 || g.primitives < 0)
+			return false;
+		if (g.primitives)
+			ranges.push_back(std::make_pair(g.startIndex, g.primitives * 3));
+	}
+	std::sort(ranges.begin(), ranges.end());
+	int covered = 0;
+	for (size_t i = 0; i < ranges.size(); i++)
+	{
+		if (ranges[i].first != covered)
+			return false;
+		covered += ranges[i].second;
+	}
+	if (covered != (int)index_count)
+		return false;
+	for (uint32 i = 0; i < index_count; i++)
+	{
+		if (ib[i] >= vb.count)
+			return false;
+	}
+
+	//the window of vertices each submesh reaches
+	std::vector<std::pair<UINT, UINT> > windows(submesh_list.size(), std::make_pair(0xffffffffu, 0u));
+	bool fits = true;
+	for (size_t s = 0; s < submesh_list.size(); s++)
+	{
+		const group_info& g = submesh_list[s].m_group_info;
+		std::pair<UINT, UINT>& w = windows[s];
+		for (uint32 i = g.startIndex; i < (uint32)(g.startIndex + g.primitives * 3); i++)
+		{
+			w.first = (std::min)(w.first, ib[i]);
+			w.second = (std::max)(w.second, ib[i]);
+		}
+		fits = fits && (!g.primitives || w.second - w.first < PACKED_MESH_MAX_VERTICES);
+	}
+
+	m_index_storage.reserve(index_count);
+	if (fits)
+	{
+		//one draw per submesh in place, overlapping windows merge into one set of bounds
+		std::vector<std::pair<UINT, UINT> > sorted;
+		for (size_t s = 0; s < windows.size(); s++)
+		{
+			if (submesh_list[s].m_group_info.primitives)
+				sorted.push_back(windows[s]);
+		}
+		std::sort(sorted.begin(), sorted.end());
+		std::vector<std::pair<UINT, UINT> > merged;
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			if (!merged.empty() && sorted[i].first <= merged.back().second)
+				merged.back().second = (std::max)(merged.back().second, sorted[i].second);
+			else
+				merged.push_back(sorted[i]);
+		}
+		std::vector<packed_submesh> dequant(merged.size());
+		for (size_t m = 0; m < merged.size(); m++)
+		{
+			quantize_bounds bounds;
+			for (UINT v = merged[m].first; v <= merged[m].second; v++)
+				bounds.add(vb.position(v), vb.uv_at(v));
+			bounds.set_dequant(dequant[m]);
+		}
+
+		packed_vertex zero;
+		memset(&zero, 0, sizeof(zero));
+		m_vertex_storage.assign(vb.count, zero);
+		for (size_t m = 0; m < merged.size(); m++)
+		{
+			for (UINT v = merged[m].first; v <= merged[m].second; v++)
+				quantize_vertex(dequant[m], vb, v, m_vertex_storage[v]);
+		}
+
+		for (size_t s = 0; s < submesh_list.size(); s++)
+		{
+			const group_info& g = submesh_list[s].m_group_info;
+			if (!g.primitives)
+				continue;
+			const std::pair<UINT, UINT>& w = windows[s];
+			const size_t m = std::upper_bound(merged.begin(), merged.end(), std::make_pair(w.first, 0xffffffffu)) - merged.begin() - 1;
+			packed_submesh sub = dequant[m];
+			sub.start_index = m_index_storage.size();
+			sub.index_count = g.primitives * 3;
+			sub.base_vertex = w.first;
+			sub.vertex_count = w.second - w.first + 1;
+			sub.source = s;
+			for (uint32 i = g.startIndex; i < (uint32)(g.startIndex + g.primitives * 3); i++)
+				m_index_storage.push_back((uint16)(ib[i] - w.first));
+			m_submesh_storage.push_back(sub);
+		}
+	}
+	else
+	{
+		//a draw takes triangles in order until the next one would need too many vertices
+		std::vector<UINT> local(vb.count, 0xffffffff);
+		std::vector<UINT> used;
+		m_vertex_storage.reserve(vb.count);
+		for (size_t s = 0; s < submesh_list.size(); s++)
+		{
+			const group_info& g = submesh_list[s].m_group_info;
+			const uint32 end = g.startIndex + g.primitives * 3;
+			uint32 t = g.startIndex;
+			while (t < end)
+			{
+				packed_submesh sub;
+				memset(&sub, 0, sizeof(sub));
+				sub.start_index = m_index_storage.size();
+				sub.base_vertex = m_vertex_storage.size();
+				sub.source = s;
+				for (; t < end; t += 3)
+				{
+					uint32 added = 0;
+					for (int k = 0; k < 3; k++)
+					{
+						if (local[ib[t + k]] == 0xffffffff &&
+							(k < 1 || ib[t + k] != ib[t]) && (k < 2 || ib[t + k] != ib[t + 1]))
+							added++;
+					}
+					if (used.size() + added > PACKED_MESH_MAX_VERTICES)
+						break;
+					for (int k = 0; k < 3; k++)
+					{
+						UINT& slot = local[ib[t + k]];
+						if (slot == 0xffffffff)
+						{
+							slot = used.size();
+							used.push_back(ib[t + k]);
+						}
+						m_index_storage.push_back((uint16)slot);
+					}
+				}
+				sub.index_count = m_index_storage.size() - sub.start_index;
+				sub.vertex_count = used.size();
+
+				quantize_bounds bounds;
+				for (size_t i = 0; i < used.size(); i++)
+					bounds.add(vb.position(used[i]), vb.uv_at(used[i]));
+				bounds.set_dequant(sub);
+				m_vertex_storage.resize(sub.base_vertex + used.size());
+				for (size_t i = 0; i < used.size(); i++)
+				{
+					quantize_vertex(sub, vb, used[i], m_vertex_storage[sub.base_vertex + i]);
+					local[used[i]] = 0xffffffff;
+				}
+				m_submesh_storage.push_back(sub);
+				used.clear();
+			}
+		}
+	}
+	m_vertices = &m_vertex_storage[0];
+	m_vertex_count = m_vertex_storage.size();
+	m_indices = &m_index_storage[0];
+	m_index_count = m_index_storage.size();
+	m_submeshes = &m_submesh_storage[0];
+	m_submesh_count = m_submesh_storage.size();
+	return true;
+}
+
+void CPackedMesh::Assign(const packed_vertex* vertices, uint32 vertex_count, const uint16* indices, uint32 index_count,
+	const packed_submesh* submeshes, uint32 submesh_count)
+{
+	Clear();
+	m_vertices = vertices;
+	m_vertex_count = vertex_count;
+	m_indices = indices;
+	m_index_count = index_count;
+	m_submeshes = submeshes;
+	m_submesh_count = submesh_count;
+}
+
+void CPackedMesh::Clear()
+{
+	std::vector<packed_vertex>().swap(m_vertex_storage);
+	std::vector<uint16>().swap(m_index_storage);
+	std::vector<packed_submesh>().swap(m_submesh_storage);
+	m_vertices = NULL;
+	m_vertex_count = 0;
+	m_indices = NULL;
+	m_index_count = 0;
+	m_submeshes = NULL;
+	m_submesh_count = 0;
+}
+
+uint32 CPackedMesh::GetSize() const
+{
+	return m_vertex_count * sizeof(packed_vertex) + m_index_count * sizeof(uint16) + m_submesh_count * sizeof(packed_submesh);
+}
+
+void CPackedMesh::Decode(std::vector<VertexXYZNUV>& vertices) const
+{
+	VertexXYZNUV zero(0, 0, 0, 0, 0, 0, 0, 0);
+	vertices.assign(m_vertex_count, zero);
+	for (uint32 s = 0; s < m_submesh_count; s++)
+	{
+		const packed_submesh& sub = m_submeshes[s];
+		for (uint32 v = sub.base_vertex; v < sub.base_vertex + sub.vertex_count; v++)
+		{
+			decode_position(sub, m_vertices[v], vertices[v].pos_);
+			decode_normal(m_vertices[v], vertices[v].normal_);
+			decode_uv(sub, m_vertices[v], vertices[v].uv_);
+		}
+	}
+}
@@ -0,0 +1,106 @@
+#ifndef PACKED_MESH_H
+#define PACKED_MESH_H
+#include "baseDefine.h"
+#include "submesh.h"
+
+class CMesh;
+
+//SceneLoader packs loaded meshes and CMesh::Init writes packed mesh caches while set
+extern bool bPackMeshes;
+
+//16 bit indices reach this many vertices past a draw's base vertex
+#define PACKED_MESH_MAX_VERTICES	65536
+
+//16 bytes instead of the 32 of VertexXYZNUV, the GPU reads it as SHORT4, SHORT2, SHORT2, see VertexPackedPNT
+struct packed_vertex
+{
+	short		  pos[4];		//over the position bounds of its draw, w is unused
+	short		  normal[2];	//octahedral, -32767 to 32767
+	short		  uv[2];		//over the uv bounds of its draw
+};
+
+//one draw of at most PACKED_MESH_MAX_VERTICES vertices, larger submeshes are split into several;
+//a stored value decodes to value * scale + bias
+struct packed_submesh
+{
+	uint32		  start_index;
+	uint32		  index_count;
+	uint32		  base_vertex;	//added to each of its 16 bit indices
+	uint32		  vertex_count;
+	uint32		  source;		//submesh of the mesh it came from, for the material
+	float		  pos_scale[3];	//half the bounds size / 32767
+	float		  pos_bias[3];	//bounds center
+	float		  uv_scale[2];
+	float		  uv_bias[2];
+};
+
+inline void decode_position(const packed_submesh& sub, const packed_vertex& v, XMFLOAT3& pos)
+{
+	pos.x = v.pos[0] * sub.pos_scale[0] + sub.pos_bias[0];
+	pos.y = v.pos[1] * sub.pos_scale[1] + sub.pos_bias[1];
+	pos.z = v.pos[2] * sub.pos_scale[2] + sub.pos_bias[2];
+}
+
+inline void decode_uv(const packed_submesh& sub, const packed_vertex& v, XMFLOAT2& uv)
+{
+	uv.x = v.uv[0] * sub.uv_scale[0] + sub.uv_bias[0];
+	uv.y = v.uv[1] * sub.uv_scale[1] + sub.uv_bias[1];
+}
+
+void encode_octahedral(const XMFLOAT3& normal, short out[2]);
+void decode_normal(const packed_vertex& v, XMFLOAT3& normal);
+
+//ranges of the source submeshes in the packed vertices and indices, the draws of one submesh are contiguous
+void get_packed_groups(const packed_submesh* draws, uint32 draw_count, uint32 source_count, std::vector<group_info>& groups);
+
+//32 bit indices into the packed vertices, with the base vertices added
+void expand_packed_indices(const uint16* indices, const packed_submesh* draws, uint32 draw_count, std::vector<UINT>& out);
+
+/**
+*  Quantized copy of a CMesh: 16 bit indices relative to each draw's base vertex, 16 bit positions and uvs over the
+*  bounds of their draws and octahedral normals.
+*  While every submesh spans at most PACKED_MESH_MAX_VERTICES vertices the vertex order is kept and each submesh is
+*  one draw over its own window of the vertices; draws whose windows overlap share their bounds, so a shared vertex
+*  is stored once. Otherwise the vertices are gathered per draw in first use order, and ones shared between draws are
+*  duplicated.
+*  Built meshes own their data, assigned ones point into memory the caller keeps, e.g. a mapped mesh cache.
+*/
+class CPackedMesh
+{
+public:
+	CPackedMesh();
+
+	//fails if the submeshes do not split the index buffer into disjoint ranges
+	bool Build(const vertex_streams& vb, const UINT* ib, uint32 index_count, const std::vector<submesh>& submesh_list);
+	void Assign(const packed_vertex* vertices, uint32 vertex_count, const uint16* indices, uint32 index_count,
+		const packed_submesh* submeshes, uint32 submesh_count);
+	void Clear();
+
+	bool IsEmpty() const { return m_submesh_count == 0; }
+	const packed_vertex* GetVertices() const { return m_vertices; }
+	uint32 GetVertexCount() const { return m_vertex_count; }
+	const uint16* GetIndices() const { return m_indices; }
+	uint32 GetIndexCount() const { return m_index_count; }
+	const packed_submesh* GetSubmeshes() const { return m_submeshes; }
+	uint32 GetSubmeshCount() const { return m_submesh_count; }
+	uint32 GetSize() const;
+
+	//float vertices in the packed order, ones no draw reaches stay zero
+	void Decode(std::vector<VertexXYZNUV>& vertices) const;
+
+private:
+	CPackedMesh(const CPackedMesh&);
+	CPackedMesh& operator=(const CPackedMesh&);
+
+	const packed_vertex*		m_vertices;
+	uint32						m_vertex_count;
+	const uint16*				m_indices;
+	uint32						m_index_count;
+	const packed_submesh*		m_submeshes;
+	uint32						m_submesh_count;
+	std::vector<packed_vertex>	m_vertex_storage;
+	std::vector<uint16>			m_index_storage;
+	std::vector<packed_submesh> m_submesh_storage;
+};
+
+#endif //PACKED_MESH_H
@@ -0,0 +1,40 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+#include <atomic>
+#include <thread>
+#include <vector>
+
+//set on threads that run one of several loads side by side, e.g. the SceneLoader workers;
+//the loads already keep every core busy, so parallel_for runs serially there instead of starting threads
+extern __declspec(thread) bool parallel_for_serial;
+
+//runs body(i) for i in [0, count) on all cores, items are handed out one at a time
+template <typename Body>
+inline void parallel_for(int count, const Body& body)
+{
+	if (parallel_for_serial)
+	{
+		for (int i = 0; i < count; i++)
+			body(i);
+		return;
+	}
+
+	std::atomic<int> next(0);
+	auto worker = [&]()
+	{
+		for (int i = next++; i < count; i = next++)
+			body(i);
+	};
+
+	int num_threads = (int)std::thread::hardware_concurrency();
+	if (num_threads > count)
+		num_threads = count;
+	std::vector<std::thread> threads;
+	for (int i = 1; i < num_threads; i++)
+		threads.push_back(std::thread(worker));
+	worker();
+	for (size_t i = 0; i < threads.size(); i++)
+		threads[i].join();
+}
+
+#endif //PARALLEL_FOR_H
@@ -1,8 +1,105 @@
 #include "assert.h"
 #include <iostream>
+#include <emmintrin.h>
+#include <string.h>
 #include "TGALoader.h"
+#include "MappedFile.h"
+
+#define TGA_HEADER_SIZE		18
+
+static uint16 read_uint16(const uchar* data)
+{
+	return data[0] | (data[1] << 8);
+}
+
+//channel < 0 keeps whole pixels, otherwise only that byte of each
+static bool copy_pixels(const uchar* src, const uchar* end, uchar* dst, uint32 texels, uint32 byte_count, int channel)
+{
+	if ((uint64)(end - src) < (uint64)texels * byte_count)
+		return false;
+	if (channel < 0 || byte_count == 1)
+	{
+		memcpy(dst, src, texels * (channel < 0 ? byte_count : 1));
+		return true;
+	}
+	src += channel;
+	for (uint32 i = 0; i < texels; i++, src += byte_count)
+		dst[i] = *src;
+	return true;
+}
+
+//packets are a count byte then one pixel repeated, top bit set, or that many raw pixels;
+//runs may cross rows but not the end of the image
+static bool decode_rle(const uchar* src, const uchar* end, uchar* dst, uint32 texels, uint32 byte_count, int channel)
+{
+	const uint32 out_bytes = channel < 0 ? byte_count : 1;
+	const uint32 in_offset = channel < 0 ? 0 : channel;
+	uint32 i = 0;
+	while (i < texels)
+	{
+		if (src >= end)
+			return false;
+		const uchar packet = *src++;
+		const uint32 count = (packet & 0x7f) + 1;
+		if (count > texels - i)
+			return false;
+		if (packet & 0x80)
+		{
+			if ((uint32)(end - src) < byte_count)
+				return false;
+			uchar* out = dst + i * out_bytes;
+			for (uint32 k = 0; k < count; k++, out += out_bytes)
+				memcpy(out, src + in_offset, out_bytes);
+			src += byte_count;
+		}
+		else
+		{
+			if ((uint32)(end - src) < count * byte_count)
+				return false;
+			if (channel < 0)
+			{
+				memcpy(dst + i * out_bytes, src, count * byte_count);
+			}
+			else
+			{
+				for (uint32 k = 0; k < count; k++)
+					dst[i + k] = src[k * byte_count + in_offset];
+			}
+			src += count * byte_count;
+		}
+		i += count;
+	}
+	return true;
+}
+
+//bgr(a) to rgb(a), four 32 bit pixels a step
+static void swap_red_blue(uchar* image, uint32 texels, uint32 byte_count)
+{
+	uint32 i = 0;
+	if (byte_count == 4)
+	{
+		const __m128i green_alpha = _mm_set1_epi32(0xff00ff00);
+		const __m128i low_byte = _mm_set1_epi32(0x000000ff);
+		for (; i + 4 <= texels; i += 4)
+		{
+			__m128i* p = (__m128i*)(image + i * 4);
+			const __m128i v = _mm_loadu_si128(p);
+			const __m128i red = _mm_and_si128(_mm_srli_epi32(v, 16), low_byte);
+			const __m128i blue = _mm_slli_epi32(_mm_and_si128(v, low_byte), 16);
+			_mm_storeu_si128(p, _mm_or_si128(_mm_and_si128(v, green_alpha), _mm_or_si128(red, blue)));
+		}
+	}
+	if (byte_count >= 3)
+	{
+		for (uchar* p = image + i * byte_count; i < texels; i++, p += byte_count)
+		{
+			uchar tmp = p[0];
+			p[0] = p[2];
+			p[2] = tmp;
+		}
+	}
+}
 
-#pragma optimize("", off)
 /** 캯 */
 CTGALoader::CTGALoader()
 {
@@ -18,77 +115,64 @@ CTGALoader::~CTGALoader()
 	FreeImage();           /**< ͷڴ */
 }
 /** TGAļ */
-bool CTGALoader::LoadTGA(const string& filename)
+bool CTGALoader::LoadTGA(const string& filename, tga_load_mode mode)
 {
 	if (filename.length() < 5) return false;
 	string format = filename.substr(filename.length() - 4, 4);
 	if (format != ".tga" && format != ".TGA") return false;
-	FILE *pfile;
 
-	/** ļ */
-	pfile = fopen(filename.c_str(), "rb");
-	//pfile = fopen("D:/logo2.tga", "rb");
-	if (!pfile)			   
+	CMappedFile file;
+	if (!file.Open(filename) || file.GetSize() < TGA_HEADER_SIZE)
 		return false;
+	const uchar* data = file.GetData();
+	const uchar* end = data + file.GetSize();
 
+	ctType = data[2];
+	imageWidth = read_uint16(data + 12);
+	imageHeight = read_uint16(data + 14);
+	depth = data[16];
+	byteCount = depth >> 3;
 
-	fseek(pfile, 2 * sizeof(uchar), SEEK_CUR);
-	fread(&ctType, sizeof(uchar), 1, pfile);
-
-	//width
-	fseek(pfile, 4 * sizeof(uint16)+sizeof(uchar), SEEK_CUR);
-	fread(&imageWidth, sizeof(uint16), 1, pfile);
-
-	//height
-	fread(&imageHeight, sizeof(uint16), 1, pfile);
-	fread(&depth, sizeof(uchar), 1, pfile);
-	fseek(pfile, sizeof(uchar), SEEK_CUR);
-
-	//color indexed
-	if (ctType == 1)
-	{
-		fclose(pfile);
-		assert(0, "ļʹ!");
+	//color indexed, plain or rle, is not supported
+	const bool rle = ctType == 10 || ctType == 11;
+	if ((ctType != 2 && ctType != 3 && !rle) || byteCount == 0 || byteCount > 4)
 		return false;
-	}
 
-	if (ctType != 2 && ctType != 3)
-	{
-		fclose(pfile);
-		assert(0, "ļʹ!");
+	//the image id and an unused color map may sit between the header and the pixels
+	const uint32 color_map_size = data[1] ? read_uint16(data + 5) * ((data[7] + 7) >> 3) : 0;
+	const uchar* pixels = data + TGA_HEADER_SIZE + data[0] + color_map_size;
+	if (pixels > end)
 		return false;
-	}
-
-	byteCount = depth >> 3;
-	size = imageWidth * imageHeight * byteCount;
 
+	//alpha planes keep the last channel after the bgr swap below, blue for 24 bit files
+	const uint32 texels = (uint32)imageWidth * imageHeight;
+	const int channel = mode == TGA_LOAD_ALPHA ? (byteCount == 3 ? 0 : byteCount - 1) : -1;
+	const uint32 out_bytes = channel < 0 ? byteCount : 1;
+	size = texels * out_bytes;
 	image = new uchar[size];
-	fread(image, size, 1, pfile);
 
-	if (image == NULL)
+	bool ok;
+	if (rle)
+		ok = decode_rle(pixels, end, image, texels, byteCount, channel);
+	else
+		ok = copy_pixels(pixels, end, image, texels, byteCount, channel);
+	if (!ok)
 	{
-		fclose(pfile);
+		FreeImage();
+		size = 0;
 		return false;
 	}
 
-	if (ferror(pfile))
+	if (channel < 0)
 	{
-		fclose(pfile);
-		return false;
+		swap_red_blue(image, texels, byteCount);
 	}
-
-	if (byteCount >= 3) //RGB RGBA
+	else
 	{
-		for (int i = 0; i < size; i += byteCount)     //convert from bgr to rgb
-		{
-			uchar tmp = image[i];
-			image[i] = image[i + 2];
-			image[i + 2] = tmp;
-		}
+		byteCount = 1;
+		depth = 8;
+		ctType = 3;
 	}
-
-	fclose(pfile);
-
 	return true;
 }
 
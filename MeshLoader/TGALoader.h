@@ -13,6 +13,14 @@
 /** TGAļ */
 #include "baseDefine.h"
 using std::string;
+
+enum tga_load_mode
+{
+	TGA_LOAD_RGBA = 0,
+	//one byte per texel, the channel FMaterial::SampleAlphaTest reads, nothing else is kept
+	TGA_LOAD_ALPHA = 1,
+};
+
 class CTGALoader
 {
 public:
@@ -26,8 +34,12 @@ public:
 	uchar depth;
 	CTGALoader();                             /**< 캯 */
 	~CTGALoader();
-	bool LoadTGA(const string& filename);          /**< TGAļ */
+	bool LoadTGA(const string& filename, tga_load_mode mode = TGA_LOAD_RGBA);          /**< TGAļ */
 	void FreeImage();                        /**< ͷڴ */
+private:
+	//images are shared through CTextureCache, a copy would free them twice
+	CTGALoader(const CTGALoader&);
+	CTGALoader& operator=(const CTGALoader&);
 	
 };
 #endif
\ No newline at end of file
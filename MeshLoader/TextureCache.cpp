@@ -0,0 +1,199 @@
+#include "TextureCache.h"
+
+std::string normalize_texture_path(const std::string& path)
+{
+	std::string result;
+	result.reserve(path.size());
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		char c = path[i] == '\\' ? '/' : path[i];
+		if (c >= 'A' && c <= 'Z')
+			c += 'a' - 'A';
+		if (c == '/' && !result.empty() && result[result.size() - 1] == '/')
+			continue;
+		result.push_back(c);
+	}
+
+	//resolve the segments, a leading ".." of a relative path has nothing to cancel and stays
+	std::vector<std::string> segments;
+	size_t start = 0;
+	while (start <= result.size())
+	{
+		size_t end = result.find('/', start);
+		if (end == std::string::npos)
+			end = result.size();
+		const std::string segment = result.substr(start, end - start);
+		if (segment == "..")
+		{
+			if (!segments.empty() && segments.back() != ".." && !segments.back().empty())
+				segments.pop_back();
+			else
+				segments.push_back(segment);
+		}
+		else if (segment != "." || end == result.size())
+		{
+			segments.push_back(segment);
+		}
+		start = end + 1;
+	}
+
+	result.clear();
+	for (size_t i = 0; i < segments.size(); i++)
+	{
+		if (i)
+			result.push_back('/');
+		result += segments[i];
+	}
+	return result;
+}
+
+//constructed before main, function statics are not thread safe on this compiler
+CTextureCache CTextureCache::s_instance;
+
+CTextureCache& CTextureCache::get_instance()
+{
+	return s_instance;
+}
+
+CTextureCache::CTextureCache()
+	: m_budget(TEXTURE_CACHE_DEFAULT_BUDGET)
+	, m_retained_bytes(0)
+	, m_load_count(0)
+	, m_hit_count(0)
+{
+}
+
+TEXTURE_PTR CTextureCache::Acquire(const std::string& path, tga_load_mode mode)
+{
+	const std::string key = normalize_texture_path(path) + (mode == TGA_LOAD_ALPHA ? "#alpha" : "");
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;)
+	{
+		ENTRY_MAP::iterator it = m_entries.find(key);
+		if (it == m_entries.end())
+			break;
+		entry& e = it->second;
+		if (e.loading)
+		{
+			//looked up again after the wait, the entry may be gone by then
+			m_loaded.wait(lock);
+			continue;
+		}
+		if (e.failed)
+			return TEXTURE_PTR();
+		TEXTURE_PTR image = e.image.lock();
+		if (image)
+		{
+			m_hit_count++;
+			retain(key, e, image);
+			return image;
+		}
+		//released everywhere after the cache had dropped it
+		m_entries.erase(it);
+		break;
+	}
+
+	m_entries[key].loading = true;
+	lock.unlock();
+
+	TEXTURE_PTR image(new CTGALoader());
+	const bool ok = image->LoadTGA(path, mode);
+
+	lock.lock();
+	//entries being loaded are never erased
+	entry& e = m_entries[key];
+	e.loading = false;
+	if (ok)
+	{
+		e.image = image;
+		e.size = image->size;
+		m_load_count++;
+		retain(key, e, image);
+	}
+	else
+	{
+		e.failed = true;
+		image.reset();
+	}
+	m_loaded.notify_all();
+	return image;
+}
+
+void CTextureCache::retain(const std::string& key, entry& e, const TEXTURE_PTR& image)
+{
+	if (e.retained)
+	{
+		m_lru.splice(m_lru.begin(), m_lru, e.lru);
+	}
+	else
+	{
+		e.retained = image;
+		e.lru = m_lru.insert(m_lru.begin(), key);
+		m_retained_bytes += e.size;
+	}
+	evict();
+}
+
+void CTextureCache::evict()
+{
+	while (m_retained_bytes > m_budget && !m_lru.empty())
+	{
+		ENTRY_MAP::iterator it = m_entries.find(m_lru.back());
+		m_lru.pop_back();
+		entry& e = it->second;
+		m_retained_bytes -= e.size;
+		e.retained.reset();
+		//still used somewhere, the entry keeps deduplicating it until then
+		if (e.image.expired())
+			m_entries.erase(it);
+	}
+}
+
+void CTextureCache::SetBudget(uint64 bytes)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_budget = bytes;
+	evict();
+}
+
+uint64 CTextureCache::GetBudget() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_budget;
+}
+
+uint64 CTextureCache::GetRetainedBytes() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_retained_bytes;
+}
+
+uint32 CTextureCache::GetLoadCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_load_count;
+}
+
+uint32 CTextureCache::GetHitCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_hit_count;
+}
+
+void CTextureCache::Clear()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_lru.clear();
+	m_retained_bytes = 0;
+	ENTRY_MAP::iterator it = m_entries.begin();
+	while (it != m_entries.end())
+	{
+		if (it->second.loading)
+		{
+			++it;
+			continue;
+		}
+		it->second.retained.reset();
+		it = m_entries.erase(it);
+	}
+}
@@ -0,0 +1,78 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+#include "TGALoader.h"
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+
+//decoded images are shared by every submesh using the file, freed with the last reference
+typedef std::shared_ptr<CTGALoader> TEXTURE_PTR;
+
+#define TEXTURE_CACHE_DEFAULT_BUDGET	(256ull * 1024 * 1024)
+
+//lower case, forward slashes and no "." or ".." segments, so every spelling of a file is one key
+std::string normalize_texture_path(const std::string& path);
+
+/**
+*  Process wide cache of decoded TGA files keyed by normalized path.
+*  A file is read once however many submeshes and loader threads ask for it, a request for a
+*  file still loading waits for that load. Images live while anyone holds them, on top of that
+*  the cache keeps the most recently used ones alive up to a byte budget.
+*/
+class CTextureCache
+{
+public:
+	static CTextureCache& get_instance();
+
+	//NULL if the file cannot be loaded, failures are not retried until Clear
+	//each mode of a file is a separate image
+	TEXTURE_PTR Acquire(const std::string& path, tga_load_mode mode = TGA_LOAD_RGBA);
+
+	//least recently used images are dropped once the ones only the cache holds exceed it
+	void SetBudget(uint64 bytes);
+	uint64 GetBudget() const;
+	uint64 GetRetainedBytes() const;
+
+	//files decoded and requests served without decoding
+	uint32 GetLoadCount() const;
+	uint32 GetHitCount() const;
+
+	//drops every image the cache holds and forgets failures, loads in flight are kept
+	void Clear();
+
+private:
+	struct entry
+	{
+		std::weak_ptr<CTGALoader> image;
+		TEXTURE_PTR				  retained;		//set while the key is in m_lru
+		std::list<std::string>::iterator lru;
+		uint32					  size;
+		bool					  loading;
+		bool					  failed;
+
+		entry() : size(0), loading(false), failed(false) {}
+	};
+	typedef std::map<std::string, entry> ENTRY_MAP;
+
+	CTextureCache();
+	CTextureCache(const CTextureCache&);
+	CTextureCache& operator=(const CTextureCache&);
+
+	//both with m_mutex held
+	void retain(const std::string& key, entry& e, const TEXTURE_PTR& image);
+	void evict();
+
+	static CTextureCache	s_instance;
+
+	mutable std::mutex		m_mutex;
+	std::condition_variable m_loaded;
+	ENTRY_MAP				m_entries;
+	std::list<std::string>	m_lru;		//most recently used first
+	uint64					m_budget;
+	uint64					m_retained_bytes;
+	uint32					m_load_count;
+	uint32					m_hit_count;
+};
+
+#endif //TEXTURE_CACHE_H
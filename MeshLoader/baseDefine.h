@@ -9,6 +9,7 @@
 typedef unsigned int  uint32;
 typedef unsigned char uchar;
 typedef unsigned short uint16;
+typedef unsigned long long uint64;
 
 typedef std::map<std::string, std::string> FILE_MAP;
 typedef std::vector<std::string> STRING_VECTOR;
@@ -51,6 +52,47 @@ struct VertexXYZNUV
 	const static int FVF;
 };
 
+//VertexXYZNUV streams read in place, interleaved in one array or each one packed on its own
+struct vertex_streams
+{
+	const uchar*	pos;
+	const uchar*	normal;
+	const uchar*	uv;
+	uint32			pos_stride;
+	uint32			normal_stride;
+	uint32			uv_stride;
+	uint32			count;
+
+	const XMFLOAT3& position(uint32 i) const { return *(const XMFLOAT3*)(pos + i * pos_stride); }
+	const XMFLOAT3& normal_at(uint32 i) const { return *(const XMFLOAT3*)(normal + i * normal_stride); }
+	const XMFLOAT2& uv_at(uint32 i) const { return *(const XMFLOAT2*)(uv + i * uv_stride); }
+	VertexXYZNUV vertex(uint32 i) const
+	{
+		VertexXYZNUV v;
+		v.pos_ = position(i);
+		v.normal_ = normal_at(i);
+		v.uv_ = uv_at(i);
+		return v;
+	}
+	//the VertexXYZNUV array behind the streams, NULL if they are separate arrays
+	const VertexXYZNUV* interleaved() const
+	{
+		return pos_stride == sizeof(VertexXYZNUV) && normal == pos + sizeof(XMFLOAT3) && uv == normal + sizeof(XMFLOAT3) ?
+			(const VertexXYZNUV*)pos : NULL;
+	}
+};
+
+inline vertex_streams get_interleaved_streams(const VertexXYZNUV* vertices, uint32 count)
+{
+	vertex_streams streams;
+	streams.pos = (const uchar*)vertices;
+	streams.normal = streams.pos + sizeof(XMFLOAT3);
+	streams.uv = streams.normal + sizeof(XMFLOAT3);
+	streams.pos_stride = streams.normal_stride = streams.uv_stride = sizeof(VertexXYZNUV);
+	streams.count = count;
+	return streams;
+}
+
 // Position //Normal
 struct VertexXYZN
 {
@@ -1,6 +1,6 @@
 #ifndef SUBMESH_H
 #define SUBMESH_H
-#include "TGALoader.h"
+#include "TextureCache.h"
 
 class material
 {
@@ -40,7 +40,7 @@ public:
 	bool		 m_twoSided;
 	bool		 m_alphaTest;
 	uchar		 m_alphaRef;
-	CTGALoader	 m_diffuse;
+	TEXTURE_PTR	 m_diffuse;
 	material	 m_mat;
 	group_info   m_group_info;
 	CMesh*		 m_parent;
@@ -1,8 +1,11 @@
 #include "SDF.h"
 #include "SDF/MeshUtilities.h"
+#include "SDF/DistanceFieldSampler.h"
 //#pragma optimize("", off)
 
 SDFModel::SDFModel(CMesh& cmesh)
+	: bakeHandle(NULL)
+	, primitive(NULL)
 {
 	meshData = new MeshData();
 	MeshVerts &vertices = meshData->Vertices;
@@ -11,32 +14,64 @@ SDFModel::SDFModel(CMesh& cmesh)
 	MeshMats &mats = meshData->Mats;
 
 	SUBMESH_LIST& submesh_list = cmesh.GetSubMeshList();
-	MESH_VERTEX& vb = cmesh.GetMeshVertex();
-	INDEX_LIST& ib = cmesh.GetIndexList();
- 	vertices.resize(vb.size());
-	uvs.resize(vb.size());
-	tris.resize(ib.size() / 3);
+	// Read in place, from the mesh cache when the mesh was loaded from one; packed meshes are decoded below
+	const vertex_streams vb = cmesh.GetVertexStreams();
+	vertices.resize(cmesh.GetVertexCount());
+	uvs.resize(cmesh.GetVertexCount());
 	mats.resize(submesh_list.size());
 	
 	for (int k = 0; k < submesh_list.size(); k++)
 	{
-		for (uint32 i = submesh_list[k].getStartVertex(); i < submesh_list[k].getEndVertex(); i++)
+		for (uint32 i = submesh_list[k].getStartVertex(); i < submesh_list[k].getEndVertex() && i < vb.count; i++)
 		{
-			vertices[i] = *(FVector*)&vb[i].pos_;
+			vertices[i] = *(const FVector*)&vb.position(i);
 			if (submesh_list[k].m_alphaTest) //uv is not used when alpha test is not enabled
-				uvs[i] = *(FVector2D*)&vb[i].uv_;
-		}
-
-		for (uint32 i = submesh_list[k].getStartIndex(); i < submesh_list[k].getEndIndex(); i ++)
-		{
-			tris[i / 3].indices[i % 3] = ib[i];
-			tris[i / 3].material = k;//materail group index
+				uvs[i] = *(const FVector2D*)&vb.uv_at(i);
 		}
 		mats[k].alphaTest = submesh_list[k].m_alphaTest;
 		mats[k].twoSided = submesh_list[k].m_twoSided;
-		if (submesh_list[k].m_alphaTest) {
+		if (submesh_list[k].m_alphaTest && submesh_list[k].m_diffuse) {
 			mats[k].alphaRef = submesh_list[k].m_alphaRef;
-			mats[k].diffuse = *(FTexture*)&submesh_list[k].m_diffuse;
+			mats[k].diffuse = *(FTexture*)submesh_list[k].m_diffuse.get();
+			textures.push_back(submesh_list[k].m_diffuse);
+		}
+	}
+
+	if (cmesh.IsPacked())
+	{
+		//16 bit indices are relative to the base vertex of their draw, vertices are quantized over its bounds
+		const CPackedMesh& packed = cmesh.GetPackedMesh();
+		const packed_vertex* pvb = packed.GetVertices();
+		const uint16* pib = packed.GetIndices();
+		const packed_submesh* draws = packed.GetSubmeshes();
+		tris.resize(packed.GetIndexCount() / 3);
+		for (uint32 d = 0; d < packed.GetSubmeshCount(); d++)
+		{
+			const packed_submesh& draw = draws[d];
+			for (uint32 v = draw.base_vertex; v < draw.base_vertex + draw.vertex_count; v++)
+			{
+				decode_position(draw, pvb[v], *(XMFLOAT3*)&vertices[v]);
+				if (mats[draw.source].alphaTest)
+					decode_uv(draw, pvb[v], *(XMFLOAT2*)&uvs[v]);
+			}
+			for (uint32 i = draw.start_index; i < draw.start_index + draw.index_count; i++)
+			{
+				tris[i / 3].indices[i % 3] = draw.base_vertex + pib[i];
+				tris[i / 3].material = draw.source;
+			}
+		}
+	}
+	else
+	{
+		const UINT* ib = cmesh.GetIndices();
+		tris.resize(cmesh.GetIndexCount() / 3);
+		for (int k = 0; k < submesh_list.size(); k++)
+		{
+			for (uint32 i = submesh_list[k].getStartIndex(); i < submesh_list[k].getEndIndex(); i ++)
+			{
+				tris[i / 3].indices[i % 3] = ib[i];
+				tris[i / 3].material = k;//materail group index
+			}
 		}
 	}
 
@@ -45,12 +80,14 @@ SDFModel::SDFModel(CMesh& cmesh)
 	sdfData = new FDistanceFieldVolumeData(boxSphereBounds->GetBox());
 }
 
-SDFModel::SDFModel(std::vector<VertexPNT>& vert, std::vector<UINT> &ind)
+static void BuildMeshData(MeshData& meshData, std::vector<VertexPNT>& vert, std::vector<UINT> &ind)
 {
-	meshData = new MeshData();
-	MeshVerts &vertices = meshData->Vertices;
-	MeshTries &tris = meshData->Indices;
+	MeshVerts &vertices = meshData.Vertices;
+	MeshTries &tris = meshData.Indices;
 	vertices.resize(vert.size());
+	// The bake reads the material and uvs of every triangle, one opaque material covers them all
+	meshData.UVs.resize(vert.size());
+	meshData.Mats.resize(1);
 	tris.resize(ind.size() / 3);
 
 	for (uint32 i = 0; i < vertices.size(); i++)
@@ -63,7 +100,27 @@ SDFModel::SDFModel(std::vector<VertexPNT>& vert, std::vector<UINT> &ind)
 		tris[i].indices[0] = ind[i * 3];
 		tris[i].indices[1] = ind[i * 3 + 1];
 		tris[i].indices[2] = ind[i * 3 + 2];
+		tris[i].material = 0;
 	}
+}
+
+SDFModel::SDFModel(std::vector<VertexPNT>& vert, std::vector<UINT> &ind)
+	: bakeHandle(NULL)
+	, primitive(NULL)
+{
+	meshData = new MeshData();
+	BuildMeshData(*meshData, vert, ind);
+	boxSphereBounds = new FBoxSphereBounds();
+	GenerateBoxSphereBounds(boxSphereBounds, meshData);
+	sdfData = new FDistanceFieldVolumeData(boxSphereBounds->GetBox());
+}
+
+SDFModel::SDFModel(const FDistanceFieldPrimitive& prim, std::vector<VertexPNT>& vert, std::vector<UINT> &ind)
+	: bakeHandle(NULL)
+	, primitive(new FDistanceFieldPrimitive(prim))
+{
+	meshData = new MeshData();
+	BuildMeshData(*meshData, vert, ind);
 	boxSphereBounds = new FBoxSphereBounds();
 	GenerateBoxSphereBounds(boxSphereBounds, meshData);
 	sdfData = new FDistanceFieldVolumeData(boxSphereBounds->GetBox());
@@ -71,24 +128,68 @@ SDFModel::SDFModel(std::vector<VertexPNT>& vert, std::vector<UINT> &ind)
 
 SDFModel::~SDFModel()
 {
+	// The bake writes into sdfData until it stops
+	delete bakeHandle;
 	delete meshData;
 	delete sdfData;
 	delete boxSphereBounds;
+	delete primitive;
+}
+
+void SDFModel::GenerateSDF(float DistanceFieldResolutionScale, bool bGenerateAsIfTwoSided, EDistanceFieldFormat Format)
+{
+	if (primitive)
+	{
+		GenerateDistanceFieldPrimitiveVolume(*primitive, DistanceFieldResolutionScale, *sdfData);
+	}
+	else
+	{
+		GenerateSignedDistanceFieldVolumeData(
+			*meshData
+			, *boxSphereBounds
+			, DistanceFieldResolutionScale
+			, bGenerateAsIfTwoSided
+			, *sdfData);
+	}
+
+	sdfData->Compress(Format);
+	if (Format != DFF_Float16)
+	{
+		// Errors are reported in world units
+		const FDistanceFieldCompressionStats& Stats = sdfData->CompressionStats;
+		const float MaxExtent = sdfData->LocalBoundingBox.GetExtent().GetMax();
+		char buffer[256];
+		sprintf(buffer, "SDF %dx%dx%d format %d: max error %f, rms error %f, %u -> %u bytes\n",
+			sdfData->Size.X, sdfData->Size.Y, sdfData->Size.Z, (int)Format,
+			Stats.MaxError * MaxExtent, Stats.RMSError * MaxExtent,
+			(uint32)Stats.SourceBytes, (uint32)Stats.CompressedBytes);
+		OutputDebugStringA(buffer);
+	}
 }
 
-void SDFModel::GenerateSDF(float DistanceFieldResolutionScale, bool bGenerateAsIfTwoSided)
+FDistanceFieldBakeHandle* SDFModel::BeginGenerateSDF(float DistanceFieldResolutionScale, bool bGenerateAsIfTwoSided, EDistanceFieldFormat Format, double TimeBudget)
 {
-	GenerateSignedDistanceFieldVolumeData(
-		*meshData
-		, *boxSphereBounds
-		, DistanceFieldResolutionScale
-		, bGenerateAsIfTwoSided
-		, *sdfData);
+	delete bakeHandle;
+	bakeHandle = NULL;
+
+	if (primitive)
+	{
+		GenerateSDF(DistanceFieldResolutionScale, bGenerateAsIfTwoSided, Format);
+		return NULL;
+	}
+
+	FDistanceFieldBakeSettings settings;
+	settings.ResolutionScale = DistanceFieldResolutionScale;
+	settings.bGenerateAsIfTwoSided = bGenerateAsIfTwoSided;
+	settings.Format = Format;
+	settings.TimeBudget = TimeBudget;
+	bakeHandle = new FDistanceFieldBakeHandle(*meshData, *boxSphereBounds, settings, *sdfData);
+	return bakeHandle;
 }
 
-void SDFModel::GetSDFData(SDFFloat*& data, uint32&w, uint32&h, uint32&d)
+void SDFModel::GetSDFData(const SDFFloat*& data, std::vector<SDFFloat>& scratch, uint32&w, uint32&h, uint32&d)
 {
-	sdfData->GetDistanceFieldVolumeData(data);
+	sdfData->GetDistanceFieldVolumeData(data, scratch);
 	w = sdfData->Size.X;
 	h = sdfData->Size.Y;
 	d = sdfData->Size.Z;
@@ -122,7 +223,88 @@ float SDFModel::GetRes()
 	return 0.0f;
 }
 
-SDFModel SDFModel::Merge(SDFModel& m0, FVector& Pos0, SDFModel& m1, FVector& Pos1)
+// Waits for a background bake still writing the volume, returns false if it has no voxels (never baked or cancelled)
+static bool WaitForVolume(SDFModel& model)
+{
+	if (model.bakeHandle)
+		model.bakeHandle->Wait();
+	const FIntVector& size = model.sdfData->Size;
+	return size.X * size.Y * size.Z > 0;
+}
+
+void SDFModel::ExtractProxyMesh(const FDistanceFieldMeshSettings& Settings, std::vector<VertexPNT>& vert, std::vector<UINT>& ind, FDistanceFieldMeshStats* Stats)
+{
+	if (!WaitForVolume(*this))
+	{
+		vert.clear();
+		ind.clear();
+		if (Stats)
+			*Stats = FDistanceFieldMeshStats();
+		return;
+	}
+
+	FDistanceFieldSampler sampler(*sdfData);
+	FDistanceFieldMesh mesh;
+	ExtractDistanceFieldMesh(sampler, Settings, mesh, Stats);
+
+	vert.resize(mesh.Positions.size());
+	for (uint32 i = 0; i < vert.size(); i++)
+	{
+		const FVector& p = mesh.Positions[i];
+		const FVector& n = mesh.Normals[i];
+		vert[i] = VertexPNT(p.X, p.Y, p.Z, n.X, n.Y, n.Z, 0.0f, 0.0f);
+	}
+	ind.assign(mesh.Indices.begin(), mesh.Indices.end());
+}
+
+static void AppendMeshData(MeshData& dst, const MeshData& src, const FVector& offset)
 {
-	return SDFModel();
+	const uint32 baseVertex = dst.Vertices.size();
+	const uint32 baseMaterial = dst.Mats.size();
+	for (uint32 i = 0; i < src.Vertices.size(); i++)
+	{
+		dst.Vertices.push_back(src.Vertices[i] + offset);
+	}
+
+	dst.UVs.insert(dst.UVs.end(), src.UVs.begin(), src.UVs.end());
+	dst.UVs.resize(dst.Vertices.size());
+	dst.Mats.insert(dst.Mats.end(), src.Mats.begin(), src.Mats.end());
+	for (uint32 i = 0; i < src.Indices.size(); i++)
+	{
+		MeshData::Triangle tri = src.Indices[i];
+		tri.indices[0] += baseVertex;
+		tri.indices[1] += baseVertex;
+		tri.indices[2] += baseVertex;
+		tri.material += baseMaterial;
+		dst.Indices.push_back(tri);
+	}
+}
+
+SDFModel* SDFModel::Merge(SDFModel& m0, const FVector& Pos0, SDFModel& m1, const FVector& Pos1, int32 MaxNumVoxelsOneDim, EDistanceFieldMergeOp Op, float SmoothRadius)
+{
+	SDFModel* merged = new SDFModel();
+	merged->meshData = new MeshData();
+	AppendMeshData(*merged->meshData, *m0.meshData, Pos0);
+	merged->textures = m0.textures;
+	// Subtracted geometry does not contribute surface of its own
+	if (Op != DFMerge_Subtract)
+	{
+		AppendMeshData(*merged->meshData, *m1.meshData, Pos1);
+		// The appended materials point into m1's alpha masks, a rebake of the merged model reads them
+		merged->textures.insert(merged->textures.end(), m1.textures.begin(), m1.textures.end());
+	}
+
+	merged->boxSphereBounds = new FBoxSphereBounds();
+	GenerateBoxSphereBounds(merged->boxSphereBounds, merged->meshData);
+	merged->sdfData = new FDistanceFieldVolumeData(merged->boxSphereBounds->GetBox());
+
+	// A source without voxels merges as empty space
+	WaitForVolume(m0);
+	WaitForVolume(m1);
+
+	MergeDistanceFieldVolumes(*m0.sdfData, Pos0, *m1.sdfData, Pos1, Op, SmoothRadius, MaxNumVoxelsOneDim, *merged->sdfData);
+
+	// The shadow pass centers the volume on GetOrigin()
+	merged->boxSphereBounds->Origin = merged->sdfData->LocalBoundingBox.GetCenter();
+	return merged;
 }
\ No newline at end of file
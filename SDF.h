@@ -2,6 +2,11 @@
 #define _SDF_H
 //#
 #include "SDF/Config.h"
+#include "SDF/DistanceFieldFormat.h"
+#include "SDF/DistanceFieldMerge.h"
+#include "SDF/DistanceFieldBake.h"
+#include "SDF/DistanceFieldMesher.h"
+#include "SDF/DistanceFieldPrimitives.h"
 #include "Vertex.h"
 #include "MeshLoader/Mesh.h"
 struct SDFModel
@@ -10,21 +15,67 @@ public:
 	MeshData *meshData;
 	FDistanceFieldVolumeData *sdfData;
 	FBoxSphereBounds *boxSphereBounds;
-	SDFModel():sdfData(NULL){};
+	/** Background bake started by BeginGenerateSDF, owned by the model. */
+	FDistanceFieldBakeHandle *bakeHandle;
+	/** Analytic shape the volume is rasterized from instead of baking meshData, owned by the model. */
+	FDistanceFieldPrimitive *primitive;
+	/** Diffuse images the alpha tested materials point into, held until the bake reading them is gone. */
+	std::vector<TEXTURE_PTR> textures;
+	SDFModel():meshData(NULL),sdfData(NULL),boxSphereBounds(NULL),bakeHandle(NULL),primitive(NULL){};
 	SDFModel(CMesh& cmesh);
 	SDFModel(std::vector<VertexPNT>& vert, std::vector<UINT> &ind);
+	/** A GeometryGenerator shape, vert and ind are its mesh and prim the matching descriptor, e.g. Box(w, h, d) for CreateBox(w, h, d). */
+	SDFModel(const FDistanceFieldPrimitive& prim, std::vector<VertexPNT>& vert, std::vector<UINT> &ind);
 	void GenerateSDF(
 		float DistanceFieldResolutionScale, 
-		bool bGenerateAsIfTwoSided
+		bool bGenerateAsIfTwoSided,
+		EDistanceFieldFormat Format = DFF_Float16
 		);
 
-	void GetSDFData(SDFFloat*& data, uint32&w, uint32&h, uint32&d);
+	/**
+	* Starts baking in the background and returns at once, sdfData is final once the handle IsDone.
+	* A TimeBudget in seconds returns the coarse result for the bricks that did not finish in time.
+	* Restarting cancels the previous bake.
+	* Primitive models need no bake, their volume is rasterized before returning NULL.
+	*/
+	FDistanceFieldBakeHandle* BeginGenerateSDF(
+		float DistanceFieldResolutionScale, 
+		bool bGenerateAsIfTwoSided,
+		EDistanceFieldFormat Format = DFF_Float16,
+		double TimeBudget = 0
+		);
+
+	/** Compressed volumes are decoded into scratch, free it after the upload so only the compressed copy stays resident. */
+	void GetSDFData(const SDFFloat*& data, std::vector<SDFFloat>& scratch, uint32&w, uint32&h, uint32&d);
 	XMFLOAT3 GetOrigin();
 	XMFLOAT3 GetBounds();
 	XMFLOAT3 GetExtend();
 	XMFLOAT3 GetModelExtend();
 	float GetRes();
-	static SDFModel Merge(SDFModel& m0, FVector& Pos0, SDFModel& m1, FVector& Pos1);
+	/**
+	* Extracts the surface of the baked volume, e.g. for a far LOD proxy, in the vertex layout the demo draws.
+	* Positions are in the model's local space, texture coordinates are left at 0.
+	* Waits for a running bake, a volume without voxels gives an empty mesh.
+	*/
+	void ExtractProxyMesh(
+		const FDistanceFieldMeshSettings& Settings, 
+		std::vector<VertexPNT>& vert, 
+		std::vector<UINT>& ind, 
+		FDistanceFieldMeshStats* Stats = NULL
+		);
+	/**
+	* Builds one model whose field combines m0 placed at Pos0 and m1 placed at Pos1.
+	* The mesh data is concatenated in the merged space so the result can be rebaked.
+	* MaxNumVoxelsOneDim caps the merged resolution per axis, e.g. the 64 or 128 a bake of the merged mesh would use.
+	* Waits for running bakes of m0 and m1.
+	*/
+	static SDFModel* Merge(
+		SDFModel& m0, const FVector& Pos0, 
+		SDFModel& m1, const FVector& Pos1, 
+		int32 MaxNumVoxelsOneDim,
+		EDistanceFieldMergeOp Op = DFMerge_Union, 
+		float SmoothRadius = 0.0f
+		);
 	~SDFModel();
 };
 
@@ -0,0 +1,169 @@
+#include "SDFAO.h"
+#include "Vertex.h"
+
+SDFAO::SDFAO(UINT width, UINT height, const FDistanceFieldAOSettings& settings)
+	: mSettings(settings), mWidth(width), mHeight(height)
+	, mConeVisibility0(0), mConeVisibility1(0), mAOMap(0), SDFAOFX(0)
+{
+	mLowWidth = FMath::DivideAndRoundUp((int32)mWidth, mSettings.Downsample);
+	mLowHeight = FMath::DivideAndRoundUp((int32)mHeight, mSettings.Downsample);
+
+	ID3DXBuffer* errors = 0;
+	HR(D3DXCreateEffectFromFileEx(gd3dDevice, "FX/DistanceFieldAO.fx", 0, 0, 0,
+		0, 0, &SDFAOFX, &errors));
+	if( errors )
+		MessageBox(0, (char*)errors->GetBufferPointer(), 0, 0);
+
+	ConeTech			= SDFAOFX->GetTechniqueByName("DistanceFieldAOConeTech");
+	UpsampleTech		= SDFAOFX->GetTechniqueByName("DistanceFieldAOUpsampleTech");
+	InvView				= SDFAOFX->GetParameterByName(0, "gInvView");
+	FarPlane			= SDFAOFX->GetParameterByName(0, "gFarPlane");
+	Res					= SDFAOFX->GetParameterByName(0, "gRes");
+	LowRes				= SDFAOFX->GetParameterByName(0, "gLowRes");
+	Downsample			= SDFAOFX->GetParameterByName(0, "gDownsample");
+	SurfaceBias			= SDFAOFX->GetParameterByName(0, "gSurfaceBias");
+	ConeTan				= SDFAOFX->GetParameterByName(0, "gConeTan");
+	CullDistance		= SDFAOFX->GetParameterByName(0, "gCullDistance");
+	DepthThreshold		= SDFAOFX->GetParameterByName(0, "gDepthThreshold");
+	NormalPower			= SDFAOFX->GetParameterByName(0, "gNormalPower");
+	ConeDirections		= SDFAOFX->GetParameterByName(0, "gConeDirections");
+	ConeWeights			= SDFAOFX->GetParameterByName(0, "gConeWeights");
+	StepDistances		= SDFAOFX->GetParameterByName(0, "gStepDistances");
+	SDFToWordInv0		= SDFAOFX->GetParameterByName(0, "gSDFToWordInv0");
+	SDFBounds0			= SDFAOFX->GetParameterByName(0, "gSDFBounds0");
+	SDFRes0				= SDFAOFX->GetParameterByName(0, "gSDFRes0");
+	SDF0				= SDFAOFX->GetParameterByName(0, "gSDF0");
+	DepthMap			= SDFAOFX->GetParameterByName(0, "gDepthMap");
+	GBuffer0			= SDFAOFX->GetParameterByName(0, "gGBuffer0");
+	ConeVisibility0		= SDFAOFX->GetParameterByName(0, "gConeVisibility0");
+	ConeVisibility1		= SDFAOFX->GetParameterByName(0, "gConeVisibility1");
+
+	D3DVIEWPORT9 lowVP = {0, 0, mLowWidth, mLowHeight, 0.0f, 1.0f};
+	D3DVIEWPORT9 vp = {0, 0, mWidth, mHeight, 0.0f, 1.0f};
+	mConeVisibility0 = new DrawableTex2D(mLowWidth, mLowHeight, 1, D3DFMT_A16B16G16R16F, false, D3DFMT_D24S8, lowVP, false);
+	mConeVisibility1 = new DrawableTex2D(mLowWidth, mLowHeight, 1, D3DFMT_A16B16G16R16F, false, D3DFMT_D24S8, lowVP, false);
+	mAOMap = new DrawableTex2D(mWidth, mHeight, 1, D3DFMT_A8R8G8B8, false, D3DFMT_D24S8, vp, false);
+}
+
+SDFAO::~SDFAO()
+{
+	delete mConeVisibility0;
+	delete mConeVisibility1;
+	delete mAOMap;
+	ReleaseCOM(SDFAOFX);
+}
+
+void SDFAO::OnLostDevice()
+{
+	mConeVisibility0->onLostDevice();
+	mConeVisibility1->onLostDevice();
+	mAOMap->onLostDevice();
+	HR(SDFAOFX->OnLostDevice());
+}
+
+void SDFAO::OnResetDevice()
+{
+	mConeVisibility0->onResetDevice();
+	mConeVisibility1->onResetDevice();
+	mAOMap->onResetDevice();
+	HR(SDFAOFX->OnResetDevice());
+}
+
+void SDFAO::SetSharedParameters()
+{
+	// Same tables as the CPU reference
+	FVector directions[DISTANCEFIELD_AO_CONES];
+	float weights[DISTANCEFIELD_AO_CONES];
+	float steps[DISTANCEFIELD_AO_STEPS];
+	GetDistanceFieldAOCones(directions, weights);
+	GetDistanceFieldAOStepDistances(mSettings, steps);
+	const float coneTan = GetDistanceFieldAOConeTan();
+
+	D3DXVECTOR4 coneDirections[DISTANCEFIELD_AO_CONES];
+	for (int i = 0; i < DISTANCEFIELD_AO_CONES; i++)
+		coneDirections[i] = D3DXVECTOR4(directions[i].X, directions[i].Y, directions[i].Z, 0.0f);
+
+	HR(SDFAOFX->SetVectorArray(ConeDirections, coneDirections, DISTANCEFIELD_AO_CONES));
+	HR(SDFAOFX->SetFloatArray(ConeWeights, weights, DISTANCEFIELD_AO_CONES));
+	HR(SDFAOFX->SetFloatArray(StepDistances, steps, DISTANCEFIELD_AO_STEPS));
+	HR(SDFAOFX->SetFloat(ConeTan, coneTan));
+	HR(SDFAOFX->SetFloat(CullDistance, mSettings.MaxDistance * (1 + coneTan)));
+	HR(SDFAOFX->SetFloat(SurfaceBias, mSettings.SurfaceBias));
+	HR(SDFAOFX->SetFloat(Downsample, (float)mSettings.Downsample));
+	HR(SDFAOFX->SetFloat(DepthThreshold, mSettings.DepthThreshold));
+	HR(SDFAOFX->SetFloat(NormalPower, mSettings.NormalPower));
+	HR(SDFAOFX->SetValue(Res, &D3DXVECTOR2(mWidth, mHeight), sizeof(D3DXVECTOR2)));
+	HR(SDFAOFX->SetValue(LowRes, &D3DXVECTOR2(mLowWidth, mLowHeight), sizeof(D3DXVECTOR2)));
+}
+
+void SDFAO::ConePassBegin(IDirect3DVertexBuffer9* vb, IDirect3DIndexBuffer9* ib, Camera &camera,
+	IDirect3DTexture9* zbuffer, IDirect3DTexture9* gbuffer0)
+{
+	gd3dDevice->BeginScene();
+	HR(gd3dDevice->SetRenderTarget(0, mConeVisibility0->d3dSurface()));
+	HR(gd3dDevice->SetRenderTarget(1, mConeVisibility1->d3dSurface()));
+	HR(gd3dDevice->Clear(0, 0, D3DCLEAR_TARGET, 0xffffffff, 1.0f, 0));
+	HR(gd3dDevice->SetVertexDeclaration(VertexPT::Decl));
+	HR(gd3dDevice->SetStreamSource(0, vb, 0, sizeof(VertexPT)));
+	HR(gd3dDevice->SetIndices(ib));
+
+	D3DXMATRIX invView;
+	float det;
+	D3DXMatrixInverse(&invView, &det, &camera.view());
+	HR(SDFAOFX->SetTechnique(ConeTech));
+	SetSharedParameters();
+	HR(SDFAOFX->SetMatrix(InvView, &invView));
+	HR(SDFAOFX->SetValue(FarPlane, &D3DXVECTOR3(
+		camera.GetFarWindowWidth() / camera.GetFarZ(),
+		-camera.GetFarWindowHeight() / camera.GetFarZ(),
+		camera.GetFarZ()), sizeof(D3DXVECTOR3)));
+	HR(SDFAOFX->SetTexture(DepthMap, zbuffer));
+	HR(SDFAOFX->SetTexture(GBuffer0, gbuffer0));
+
+	UINT numPasses = 0;
+	HR(SDFAOFX->Begin(&numPasses, 0));
+	HR(SDFAOFX->BeginPass(0));
+}
+
+void SDFAO::ConePassDraw(D3DXMATRIX& SDFToWordInv, D3DXVECTOR3& bounds, float res, IDirect3DVolumeTexture9* sdf)
+{
+	HR(SDFAOFX->SetMatrix(SDFToWordInv0, &SDFToWordInv));
+	HR(SDFAOFX->SetValue(SDFBounds0, &bounds, sizeof(D3DXVECTOR3)));
+	HR(SDFAOFX->SetFloat(SDFRes0, res));
+	HR(SDFAOFX->SetTexture(SDF0, sdf));
+	HR(SDFAOFX->CommitChanges());
+	HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST,
+		0,0,3,
+		0,1));
+}
+
+void SDFAO::ConePassEnd()
+{
+	HR(SDFAOFX->EndPass());
+	HR(SDFAOFX->End());
+	HR(gd3dDevice->SetRenderTarget(1, NULL));
+	gd3dDevice->EndScene();
+}
+
+void SDFAO::Upsample(IDirect3DVertexBuffer9* vb, IDirect3DIndexBuffer9* ib)
+{
+	gd3dDevice->BeginScene();
+	HR(gd3dDevice->SetRenderTarget(0, mAOMap->d3dSurface()));
+	HR(gd3dDevice->SetVertexDeclaration(VertexPT::Decl));
+	HR(gd3dDevice->SetStreamSource(0, vb, 0, sizeof(VertexPT)));
+	HR(gd3dDevice->SetIndices(ib));
+	HR(SDFAOFX->SetTechnique(UpsampleTech));
+	HR(SDFAOFX->SetTexture(ConeVisibility0, mConeVisibility0->d3dTex()));
+	HR(SDFAOFX->SetTexture(ConeVisibility1, mConeVisibility1->d3dTex()));
+
+	UINT numPasses = 0;
+	HR(SDFAOFX->Begin(&numPasses, 0));
+	HR(SDFAOFX->BeginPass(0));
+	HR(SDFAOFX->CommitChanges());
+	HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST,
+		0,0,3,
+		0,1));
+	HR(SDFAOFX->EndPass());
+	HR(SDFAOFX->End());
+	gd3dDevice->EndScene();
+}
@@ -0,0 +1,68 @@
+#ifndef _SDFAO
+#define _SDFAO
+#include "d3dUtil.h"
+#include "Camera.h"
+#include "DrawableTex2D.h"
+#include "SDF/DistanceFieldAO.h"
+
+/**
+* Distance field AO on the GPU, the shader path of sdf/DistanceFieldAO.
+* Cones are traced at reduced resolution with one pass per object, which keeps the min per cone,
+* then upsampled to full resolution with the same weights as the CPU reference.
+*/
+class SDFAO
+{
+public:
+	SDFAO(UINT width, UINT height, const FDistanceFieldAOSettings& settings = FDistanceFieldAOSettings());
+	~SDFAO();
+
+	void OnLostDevice();
+	void OnResetDevice();
+
+	void ConePassBegin(IDirect3DVertexBuffer9* vb, IDirect3DIndexBuffer9* ib, Camera &camera,
+		IDirect3DTexture9* zbuffer, IDirect3DTexture9* gbuffer0);
+	void ConePassDraw(D3DXMATRIX& SDFToWordInv, D3DXVECTOR3& bounds, float res, IDirect3DVolumeTexture9* sdf);
+	void ConePassEnd();
+	void Upsample(IDirect3DVertexBuffer9* vb, IDirect3DIndexBuffer9* ib);
+
+	FDistanceFieldAOSettings mSettings;
+	UINT mWidth, mHeight;
+	UINT mLowWidth, mLowHeight;
+
+	/** Per cone visibility, cones 0-3 and 4-7. */
+	DrawableTex2D* mConeVisibility0;
+	DrawableTex2D* mConeVisibility1;
+
+	/** Full resolution visibility in r. */
+	DrawableTex2D* mAOMap;
+
+	ID3DXEffect* SDFAOFX;
+	D3DXHANDLE ConeTech;
+	D3DXHANDLE UpsampleTech;
+	D3DXHANDLE InvView;
+	D3DXHANDLE FarPlane;
+	D3DXHANDLE Res;
+	D3DXHANDLE LowRes;
+	D3DXHANDLE Downsample;
+	D3DXHANDLE SurfaceBias;
+	D3DXHANDLE ConeTan;
+	D3DXHANDLE CullDistance;
+	D3DXHANDLE DepthThreshold;
+	D3DXHANDLE NormalPower;
+	D3DXHANDLE ConeDirections;
+	D3DXHANDLE ConeWeights;
+	D3DXHANDLE StepDistances;
+	D3DXHANDLE SDFToWordInv0;
+	D3DXHANDLE SDFBounds0;
+	D3DXHANDLE SDFRes0;
+	D3DXHANDLE SDF0;
+	D3DXHANDLE DepthMap;
+	D3DXHANDLE GBuffer0;
+	D3DXHANDLE ConeVisibility0;
+	D3DXHANDLE ConeVisibility1;
+
+private:
+	void SetSharedParameters();
+};
+
+#endif
@@ -0,0 +1,1610 @@
+#include "SDFBenchmark.h"
+#include "SDF/MeshUtilities.h"
+#include "SDF/DistanceFieldSampler.h"
+#include "SDF/GlobalDistanceField.h"
+#include "SDF/DistanceFieldShadow.h"
+#include "SDF/DistanceFieldCollision.h"
+#include "SDF/DistanceFieldAO.h"
+#include "SDF/DistanceFieldCulling.h"
+#include "SDF/DistanceFieldAtlas.h"
+#include "SDF/DistanceFieldStreaming.h"
+#include "SDF/DistanceFieldMesher.h"
+#include "SDF/DistanceFieldPrimitives.h"
+#include "GeometryGenerator.h"
+#include "MeshLoader/LoadOBJ.h"
+#include "MeshLoader/CommandLine.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <algorithm>
+#include <map>
+#include <windows.h>
+
+namespace
+{
+	/** Command line of the run, for benchmarks with options of their own. */
+	const char* gCommandLine = "";
+
+	/** Wall clock in milliseconds. */
+	class BenchmarkTimer
+	{
+	public:
+		BenchmarkTimer()
+		{
+			QueryPerformanceFrequency(&mFrequency);
+			Reset();
+		}
+
+		void Reset()
+		{
+			QueryPerformanceCounter(&mStart);
+		}
+
+		double ElapsedMs() const
+		{
+			LARGE_INTEGER now;
+			QueryPerformanceCounter(&now);
+			return double(now.QuadPart - mStart.QuadPart) * 1000.0 / double(mFrequency.QuadPart);
+		}
+
+	private:
+		LARGE_INTEGER mFrequency;
+		LARGE_INTEGER mStart;
+	};
+
+	/** Collects one JSON object per line. */
+	class BenchmarkReport
+	{
+	public:
+		BenchmarkReport(FILE* file) : mFile(file) {}
+
+		void Begin(const char* benchmark, const char* test)
+		{
+			fprintf(mFile, "{\"benchmark\":\"%s\",\"test\":\"%s\"", benchmark, test);
+		}
+
+		void Value(const char* key, double value)
+		{
+			fprintf(mFile, ",\"%s\":%.6g", key, value);
+		}
+
+		void End()
+		{
+			fprintf(mFile, "}\n");
+			fflush(mFile);
+		}
+
+	private:
+		FILE* mFile;
+	};
+
+	void BuildBoxMeshData(MeshData& mesh, const FVector& extent)
+	{
+		static const float corners[8][3] = {
+			{-1,-1,-1}, {1,-1,-1}, {1,1,-1}, {-1,1,-1},
+			{-1,-1, 1}, {1,-1, 1}, {1,1, 1}, {-1,1, 1} };
+		static const unsigned faces[12][3] = {
+			{0,2,1}, {0,3,2}, {4,5,6}, {4,6,7}, {0,1,5}, {0,5,4},
+			{2,3,7}, {2,7,6}, {1,2,6}, {1,6,5}, {3,0,4}, {3,4,7} };
+
+		for (int i = 0; i < 8; i++)
+			mesh.Vertices.push_back(FVector(corners[i][0], corners[i][1], corners[i][2]) * extent);
+		for (int i = 0; i < 12; i++)
+		{
+			MeshData::Triangle tri;
+			tri.indices[0] = faces[i][0];
+			tri.indices[1] = faces[i][1];
+			tri.indices[2] = faces[i][2];
+			tri.material = 0;
+			mesh.Indices.push_back(tri);
+		}
+		mesh.UVs.resize(mesh.Vertices.size());
+		mesh.Mats.resize(1);
+	}
+
+	FDistanceFieldVolumeData* BakeMeshData(MeshData& mesh, float resolutionScale)
+	{
+		FBoxSphereBounds bounds;
+		GenerateBoxSphereBounds(&bounds, &mesh);
+		FBox box = bounds.GetBox();
+		FDistanceFieldVolumeData* data = new FDistanceFieldVolumeData(box);
+		GenerateSignedDistanceFieldVolumeData(mesh, bounds, resolutionScale, false, *data);
+		return data;
+	}
+
+	/** Instances on a grid around the origin, camera flying through them. */
+	void BenchmarkClipmap(BenchmarkReport& report)
+	{
+		MeshData mesh;
+		BuildBoxMeshData(mesh, FVector(4.0f, 4.0f, 8.0f));
+		FDistanceFieldVolumeData* volume = BakeMeshData(mesh, 2.0f);
+		FDistanceFieldSampler sampler(*volume);
+
+		const int gridSize = 48;
+		const float spacing = 20.0f;
+		FGlobalDistanceField field(4, 64, 1.0f, 4.0f);
+		std::vector<int32> instanceIds;
+		for (int y = 0; y < gridSize; y++)
+			for (int x = 0; x < gridSize; x++)
+				instanceIds.push_back(field.AddInstance(&sampler, FVector((x - gridSize / 2) * spacing, (y - gridSize / 2) * spacing, 0.0f)));
+
+		BenchmarkTimer timer;
+		FVector camera(0.0f, 0.0f, 10.0f);
+		field.Update(camera);
+		report.Begin("clipmap", "full_build");
+		report.Value("instances", (double)instanceIds.size());
+		report.Value("cascades", field.GetNumCascades());
+		report.Value("resolution", field.GetResolution());
+		report.Value("ms", timer.ElapsedMs());
+		report.Value("voxels", field.GetStats().NumVoxelsComposited);
+		report.Value("instance_samples", field.GetStats().NumInstanceSamples);
+		report.End();
+
+		// Scrolling only, the camera moves a little under a voxel of cascade 0 per frame
+		const int numFrames = 240;
+		double totalMs = 0, maxMs = 0, totalVoxels = 0;
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			camera += FVector(0.7f, 0.3f, 0.0f);
+			timer.Reset();
+			field.Update(camera);
+			const double ms = timer.ElapsedMs();
+			totalMs += ms;
+			maxMs = max(maxMs, ms);
+			totalVoxels += field.GetStats().NumVoxelsComposited;
+		}
+		report.Begin("clipmap", "scroll");
+		report.Value("frames", numFrames);
+		report.Value("avg_ms", totalMs / numFrames);
+		report.Value("max_ms", maxMs);
+		report.Value("avg_voxels", totalVoxels / numFrames);
+		report.End();
+
+		// Static camera, a few instances move every frame
+		const int movedPerFrame = 8;
+		totalMs = maxMs = totalVoxels = 0;
+		FRandomStream random(0);
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			for (int i = 0; i < movedPerFrame; i++)
+			{
+				const int32 instanceId = instanceIds[random.RandRange(0, instanceIds.size() - 1)];
+				const FVector offset(random.FRandRange(-2.0f, 2.0f), random.FRandRange(-2.0f, 2.0f), 0.0f);
+				field.UpdateInstance(instanceId, field.GetInstance(instanceId).Position + offset);
+			}
+			timer.Reset();
+			field.Update(camera);
+			const double ms = timer.ElapsedMs();
+			totalMs += ms;
+			maxMs = max(maxMs, ms);
+			totalVoxels += field.GetStats().NumVoxelsComposited;
+		}
+		report.Begin("clipmap", "instance_updates");
+		report.Value("frames", numFrames);
+		report.Value("moved_per_frame", movedPerFrame);
+		report.Value("avg_ms", totalMs / numFrames);
+		report.Value("max_ms", maxMs);
+		report.Value("avg_voxels", totalVoxels / numFrames);
+		report.End();
+
+		delete volume;
+	}
+
+	/** Distance from a point to a box centred at the origin, negative inside. */
+	float BoxDistance(const FVector& point, const FVector& extent)
+	{
+		const FVector q(FMath::Abs(point.X) - extent.X, FMath::Abs(point.Y) - extent.Y, FMath::Abs(point.Z) - extent.Z);
+		const FVector outside(max(q.X, 0.0f), max(q.Y, 0.0f), max(q.Z, 0.0f));
+		return outside.Size() + min(max(q.X, max(q.Y, q.Z)), 0.0f);
+	}
+
+	/** Trilinear sample of a volume of SDFFloat at texel coordinate (uvw * size - .5), clamped like CLAMP addressing. */
+	float SampleVoxels(const SDFFloat* voxels, const FIntVector& size, const FVector& texel)
+	{
+		const int x0 = FMath::FloorToInt(texel.X), y0 = FMath::FloorToInt(texel.Y), z0 = FMath::FloorToInt(texel.Z);
+		const float fx = texel.X - x0, fy = texel.Y - y0, fz = texel.Z - z0;
+		float result = 0;
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const int x = FMath::Clamp(x0 + (corner & 1), 0, size.X - 1);
+			const int y = FMath::Clamp(y0 + (corner >> 1 & 1), 0, size.Y - 1);
+			const int z = FMath::Clamp(z0 + (corner >> 2), 0, size.Z - 1);
+			const float weight = (corner & 1 ? fx : 1 - fx) * (corner >> 1 & 1 ? fy : 1 - fy) * (corner >> 2 ? fz : 1 - fz);
+			result += weight * voxels[(z * size.Y + y) * size.X + x];
+		}
+		return result;
+	}
+
+	/** Random volumes allocated, half freed, refilled and defragmented, every allocation sampled against its source. */
+	void BenchmarkAtlas(BenchmarkReport& report)
+	{
+		FRandomStream random(0);
+		const int numVolumes = 1500;
+		std::vector<FDistanceFieldVolumeData*> volumes;
+		for (int i = 0; i < numVolumes; i++)
+		{
+			FBox bounds(FVector(-1.0f), FVector(1.0f));
+			FDistanceFieldVolumeData* volume = new FDistanceFieldVolumeData(bounds);
+			volume->Size = FIntVector(random.RandRange(4, 40), random.RandRange(4, 40), random.RandRange(4, 40));
+			volume->DistanceFieldVolume.resize(volume->Size.X * volume->Size.Y * volume->Size.Z);
+			for (size_t v = 0; v < volume->DistanceFieldVolume.size(); v++)
+				volume->DistanceFieldVolume[v] = random.FRandRange(-1.0f, 1.0f);
+			volumes.push_back(volume);
+		}
+
+		FDistanceFieldAtlas atlas(FIntVector(256, 256, 256));
+		std::vector<int32> allocationIds(numVolumes, INDEX_NONE);
+		const auto reportStats = [&](const char* test, double ms)
+		{
+			const FDistanceFieldAtlasStats stats = atlas.GetStats();
+			report.Begin("atlas", test);
+			report.Value("ms", ms);
+			report.Value("allocations", stats.NumAllocations);
+			report.Value("pages", stats.NumPages);
+			report.Value("occupancy", (double)stats.NumUsedVoxels / max(stats.NumPageVoxels, (SIZE_t)1));
+			report.Value("moved", stats.NumMoved);
+			report.End();
+		};
+
+		BenchmarkTimer timer;
+		for (int i = 0; i < numVolumes / 2; i++)
+			allocationIds[i] = atlas.Allocate(*volumes[i]);
+		reportStats("allocate", timer.ElapsedMs());
+
+		timer.Reset();
+		for (int i = 0; i < numVolumes / 2; i += 2)
+		{
+			atlas.Free(allocationIds[i]);
+			allocationIds[i] = INDEX_NONE;
+		}
+		for (int i = numVolumes / 2; i < numVolumes; i++)
+			allocationIds[i] = atlas.Allocate(*volumes[i]);
+		reportStats("free_and_refill", timer.ElapsedMs());
+
+		timer.Reset();
+		atlas.Defragment();
+		reportStats("defragment", timer.ElapsedMs());
+
+		// Trilinear samples through the UVW table against the source, edges and outside included
+		std::vector<int32> liveIds;
+		std::vector<int> liveVolumes;
+		for (int i = 0; i < numVolumes; i++)
+		{
+			if (allocationIds[i] != INDEX_NONE)
+			{
+				liveIds.push_back(allocationIds[i]);
+				liveVolumes.push_back(i);
+			}
+		}
+		TArray<FDistanceFieldAtlasUVW> table;
+		atlas.BuildUVWTable(liveIds.data(), liveIds.size(), table);
+		const FIntVector pageSize = atlas.GetPageSize();
+		double maxError = 0;
+		for (size_t i = 0; i < liveIds.size(); i++)
+		{
+			const FDistanceFieldVolumeData& volume = *volumes[liveVolumes[i]];
+			const FDistanceFieldAtlasUVW& uvw = table[i];
+			for (int sample = 0; sample < 64; sample++)
+			{
+				const FVector local(random.FRandRange(-0.05f, 1.05f), random.FRandRange(-0.05f, 1.05f), random.FRandRange(-0.05f, 1.05f));
+				const FVector clamped(FMath::Clamp(local.X, 0.0f, 1.0f), FMath::Clamp(local.Y, 0.0f, 1.0f), FMath::Clamp(local.Z, 0.0f, 1.0f));
+				const FVector size((float)volume.Size.X, (float)volume.Size.Y, (float)volume.Size.Z);
+				const float expected = SampleVoxels(volume.DistanceFieldVolume.data(), volume.Size, clamped * size - FVector(0.5f));
+				const FVector atlasUVW = clamped * uvw.Scale + uvw.Bias;
+				const float actual = SampleVoxels(atlas.GetPageData(uvw.Page), pageSize,
+					atlasUVW * FVector((float)pageSize.X, (float)pageSize.Y, (float)pageSize.Z) - FVector(0.5f));
+				maxError = max(maxError, (double)FMath::Abs(actual - expected));
+			}
+		}
+		report.Begin("atlas", "sample");
+		report.Value("allocations", (double)liveIds.size());
+		report.Value("max_error", maxError);
+		report.End();
+
+		for (int i = 0; i < numVolumes; i++)
+			delete volumes[i];
+	}
+
+	/** Rotated boxes on a grid, agents querying and sweeping through them, checked against the analytic boxes. */
+	void BenchmarkCollision(BenchmarkReport& report)
+	{
+		const FVector extent(4.0f, 4.0f, 8.0f);
+		MeshData mesh;
+		BuildBoxMeshData(mesh, extent);
+		FDistanceFieldVolumeData* volume = BakeMeshData(mesh, 8.0f);
+		FDistanceFieldSampler sampler(*volume);
+
+		const int gridSize = 100;
+		const float spacing = 20.0f;
+		FDistanceFieldCollisionScene scene(spacing);
+		std::vector<FDistanceFieldTransform> transforms;
+		FRandomStream random(0);
+		BenchmarkTimer timer;
+		for (int y = 0; y < gridSize; y++)
+		{
+			for (int x = 0; x < gridSize; x++)
+			{
+				const float yaw = random.FRandRange(0.0f, 2.0f * PI);
+				const FVector axisX(FMath::Cos(yaw), FMath::Sin(yaw), 0.0f);
+				const FVector axisY(-FMath::Sin(yaw), FMath::Cos(yaw), 0.0f);
+				transforms.push_back(FDistanceFieldTransform(axisX, axisY, FVector(0, 0, 1), FVector(x * spacing, y * spacing, 8.0f)));
+				scene.AddInstance(&sampler, transforms.back());
+			}
+		}
+		report.Begin("collision", "build");
+		report.Value("instances", (double)transforms.size());
+		report.Value("ms", timer.ElapsedMs());
+		report.End();
+
+		const int numAgents = 100000;
+		const float maxDistance = 4.0f;
+		std::vector<FVector> points(numAgents);
+		std::vector<FDistanceFieldSphereSweep> sweeps(numAgents);
+		for (int i = 0; i < numAgents; i++)
+		{
+			points[i] = FVector(random.FRandRange(0.0f, gridSize * spacing), random.FRandRange(0.0f, gridSize * spacing), random.FRandRange(0.0f, 20.0f));
+			sweeps[i].Start = points[i] + FVector(0.0f, 0.0f, 10.0f);
+			sweeps[i].End = points[i] + FVector(random.FRandRange(-8.0f, 8.0f), random.FRandRange(-8.0f, 8.0f), -12.0f);
+			sweeps[i].Radius = 0.5f;
+		}
+
+		std::vector<FDistanceFieldPointResult> pointResults(numAgents);
+		timer.Reset();
+		scene.QueryPoints(points.data(), numAgents, maxDistance, pointResults.data());
+		const double pointMs = timer.ElapsedMs();
+
+		// Outside the boxes the baked field is exact up to filtering, compare against the analytic distance
+		double maxError = 0;
+		int numHits = 0;
+		for (int i = 0; i < numAgents; i++)
+		{
+			float expected = maxDistance;
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					const int x = FMath::FloorToInt(points[i].X / spacing + .5f) + dx;
+					const int y = FMath::FloorToInt(points[i].Y / spacing + .5f) + dy;
+					if (x >= 0 && y >= 0 && x < gridSize && y < gridSize)
+						expected = min(expected, BoxDistance(transforms[y * gridSize + x].InverseTransformPosition(points[i]), extent));
+				}
+			}
+
+			if (pointResults[i].InstanceId != INDEX_NONE)
+				numHits++;
+			if (expected > 0 && expected < maxDistance)
+				maxError = max(maxError, (double)FMath::Abs(min(pointResults[i].Distance, maxDistance) - expected));
+		}
+
+		report.Begin("collision", "point_queries");
+		report.Value("queries", numAgents);
+		report.Value("ms", pointMs);
+		report.Value("mqueries_per_sec", numAgents / pointMs / 1000.0);
+		report.Value("hits", numHits);
+		report.Value("max_error", maxError);
+		report.End();
+
+		std::vector<FDistanceFieldSweepResult> sweepResults(numAgents);
+		timer.Reset();
+		scene.SweepSpheres(sweeps.data(), numAgents, sweepResults.data());
+		const double sweepMs = timer.ElapsedMs();
+
+		// A sweep that reports a contact after its start must not have been penetrating before it
+		numHits = 0;
+		double maxPenetration = 0;
+		for (int i = 0; i < numAgents; i++)
+		{
+			if (sweepResults[i].InstanceId == INDEX_NONE)
+				continue;
+			numHits++;
+			if (sweepResults[i].Time == 0)
+				continue;
+			const FDistanceFieldTransform& transform = transforms[sweepResults[i].InstanceId];
+			const float distance = BoxDistance(transform.InverseTransformPosition(sweepResults[i].Position), extent) - sweeps[i].Radius;
+			maxPenetration = max(maxPenetration, (double)-distance);
+		}
+
+		report.Begin("collision", "sphere_sweeps");
+		report.Value("sweeps", numAgents);
+		report.Value("ms", sweepMs);
+		report.Value("msweeps_per_sec", numAgents / sweepMs / 1000.0);
+		report.Value("hits", numHits);
+		report.Value("max_penetration", maxPenetration);
+		report.End();
+
+		// Spheres swept along a wall just outside the skin take tiny steps, every one must still stop at the box across its end
+		const int wallLength = 16;
+		FDistanceFieldCollisionScene wallScene(spacing);
+		std::vector<FVector> wallCenters;
+		for (int x = 0; x < wallLength; x++)
+			wallCenters.push_back(FVector(x * 2.0f * extent.X, 0.0f, extent.Z));
+		wallCenters.push_back(FVector((wallLength - 4) * 2.0f * extent.X, 2.0f * extent.Y, extent.Z));
+		for (size_t i = 0; i < wallCenters.size(); i++)
+			wallScene.AddInstance(&sampler, FDistanceFieldTransform(FVector(1, 0, 0), FVector(0, 1, 0), FVector(0, 0, 1), wallCenters[i]));
+
+		const int numGrazing = 64;
+		const float grazingRadius = 0.5f;
+		int numPassedThrough = 0;
+		double maxGrazingPenetration = 0;
+		for (int i = 0; i < numGrazing; i++)
+		{
+			const float gap = 0.02f + 0.5f * i / numGrazing;
+			FDistanceFieldSphereSweep sweep;
+			sweep.Start = FVector(-extent.X, extent.Y + grazingRadius + gap, extent.Z);
+			sweep.End = FVector((wallLength - 1) * 2.0f * extent.X, sweep.Start.Y, sweep.Start.Z);
+			sweep.Radius = grazingRadius;
+
+			FDistanceFieldSweepResult result;
+			if (!wallScene.SweepSphere(sweep, result))
+				numPassedThrough++;
+			float distance = MAX_flt;
+			for (size_t box = 0; box < wallCenters.size(); box++)
+				distance = min(distance, BoxDistance(result.Position - wallCenters[box], extent));
+			maxGrazingPenetration = max(maxGrazingPenetration, (double)(grazingRadius - distance));
+		}
+
+		// Capsules along the same wall that stop short of the box across it run alongside it, none of them overlaps
+		int numGrazingOverlaps = 0;
+		for (int i = 0; i < numGrazing; i++)
+		{
+			const float gap = 0.02f + 0.5f * i / numGrazing;
+			const FVector start(-extent.X, extent.Y + grazingRadius + gap, extent.Z);
+			const FVector end((wallLength - 6) * 2.0f * extent.X, start.Y, start.Z);
+			if (wallScene.OverlapCapsule(start, end, grazingRadius))
+				numGrazingOverlaps++;
+		}
+
+		report.Begin("collision", "grazing_sweeps");
+		report.Value("sweeps", numGrazing);
+		report.Value("passed_through", numPassedThrough);
+		report.Value("max_penetration", maxGrazingPenetration);
+		report.Value("capsule_overlaps", numGrazingOverlaps);
+		report.End();
+
+		delete volume;
+	}
+
+	/** Random points in and around one baked box, scalar calls against the batch API. */
+	void BenchmarkSampler(BenchmarkReport& report)
+	{
+		MeshData mesh;
+		BuildBoxMeshData(mesh, FVector(4.0f, 4.0f, 8.0f));
+		FDistanceFieldVolumeData* volume = BakeMeshData(mesh, 2.0f);
+		FDistanceFieldSampler sampler(*volume);
+
+		const int numPoints = 1 << 20;
+		const FBox box = sampler.GetBox().ExpandBy(2.0f);
+		FRandomStream random(0);
+		std::vector<FVector> points(numPoints);
+		for (int i = 0; i < numPoints; i++)
+			points[i] = FVector(random.FRandRange(box.Min.X, box.Max.X), random.FRandRange(box.Min.Y, box.Max.Y), random.FRandRange(box.Min.Z, box.Max.Z));
+
+		std::vector<float> reference(numPoints);
+		std::vector<float> distances(numPoints);
+		BenchmarkTimer timer;
+		for (int i = 0; i < numPoints; i++)
+			reference[i] = sampler.Sample(points[i]);
+		const double scalarMs = timer.ElapsedMs();
+
+		timer.Reset();
+		sampler.SampleBatch(points.data(), numPoints, distances.data());
+		const double batchMs = timer.ElapsedMs();
+
+		double maxDiff = 0;
+		for (int i = 0; i < numPoints; i++)
+			maxDiff = max(maxDiff, (double)FMath::Abs(distances[i] - reference[i]));
+
+		report.Begin("sampler", "distance");
+		report.Value("points", numPoints);
+		report.Value("scalar_ms", scalarMs);
+		report.Value("batch_ms", batchMs);
+		report.Value("scalar_msamples_per_sec", numPoints / scalarMs / 1000.0);
+		report.Value("batch_msamples_per_sec", numPoints / batchMs / 1000.0);
+		report.Value("max_diff", maxDiff);
+		report.End();
+
+		std::vector<FVector> referenceGradients(numPoints);
+		std::vector<FVector> gradients(numPoints);
+		timer.Reset();
+		for (int i = 0; i < numPoints; i++)
+			referenceGradients[i] = sampler.SampleGradient(points[i]);
+		const double scalarGradientMs = timer.ElapsedMs();
+
+		timer.Reset();
+		sampler.SampleGradientBatch(points.data(), numPoints, gradients.data());
+		const double batchGradientMs = timer.ElapsedMs();
+
+		maxDiff = 0;
+		for (int i = 0; i < numPoints; i++)
+			maxDiff = max(maxDiff, (double)(gradients[i] - referenceGradients[i]).GetAbsMax());
+
+		report.Begin("sampler", "gradient");
+		report.Value("points", numPoints);
+		report.Value("scalar_ms", scalarGradientMs);
+		report.Value("batch_ms", batchGradientMs);
+		report.Value("batch_mgradients_per_sec", numPoints / batchGradientMs / 1000.0);
+		report.Value("max_diff", maxDiff);
+		report.End();
+
+		delete volume;
+	}
+
+	/** Camera looking down at the plane z = 0, depth and normals are analytic. */
+	void BuildGroundPlaneView(int width, int height, FDistanceFieldShadowView& view, std::vector<float>& depth, std::vector<FVector>& normals)
+	{
+		view.EyePosition = FVector(0.0f, -80.0f, 90.0f);
+		view.Forward = FVector(0.0f, 0.6f, -0.8f);
+		view.Right = FVector(1.0f, 0.0f, 0.0f);
+		view.Up = FVector::CrossProduct(view.Right, view.Forward);
+		view.TanHalfFovY = 0.5f;
+		view.TanHalfFovX = view.TanHalfFovY * width / height;
+		view.FarClipDistance = 1000.0f;
+
+		depth.resize(width * height);
+		normals.assign(width * height, FVector(0.0f, 0.0f, 1.0f));
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const FVector ray = GetDistanceFieldShadowWorldPosition(view, x, y, width, height, 1.0f / view.FarClipDistance) - view.EyePosition;
+				depth[y * width + x] = ray.Z < 0 ? FMath::Min(-view.EyePosition.Z / ray.Z, view.FarClipDistance) / view.FarClipDistance : 1.0f;
+			}
+		}
+	}
+
+	/** Boxes standing on a ground plane seen from above at 1280x720, SSE and threads against the scalar PS. */
+	void BenchmarkShadow(BenchmarkReport& report)
+	{
+		MeshData mesh;
+		BuildBoxMeshData(mesh, FVector(4.0f, 4.0f, 8.0f));
+		FDistanceFieldVolumeData* volume = BakeMeshData(mesh, 2.0f);
+		FDistanceFieldSampler sampler(*volume);
+
+		std::vector<FDistanceFieldShadowObject> objects;
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				FDistanceFieldShadowObject object;
+				object.Sampler = &sampler;
+				object.Position = FVector((x - 1.5f) * 24.0f, (y - 1.5f) * 24.0f, 8.0f);
+				objects.push_back(object);
+			}
+		}
+
+		const int width = 1280, height = 720;
+		FDistanceFieldShadowView view;
+		std::vector<float> depth;
+		std::vector<FVector> normals;
+		BuildGroundPlaneView(width, height, view, depth, normals);
+
+		const FVector lightDirection = FVector(0.4f, 0.3f, -0.8f).GetSafeNormal();
+		std::vector<float> shadow(width * height);
+		std::vector<float> reference(width * height);
+
+		const int numFrames = 8;
+		FDistanceFieldShadowStats stats;
+		BenchmarkTimer timer;
+		for (int frame = 0; frame < numFrames; frame++)
+			ComputeDistanceFieldShadows(view, lightDirection, objects.data(), objects.size(), depth.data(), normals.data(), width, height, shadow.data(), &stats);
+		const double simdMs = timer.ElapsedMs() / numFrames;
+
+		timer.Reset();
+		int32 referenceSteps = 0;
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				const int index = y * width + x;
+				const FVector position = GetDistanceFieldShadowWorldPosition(view, x, y, width, height, depth[index]);
+				float value = 1.0f;
+				for (uint32 i = 0; i < objects.size(); i++)
+					value = FMath::Min(value, TraceDistanceFieldShadow(objects[i], position, normals[index], lightDirection, &referenceSteps));
+				reference[index] = value;
+			}
+		}
+		const double scalarMs = timer.ElapsedMs();
+
+		double maxDiff = 0, shadowed = 0;
+		for (int i = 0; i < width * height; i++)
+		{
+			maxDiff = max(maxDiff, (double)FMath::Abs(shadow[i] - reference[i]));
+			shadowed += shadow[i] < 1.0f ? 1 : 0;
+		}
+
+		report.Begin("shadow", "soft_shadow");
+		report.Value("width", width);
+		report.Value("height", height);
+		report.Value("objects", (double)objects.size());
+		report.Value("ms", simdMs);
+		report.Value("scalar_ms", scalarMs);
+		report.Value("speedup", scalarMs / simdMs);
+		report.Value("steps", stats.NumSteps);
+		report.Value("scalar_steps", referenceSteps);
+		report.Value("lit_pixels", stats.NumLitPixels);
+		report.Value("shadowed_fraction", shadowed / (width * height));
+		report.Value("max_diff", maxDiff);
+		report.End();
+
+		delete volume;
+	}
+
+	/** The shadow benchmark's scene, AO traced at full and reduced resolution. */
+	void BenchmarkAO(BenchmarkReport& report)
+	{
+		MeshData mesh;
+		BuildBoxMeshData(mesh, FVector(4.0f, 4.0f, 8.0f));
+		FDistanceFieldVolumeData* volume = BakeMeshData(mesh, 2.0f);
+		FDistanceFieldSampler sampler(*volume);
+
+		std::vector<FDistanceFieldAOObject> objects;
+		for (int y = 0; y < 4; y++)
+		{
+			for (int x = 0; x < 4; x++)
+			{
+				FDistanceFieldAOObject object;
+				object.Sampler = &sampler;
+				object.Transform = FDistanceFieldTransform(FVector((x - 1.5f) * 24.0f, (y - 1.5f) * 24.0f, 8.0f));
+				objects.push_back(object);
+			}
+		}
+
+		const int width = 1280, height = 720;
+		FDistanceFieldShadowView view;
+		std::vector<float> depth;
+		std::vector<FVector> normals;
+		BuildGroundPlaneView(width, height, view, depth, normals);
+
+		FDistanceFieldAOSettings settings;
+		settings.Downsample = 1;
+		FDistanceFieldAOBuffer reference;
+		FDistanceFieldAOStats stats;
+		BenchmarkTimer timer;
+		ComputeDistanceFieldAO(view, settings, objects.data(), objects.size(), depth.data(), normals.data(), width, height, reference, &stats);
+		const double fullMs = timer.ElapsedMs();
+
+		double occluded = 0;
+		for (int i = 0; i < width * height; i++)
+			occluded += reference.Visibility[i] < 0.99f ? 1 : 0;
+
+		report.Begin("ao", "full_resolution");
+		report.Value("width", width);
+		report.Value("height", height);
+		report.Value("objects", (double)objects.size());
+		report.Value("ms", fullMs);
+		report.Value("traced_pixels", stats.NumTracedPixels);
+		report.Value("samples", stats.NumSamples);
+		report.Value("occluded_fraction", occluded / (width * height));
+		report.End();
+
+		for (int downsample = 2; downsample <= 4; downsample *= 2)
+		{
+			settings.Downsample = downsample;
+			FDistanceFieldAOBuffer buffer;
+			std::vector<float> visibility(width * height);
+			timer.Reset();
+			ComputeDistanceFieldAO(view, settings, objects.data(), objects.size(), depth.data(), normals.data(), width, height, buffer, &stats);
+			const double traceMs = timer.ElapsedMs();
+			timer.Reset();
+			UpsampleDistanceFieldAO(settings, buffer, depth.data(), normals.data(), width, height, visibility.data());
+			const double upsampleMs = timer.ElapsedMs();
+
+			double totalError = 0, maxError = 0;
+			for (int i = 0; i < width * height; i++)
+			{
+				const double error = FMath::Abs(visibility[i] - reference.Visibility[i]);
+				totalError += error;
+				maxError = max(maxError, error);
+			}
+
+			report.Begin("ao", downsample == 2 ? "half_resolution" : "quarter_resolution");
+			report.Value("downsample", downsample);
+			report.Value("trace_ms", traceMs);
+			report.Value("upsample_ms", upsampleMs);
+			report.Value("samples", stats.NumSamples);
+			report.Value("mean_error", totalError / (width * height));
+			report.Value("max_error", maxError);
+			report.End();
+		}
+
+		delete volume;
+	}
+
+	/** 10k boxes scattered over and around the ground plane view, SIMD binning against testing every object per tile. */
+	void BenchmarkCulling(BenchmarkReport& report)
+	{
+		const int width = 1280, height = 720;
+		FDistanceFieldShadowView view;
+		std::vector<float> depth;
+		std::vector<FVector> normals;
+		BuildGroundPlaneView(width, height, view, depth, normals);
+		const FVector lightDirection = FVector(0.4f, 0.3f, -0.866f).GetSafeNormal();
+
+		const char* scenes[2] = { "scattered", "dense" };
+		const float sceneExtents[2] = { 600.0f, 120.0f };
+		for (int sceneIndex = 0; sceneIndex < 2; sceneIndex++)
+		{
+			const int numObjects = 10000;
+			const float sceneExtent = sceneExtents[sceneIndex];
+			FRandomStream random(sceneIndex);
+			std::vector<FBox> bounds(numObjects);
+			for (int i = 0; i < numObjects; i++)
+			{
+				const FVector center(random.FRandRange(-sceneExtent, sceneExtent), random.FRandRange(-sceneExtent * 0.25f, sceneExtent * 1.75f), 0.0f);
+				const FVector extent(random.FRandRange(0.5f, 3.0f), random.FRandRange(0.5f, 3.0f), random.FRandRange(1.0f, 6.0f));
+				bounds[i] = FBox(center - FVector(extent.X, extent.Y, 0.0f), center + FVector(extent.X, extent.Y, 2.0f * extent.Z));
+			}
+
+			FDistanceFieldTileObjects tiles;
+			FDistanceFieldCullingStats stats;
+			BenchmarkTimer timer;
+			CullDistanceFieldObjectsForLight(view, lightDirection, bounds.data(), numObjects, depth.data(), normals.data(), width, height,
+				DISTANCEFIELD_CULLING_TILE_SIZE, DISTANCEFIELD_CULLING_TILE_SIZE, tiles, &stats);
+			const double ms = timer.ElapsedMs();
+
+			// Every object against the bounds of every tile, as the shadow tracer used to.
+			// Tile bounds reach further than the tile's pixels, so the binned lists can be shorter,
+			// but they must hold every object a ray from one of the pixels towards the light hits
+			const int numTiles = tiles.NumTilesX * tiles.NumTilesY;
+			std::vector<int32> reference;
+			int bruteForceTileObjects = 0;
+			double bruteForceMs = 0;
+			int missedObjects = 0;
+			for (int tileIndex = 0; tileIndex < numTiles; tileIndex++)
+			{
+				timer.Reset();
+				reference.clear();
+				if (tiles.TileBounds[tileIndex].IsValid)
+				{
+					for (int i = 0; i < numObjects; i++)
+					{
+						if (IsSweptBoxOverlapping(tiles.TileBounds[tileIndex], -lightDirection, bounds[i]))
+							reference.push_back(i);
+					}
+				}
+				bruteForceMs += timer.ElapsedMs();
+				bruteForceTileObjects += reference.size();
+
+				const int32* tileObjects = tiles.GetObjects(tileIndex);
+				const int32* tileObjectsEnd = tileObjects + tiles.GetNumObjects(tileIndex);
+				const int minX = tileIndex % tiles.NumTilesX * tiles.TileSizeX;
+				const int minY = tileIndex / tiles.NumTilesX * tiles.TileSizeY;
+				for (int y = minY; y < min(minY + tiles.TileSizeY, height); y++)
+				{
+					for (int x = minX; x < min(minX + tiles.TileSizeX, width); x++)
+					{
+						const FVector position = GetDistanceFieldShadowWorldPosition(view, x, y, width, height, depth[y * width + x]);
+						for (size_t i = 0; i < reference.size(); i++)
+						{
+							if (IsSweptBoxOverlapping(FBox(position, position), -lightDirection, bounds[reference[i]])
+								&& !std::binary_search(tileObjects, tileObjectsEnd, reference[i]))
+								missedObjects++;
+						}
+					}
+				}
+			}
+
+			report.Begin("culling", scenes[sceneIndex]);
+			report.Value("objects", numObjects);
+			report.Value("tiles", numTiles);
+			report.Value("ms", ms);
+			report.Value("brute_force_ms", bruteForceMs);
+			report.Value("speedup", bruteForceMs / ms);
+			report.Value("visible_objects", stats.NumVisibleObjects);
+			report.Value("tests", stats.NumTests);
+			report.Value("tile_objects", stats.NumTileObjects);
+			report.Value("mean_tile_objects", (double)stats.NumTileObjects / numTiles);
+			report.Value("max_tile_objects", stats.MaxTileObjects);
+			report.Value("brute_force_tile_objects", bruteForceTileObjects);
+			report.Value("missed_objects", missedObjects);
+			report.End();
+		}
+	}
+
+	/**
+	* Sphere volumes written to disk with mips, instanced on a grid the view flies over.
+	* Each frame waits for its loads so the counts do not depend on the machine.
+	*/
+	void BenchmarkStreaming(BenchmarkReport& report)
+	{
+		FRandomStream random(0);
+		const int numVolumes = 256;
+		const EDistanceFieldFormat formats[] = { DFF_Float16, DFF_Unorm8, DFF_Block4x4x4 };
+		std::vector<std::string> filenames;
+		double maxError = 0;
+		BenchmarkTimer timer;
+		for (int i = 0; i < numVolumes; i++)
+		{
+			FBox bounds(FVector(-1.0f), FVector(1.0f));
+			FDistanceFieldVolumeData volume(bounds);
+			volume.LocalBoundingBox = bounds;
+			const int size = random.RandRange(24, 64);
+			volume.Size = FIntVector(size, size, size);
+			volume.DistanceFieldVolume.resize(size * size * size);
+			const float radius = random.FRandRange(0.3f, 0.9f);
+			for (int z = 0; z < size; z++)
+				for (int y = 0; y < size; y++)
+					for (int x = 0; x < size; x++)
+					{
+						const FVector p = (FVector((float)x, (float)y, (float)z) + FVector(0.5f)) * (2.0f / size) - FVector(1.0f);
+						volume.DistanceFieldVolume[(z * size + y) * size + x] = p.Size() - radius;
+					}
+			volume.Compress(formats[i % 3]);
+
+			char filename[64];
+			sprintf(filename, "sdf_streaming_%d.sdfv", i);
+			filenames.push_back(filename);
+			SaveDistanceFieldVolume(filename, volume, DISTANCEFIELD_FILE_MAX_MIPS);
+
+			// Mip 0 must come back exactly as it was encoded
+			FDistanceFieldVolumeData* loaded = LoadDistanceFieldVolume(filename);
+			for (int sample = 0; sample < 64; sample++)
+			{
+				const int x = random.RandRange(0, size - 1), y = random.RandRange(0, size - 1), z = random.RandRange(0, size - 1);
+				float expected[FCompressedDistanceFieldVolume::BlockVoxels], actual[FCompressedDistanceFieldVolume::BlockVoxels];
+				volume.DecodeBrick(x, y, z, expected);
+				loaded->DecodeBrick(x, y, z, actual);
+				for (int v = 0; v < FCompressedDistanceFieldVolume::BlockVoxels; v++)
+					maxError = max(maxError, (double)FMath::Abs(actual[v] - expected[v]));
+			}
+			delete loaded;
+		}
+		report.Begin("streaming", "save");
+		report.Value("ms", timer.ElapsedMs());
+		report.Value("volumes", numVolumes);
+		report.Value("max_error", maxError);
+		report.End();
+
+		const int gridSize = 16;
+		const float spacing = 16.0f;
+		const int numFrames = 400;
+		const float screenMultiple = 720.0f / (2.0f * FMath::Tan(PI / 8));
+		const SIZE_t budgets[] = { 4 * 1024 * 1024, 16 * 1024 * 1024 };
+		for (int budgetIndex = 0; budgetIndex < 2; budgetIndex++)
+		{
+			for (int useMips = 0; useMips < 2; useMips++)
+			{
+				FDistanceFieldStreamingSettings settings;
+				settings.BudgetBytes = budgets[budgetIndex];
+				settings.bUseMips = useMips != 0;
+				settings.MinScreenSize = 48.0f;
+				FDistanceFieldStreamingManager manager(settings);
+				std::vector<int32> volumeIds;
+				for (int i = 0; i < numVolumes; i++)
+					volumeIds.push_back(manager.RegisterVolume(filenames[i].c_str()));
+
+				FRandomStream placement(1);
+				for (int y = 0; y < gridSize; y++)
+					for (int x = 0; x < gridSize; x++)
+					{
+						const FVector center(x * spacing, y * spacing, 0.0f);
+						const float scale = placement.FRandRange(0.5f, 2.0f);
+						manager.AddInstance(volumeIds[y * gridSize + x], FBox(center - FVector(scale), center + FVector(scale)));
+					}
+
+				// Low pass over the grid along its diagonal, then back along a row
+				timer.Reset();
+				double updateMs = 0;
+				int framesWithoutVolume = 0;
+				for (int frame = 0; frame < numFrames; frame++)
+				{
+					const float t = (float)frame / (numFrames / 2);
+					const FVector viewOrigin = frame < numFrames / 2
+						? FVector(t, t, 0.1f) * (gridSize * spacing) + FVector(0, 0, 4.0f)
+						: FVector((2.0f - t) * gridSize * spacing, gridSize * spacing * 0.5f, 4.0f);
+					BenchmarkTimer updateTimer;
+					manager.Update(viewOrigin, screenMultiple);
+					updateMs += updateTimer.ElapsedMs();
+					for (int i = 0; i < numVolumes; i++)
+					{
+						if (manager.GetWantedMip(volumeIds[i]) != INDEX_NONE && !manager.GetVolume(volumeIds[i]))
+						{
+							framesWithoutVolume++;
+							break;
+						}
+					}
+					manager.Flush();
+				}
+
+				const FDistanceFieldStreamingStats stats = manager.GetStats();
+				report.Begin("streaming", useMips ? "fly_mips" : "fly");
+				report.Value("budget_bytes", (double)settings.BudgetBytes);
+				report.Value("ms", timer.ElapsedMs());
+				report.Value("update_ms", updateMs / numFrames);
+				report.Value("hits", stats.NumHits);
+				report.Value("misses", stats.NumMisses);
+				report.Value("hit_rate", (double)stats.NumHits / max(stats.NumHits + stats.NumMisses, 1));
+				report.Value("loads", stats.NumLoads);
+				report.Value("failed_loads", stats.NumFailedLoads);
+				report.Value("evictions", stats.NumEvictions);
+				report.Value("deferred", stats.NumDeferred);
+				report.Value("bytes_streamed", (double)stats.BytesStreamed);
+				report.Value("resident_bytes", (double)stats.ResidentBytes);
+				report.Value("resident", stats.NumResident);
+				report.Value("frames_missing_volume", framesWithoutVolume);
+				report.End();
+			}
+		}
+
+		for (int i = 0; i < numVolumes; i++)
+			remove(filenames[i].c_str());
+	}
+
+	/** Directed edges without a twin, 0 for a closed and consistently wound mesh. */
+	int CountOpenEdges(const FDistanceFieldMesh& mesh)
+	{
+		std::vector<std::pair<uint32, uint32> > edges;
+		for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+			for (int corner = 0; corner < 3; corner++)
+				edges.push_back(std::make_pair(mesh.Indices[i + corner], mesh.Indices[i + (corner + 1) % 3]));
+		std::sort(edges.begin(), edges.end());
+		int open = 0;
+		for (size_t i = 0; i < edges.size(); i++)
+			if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(edges[i].second, edges[i].first)))
+				open++;
+		return open;
+	}
+
+	double GetSignedVolume(const FDistanceFieldMesh& mesh)
+	{
+		double volume = 0;
+		for (size_t i = 0; i < mesh.Indices.size(); i += 3)
+		{
+			const FVector& a = mesh.Positions[mesh.Indices[i]];
+			volume += FVector::DotProduct(a, FVector::CrossProduct(mesh.Positions[mesh.Indices[i + 1]], mesh.Positions[mesh.Indices[i + 2]])) / 6.0;
+		}
+		return volume;
+	}
+
+	/** Exact box distances meshed both ways, with and without decimation, checked against the analytic box. */
+	void BenchmarkMesher(BenchmarkReport& report)
+	{
+		const FVector extent(4.0f, 4.0f, 8.0f);
+		FBox bounds(-extent, extent);
+		FDistanceFieldVolumeData* volume = new FDistanceFieldVolumeData(bounds);
+		const FVector volumeSize = volume->LocalBoundingBox.GetSize();
+		volume->Size = FIntVector(48, 48, 96);
+		volume->DistanceFieldVolume.resize(volume->Size.X * volume->Size.Y * volume->Size.Z);
+		for (int z = 0; z < volume->Size.Z; z++)
+			for (int y = 0; y < volume->Size.Y; y++)
+				for (int x = 0; x < volume->Size.X; x++)
+				{
+					const FVector position = volume->LocalBoundingBox.Min
+						+ (FVector((float)x, (float)y, (float)z) + FVector(0.5f)) * volumeSize / FVector(48.0f, 48.0f, 96.0f);
+					volume->DistanceFieldVolume[(z * volume->Size.Y + y) * volume->Size.X + x] =
+						BoxDistance(position, extent) / volume->LocalBoundingBox.GetExtent().GetMax();
+				}
+		FDistanceFieldSampler sampler(*volume);
+		const double boxVolume = 8.0 * extent.X * extent.Y * extent.Z;
+
+		const char* tests[] = { "marching_cubes", "marching_cubes_decimated", "dual_contouring", "dual_contouring_decimated" };
+		for (int test = 0; test < 4; test++)
+		{
+			FDistanceFieldMeshSettings settings;
+			settings.Method = test < 2 ? DFMesh_MarchingCubes : DFMesh_DualContouring;
+			settings.WeldDistance = 1e-3f;
+			settings.TriangleRatio = test % 2 ? 0.1f : 1.0f;
+			FDistanceFieldMesh result;
+			FDistanceFieldMeshStats stats;
+			ExtractDistanceFieldMesh(sampler, settings, result, &stats);
+
+			double maxError = 0, sumSquares = 0;
+			for (size_t i = 0; i < result.Positions.size(); i++)
+			{
+				const double error = FMath::Abs(BoxDistance(result.Positions[i], extent));
+				maxError = max(maxError, error);
+				sumSquares += error * error;
+			}
+
+			// Sharp features: how far the closest vertex is from each corner of the box
+			double cornerError = 0;
+			for (int corner = 0; corner < 8; corner++)
+			{
+				const FVector position(corner & 1 ? extent.X : -extent.X, corner & 2 ? extent.Y : -extent.Y, corner & 4 ? extent.Z : -extent.Z);
+				double closest = MAX_dbl;
+				for (size_t i = 0; i < result.Positions.size(); i++)
+					closest = min(closest, (double)(result.Positions[i] - position).Size());
+				cornerError = max(cornerError, closest);
+			}
+
+			report.Begin("mesher", tests[test]);
+			report.Value("voxels", (double)volume->Size.X * volume->Size.Y * volume->Size.Z);
+			report.Value("extract_ms", stats.ExtractSeconds * 1000.0);
+			report.Value("decimate_ms", stats.DecimateSeconds * 1000.0);
+			report.Value("extracted_triangles", stats.NumExtractedTriangles);
+			report.Value("triangles", stats.NumTriangles);
+			report.Value("vertices", stats.NumVertices);
+			report.Value("welded_vertices", stats.NumWeldedVertices);
+			report.Value("open_edges", CountOpenEdges(result));
+			report.Value("volume_ratio", GetSignedVolume(result) / boxVolume);
+			report.Value("max_error", maxError);
+			report.Value("rms_error", sqrt(sumSquares / max(result.Positions.size(), (size_t)1)));
+			report.Value("corner_error", cornerError);
+			report.End();
+		}
+
+		delete volume;
+	}
+
+	/** Rasterizes each GeometryGenerator shape, checks the sampled volume against the exact distance and the box against a mesh bake. */
+	void BenchmarkPrimitives(BenchmarkReport& report)
+	{
+		const char* tests[] = { "box", "sphere", "cylinder", "grid" };
+		const FDistanceFieldPrimitive primitives[] = {
+			FDistanceFieldPrimitive::Box(64.0f, 64.0f, 128.0f),
+			FDistanceFieldPrimitive::Sphere(48.0f),
+			FDistanceFieldPrimitive::Cylinder(32.0f, 16.0f, 96.0f),
+			FDistanceFieldPrimitive::Grid(128.0f, 128.0f) };
+		const int numSamples = 100000;
+
+		for (int test = 0; test < 4; test++)
+		{
+			const FDistanceFieldPrimitive& primitive = primitives[test];
+			FBox bounds = primitive.GetBounds();
+			FDistanceFieldVolumeData volume(bounds);
+			BenchmarkTimer timer;
+			GenerateDistanceFieldPrimitiveVolume(primitive, 2.0f, volume);
+			const double rasterizeMs = timer.ElapsedMs();
+
+			// Trilinear reconstruction against the exact distance, inside the shape's own bounds
+			FDistanceFieldSampler sampler(volume);
+			FRandomStream random(test);
+			double maxError = 0, sumSquares = 0;
+			timer.Reset();
+			for (int i = 0; i < numSamples; i++)
+			{
+				const FVector position(
+					random.FRandRange(bounds.Min.X, bounds.Max.X),
+					random.FRandRange(bounds.Min.Y, bounds.Max.Y),
+					random.FRandRange(bounds.Min.Z, bounds.Max.Z));
+				const double error = FMath::Abs(sampler.Sample(position) - primitive.GetDistance(position));
+				maxError = max(maxError, error);
+				sumSquares += error * error;
+			}
+			const double sampleMs = timer.ElapsedMs();
+
+			report.Begin("primitives", tests[test]);
+			report.Value("voxels", (double)volume.Size.X * volume.Size.Y * volume.Size.Z);
+			report.Value("rasterize_ms", rasterizeMs);
+			report.Value("voxel_size", volume.LocalBoundingBox.GetSize().X / volume.Size.X);
+			report.Value("sample_max_error", maxError);
+			report.Value("sample_rms_error", sqrt(sumSquares / numSamples));
+			report.Value("exact_ns_per_sample", sampleMs * 1e6 / numSamples);
+			report.End();
+		}
+
+		// Same box both ways, the layouts match so the voxels compare one to one
+		MeshData mesh;
+		BuildBoxMeshData(mesh, FVector(32.0f, 32.0f, 64.0f));
+		BenchmarkTimer timer;
+		FDistanceFieldVolumeData* baked = BakeMeshData(mesh, 1.0f);
+		const double bakeMs = timer.ElapsedMs();
+
+		FBox boxBounds = primitives[0].GetBounds();
+		FDistanceFieldVolumeData analytic(boxBounds);
+		timer.Reset();
+		GenerateDistanceFieldPrimitiveVolume(primitives[0], 1.0f, analytic);
+		const double rasterizeMs = timer.ElapsedMs();
+
+		FDistanceFieldSampler bakedSampler(*baked);
+		FDistanceFieldSampler analyticSampler(analytic);
+		const int32 numVoxels = baked->Size.X * baked->Size.Y * baked->Size.Z;
+		const float scale = analyticSampler.GetDistanceScale();
+		double maxDifference = 0, sumSquares = 0;
+		int signFlips = 0;
+		for (int32 i = 0; i < numVoxels; i++)
+		{
+			const float bakedDistance = bakedSampler.GetVoxels()[i] * scale;
+			const float analyticDistance = analyticSampler.GetVoxels()[i] * scale;
+			const double difference = FMath::Abs(bakedDistance - analyticDistance);
+			maxDifference = max(maxDifference, difference);
+			sumSquares += difference * difference;
+			signFlips += (bakedDistance < 0) != (analyticDistance < 0);
+		}
+
+		report.Begin("primitives", "box_vs_bake");
+		report.Value("same_layout", baked->Size == analytic.Size && baked->LocalBoundingBox.Min == analytic.LocalBoundingBox.Min);
+		report.Value("voxels", numVoxels);
+		report.Value("bake_ms", bakeMs);
+		report.Value("rasterize_ms", rasterizeMs);
+		report.Value("speedup", bakeMs / max(rasterizeMs, 1e-3));
+		report.Value("max_difference", maxDifference);
+		report.Value("rms_difference", sqrt(sumSquares / numVoxels));
+		report.Value("sign_flips", signFlips);
+		report.End();
+
+		delete baked;
+	}
+
+	void ConvertGeometryMeshData(const GeometryGenerator::MeshData& src, MeshData& mesh)
+	{
+		mesh.Vertices.resize(src.Vertices.size());
+		mesh.UVs.resize(src.Vertices.size());
+		for (size_t i = 0; i < src.Vertices.size(); i++)
+		{
+			const GeometryGenerator::Vertex& v = src.Vertices[i];
+			mesh.Vertices[i] = FVector(v.Position.x, v.Position.y, v.Position.z);
+			mesh.UVs[i] = FVector2D(v.TexC.x, v.TexC.y);
+		}
+		for (size_t i = 0; i + 2 < src.Indices.size(); i += 3)
+		{
+			MeshData::Triangle tri;
+			tri.indices[0] = src.Indices[i];
+			tri.indices[1] = src.Indices[i + 1];
+			tri.indices[2] = src.Indices[i + 2];
+			tri.material = 0;
+			mesh.Indices.push_back(tri);
+		}
+		mesh.Mats.resize(1);
+	}
+
+	/** Squared distance from p to the closest point of triangle abc. */
+	float PointTriangleDistanceSquared(const FVector& p, const FVector& a, const FVector& b, const FVector& c)
+	{
+		const FVector ab = b - a, ac = c - a, ap = p - a;
+		const float d1 = FVector::DotProduct(ab, ap), d2 = FVector::DotProduct(ac, ap);
+		if (d1 <= 0 && d2 <= 0)
+			return ap.SizeSquared();
+
+		const FVector bp = p - b;
+		const float d3 = FVector::DotProduct(ab, bp), d4 = FVector::DotProduct(ac, bp);
+		if (d3 >= 0 && d4 <= d3)
+			return bp.SizeSquared();
+
+		const float vc = d1 * d4 - d3 * d2;
+		if (vc <= 0 && d1 >= 0 && d3 <= 0)
+			return (ap - ab * (d1 / (d1 - d3))).SizeSquared();
+
+		const FVector cp = p - c;
+		const float d5 = FVector::DotProduct(ab, cp), d6 = FVector::DotProduct(ac, cp);
+		if (d6 >= 0 && d5 <= d6)
+			return cp.SizeSquared();
+
+		const float vb = d5 * d2 - d1 * d6;
+		if (vb <= 0 && d2 >= 0 && d6 <= 0)
+			return (ap - ac * (d2 / (d2 - d6))).SizeSquared();
+
+		const float va = d3 * d6 - d5 * d4;
+		if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+			return (bp - (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)))).SizeSquared();
+
+		const float denom = 1.0f / (va + vb + vc);
+		return (ap - ab * (vb * denom) - ac * (vc * denom)).SizeSquared();
+	}
+
+	/** Signed solid angle of abc seen from p over 4 pi, summed over a closed mesh it is +-1 inside and 0 outside. */
+	double TriangleWinding(const FVector& p, const FVector& a, const FVector& b, const FVector& c)
+	{
+		const FVector pa = a - p, pb = b - p, pc = c - p;
+		const double la = pa.Size(), lb = pb.Size(), lc = pc.Size();
+		const double det = FVector::DotProduct(pa, FVector::CrossProduct(pb, pc));
+		const double div = la * lb * lc + FVector::DotProduct(pa, pb) * lc + FVector::DotProduct(pb, pc) * la + FVector::DotProduct(pc, pa) * lb;
+		return atan2(det, div) / (2.0 * PI);
+	}
+
+	/**
+	* Points on the opaque texels of alpha-tested triangles, spacing apart along each edge.
+	* Texels are addressed the usual way, (u * width, v * height) with rows of width texels.
+	*/
+	void SampleAlphaTestedSurface(const MeshData& mesh, float spacing, std::vector<FVector>& outPoints)
+	{
+		for (size_t t = 0; t < mesh.Indices.size(); t++)
+		{
+			const MeshData::Triangle& tri = mesh.Indices[t];
+			const FMaterial& mat = mesh.Mats[tri.material];
+			if (!mat.alphaTest)
+				continue;
+
+			const FVector& a = mesh.Vertices[tri.indices[0]];
+			const FVector& b = mesh.Vertices[tri.indices[1]];
+			const FVector& c = mesh.Vertices[tri.indices[2]];
+			const float longest = max((b - a).Size(), max((c - b).Size(), (a - c).Size()));
+			const int steps = max(1, (int)ceil(longest / spacing));
+			for (int i = 0; i <= steps; i++)
+				for (int j = 0; i + j <= steps; j++)
+				{
+					const float wb = (float)i / steps, wc = (float)j / steps, wa = 1.0f - wb - wc;
+					const FVector2D uv = mesh.UVs[tri.indices[0]] * wa + mesh.UVs[tri.indices[1]] * wb + mesh.UVs[tri.indices[2]] * wc;
+					const int x = FMath::Clamp((int)(uv.X * mat.diffuse.width), 0, mat.diffuse.width - 1);
+					const int y = FMath::Clamp((int)(uv.Y * mat.diffuse.height), 0, mat.diffuse.height - 1);
+					const uint8 alpha = mat.diffuse.data[(y * mat.diffuse.width + x) * mat.diffuse.byteCount + mat.diffuse.byteCount - 1];
+					if (alpha >= mat.alphaRef)
+						outPoints.push_back(a * wa + b * wb + c * wc);
+				}
+		}
+	}
+
+	/** Open edges after welding vertices closer than a millionth of the bounds, seams and caps repeat positions with rounding. */
+	int CountOpenWeldedEdges(const MeshData& mesh)
+	{
+		FBox bounds(mesh.Vertices[0], mesh.Vertices[0]);
+		for (size_t i = 0; i < mesh.Vertices.size(); i++)
+			bounds += mesh.Vertices[i];
+		const float cellSize = max(bounds.GetSize().GetMax() * 1e-6f, 1e-6f);
+
+		std::map<std::pair<std::pair<int, int>, int>, uint32> cells;
+		std::vector<uint32> remap(mesh.Vertices.size());
+		for (uint32 i = 0; i < mesh.Vertices.size(); i++)
+		{
+			const FVector cell = mesh.Vertices[i] / cellSize;
+			const std::pair<std::pair<int, int>, int> key(std::make_pair(FMath::RoundToInt(cell.X), FMath::RoundToInt(cell.Y)), FMath::RoundToInt(cell.Z));
+			remap[i] = cells.insert(std::make_pair(key, i)).first->second;
+		}
+
+		std::vector<std::pair<uint32, uint32> > edges;
+		for (size_t t = 0; t < mesh.Indices.size(); t++)
+			for (int corner = 0; corner < 3; corner++)
+				edges.push_back(std::make_pair(remap[mesh.Indices[t].indices[corner]], remap[mesh.Indices[t].indices[(corner + 1) % 3]]));
+		std::sort(edges.begin(), edges.end());
+		int open = 0;
+		for (size_t i = 0; i < edges.size(); i++)
+			if (!std::binary_search(edges.begin(), edges.end(), std::make_pair(edges[i].second, edges[i].first)))
+				open++;
+		return open;
+	}
+
+	/**
+	* Bakes one mesh of the corpus and compares every voxel against brute force distances to all of its triangles.
+	* Closed meshes are signed by their winding number, open ones are compared by unsigned distance.
+	* Large meshes check every n-th voxel so the brute force stays within a fixed number of triangle tests.
+	*/
+	void BenchmarkBakeMesh(BenchmarkReport& report, const char* name, MeshData& mesh, float resolutionScale)
+	{
+		FBoxSphereBounds bounds;
+		GenerateBoxSphereBounds(&bounds, &mesh);
+		FBox box = bounds.GetBox();
+		FDistanceFieldVolumeData volume(box);
+		FDistanceFieldBuildStats stats;
+		GenerateSignedDistanceFieldVolumeData(mesh, bounds, resolutionScale, false, volume, &stats);
+
+		const bool bClosed = CountOpenWeldedEdges(mesh) == 0;
+		bool bAlphaTested = false;
+		for (size_t i = 0; i < mesh.Mats.size(); i++)
+			bAlphaTested |= mesh.Mats[i].alphaTest;
+
+		report.Begin("bake", name);
+		report.Value("triangles", (double)mesh.Indices.size());
+		report.Value("closed", bClosed);
+		report.Value("alpha_tested", bAlphaTested);
+		report.Value("voxels", (double)stats.NumVoxels);
+		report.Value("build_ms", stats.BuildSeconds * 1000.0);
+		report.Value("bake_ms", stats.BakeSeconds * 1000.0);
+		report.Value("voxels_per_sec", stats.NumVoxels / max(stats.BakeSeconds, 1e-9));
+		report.Value("rays_per_voxel", (double)stats.NumRays / max(stats.NumVoxels, (int64)1));
+		report.Value("nodes_per_ray", (double)stats.NumNodesVisited / max(stats.NumRays, (int64)1));
+		report.Value("triangle_batches_per_ray", (double)stats.NumTriangleBatchesTested / max(stats.NumRays, (int64)1));
+
+		// The bake drops volumes that are negative at the border
+		if (volume.Size.X == 0)
+		{
+			report.Value("discarded", 1);
+			report.End();
+			return;
+		}
+
+		FDistanceFieldSampler sampler(volume);
+		const FVector voxelSize = volume.LocalBoundingBox.GetSize() / FVector(volume.Size.X, volume.Size.Y, volume.Size.Z);
+		const float voxelDiameter = voxelSize.Size();
+		std::vector<FVector> alphaPoints;
+		// Alpha-tested distances are exact to within half the sample spacing
+		if (bAlphaTested)
+			SampleAlphaTestedSurface(mesh, voxelSize.GetMax() * 0.25f, alphaPoints);
+
+		const int64 maxTests = (int64)1 << 27;
+		const int64 numVoxels = (int64)volume.Size.X * volume.Size.Y * volume.Size.Z;
+		const int64 testsPerVoxel = max((int64)mesh.Indices.size() + (int64)alphaPoints.size(), (int64)1);
+		const int64 stride = max((int64)1, numVoxels * testsPerVoxel / maxTests);
+
+		double maxError = 0, sumSquares = 0, surfaceMaxError = 0;
+		int64 checked = 0, signFlips = 0;
+		for (int64 voxel = 0; voxel < numVoxels; voxel += stride)
+		{
+			const int32 x = (int32)(voxel % volume.Size.X);
+			const int32 y = (int32)(voxel / volume.Size.X % volume.Size.Y);
+			const int32 z = (int32)(voxel / ((int64)volume.Size.X * volume.Size.Y));
+			const FVector position = volume.LocalBoundingBox.Min + FVector(x + .5f, y + .5f, z + .5f) * voxelSize;
+
+			float minDistanceSquared = MAX_flt;
+			double winding = 0;
+			for (size_t t = 0; t < mesh.Indices.size(); t++)
+			{
+				const MeshData::Triangle& tri = mesh.Indices[t];
+				const FVector& a = mesh.Vertices[tri.indices[0]];
+				const FVector& b = mesh.Vertices[tri.indices[1]];
+				const FVector& c = mesh.Vertices[tri.indices[2]];
+				if (!mesh.Mats[tri.material].alphaTest)
+					minDistanceSquared = min(minDistanceSquared, PointTriangleDistanceSquared(position, a, b, c));
+				if (bClosed)
+					winding += TriangleWinding(position, a, b, c);
+			}
+			for (size_t i = 0; i < alphaPoints.size(); i++)
+				minDistanceSquared = min(minDistanceSquared, FVector::DistSquared(position, alphaPoints[i]));
+
+			float truth = FMath::Sqrt(minDistanceSquared);
+			float baked = sampler.GetVoxels()[voxel] * sampler.GetDistanceScale();
+			if (bClosed)
+			{
+				if (FMath::Abs(winding) > 0.5)
+					truth = -truth;
+				if ((truth < 0) != (baked < 0) && FMath::Abs(truth) > voxelDiameter * 0.05f)
+					signFlips++;
+			}
+			else
+			{
+				baked = FMath::Abs(baked);
+			}
+
+			const double error = FMath::Abs(baked - truth);
+			maxError = max(maxError, error);
+			sumSquares += error * error;
+			if (FMath::Abs(truth) < voxelDiameter)
+				surfaceMaxError = max(surfaceMaxError, error);
+			checked++;
+		}
+
+		report.Value("checked_voxels", (double)checked);
+		report.Value("voxel_size", voxelSize.GetMax());
+		report.Value("max_error", maxError);
+		report.Value("rms_error", sqrt(sumSquares / max(checked, (int64)1)));
+		report.Value("surface_max_error", surfaceMaxError);
+		report.Value("max_error_voxels", maxError / voxelSize.GetMax());
+		report.Value("sign_flips", (double)signFlips);
+		report.End();
+	}
+
+	/**
+	* Bakes a fixed corpus of GeometryGenerator shapes and an alpha-tested plane, plus the OBJ files listed by
+	* "-benchmark-obj=a.obj;b.obj", and checks each against brute force distances.
+	*/
+	void BenchmarkBake(BenchmarkReport& report)
+	{
+		const float resolutionScale = 1.5f;
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData shape;
+		MeshData mesh;
+
+		geoGen.CreateBox(96.0f, 64.0f, 128.0f, 1, shape);
+		ConvertGeometryMeshData(shape, mesh);
+		BenchmarkBakeMesh(report, "box", mesh, resolutionScale);
+
+		shape = GeometryGenerator::MeshData();
+		mesh = MeshData();
+		geoGen.CreateSphere(64.0f, 24, 16, shape);
+		ConvertGeometryMeshData(shape, mesh);
+		BenchmarkBakeMesh(report, "sphere", mesh, resolutionScale);
+
+		shape = GeometryGenerator::MeshData();
+		mesh = MeshData();
+		geoGen.CreateGeosphere(64.0f, 3, shape);
+		ConvertGeometryMeshData(shape, mesh);
+		BenchmarkBakeMesh(report, "geosphere", mesh, resolutionScale);
+
+		shape = GeometryGenerator::MeshData();
+		mesh = MeshData();
+		geoGen.CreateCylinder(48.0f, 24.0f, 128.0f, 24, 4, shape);
+		ConvertGeometryMeshData(shape, mesh);
+		BenchmarkBakeMesh(report, "cylinder", mesh, resolutionScale);
+
+		shape = GeometryGenerator::MeshData();
+		mesh = MeshData();
+		geoGen.CreateGrid(128.0f, 128.0f, 8, 8, shape);
+		ConvertGeometryMeshData(shape, mesh);
+		BenchmarkBakeMesh(report, "grid", mesh, resolutionScale);
+
+		// Foliage card: a plane whose texture is opaque on a disc, one byte per texel of alpha only
+		const int textureSize = 32;
+		std::vector<uint8> texture(textureSize * textureSize);
+		for (int y = 0; y < textureSize; y++)
+			for (int x = 0; x < textureSize; x++)
+			{
+				const float dx = x + .5f - textureSize * .5f, dy = y + .5f - textureSize * .5f;
+				texture[y * textureSize + x] = dx * dx + dy * dy < textureSize * textureSize * .16f ? 255 : 0;
+			}
+		shape = GeometryGenerator::MeshData();
+		mesh = MeshData();
+		geoGen.CreateGrid(128.0f, 128.0f, 2, 2, shape);
+		ConvertGeometryMeshData(shape, mesh);
+		mesh.Mats[0].alphaTest = true;
+		mesh.Mats[0].alphaRef = 128;
+		mesh.Mats[0].diffuse.width = textureSize;
+		mesh.Mats[0].diffuse.height = textureSize;
+		mesh.Mats[0].diffuse.byteCount = 1;
+		mesh.Mats[0].diffuse.data = texture.data();
+		BenchmarkBakeMesh(report, "alpha_plane", mesh, resolutionScale);
+
+		std::string objList = get_command_line_option(gCommandLine, "-benchmark-obj=");
+		while (!objList.empty())
+		{
+			const size_t separator = objList.find(';');
+			const std::string path = objList.substr(0, separator);
+			objList = separator == std::string::npos ? std::string() : objList.substr(separator + 1);
+
+			std::vector<VertexXYZNUV> vertices;
+			std::vector<UINT> indices;
+			OBJLoader loader;
+			if (path.empty() || !loader.Load(path, vertices, indices) || indices.empty())
+				continue;
+
+			mesh = MeshData();
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				mesh.Vertices.push_back(FVector(vertices[i].pos_.x, vertices[i].pos_.y, vertices[i].pos_.z));
+				mesh.UVs.push_back(FVector2D(vertices[i].uv_.x, vertices[i].uv_.y));
+			}
+			for (size_t i = 0; i + 2 < indices.size(); i += 3)
+			{
+				MeshData::Triangle tri;
+				tri.indices[0] = indices[i];
+				tri.indices[1] = indices[i + 1];
+				tri.indices[2] = indices[i + 2];
+				tri.material = 0;
+				mesh.Indices.push_back(tri);
+			}
+			mesh.Mats.resize(1);
+			BenchmarkBakeMesh(report, path.c_str(), mesh, resolutionScale);
+		}
+	}
+
+	/** Loads one OBJ with both loaders, best of a few runs each, and checks they produce the same triangles. */
+	void BenchmarkOBJFile(BenchmarkReport& report, const char* name, const std::string& path)
+	{
+		const int numRuns = 3;
+		double referenceMs = 0, loadMs = 0;
+		std::vector<VertexXYZNUV> referenceVertices, vertices;
+		std::vector<UINT> referenceIndices, indices;
+		bool bReferenceLoaded = false, bLoaded = false;
+		OBJLoader loader;
+		for (int run = 0; run < numRuns; run++)
+		{
+			referenceVertices.clear();
+			referenceIndices.clear();
+			BenchmarkTimer timer;
+			bReferenceLoaded = loader.LoadReference(path, referenceVertices, referenceIndices);
+			const double ms = timer.ElapsedMs();
+			referenceMs = run == 0 ? ms : min(referenceMs, ms);
+
+			vertices.clear();
+			indices.clear();
+			timer.Reset();
+			bLoaded = loader.Load(path, vertices, indices);
+			const double loadElapsedMs = timer.ElapsedMs();
+			loadMs = run == 0 ? loadElapsedMs : min(loadMs, loadElapsedMs);
+		}
+
+		// The loaders number vertices differently, so triangles are compared corner by corner
+		double maxDifference = 0;
+		const bool bComparable = bReferenceLoaded && bLoaded && referenceIndices.size() == indices.size();
+		for (size_t i = 0; bComparable && i < indices.size(); i++)
+		{
+			const VertexXYZNUV& a = referenceVertices[referenceIndices[i]];
+			const VertexXYZNUV& b = vertices[indices[i]];
+			const float difference[8] = {
+				a.pos_.x - b.pos_.x, a.pos_.y - b.pos_.y, a.pos_.z - b.pos_.z,
+				a.normal_.x - b.normal_.x, a.normal_.y - b.normal_.y, a.normal_.z - b.normal_.z,
+				a.uv_.x - b.uv_.x, a.uv_.y - b.uv_.y };
+			for (int j = 0; j < 8; j++)
+				maxDifference = max(maxDifference, (double)FMath::Abs(difference[j]));
+		}
+
+		FILE* file = fopen(path.c_str(), "rb");
+		double megabytes = 0;
+		if (file)
+		{
+			fseek(file, 0, SEEK_END);
+			megabytes = ftell(file) / (1024.0 * 1024.0);
+			fclose(file);
+		}
+
+		report.Begin("obj", name);
+		report.Value("loaded", bLoaded);
+		report.Value("megabytes", megabytes);
+		report.Value("vertices", (double)vertices.size());
+		report.Value("triangles", (double)(indices.size() / 3));
+		report.Value("reference_ms", referenceMs);
+		report.Value("load_ms", loadMs);
+		report.Value("reference_mb_per_sec", megabytes * 1000.0 / max(referenceMs, 1e-3));
+		report.Value("load_mb_per_sec", megabytes * 1000.0 / max(loadMs, 1e-3));
+		report.Value("speedup", referenceMs / max(loadMs, 1e-3));
+		report.Value("reference_vertices", (double)referenceVertices.size());
+		// -1 when the reference cannot read the file, e.g. quads or corners without uvs
+		report.Value("max_difference", bComparable ? maxDifference : -1.0);
+		report.End();
+	}
+
+	/**
+	* Times the parallel OBJ loader against the line by line one on a generated terrain grid,
+	* plus the OBJ files listed by "-benchmark-obj=a.obj;b.obj".
+	*/
+	void BenchmarkOBJ(BenchmarkReport& report)
+	{
+		// 2M triangles with v/t/n corners, the only kind of face the reference loader reads
+		const int gridSize = 1024;
+		const char* gridPath = "sdf_benchmark_grid.obj";
+		FILE* file = fopen(gridPath, "w");
+		if (file)
+		{
+			fprintf(file, "# %dx%d benchmark grid\n", gridSize, gridSize);
+			for (int z = 0; z <= gridSize; z++)
+				for (int x = 0; x <= gridSize; x++)
+					fprintf(file, "v %.6f %.6f %.6f\n", x * 0.5f, FMath::Sin(x * 0.1f) * FMath::Cos(z * 0.07f) * 8.0f, z * 0.5f);
+			for (int z = 0; z <= gridSize; z++)
+				for (int x = 0; x <= gridSize; x++)
+					fprintf(file, "vt %.6f %.6f\n", x / (float)gridSize, z / (float)gridSize);
+			fprintf(file, "vn 0 1 0\nvn 0.707107 0.707107 0\n");
+			for (int z = 0; z < gridSize; z++)
+				for (int x = 0; x < gridSize; x++)
+				{
+					const int a = z * (gridSize + 1) + x + 1, b = a + 1, c = a + gridSize + 1, d = c + 1, n = 1 + (x & 1);
+					fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, n, c, c, n, b, b, n);
+					fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\n", b, b, n, c, c, n, d, d, n);
+				}
+			fclose(file);
+			BenchmarkOBJFile(report, "grid", gridPath);
+			remove(gridPath);
+		}
+
+		std::string objList = get_command_line_option(gCommandLine, "-benchmark-obj=");
+		while (!objList.empty())
+		{
+			const size_t separator = objList.find(';');
+			const std::string path = objList.substr(0, separator);
+			objList = separator == std::string::npos ? std::string() : objList.substr(separator + 1);
+			if (!path.empty())
+				BenchmarkOBJFile(report, path.c_str(), path);
+		}
+	}
+
+	struct BenchmarkEntry
+	{
+		const char* name;
+		void (*run)(BenchmarkReport& report);
+	};
+
+	const BenchmarkEntry gBenchmarks[] =
+	{
+		{ "clipmap", BenchmarkClipmap },
+		{ "sampler", BenchmarkSampler },
+		{ "shadow", BenchmarkShadow },
+		{ "collision", BenchmarkCollision },
+		{ "ao", BenchmarkAO },
+		{ "culling", BenchmarkCulling },
+		{ "atlas", BenchmarkAtlas },
+		{ "streaming", BenchmarkStreaming },
+		{ "mesher", BenchmarkMesher },
+		{ "primitives", BenchmarkPrimitives },
+		{ "bake", BenchmarkBake },
+		{ "obj", BenchmarkOBJ },
+	};
+}
+
+bool IsSDFBenchmarkCommandLine(const char* cmdLine)
+{
+	return cmdLine && strstr(cmdLine, "-benchmark") != NULL;
+}
+
+int RunSDFBenchmarks(const char* cmdLine)
+{
+	gCommandLine = cmdLine;
+	std::string only = get_command_line_option(cmdLine, "-benchmark=");
+	std::string outPath = get_command_line_option(cmdLine, "-benchmark-out=");
+	if (outPath.empty())
+		outPath = "sdf_benchmark.json";
+
+	FILE* file = fopen(outPath.c_str(), "a");
+	if (!file)
+		return 1;
+
+	BenchmarkReport report(file);
+	int numRun = 0;
+	for (int i = 0; i < sizeof(gBenchmarks) / sizeof(gBenchmarks[0]); i++)
+	{
+		if (only.empty() || only == gBenchmarks[i].name)
+		{
+			gBenchmarks[i].run(report);
+			numRun++;
+		}
+	}
+
+	fclose(file);
+	return numRun > 0 ? 0 : 1;
+}
@@ -0,0 +1,15 @@
+#ifndef _SDFBENCHMARK
+#define _SDFBENCHMARK
+
+/**
+* Headless benchmarks of the CPU distance field code, run instead of the demo window when the
+* command line contains "-benchmark" or "-benchmark=name".
+* Every result is one JSON object per line, appended to "-benchmark-out=file" (sdf_benchmark.json by default).
+* Returns the process exit code.
+*/
+int RunSDFBenchmarks(const char* cmdLine);
+
+/** True when the command line asks for the benchmarks. */
+bool IsSDFBenchmarkCommandLine(const char* cmdLine);
+
+#endif // !_SDFBENCHMARK
@@ -0,0 +1,142 @@
+#include "SceneLoader.h"
+#include "SDF.h"
+#include "io.h"
+#include "MeshLoader/ParallelFor.h"
+
+SceneLoader::SceneLoader(const std::string& resourceDir, float sdfResolutionScale, EDistanceFieldFormat sdfFormat)
+	: mResourceDir(resourceDir)
+	, mSDFResolutionScale(sdfResolutionScale)
+	, mSDFFormat(sdfFormat)
+	, mStopRequested(false)
+	, mNumQueued(0)
+	, mNumCompleted(0)
+{
+	// One core is left to the render thread, which keeps drawing while the scene streams in
+	const UINT numCores = std::thread::hardware_concurrency();
+	const UINT numWorkers = numCores > 2 ? numCores - 1 : 1;
+	for (UINT i = 0; i < numWorkers; i++)
+	{
+		mWorkers.push_back(std::thread(&SceneLoader::Run, this));
+	}
+}
+
+SceneLoader::~SceneLoader()
+{
+	Stop();
+
+	LoadedModel* model = mCompleted.PopAll();
+	while (model)
+	{
+		LoadedModel* next = model->next;
+		delete model->sdf;
+		delete model->mesh;
+		delete model;
+		model = next;
+	}
+}
+
+void SceneLoader::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopRequested = true;
+		for (size_t i = 0; i < mJobs.size(); i++)
+		{
+			delete mJobs[i];
+		}
+		mJobs.clear();
+	}
+	mCondition.notify_all();
+	for (size_t i = 0; i < mWorkers.size(); i++)
+	{
+		mWorkers[i].join();
+	}
+	mWorkers.clear();
+}
+
+UINT SceneLoader::LoadDirectory(const std::string& dir)
+{
+	const UINT firstIndex = mNumQueued;
+	std::string path = dir + "*.*";
+	_finddata_t file;
+	long lf;
+	if ((lf = _findfirst(path.c_str(), &file)) == -1l)
+		return 0;
+
+	do
+	{
+		if (file.attrib & _A_SUBDIR)
+			continue;
+		std::string name(file.name);
+		if (name.length() > 6 && name.substr(name.length() - 6, 6) == ".model")
+		{
+			// Proxies are named by the hex coordinates of their 100 unit tile
+			short x = 0, z = 0;
+			sscanf(name.substr(0, 4).c_str(), "%hx", &x);
+			sscanf(name.substr(4, 4).c_str(), "%hx", &z);
+			Load(dir + name, XMFLOAT3(x * 100 + 50.0f, 0, z * 100 + 50.0f));
+		}
+	} while (_findnext(lf, &file) == 0);
+	_findclose(lf);
+
+	return mNumQueued - firstIndex;
+}
+
+UINT SceneLoader::Load(const std::string& fileName, const XMFLOAT3& pos)
+{
+	LoadedModel* model = new LoadedModel();
+	model->index = mNumQueued++;
+	model->fileName = fileName;
+	model->pos = pos;
+	model->mesh = NULL;
+	model->sdf = NULL;
+	model->next = NULL;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mJobs.push_back(model);
+	}
+	mCondition.notify_one();
+	return model->index;
+}
+
+void SceneLoader::Run()
+{
+	// The workers already load one model per core, the OBJ parse and the mesh optimize stay on this thread
+	parallel_for_serial = true;
+
+	for (;;)
+	{
+		LoadedModel* model;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			while (!mStopRequested && mJobs.empty())
+			{
+				mCondition.wait(lock);
+			}
+			if (mStopRequested)
+				return;
+			model = mJobs.front();
+			mJobs.pop_front();
+		}
+
+		CMesh* mesh = new CMesh();
+		if (mesh->Init(model->fileName, mResourceDir, model->pos) && mesh->GetIndexCount() != 0)
+		{
+			// The 32-bit indices are dropped here, the buffers and the SDF read the 16-bit ones
+			if (bPackMeshes)
+				mesh->Pack();
+			model->mesh = mesh;
+			model->sdf = new SDFModel(*mesh);
+			// Bakes in the background, the volume texture is created once it is done
+			model->sdf->BeginGenerateSDF(mSDFResolutionScale, false, mSDFFormat);
+		}
+		else
+		{
+			delete mesh;
+		}
+
+		// Counted before it is handed over, see GetNumCompleted
+		mNumCompleted++;
+		mCompleted.Push(model);
+	}
+}
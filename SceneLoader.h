@@ -0,0 +1,137 @@
+#ifndef _SCENELOADER
+#define _SCENELOADER
+#include "MeshLoader/baseDefine.h"
+#include "SDF/DistanceFieldFormat.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class CMesh;
+class SDFModel;
+
+/** A model loaded on a worker thread, waiting for the render thread to create its buffers. */
+struct LoadedModel
+{
+	/** Order in which the directory listed the model, the slot it takes in the scene. */
+	UINT index;
+	std::string fileName;
+	XMFLOAT3 pos;
+
+	/** NULL when the load failed. */
+	CMesh* mesh;
+	SDFModel* sdf;
+
+	LoadedModel* next;
+};
+
+/**
+* Multi producer, single consumer queue of finished loads without locks.
+* Workers push onto an atomic list head, the render thread swaps the whole list out at once,
+* so there is no ABA problem and neither side ever waits on the other.
+*/
+class LoadCompletionQueue
+{
+public:
+	LoadCompletionQueue() : mHead(NULL) {}
+
+	/** Any thread. */
+	void Push(LoadedModel* model)
+	{
+		LoadedModel* head = mHead.load(std::memory_order_relaxed);
+		do
+		{
+			model->next = head;
+		} while (!mHead.compare_exchange_weak(head, model, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	/** Consumer thread only, everything pushed so far linked oldest first. */
+	LoadedModel* PopAll()
+	{
+		LoadedModel* list = mHead.exchange(NULL, std::memory_order_acquire);
+		LoadedModel* ordered = NULL;
+		while (list)
+		{
+			LoadedModel* next = list->next;
+			list->next = ordered;
+			ordered = list;
+			list = next;
+		}
+		return ordered;
+	}
+
+private:
+	std::atomic<LoadedModel*> mHead;
+};
+
+/**
+* Loads .model files on worker threads: XML, primitives and textures are read, the SDFModel is built and its
+* bake started, then the result is handed back through a LoadCompletionQueue.
+* Directory enumeration only queues jobs, workers pick them up as soon as the first one is listed.
+*/
+class SceneLoader
+{
+public:
+	/** resourceDir is where the .model files' primitives and textures live, sdfFormat is what the baked SDFs keep resident. */
+	SceneLoader(const std::string& resourceDir, float sdfResolutionScale, EDistanceFieldFormat sdfFormat);
+
+	/** Drops queued jobs, waits for the running ones and frees every result nobody took. */
+	~SceneLoader();
+
+	/** Drops queued jobs and waits for the running ones, their results can still be popped. Later jobs never run. */
+	void Stop();
+
+	/**
+	* Queues every proxy .model in dir, placed by the hex tile coordinates in its name.
+	* Returns the number of models queued, the slots of their LoadedModel::index.
+	*/
+	UINT LoadDirectory(const std::string& dir);
+
+	/** Queues one model in the next slot. */
+	UINT Load(const std::string& fileName, const XMFLOAT3& pos);
+
+	/** Finished loads in completion order, the caller owns them. */
+	LoadedModel* PopCompleted()
+	{
+		return mCompleted.PopAll();
+	}
+
+	UINT GetNumQueued() const
+	{
+		return mNumQueued;
+	}
+
+	/**
+	* Loads are counted just before they are pushed, so once this reaches GetNumQueued the last results may still be
+	* on their way: Stop, then pop them.
+	*/
+	UINT GetNumCompleted() const
+	{
+		return mNumCompleted;
+	}
+
+private:
+	SceneLoader(const SceneLoader&);
+	SceneLoader& operator=(const SceneLoader&);
+
+	void Run();
+
+	std::string mResourceDir;
+	float mSDFResolutionScale;
+	EDistanceFieldFormat mSDFFormat;
+
+	std::mutex mMutex;
+	std::condition_variable mCondition;
+	std::deque<LoadedModel*> mJobs;
+	bool mStopRequested;
+	std::vector<std::thread> mWorkers;
+
+	LoadCompletionQueue mCompleted;
+	UINT mNumQueued;
+	std::atomic<UINT> mNumCompleted;
+};
+
+#endif // !_SCENELOADER
@@ -22,6 +22,11 @@
 #include "GeometryGenerator.h"
 #include "SDFShadow.h"
 #include "SAO.h"
+#include "SDFAO.h"
+#include "SDFBenchmark.h"
+#include "MeshLoader/MeshCache.h"
+#include "MeshLoader/CommandLine.h"
+#include "SceneLoader.h"
 
 struct SpotLight
 {
@@ -33,6 +38,25 @@ struct SpotLight
 	float  spotPower;
 };
 
+// One DrawIndexedPrimitive of a model, packed models draw each 16-bit chunk from its own base vertex
+struct ModelDraw
+{
+	UINT baseVertex;
+	UINT numVertices;
+	UINT startIndex;
+	UINT primCount;
+	// gDequant of PackedVertex.fx, scale and bias of the chunk's quantized vertices
+	D3DXVECTOR4 dequant[3];
+};
+
+// gDequant for float vertices
+static const D3DXVECTOR4 gFloatVertexDequant[3] =
+{
+	D3DXVECTOR4(1.0f, 1.0f, 1.0f, 0.0f),
+	D3DXVECTOR4(0.0f, 0.0f, 0.0f, 0.0f),
+	D3DXVECTOR4(1.0f, 1.0f, 0.0f, 0.0f),
+};
+
 class ShadowMapDemo : public D3DApp
 {
 public:
@@ -47,6 +71,12 @@ public:
 	void drawShadowMap();
 	void buildFX();
 	void BuildModel();
+	void PollSceneLoads();
+	void CreateModelBuffers(UINT i, CMesh& cmesh);
+	// Returns true if the vertex buffer holds VertexPackedPNT instead of VertexPNT
+	bool CreateMeshBuffers(CMesh& cmesh, IDirect3DVertexBuffer9*& vertexBuffer, IDirect3DIndexBuffer9*& indexBuffer,
+		vector<ModelDraw>& draws);
+	void UploadBakedSDFs();
 	void LoadSponza();
 	void BuildCullingVolume(XMFLOAT3 lightDir);
 	void BuildQuadPlane();
@@ -56,11 +86,13 @@ public:
 	void BuildHIZ();
 	void DeferredShadingPass();
 	void SDFShadowPass(UINT idx);
+	void SDFAOPass();
 	void DebugTexture(IDirect3DTexture9* tex);
 private:
 	GfxStats* mGfxStats;
 
 	SAO* mSAO;
+	SDFAO* mSDFAO;
 	DeferredShading *mDeferredShading;
 	SDFShadow *mSDFShadow; 
 
@@ -91,6 +123,7 @@ private:
 	D3DXHANDLE   mhWorld;
 	D3DXHANDLE   mhTex;
 	D3DXHANDLE   mhShadowMap;
+	D3DXHANDLE   mhDequant;
 	D3DXHANDLE   mhMtrl;
 	D3DXHANDLE   mhLight;
 
@@ -106,9 +139,16 @@ private:
 	vector<SDFModel*> mObjSDF;
 	vector<IDirect3DVertexBuffer9*> mObjModelVB;
 	vector<IDirect3DIndexBuffer9*> mObjModelIB;
-	vector<UINT> mObjModelCnt;
-	vector<UINT> mObjModelVertexCnt;
+	vector<vector<ModelDraw> > mObjModelDraws;
+	vector<bool> mObjModelPacked;
 	vector<D3DXMATRIX> mObjModelMat;
+	// Models stream in on worker threads, their slots above stay NULL until PollSceneLoads fills them
+	SceneLoader* mSceneLoader;
+	__int64 mSceneLoadStart;
+	uint32 mSceneLoadedBytes;
+	// Bytes the baked SDFs keep on the CPU, and what they would as half floats
+	SIZE_t mSDFResidentBytes;
+	SIZE_t mSDFHalfBytes;
 	vector<IDirect3DVertexBuffer9*> mObjCullingVolumeVB;
 	vector<IDirect3DIndexBuffer9*> mObjCullingVolumeIB;
 	vector<UINT> mObjCullingVolumeCnt;
@@ -126,8 +166,8 @@ private:
 
 	IDirect3DVertexBuffer9* mSponzaVB;
 	IDirect3DIndexBuffer9* mSponzaIB;
-	UINT mSponzaVertexCnt;
-	UINT mSponzaIndexCnt;
+	vector<ModelDraw> mSponzaDraws;
+	bool mSponzaPacked;
 	D3DXMATRIX mSponzaMat;
 };
 
@@ -140,6 +180,12 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
 		_CrtSetDbgFlag( _CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF );
 	#endif
 
+	// Headless benchmark and mesh cache converter runs never create the window
+	if (IsSDFBenchmarkCommandLine(cmdLine))
+		return RunSDFBenchmarks(cmdLine);
+	if (IsMeshCacheCommandLine(cmdLine))
+		return RunMeshCacheConverter(cmdLine);
+
 	// Construct camera before application, since the application uses the camera.
 	Camera camera;
 	gCamera = &camera;
@@ -217,6 +263,7 @@ ShadowMapDemo::ShadowMapDemo(HINSTANCE hInstance, std::string winCaption, D3DDEV
 	mDeferredShading = new DeferredShading(md3dPP.BackBufferWidth, md3dPP.BackBufferHeight);
 	mSDFShadow = new SDFShadow(md3dPP.BackBufferWidth, md3dPP.BackBufferHeight);
 	mSAO = new SAO(md3dPP.BackBufferWidth, md3dPP.BackBufferHeight);
+	mSDFAO = new SDFAO(md3dPP.BackBufferWidth, md3dPP.BackBufferHeight);
 	onResetDevice();
 	mDeferredShading->InitQuad();
 	
@@ -238,6 +285,9 @@ ShadowMapDemo::~ShadowMapDemo()
 	//for(UINT i = 0; i < mCarTextures.size(); ++i)
 		//ReleaseCOM(mCarTextures[i]);
 
+	// Workers still loading hold no device resources, but must not outlive the demo
+	delete mSceneLoader;
+
 	DestroyAllVertexDeclarations();
 }
 
@@ -289,6 +339,7 @@ void ShadowMapDemo::onLostDevice()
 	mDeferredShading->onLostDeivce();
 	mSDFShadow->OnLostDevice();
 	mSAO->OnLostDevice();
+	mSDFAO->OnLostDevice();
 	HR(mFX->OnLostDevice());
 	HR(mDebugTexFX->OnLostDevice());
 }
@@ -301,6 +352,7 @@ void ShadowMapDemo::onResetDevice()
 	mDeferredShading->onResetDevice();
 	mSDFShadow->OnResetDevice();
 	mSAO->OnResetDevice();
+	mSDFAO->OnResetDevice();
 	HR(mFX->OnResetDevice());
 	HR(mDebugTexFX->OnResetDevice());
 
@@ -319,6 +371,9 @@ void ShadowMapDemo::updateScene(float dt)
 
 	gCamera->update(dt, 0, 0);
 
+	PollSceneLoads();
+	UploadBakedSDFs();
+
 	// Animate spot light by rotating it on y-axis with respect to time.
 	D3DXMATRIX lightView;
 	D3DXVECTOR3 lightPosW(125.0f, 50.0f, 0.0f);
@@ -463,22 +518,30 @@ void ShadowMapDemo::ForwardShading()
 
 
 	//////////////////////////////////////////////////////////////////////
-	gd3dDevice->SetVertexDeclaration(VertexPNT::Decl);
-
-	for(int i = 50; i < 51; i++ )
+	for(int i = 50; i < 51 && i < (int)mObjModelVB.size(); i++ )
 	{
+		if (!mObjModelVB[i])
+			continue;
 		HR(mFX->SetValue(mhMtrl, &mSceneMtrls[0], sizeof(Mtrl)));
 		HR(mFX->SetMatrix(mhWVP, &(mObjModelMat[i]*gCamera->viewProj())));
 		HR(mFX->SetMatrix(mhWorld, &mObjModelMat[i]));
-		HR(mFX->CommitChanges());
-		HR(gd3dDevice->SetStreamSource(0, mObjModelVB[i], 0, sizeof(VertexPNT)));
+		HR(gd3dDevice->SetVertexDeclaration(mObjModelPacked[i] ? VertexPackedPNT::Decl : VertexPNT::Decl));
+		HR(gd3dDevice->SetStreamSource(0, mObjModelVB[i], 0, mObjModelPacked[i] ? sizeof(VertexPackedPNT) : sizeof(VertexPNT)));
 		HR(gd3dDevice->SetIndices(mObjModelIB[i]));
 
 
-		HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST,
-			0,0,mObjModelVertexCnt[i],
-			0,mObjModelCnt[i] / 3));
+		for (UINT d = 0; d < mObjModelDraws[i].size(); d++)
+		{
+			const ModelDraw& draw = mObjModelDraws[i][d];
+			HR(mFX->SetVectorArray(mhDequant, draw.dequant, 3));
+			HR(mFX->CommitChanges());
+			HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST,
+				draw.baseVertex,0,draw.numVertices,
+				draw.startIndex,draw.primCount));
+		}
 	}
+	// The scene and car meshes are float
+	HR(mFX->SetVectorArray(mhDequant, gFloatVertexDequant, 3));
 
 	// 	D3DXMATRIX e;
 	// 	D3DXMatrixIdentity(&e);
@@ -570,6 +633,7 @@ void ShadowMapDemo::buildFX()
 	mhEyePosW            = mFX->GetParameterByName(0, "gEyePosW");
 	mhTex                = mFX->GetParameterByName(0, "gTex");
 	mhShadowMap          = mFX->GetParameterByName(0, "gShadowMap");
+	mhDequant            = mFX->GetParameterByName(0, "gDequant");
 
 	errors = 0;
 	HR(D3DXCreateEffectFromFile(gd3dDevice, "FX/DebugTex.fx", 
@@ -599,130 +663,248 @@ void ShadowMapDemo::buildFX()
 void ShadowMapDemo::BuildModel()
 {
 	///////////
-	string file_name = "./lod/proxy/";
-	vector<CMesh> meshs;
-	string path = file_name + "*.*";
-	_finddata_t file;
-	long lf;
-	if ((lf = _findfirst(path.c_str(), &file)) == -1l)//_findfirstصlong; long __cdecl _findfirst(const char *, struct _finddata_t *)
+	// Only the directory is listed here, meshes and SDFs are built on worker threads
+	mSceneLoadedBytes = 0;
+	mSDFResidentBytes = 0;
+	mSDFHalfBytes = 0;
+	QueryPerformanceCounter((LARGE_INTEGER*)&mSceneLoadStart);
+	// "-sdfformat=half", "unorm8" or "block" picks what the SDFs keep resident, they are decoded only for the upload
+	const string sdfFormatName = get_command_line_option(GetCommandLineA(), "-sdfformat=");
+	const EDistanceFieldFormat sdfFormat = sdfFormatName == "half" ? DFF_Float16 :
+		(sdfFormatName == "block" ? DFF_Block4x4x4 : DFF_Unorm8);
+	mSceneLoader = new SceneLoader("D:/", 1.0f, sdfFormat);
+	UINT numModels = mSceneLoader->LoadDirectory("./lod/proxy/");
+	//mSceneLoader->Load("D:/scene/common/zw/zwshu/slj_zwshu0020_wb.model", XMFLOAT3(0, 0, 0));
+	////////////////////////////////////////////SDF///////////////////////
+
+	mObjSDF.resize(numModels, NULL);
+	mObjSDFSRV.resize(numModels, NULL);
+	mObjModelVB.resize(numModels, NULL);
+	mObjModelIB.resize(numModels, NULL);
+	mObjModelDraws.resize(numModels);
+	mObjModelPacked.resize(numModels, false);
+	mObjModelMat.resize(numModels);
+	for (UINT i = 0; i < numModels; i++)
+	{
+		D3DXMatrixIdentity(&mObjModelMat[i]);
+	}
+}
+
+void ShadowMapDemo::PollSceneLoads()
+{
+	if (!mSceneLoader)
 		return;
-	else
+
+	// Checked before popping: once every load is counted, stopping the workers lets the last pushes land,
+	// this also ends loads that queued no models at all
+	const bool allLoaded = mSceneLoader->GetNumCompleted() == mSceneLoader->GetNumQueued();
+	if (allLoaded)
+		mSceneLoader->Stop();
+
+	LoadedModel* model = mSceneLoader->PopCompleted();
+	while (model)
 	{
-		while (_findnext(lf, &file) == 0)//int __cdecl _findnext(long, struct _finddata_t *);ҵ¸ļֳɹĻͷ0,򷵻-1
+		LoadedModel* next = model->next;
+		const UINT i = model->index;
+		if (model->mesh && i < mObjModelVB.size())
 		{
-			if (file.attrib != _A_SUBDIR)
-			{
-				string name(file.name);
-				if (name != ".." && name != "." && name.length() > 6 &&
-					name.substr(name.length() - 6, 6) == ".model")  {
-						CMesh cmesh;
-						short x = 0, z = 0;
-						sscanf(name.substr(0, 4).c_str(), "%hx", &x);
-						sscanf(name.substr(4, 4).c_str(), "%hx", &z);
-						XMFLOAT3 pos = XMFLOAT3(x * 100 + 50.0f, 0, z * 100 + 50.0f);
-						cmesh.Init(file_name + name, "D:/", pos);
-						XMFLOAT4X4 world;
-						XMStoreFloat4x4(&world, XMMatrixTranslation(pos.x, pos.y, pos.z));
-						SDFModel *sdf = new SDFModel(cmesh);
-						meshs.push_back(std::move(cmesh));
-						mObjSDF.push_back(sdf);
-						//mObjModelMat.push_back(world);
-						std::string dds = file_name + name.substr(0, 9) + ".dds";
-						//std::wstring wdds(dds.length(), L' ');
-						//std::copy(dds.begin(), dds.end(), wdds.begin());
-						LPDIRECT3DVOLUMETEXTURE9 SDFMap = 0;
-						//0HR(D3DXCreateVolumeTextureFromFile(gd3dDevice, dds.c_str(),&SDFMap));
-						//mObjSDFSRV.push_back(SDFMap);
-				}
-			}
+			CreateModelBuffers(i, *model->mesh);
+			mObjSDF[i] = model->sdf;
+			mSceneLoadedBytes += model->mesh->GetLoadedBytes();
+		}
+		else
+		{
+			delete model->sdf;
 		}
+		// The SDF keeps its own copy of the geometry, and the buffers now hold the rest
+		delete model->mesh;
+		delete model;
+		model = next;
 	}
-	_findclose(lf);
-	//cmesh.Init("D:/scene/common/zw/zwshu/slj_zwshu0020_wb.model", "D:/", XMFLOAT3(0, 0, 0));
-	////////////////////////////////////////////SDF///////////////////////
 
-	mObjModelVB.resize(meshs.size());
-	mObjModelIB.resize(meshs.size());
-	mObjModelCnt.resize(meshs.size());
-	mObjModelMat.resize(meshs.size());
-	mObjModelVertexCnt.resize(meshs.size());
-	for (int i = 0; i < meshs.size(); i++)
+	if (allLoaded)
 	{
-		CMesh& cmesh = meshs[i];
-		INDEX_LIST &ib = cmesh.GetIndexList();
-		MESH_VERTEX &vb = cmesh.GetMeshVertex();
-		UINT count = ib.size();
+		__int64 cntsPerSec = 0, loadEnd = 0;
+		QueryPerformanceFrequency((LARGE_INTEGER*)&cntsPerSec);
+		QueryPerformanceCounter((LARGE_INTEGER*)&loadEnd);
+
+		char buffer[128];
+		const double loadSeconds = cntsPerSec ? (double)(loadEnd - mSceneLoadStart) / cntsPerSec : 0.0;
+		const double loadedMB = mSceneLoadedBytes / (1024.0 * 1024.0);
+		sprintf(buffer, "Loaded %u models, %.2f MB in %.3fs (%.1f MB/s)\n", mSceneLoader->GetNumQueued(), loadedMB, loadSeconds,
+			loadSeconds > 0 ? loadedMB / loadSeconds : 0.0);
+		OutputDebugStringA(buffer);
+		CTextureCache& textures = CTextureCache::get_instance();
+		sprintf(buffer, "Textures: %u decoded, %u shared, %.2f MB cached\n", textures.GetLoadCount(), textures.GetHitCount(),
+			textures.GetRetainedBytes() / (1024.0 * 1024.0));
+		OutputDebugStringA(buffer);
+
+		delete mSceneLoader;
+		mSceneLoader = NULL;
+	}
+}
+
+void ShadowMapDemo::CreateModelBuffers(UINT i, CMesh& cmesh)
+{
+	mObjModelPacked[i] = CreateMeshBuffers(cmesh, mObjModelVB[i], mObjModelIB[i], mObjModelDraws[i]);
+	mObjModelMat[i] = *(D3DXMATRIX*)&cmesh.GetWorldTrans();
+}
+
+bool ShadowMapDemo::CreateMeshBuffers(CMesh& cmesh, IDirect3DVertexBuffer9*& vertexBuffer, IDirect3DIndexBuffer9*& indexBuffer,
+	vector<ModelDraw>& draws)
+{
+	draws.clear();
+	if (!cmesh.IsPacked())
+	{
+		// Read in place, from the mesh cache when the mesh was loaded from one
+		const vertex_streams vb = cmesh.GetVertexStreams();
 		gd3dDevice->CreateVertexBuffer(
-			sizeof(VertexPNT) * vb.size(),
+			sizeof(VertexPNT) * vb.count,
 			0,
 			D3DFVF_XYZ| D3DFVF_NORMAL|D3DFVF_TEX0,
 			D3DPOOL_MANAGED,
-			&mObjModelVB[i],
+			&vertexBuffer,
 			NULL
 			);
 		void *tvb;
-		HR(mObjModelVB[i]->Lock(0, sizeof(VertexPNT) * vb.size(), &tvb, 0));
-		memcpy(tvb, &vb[0], sizeof(VertexPNT) * vb.size());
-		HR(mObjModelVB[i]->Unlock());
+		HR(vertexBuffer->Lock(0, sizeof(VertexPNT) * vb.count, &tvb, 0));
+		if (vb.interleaved())
+		{
+			memcpy(tvb, vb.interleaved(), sizeof(VertexPNT) * vb.count);
+		}
+		else
+		{
+			// Deinterleaved caches are interleaved straight into the locked buffer
+			VertexPNT* dst = (VertexPNT*)tvb;
+			for (UINT v = 0; v < vb.count; v++)
+			{
+				const XMFLOAT3& p = vb.position(v);
+				const XMFLOAT3& n = vb.normal_at(v);
+				const XMFLOAT2& uv = vb.uv_at(v);
+				dst[v] = VertexPNT(p.x, p.y, p.z, n.x, n.y, n.z, uv.x, uv.y);
+			}
+		}
+		HR(vertexBuffer->Unlock());
 
+		const UINT* ib = cmesh.GetIndices();
+		UINT count = cmesh.GetIndexCount();
 		gd3dDevice->CreateIndexBuffer(
 			sizeof(UINT)* count,
 			0,
 			D3DFMT_INDEX32,
 			D3DPOOL_MANAGED,
-			&mObjModelIB[i],
+			&indexBuffer,
 			NULL
 			);
 
 		void *tib;
-		HR(mObjModelIB[i]->Lock(0, sizeof(UINT)* count, &tib, 0));
-		memcpy(tib, &ib[0], sizeof(UINT)* count);
-		HR(mObjModelIB[i]->Unlock());
+		HR(indexBuffer->Lock(0, sizeof(UINT)* count, &tib, 0));
+		memcpy(tib, ib, sizeof(UINT)* count);
+		HR(indexBuffer->Unlock());
 
-		mObjModelVertexCnt[i] = vb.size();
-		mObjModelCnt[i] = count;
-		mObjModelMat[i] = *(D3DXMATRIX*)&cmesh.GetWorldTrans();
+		ModelDraw draw = { 0, vb.count, 0, count / 3 };
+		memcpy(draw.dequant, gFloatVertexDequant, sizeof(draw.dequant));
+		draws.push_back(draw);
+		return false;
 	}
-}
 
-void ShadowMapDemo::LoadSponza()
-{
-	
-	string path = "D:/sponza.obj";
-	CMesh cmesh;
-	cmesh.Init(path, "", XMFLOAT3(0,0,0));
-	INDEX_LIST &ib = cmesh.GetIndexList();
-	MESH_VERTEX &vb = cmesh.GetMeshVertex();
-	UINT count = ib.size();
+	// The quantized vertices go to the GPU as they are, the effects decode them per draw
+	const CPackedMesh& packed = cmesh.GetPackedMesh();
+	const packed_submesh* chunks = packed.GetSubmeshes();
 	gd3dDevice->CreateVertexBuffer(
-		sizeof(VertexPNT) * vb.size(),
+		sizeof(VertexPackedPNT) * packed.GetVertexCount(),
+		0,
 		0,
-		D3DFVF_XYZ| D3DFVF_NORMAL|D3DFVF_TEX0,
 		D3DPOOL_MANAGED,
-		&mSponzaVB,
+		&vertexBuffer,
 		NULL
 		);
 	void *tvb;
-	HR(mSponzaVB->Lock(0, sizeof(VertexPNT) * vb.size(), &tvb, 0));
-	memcpy(tvb, &vb[0], sizeof(VertexPNT) * vb.size());
-	HR(mSponzaVB->Unlock());
+	HR(vertexBuffer->Lock(0, sizeof(VertexPackedPNT) * packed.GetVertexCount(), &tvb, 0));
+	memcpy(tvb, packed.GetVertices(), sizeof(VertexPackedPNT) * packed.GetVertexCount());
+	HR(vertexBuffer->Unlock());
 
+	// Each draw reaches at most 65536 vertices past its base vertex, so 16-bit indices do
 	gd3dDevice->CreateIndexBuffer(
-		sizeof(UINT)* count,
+		sizeof(USHORT)* packed.GetIndexCount(),
 		0,
-		D3DFMT_INDEX32,
+		D3DFMT_INDEX16,
 		D3DPOOL_MANAGED,
-		&mSponzaIB,
+		&indexBuffer,
 		NULL
 		);
 
 	void *tib;
-	HR(mSponzaIB->Lock(0, sizeof(UINT)* count, &tib, 0));
-	memcpy(tib, &ib[0], sizeof(UINT)* count);
-	HR(mSponzaIB->Unlock());
+	HR(indexBuffer->Lock(0, sizeof(USHORT)* packed.GetIndexCount(), &tib, 0));
+	memcpy(tib, packed.GetIndices(), sizeof(USHORT)* packed.GetIndexCount());
+	HR(indexBuffer->Unlock());
+
+	for (UINT c = 0; c < packed.GetSubmeshCount(); c++)
+	{
+		const packed_submesh& chunk = chunks[c];
+		ModelDraw draw = { chunk.base_vertex, chunk.vertex_count, chunk.start_index, chunk.index_count / 3 };
+		draw.dequant[0] = D3DXVECTOR4(chunk.pos_scale[0], chunk.pos_scale[1], chunk.pos_scale[2], 1.0f / 32767.0f);
+		draw.dequant[1] = D3DXVECTOR4(chunk.pos_bias[0], chunk.pos_bias[1], chunk.pos_bias[2], 0.0f);
+		draw.dequant[2] = D3DXVECTOR4(chunk.uv_scale[0], chunk.uv_scale[1], chunk.uv_bias[0], chunk.uv_bias[1]);
+		draws.push_back(draw);
+	}
+	return true;
+}
+
+void ShadowMapDemo::UploadBakedSDFs()
+{
+	for (UINT i = 0; i < mObjSDF.size(); i++)
+	{
+		SDFModel* sdf = mObjSDF[i];
+		if (!sdf)
+			continue;
+		FDistanceFieldBakeHandle* bake = sdf->bakeHandle;
+		if (mObjSDFSRV[i] || (bake && (!bake->IsDone() || bake->GetState() == DFBake_Cancelled)) || sdf->sdfData->Size.X == 0)
+			continue;
+
+		const SDFFloat* data;
+		vector<SDFFloat> scratch;
+		uint32 w, h, d;
+		sdf->GetSDFData(data, scratch, w, h, d);
+		HR(D3DXCreateVolumeTexture(gd3dDevice, w, h, d, 1, 0,
+			sizeof(SDFFloat) == 2 ? D3DFMT_R16F : D3DFMT_R32F, D3DPOOL_MANAGED, &mObjSDFSRV[i]));
+
+		D3DLOCKED_BOX box;
+		HR(mObjSDFSRV[i]->LockBox(0, &box, NULL, 0));
+		for (uint32 z = 0; z < d; z++)
+		{
+			for (uint32 y = 0; y < h; y++)
+			{
+				memcpy((BYTE*)box.pBits + z * box.SlicePitch + y * box.RowPitch, data + (z * h + y) * w, w * sizeof(SDFFloat));
+			}
+		}
+		HR(mObjSDFSRV[i]->UnlockBox(0));
+		vector<SDFFloat>().swap(scratch);
+
+		// The texture stays half float, only the CPU copy is compressed
+		const FDistanceFieldVolumeData& volume = *sdf->sdfData;
+		const SIZE_t residentBytes = volume.DistanceFieldVolume.capacity() * sizeof(SDFFloat) + volume.CompressedVolume.GetResourceSize();
+		const SIZE_t halfBytes = (SIZE_t)w * h * d * sizeof(uint16);
+		mSDFResidentBytes += residentBytes;
+		mSDFHalfBytes += halfBytes;
+
+		char buffer[256];
+		// Models without a bake were generated up front, e.g. rasterized primitives
+		sprintf(buffer, "SDF %u baked %ux%ux%u in %.2fs%s, %u KB resident instead of %u KB, %.2f of %.2f MB in total\n", i, w, h, d,
+			bake ? bake->GetElapsedSeconds() : 0.0, bake && bake->GetState() == DFBake_Coarse ? " (coarse)" : "",
+			(uint32)(residentBytes / 1024), (uint32)(halfBytes / 1024),
+			mSDFResidentBytes / (1024.0 * 1024.0), mSDFHalfBytes / (1024.0 * 1024.0));
+		OutputDebugStringA(buffer);
+	}
+}
 
-	mSponzaVertexCnt = vb.size();
-	mSponzaIndexCnt = count;
+void ShadowMapDemo::LoadSponza()
+{
+	
+	string path = "D:/sponza.obj";
+	CMesh cmesh;
+	cmesh.Init(path, "", XMFLOAT3(0,0,0));
+	mSponzaPacked = CreateMeshBuffers(cmesh, mSponzaVB, mSponzaIB, mSponzaDraws);
 	mSponzaMat = *(D3DXMATRIX*)&cmesh.GetWorldTrans();
 
 }
@@ -789,23 +971,32 @@ void ShadowMapDemo::BuildGBuffer()
 	mDeferredShading->GBufferBegin();
 	ID3DXEffect* mFX = mDeferredShading->GBufferFX;
 
-	gd3dDevice->SetVertexDeclaration(VertexPNT::Decl);
-
-	for(int i = 0; i < 51; i++ )
+	for(int i = 0; i < 51 && i < (int)mObjModelVB.size(); i++ )
 	{
+		if (!mObjModelVB[i])
+			continue;
 		HR(mFX->SetValue(mDeferredShading->mtrl, &mWhite, sizeof(Mtrl)));
 		HR(mFX->SetMatrix(mDeferredShading->WorldInvTranspose, &MathHelper::InverseTranspose(mObjModelMat[i])));
 		HR(mFX->SetMatrix(mDeferredShading->WorldViewProj, &(mObjModelMat[i]*gCamera->viewProj())));
-		HR(mFX->CommitChanges());
-		HR(gd3dDevice->SetStreamSource(0, mObjModelVB[i], 0, sizeof(VertexPNT)));
+		HR(gd3dDevice->SetVertexDeclaration(mObjModelPacked[i] ? VertexPackedPNT::Decl : VertexPNT::Decl));
+		HR(gd3dDevice->SetStreamSource(0, mObjModelVB[i], 0, mObjModelPacked[i] ? sizeof(VertexPackedPNT) : sizeof(VertexPNT)));
 		HR(gd3dDevice->SetIndices(mObjModelIB[i]));
 
 
-		HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST,
-			0,0,mObjModelVertexCnt[i],
-			0,mObjModelCnt[i] / 3));
+		for (UINT d = 0; d < mObjModelDraws[i].size(); d++)
+		{
+			const ModelDraw& draw = mObjModelDraws[i][d];
+			HR(mFX->SetVectorArray(mDeferredShading->Dequant, draw.dequant, 3));
+			HR(mFX->CommitChanges());
+			HR(gd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST,
+				draw.baseVertex,0,draw.numVertices,
+				draw.startIndex,draw.primCount));
+		}
 	}
 
+	// The plane is float
+	HR(gd3dDevice->SetVertexDeclaration(VertexPNT::Decl));
+	HR(mFX->SetVectorArray(mDeferredShading->Dequant, gFloatVertexDequant, 3));
 	D3DXMATRIX e;
 	D3DXMatrixIdentity(&e);
 	HR(mFX->SetValue(mDeferredShading->mtrl, &mWhite, sizeof(Mtrl)));
@@ -899,7 +1090,15 @@ void ShadowMapDemo::DeferredShadingPass()
  	HR(gd3dDevice->SetRenderTarget(0,mBackBuffer));
 	//DebugTexture(mDeferredShading->mGBuffer0->d3dTex());
 	//DebugTexture(mSAO->mSAOMapSampled->d3dTex());
-	DebugTexture(mSAO->mSAOMapBlurred1->d3dTex());
+	// Hold O to compare distance field AO against SAO
+	if (gDInput->keyDown(DIK_O))
+	{
+		SDFAOPass();
+		HR(gd3dDevice->SetRenderTarget(0,mBackBuffer));
+		DebugTexture(mSDFAO->mAOMap->d3dTex());
+	}
+	else
+		DebugTexture(mSAO->mSAOMapBlurred1->d3dTex());
 //  	HR(gd3dDevice->BeginScene());	
 //  	mDeferredShading->ShadingBegin();
 //  	HR(mDeferredShading->DeferredShadingFX->SetValue(
@@ -959,4 +1158,31 @@ void ShadowMapDemo::SDFShadowPass(UINT idx)
 	HR(mFX->End());
 	HR(gd3dDevice->EndScene())
 
-}
\ No newline at end of file
+}
+
+void ShadowMapDemo::SDFAOPass()
+{
+	mSDFAO->ConePassBegin(mDebugTexVB, mDebugTexIB, *gCamera
+		, mDeferredShading->mDepthMap->d3dTex(), mDeferredShading->mGBuffer0->d3dTex());
+	for (UINT idx = 0; idx < mObjSDF.size(); idx++)
+	{
+		if (!mObjSDFSRV[idx])
+			continue;
+
+		// World to volume texture space, as in SDFShadowPass
+		SDFModel* sdfModel = mObjSDF[idx];
+		D3DXVECTOR3 origin = *(D3DXVECTOR3*)&sdfModel->GetOrigin();
+		D3DXVECTOR3 bounds = *(D3DXVECTOR3*)&sdfModel->GetBounds();
+		D3DXVECTOR3 extends = bounds * 0.5f;
+		D3DXMATRIX SDFToWordInv0;
+		float det;
+		D3DXMatrixInverse(&SDFToWordInv0, &det, &mObjModelMat[idx]);
+		D3DXMATRIX trans;
+		D3DXMatrixTranslation(&trans,-origin.x, -origin.y, -origin.z);
+		SDFToWordInv0 *= trans;
+		for(int i = 0; i < 3; i ++) SDFToWordInv0(3, i) += extends[i];
+		mSDFAO->ConePassDraw(SDFToWordInv0, bounds, max(extends[0], max(extends[1], extends[2])), mObjSDFSRV[idx]);
+	}
+	mSDFAO->ConePassEnd();
+	mSDFAO->Upsample(mDebugTexVB, mDebugTexIB);
+}
@@ -10,6 +10,7 @@ IDirect3DVertexDeclaration9* VertexPos::Decl = 0;
 IDirect3DVertexDeclaration9* VertexCol::Decl = 0;
 IDirect3DVertexDeclaration9* VertexPN::Decl  = 0;
 IDirect3DVertexDeclaration9* VertexPNT::Decl = 0;
+IDirect3DVertexDeclaration9* VertexPackedPNT::Decl = 0;
 IDirect3DVertexDeclaration9* VertexPT::Decl = 0;
 IDirect3DVertexDeclaration9* GrassVertex::Decl = 0;
 
@@ -59,6 +60,18 @@ void InitAllVertexDeclarations()
 	};	
 	HR(gd3dDevice->CreateVertexDeclaration(VertexPNTElements, &VertexPNT::Decl));
 
+	//===============================================================
+	// VertexPackedPNT
+
+	D3DVERTEXELEMENT9 VertexPackedPNTElements[] = 
+	{
+		{0, 0,  D3DDECLTYPE_SHORT4, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0},
+		{0, 8,  D3DDECLTYPE_SHORT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL, 0},
+		{0, 12, D3DDECLTYPE_SHORT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0},
+		D3DDECL_END()
+	};	
+	HR(gd3dDevice->CreateVertexDeclaration(VertexPackedPNTElements, &VertexPackedPNT::Decl));
+
 	//===============================================================
 	// VertexPT
 
@@ -90,6 +103,7 @@ void DestroyAllVertexDeclarations()
 	ReleaseCOM(VertexCol::Decl);
 	ReleaseCOM(VertexPN::Decl);
 	ReleaseCOM(VertexPNT::Decl);
+	ReleaseCOM(VertexPackedPNT::Decl);
 	ReleaseCOM(VertexPT::Decl);
 	ReleaseCOM(GrassVertex::Decl);
 }
\ No newline at end of file
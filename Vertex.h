@@ -74,6 +74,18 @@ struct VertexPNT
 	static IDirect3DVertexDeclaration9* Decl;
 };
 
+//===============================================================
+// Quantized VertexPNT of a packed mesh, see packed_vertex. The effects
+// decode it with the per-draw gDequant constants of PackedVertex.fx.
+struct VertexPackedPNT
+{
+	short pos[4];
+	short normal[2];
+	short tex0[2];
+
+	static IDirect3DVertexDeclaration9* Decl;
+};
+
 //=====================================================================
 struct VertexPT
 {
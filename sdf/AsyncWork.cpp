@@ -1,4 +1,5 @@
 #include "AsyncWork.h"
+#include "MathUtil.h"
 
 
 void FQueuedThreadPool::DoAllWork()
@@ -37,4 +38,89 @@ void FQueuedThreadPool::AddWork(IQueuedWork* work)
 {
 	if (work)
 		workQueue.push_back(work);
-}
\ No newline at end of file
+}
+
+FPersistentThreadPool::FPersistentThreadPool(int32 NumThreads)
+	: bStopping(false)
+{
+	for (int32 ThreadIndex = 0; ThreadIndex < FMath::Max(NumThreads, 1); ThreadIndex++)
+	{
+		Threads.push_back(std::thread(&FPersistentThreadPool::WorkerLoop, this));
+	}
+}
+
+FPersistentThreadPool::~FPersistentThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		bStopping = true;
+	}
+	Condition.notify_all();
+	for (uint32 ThreadIndex = 0; ThreadIndex < Threads.size(); ThreadIndex++)
+	{
+		Threads[ThreadIndex].join();
+	}
+}
+
+void FPersistentThreadPool::AddQueuedWork(IQueuedWork* Work)
+{
+	if (!Work)
+		return;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Queue.push_back(Work);
+	}
+	Condition.notify_one();
+}
+
+bool FPersistentThreadPool::RetractQueuedWork(IQueuedWork* Work)
+{
+	std::lock_guard<std::mutex> Lock(Mutex);
+	for (std::deque<IQueuedWork*>::iterator It = Queue.begin(); It != Queue.end(); ++It)
+	{
+		if (*It == Work)
+		{
+			Queue.erase(It);
+			return true;
+		}
+	}
+	return false;
+}
+
+void FPersistentThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		IQueuedWork* Work;
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			while (!bStopping && Queue.empty())
+			{
+				Condition.wait(Lock);
+			}
+			if (Queue.empty())
+				return;
+			Work = Queue.front();
+			Queue.pop_front();
+		}
+		Work->DoThreadedWork();
+	}
+}
+
+namespace
+{
+	FPersistentThreadPool* GDistanceFieldThreadPool = NULL;
+	std::once_flag GDistanceFieldThreadPoolOnce;
+
+	void CreateDistanceFieldThreadPool()
+	{
+		GDistanceFieldThreadPool = new FPersistentThreadPool(FMath::Clamp((int32)std::thread::hardware_concurrency(), 1, MAXTHREADNUM));
+	}
+}
+
+FPersistentThreadPool& GetDistanceFieldThreadPool()
+{
+	// Bakes can start from any loader thread, and function statics are not thread safe on every compiler we build with
+	std::call_once(GDistanceFieldThreadPoolOnce, CreateDistanceFieldThreadPool);
+	return *GDistanceFieldThreadPool;
+}
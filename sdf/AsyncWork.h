@@ -1,6 +1,9 @@
 #ifndef _ASYNCWORK
 #define _ASYNCWORK
 #include "Config.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <thread>
 #define  MAXTHREADNUM  16
 class IQueuedWork
@@ -146,4 +149,44 @@ private:
 	TArray<IQueuedWork *> workQueue;
 };
 
+/**
+* Worker threads that stay alive and run queued work in the order it was added.
+* However much work is queued, at most GetNumThreads items run at once; work that has to wait for
+* other work should queue a continuation instead of blocking a worker.
+*/
+class FPersistentThreadPool
+{
+public:
+	explicit FPersistentThreadPool(int32 NumThreads);
+
+	/** Runs what is still queued, then stops the threads. */
+	~FPersistentThreadPool();
+
+	/** Work must stay alive until its DoThreadedWork returned, the pool does not touch it afterwards. */
+	void AddQueuedWork(IQueuedWork* Work);
+
+	/** Removes Work if no thread has picked it up yet and returns true, otherwise it runs or already ran. */
+	bool RetractQueuedWork(IQueuedWork* Work);
+
+	int32 GetNumThreads() const
+	{
+		return Threads.size();
+	}
+
+private:
+	FPersistentThreadPool(const FPersistentThreadPool&);
+	FPersistentThreadPool& operator=(const FPersistentThreadPool&);
+
+	void WorkerLoop();
+
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	std::deque<IQueuedWork*> Queue;
+	bool bStopping;
+	TArray<std::thread> Threads;
+};
+
+/** The pool background distance field work shares, one thread per core up to MAXTHREADNUM, created on first use. */
+FPersistentThreadPool& GetDistanceFieldThreadPool();
+
 #endif // !_ASYNCWORK
@@ -3,6 +3,9 @@
 #define _HALF
 #define MS_ALIGN(n) __declspec(align(n))
 
+// Lets the math headers define their constants and be included from several translation units.
+#define SELECTANY __declspec(selectany)
+
 #define FORCEINLINE __forceinline
 
 #define RESTRICT __restrict
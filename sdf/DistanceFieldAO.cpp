@@ -0,0 +1,399 @@
+#include "DistanceFieldAO.h"
+#include "DistanceFieldSampler.h"
+#include "AsyncWork.h"
+#include <atomic>
+
+namespace
+{
+	/** Polar angle of the ring of cones around the one along the normal. */
+	const float ConeRingAngle = PI / 3;
+
+	const float ConeHalfAngle = PI / 6;
+
+	/** First sample distance as a fraction of MaxDistance. */
+	const float FirstStepFraction = 0.05f;
+
+	/** Everything a trace needs, computed once per call. */
+	struct FDistanceFieldAOContext
+	{
+		const FDistanceFieldAOSettings* Settings;
+		const FDistanceFieldAOObject* Objects;
+		int32 NumObjects;
+
+		FVector ConeDirections[DISTANCEFIELD_AO_CONES];
+		float ConeWeights[DISTANCEFIELD_AO_CONES];
+		float StepDistances[DISTANCEFIELD_AO_STEPS];
+		float ConeTan;
+
+		/** Pixels further than this from an object's box can not be occluded by it. */
+		float CullDistance;
+
+		FDistanceFieldAOContext(const FDistanceFieldAOSettings& InSettings, const FDistanceFieldAOObject* InObjects, int32 InNumObjects)
+			: Settings(&InSettings)
+			, Objects(InObjects)
+			, NumObjects(InNumObjects)
+		{
+			GetDistanceFieldAOCones(ConeDirections, ConeWeights);
+			GetDistanceFieldAOStepDistances(InSettings, StepDistances);
+			ConeTan = GetDistanceFieldAOConeTan();
+			CullDistance = InSettings.MaxDistance * (1 + ConeTan);
+		}
+
+		float Trace(const FVector& WorldPosition, const FVector& WorldNormal, int32& NumSamples) const
+		{
+			FVector Tangent;
+			FVector Bitangent;
+			GetDistanceFieldAOTangentBasis(WorldNormal, Tangent, Bitangent);
+
+			FVector WorldDirections[DISTANCEFIELD_AO_CONES];
+			for (int32 ConeIndex = 0; ConeIndex < DISTANCEFIELD_AO_CONES; ConeIndex++)
+			{
+				const FVector& Direction = ConeDirections[ConeIndex];
+				WorldDirections[ConeIndex] = Tangent * Direction.X + Bitangent * Direction.Y + WorldNormal * Direction.Z;
+			}
+			const FVector Origin = WorldPosition + WorldNormal * Settings->SurfaceBias;
+
+			VectorRegister Visibility[2] = { VectorOne(), VectorOne() };
+			for (int32 ObjectIndex = 0; ObjectIndex < NumObjects; ObjectIndex++)
+			{
+				const FDistanceFieldAOObject& Object = Objects[ObjectIndex];
+				if (!Object.Sampler->IsValid())
+				{
+					continue;
+				}
+
+				const FDistanceFieldTransform& Transform = Object.Transform;
+				const FVector LocalPosition = Transform.InverseTransformPosition(WorldPosition);
+				if (FMath::Sqrt(Object.Sampler->GetBox().ComputeSquaredDistanceToPoint(LocalPosition)) * Transform.Scale > CullDistance)
+				{
+					continue;
+				}
+
+				// Cones in structure of arrays, four per register
+				const FVector LocalOrigin = Transform.InverseTransformPosition(Origin);
+				VectorRegister LocalDirections[2][3];
+				for (int32 Group = 0; Group < 2; Group++)
+				{
+					MS_ALIGN(16) float Components[3][4];
+					for (int32 Lane = 0; Lane < 4; Lane++)
+					{
+						const FVector LocalDirection = Transform.InverseTransformVector(WorldDirections[Group * 4 + Lane]);
+						Components[0][Lane] = LocalDirection.X;
+						Components[1][Lane] = LocalDirection.Y;
+						Components[2][Lane] = LocalDirection.Z;
+					}
+					for (int32 Axis = 0; Axis < 3; Axis++)
+					{
+						LocalDirections[Group][Axis] = VectorLoadAligned(Components[Axis]);
+					}
+				}
+
+				for (int32 StepIndex = 0; StepIndex < DISTANCEFIELD_AO_STEPS; StepIndex++)
+				{
+					const float StepDistance = StepDistances[StepIndex];
+					const VectorRegister Distance = VectorSetFloat1(StepDistance);
+					const VectorRegister DistanceToVisibility = VectorSetFloat1(Transform.Scale / (StepDistance * ConeTan));
+					for (int32 Group = 0; Group < 2; Group++)
+					{
+						const VectorRegister SamplePosition[3] = {
+							VectorMultiplyAdd(LocalDirections[Group][0], Distance, VectorSetFloat1(LocalOrigin.X)),
+							VectorMultiplyAdd(LocalDirections[Group][1], Distance, VectorSetFloat1(LocalOrigin.Y)),
+							VectorMultiplyAdd(LocalDirections[Group][2], Distance, VectorSetFloat1(LocalOrigin.Z)) };
+						const VectorRegister SampleVisibility = VectorMultiply(Object.Sampler->Sample4(SamplePosition), DistanceToVisibility);
+						Visibility[Group] = VectorMin(Visibility[Group], VectorMax(SampleVisibility, VectorZero()));
+					}
+				}
+				NumSamples += DISTANCEFIELD_AO_CONES * DISTANCEFIELD_AO_STEPS;
+			}
+
+			MS_ALIGN(16) float ConeVisibility[DISTANCEFIELD_AO_CONES];
+			VectorStoreAligned(Visibility[0], ConeVisibility);
+			VectorStoreAligned(Visibility[1], ConeVisibility + 4);
+			float Result = 0;
+			for (int32 ConeIndex = 0; ConeIndex < DISTANCEFIELD_AO_CONES; ConeIndex++)
+			{
+				Result += ConeVisibility[ConeIndex] * ConeWeights[ConeIndex];
+			}
+			return Result;
+		}
+	};
+
+	/** Weight of a low resolution sample for a full resolution pixel, without the bilinear term. */
+	FORCEINLINE float GetUpsampleWeight(const FDistanceFieldAOSettings& Settings, float Depth, const FVector& Normal, float SampleDepth, const FVector& SampleNormal)
+	{
+		const float DepthWeight = FMath::Max(1.0f - FMath::Abs(SampleDepth - Depth) / (Depth * Settings.DepthThreshold), 0.0f);
+		const float NormalWeight = FMath::Pow(FMath::Max(FVector::DotProduct(Normal, SampleNormal), 0.0f), Settings.NormalPower);
+		return DepthWeight * NormalWeight;
+	}
+}
+
+/** Traces or upsamples rows, pulled from a shared counter until none are left. */
+class FDistanceFieldAOTask
+{
+public:
+	FDistanceFieldAOTask(
+		const FDistanceFieldAOContext* InContext,
+		const FDistanceFieldShadowView* InView,
+		const float* InDepthBuffer,
+		const FVector* InNormalBuffer,
+		FIntVector InBufferSize,
+		const FDistanceFieldAOBuffer* InSourceBuffer,
+		FDistanceFieldAOBuffer* InOutBuffer,
+		float* InOutVisibility,
+		std::atomic<int32>* InNextRow)
+		: Context(InContext)
+		, View(InView)
+		, DepthBuffer(InDepthBuffer)
+		, NormalBuffer(InNormalBuffer)
+		, BufferSize(InBufferSize)
+		, SourceBuffer(InSourceBuffer)
+		, OutBuffer(InOutBuffer)
+		, OutVisibility(InOutVisibility)
+		, NextRow(InNextRow)
+		, NumTracedPixels(0)
+		, NumSamples(0)
+	{}
+
+	void DoWork()
+	{
+		if (OutVisibility)
+		{
+			for (int32 Y = (*NextRow)++; Y < BufferSize.Y; Y = (*NextRow)++)
+			{
+				UpsampleRow(Y);
+			}
+		}
+		else
+		{
+			for (int32 Y = (*NextRow)++; Y < OutBuffer->Height; Y = (*NextRow)++)
+			{
+				TraceRow(Y);
+			}
+		}
+	}
+
+	int32 NumTracedPixels;
+	int32 NumSamples;
+
+private:
+	void TraceRow(int32 Y)
+	{
+		const int32 Downsample = Context->Settings->Downsample;
+		const int32 SourceY = FMath::Min(Y * Downsample + Downsample / 2, BufferSize.Y - 1);
+		for (int32 X = 0; X < OutBuffer->Width; X++)
+		{
+			const int32 SourceX = FMath::Min(X * Downsample + Downsample / 2, BufferSize.X - 1);
+			const int32 SourceIndex = SourceY * BufferSize.X + SourceX;
+			const int32 Index = Y * OutBuffer->Width + X;
+			const float Depth = DepthBuffer[SourceIndex];
+			OutBuffer->Depth[Index] = Depth;
+			OutBuffer->Normals[Index] = NormalBuffer[SourceIndex];
+			OutBuffer->Visibility[Index] = 1.0f;
+
+			// Sky
+			if (Depth >= 1.0f)
+			{
+				continue;
+			}
+
+			const FVector WorldPosition = GetDistanceFieldShadowWorldPosition(*View, SourceX, SourceY, BufferSize.X, BufferSize.Y, Depth);
+			OutBuffer->Visibility[Index] = Context->Trace(WorldPosition, NormalBuffer[SourceIndex], NumSamples);
+			NumTracedPixels++;
+		}
+	}
+
+	void UpsampleRow(int32 Y)
+	{
+		const FDistanceFieldAOSettings& Settings = *Context->Settings;
+		const int32 Downsample = Settings.Downsample;
+
+		// Low resolution texel I was traced at full resolution pixel I * Downsample + Downsample / 2
+		const float LowY = (float)(Y - Downsample / 2) / Downsample;
+		const int32 Y0 = FMath::Clamp(FMath::FloorToInt(LowY), 0, SourceBuffer->Height - 1);
+		const int32 Y1 = FMath::Min(Y0 + 1, SourceBuffer->Height - 1);
+		const float FracY = FMath::Clamp(LowY - Y0, 0.0f, 1.0f);
+
+		for (int32 X = 0; X < BufferSize.X; X++)
+		{
+			const float LowX = (float)(X - Downsample / 2) / Downsample;
+			const int32 X0 = FMath::Clamp(FMath::FloorToInt(LowX), 0, SourceBuffer->Width - 1);
+			const int32 X1 = FMath::Min(X0 + 1, SourceBuffer->Width - 1);
+			const float FracX = FMath::Clamp(LowX - X0, 0.0f, 1.0f);
+
+			const int32 Index = Y * BufferSize.X + X;
+			const float Depth = DepthBuffer[Index];
+			const FVector& Normal = NormalBuffer[Index];
+			const int32 SampleIndices[4] = { Y0 * SourceBuffer->Width + X0, Y0 * SourceBuffer->Width + X1, Y1 * SourceBuffer->Width + X0, Y1 * SourceBuffer->Width + X1 };
+			const float BilinearWeights[4] = { (1 - FracX) * (1 - FracY), FracX * (1 - FracY), (1 - FracX) * FracY, FracX * FracY };
+
+			float TotalWeight = 0;
+			float Total = 0;
+			int32 ClosestSample = SampleIndices[0];
+			for (int32 SampleIndex = 0; SampleIndex < 4; SampleIndex++)
+			{
+				const int32 LowIndex = SampleIndices[SampleIndex];
+				const float Weight = BilinearWeights[SampleIndex] * GetUpsampleWeight(Settings, Depth, Normal, SourceBuffer->Depth[LowIndex], SourceBuffer->Normals[LowIndex]);
+				TotalWeight += Weight;
+				Total += Weight * SourceBuffer->Visibility[LowIndex];
+				if (FMath::Abs(SourceBuffer->Depth[LowIndex] - Depth) < FMath::Abs(SourceBuffer->Depth[ClosestSample] - Depth))
+				{
+					ClosestSample = LowIndex;
+				}
+			}
+
+			// No similar sample, e.g. a thin object only seen at full resolution
+			OutVisibility[Index] = TotalWeight > 1e-4f ? Total / TotalWeight : SourceBuffer->Visibility[ClosestSample];
+		}
+	}
+
+	const FDistanceFieldAOContext* Context;
+	const FDistanceFieldShadowView* View;
+	const float* DepthBuffer;
+	const FVector* NormalBuffer;
+	FIntVector BufferSize;
+	const FDistanceFieldAOBuffer* SourceBuffer;
+	FDistanceFieldAOBuffer* OutBuffer;
+	float* OutVisibility;
+	std::atomic<int32>* NextRow;
+};
+
+namespace
+{
+	void RunDistanceFieldAOTasks(
+		const FDistanceFieldAOContext& Context,
+		const FDistanceFieldShadowView* View,
+		const float* DepthBuffer,
+		const FVector* NormalBuffer,
+		int32 Width,
+		int32 Height,
+		const FDistanceFieldAOBuffer* SourceBuffer,
+		FDistanceFieldAOBuffer* OutBuffer,
+		float* OutVisibility,
+		FDistanceFieldAOStats* OutStats)
+	{
+		std::atomic<int32> NextRow(0);
+		const int32 NumWorkers = FMath::Clamp((int32)std::thread::hardware_concurrency(), 1, MAXTHREADNUM);
+		FQueuedThreadPool ThreadPool;
+		TArray<FAsyncTask<FDistanceFieldAOTask>*> AsyncTasks;
+
+		for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+		{
+			FAsyncTask<FDistanceFieldAOTask>* Task = new FAsyncTask<FDistanceFieldAOTask>(
+				&Context,
+				View,
+				DepthBuffer,
+				NormalBuffer,
+				FIntVector(Width, Height, 1),
+				SourceBuffer,
+				OutBuffer,
+				OutVisibility,
+				&NextRow);
+
+			ThreadPool.AddWork(Task);
+			AsyncTasks.push_back(Task);
+		}
+		ThreadPool.DoAllWork();
+
+		FDistanceFieldAOStats Stats;
+		for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+		{
+			Stats.NumTracedPixels += AsyncTasks[TaskIndex]->GetTask().NumTracedPixels;
+			Stats.NumSamples += AsyncTasks[TaskIndex]->GetTask().NumSamples;
+			delete AsyncTasks[TaskIndex];
+		}
+
+		if (OutStats)
+		{
+			*OutStats = Stats;
+		}
+	}
+}
+
+void GetDistanceFieldAOCones(FVector OutDirections[DISTANCEFIELD_AO_CONES], float OutWeights[DISTANCEFIELD_AO_CONES])
+{
+	// One cone along the normal and a ring around it, weighted by the cosine of their axes
+	const int32 NumRingCones = DISTANCEFIELD_AO_CONES - 1;
+	const float RingWeight = FMath::Cos(ConeRingAngle);
+	const float TotalWeight = 1 + NumRingCones * RingWeight;
+
+	OutDirections[0] = FVector(0, 0, 1);
+	OutWeights[0] = 1 / TotalWeight;
+	for (int32 ConeIndex = 0; ConeIndex < NumRingCones; ConeIndex++)
+	{
+		const float Azimuth = 2 * PI * ConeIndex / NumRingCones;
+		OutDirections[ConeIndex + 1] = FVector(
+			FMath::Sin(ConeRingAngle) * FMath::Cos(Azimuth),
+			FMath::Sin(ConeRingAngle) * FMath::Sin(Azimuth),
+			FMath::Cos(ConeRingAngle));
+		OutWeights[ConeIndex + 1] = RingWeight / TotalWeight;
+	}
+}
+
+float GetDistanceFieldAOConeTan()
+{
+	return FMath::Tan(ConeHalfAngle);
+}
+
+void GetDistanceFieldAOStepDistances(const FDistanceFieldAOSettings& Settings, float OutDistances[DISTANCEFIELD_AO_STEPS])
+{
+	const float FirstDistance = Settings.MaxDistance * FirstStepFraction;
+	for (int32 StepIndex = 0; StepIndex < DISTANCEFIELD_AO_STEPS; StepIndex++)
+	{
+		OutDistances[StepIndex] = FirstDistance * FMath::Pow(1 / FirstStepFraction, (float)StepIndex / (DISTANCEFIELD_AO_STEPS - 1));
+	}
+}
+
+void GetDistanceFieldAOTangentBasis(const FVector& Normal, FVector& OutTangent, FVector& OutBitangent)
+{
+	const FVector Up = FMath::Abs(Normal.Z) < .999f ? FVector(0, 0, 1) : FVector(1, 0, 0);
+	OutTangent = FVector::CrossProduct(Up, Normal).GetSafeNormal();
+	OutBitangent = FVector::CrossProduct(Normal, OutTangent);
+}
+
+float ComputeDistanceFieldAOAtPosition(
+	const FDistanceFieldAOSettings& Settings
+	, const FDistanceFieldAOObject* Objects
+	, int32 NumObjects
+	, const FVector& WorldPosition
+	, const FVector& WorldNormal)
+{
+	const FDistanceFieldAOContext Context(Settings, Objects, NumObjects);
+	int32 NumSamples = 0;
+	return Context.Trace(WorldPosition, WorldNormal, NumSamples);
+}
+
+void ComputeDistanceFieldAO(
+	const FDistanceFieldShadowView& View
+	, const FDistanceFieldAOSettings& Settings
+	, const FDistanceFieldAOObject* Objects
+	, int32 NumObjects
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, FDistanceFieldAOBuffer& OutBuffer
+	, FDistanceFieldAOStats* OutStats)
+{
+	OutBuffer.Width = FMath::DivideAndRoundUp(Width, Settings.Downsample);
+	OutBuffer.Height = FMath::DivideAndRoundUp(Height, Settings.Downsample);
+	const int32 NumTexels = OutBuffer.Width * OutBuffer.Height;
+	OutBuffer.Visibility.resize(NumTexels);
+	OutBuffer.Depth.resize(NumTexels);
+	OutBuffer.Normals.resize(NumTexels);
+
+	const FDistanceFieldAOContext Context(Settings, Objects, NumObjects);
+	RunDistanceFieldAOTasks(Context, &View, DepthBuffer, NormalBuffer, Width, Height, NULL, &OutBuffer, NULL, OutStats);
+}
+
+void UpsampleDistanceFieldAO(
+	const FDistanceFieldAOSettings& Settings
+	, const FDistanceFieldAOBuffer& Buffer
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, float* OutVisibility)
+{
+	const FDistanceFieldAOContext Context(Settings, NULL, 0);
+	RunDistanceFieldAOTasks(Context, NULL, DepthBuffer, NormalBuffer, Width, Height, &Buffer, NULL, OutVisibility, NULL);
+}
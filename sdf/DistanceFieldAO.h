@@ -0,0 +1,125 @@
+#ifndef _DISTANCEFIELDAO
+#define _DISTANCEFIELDAO
+#include "Config.h"
+#include "Vector.h"
+#include "DistanceFieldShadow.h"
+#include "DistanceFieldCollision.h"
+
+/** Cones traced per pixel, FX/DistanceFieldAO.fx keeps one per channel of two render targets. */
+#define DISTANCEFIELD_AO_CONES 8
+
+/** Samples along each cone, spaced geometrically up to MaxDistance. */
+#define DISTANCEFIELD_AO_STEPS 10
+
+/** Parameters shared by the CPU reference and the shader path. */
+struct FDistanceFieldAOSettings
+{
+	/** World space distance occluders are searched within. */
+	float MaxDistance;
+
+	/** Cones start this far off the surface along its normal, so surfaces do not occlude themselves. */
+	float SurfaceBias;
+
+	/** AO is traced at 1 / Downsample of the buffer resolution in each axis. */
+	int32 Downsample;
+
+	/** Relative view depth difference at which the upsample weight of a low resolution sample reaches 0. */
+	float DepthThreshold;
+
+	/** Exponent on the normal similarity in the upsample weights. */
+	float NormalPower;
+
+	FDistanceFieldAOSettings()
+		: MaxDistance(10.0f)
+		, SurfaceBias(0.5f)
+		, Downsample(2)
+		, DepthThreshold(0.05f)
+		, NormalPower(8.0f)
+	{}
+};
+
+/** A volume placed in the world. */
+struct FDistanceFieldAOObject
+{
+	const FDistanceFieldSampler* Sampler;
+	FDistanceFieldTransform Transform;
+};
+
+/** Reduced resolution result, with the depth and normal of the pixel each texel was traced for. */
+struct FDistanceFieldAOBuffer
+{
+	int32 Width;
+	int32 Height;
+
+	/** 1 is unoccluded. */
+	TArray<float> Visibility;
+	TArray<float> Depth;
+	TArray<FVector> Normals;
+};
+
+struct FDistanceFieldAOStats
+{
+	int32 NumTracedPixels;
+
+	/** Object samples taken, cones of an object that can not occlude are not counted. */
+	int32 NumSamples;
+
+	FDistanceFieldAOStats()
+		: NumTracedPixels(0)
+		, NumSamples(0)
+	{}
+};
+
+/**
+* Cone axes in the tangent frame of GetDistanceFieldAOTangentBasis, Z along the normal,
+* and their cosine weights, which sum to 1.
+*/
+void GetDistanceFieldAOCones(FVector OutDirections[DISTANCEFIELD_AO_CONES], float OutWeights[DISTANCEFIELD_AO_CONES]);
+
+/** Tangent of the cones' half angle. */
+float GetDistanceFieldAOConeTan();
+
+/** Distances of the samples along each cone. */
+void GetDistanceFieldAOStepDistances(const FDistanceFieldAOSettings& Settings, float OutDistances[DISTANCEFIELD_AO_STEPS]);
+
+void GetDistanceFieldAOTangentBasis(const FVector& Normal, FVector& OutTangent, FVector& OutBitangent);
+
+/**
+* Visibility of one world position, the weighted mean of the cones' visibility.
+* A cone's visibility is the min over objects and samples of distance / cone radius at the sample,
+* which is the min over the union of the objects. The shader runs one pass per object and keeps the min per cone.
+*/
+float ComputeDistanceFieldAOAtPosition(
+	const FDistanceFieldAOSettings& Settings
+	, const FDistanceFieldAOObject* Objects
+	, int32 NumObjects
+	, const FVector& WorldPosition
+	, const FVector& WorldNormal);
+
+/**
+* Traces every Downsample-th pixel of a linear depth buffer (view depth / far clip) and a world normal buffer.
+* Rows of the reduced buffer are spread over worker threads, each sample evaluates the cones four at a time.
+*/
+void ComputeDistanceFieldAO(
+	const FDistanceFieldShadowView& View
+	, const FDistanceFieldAOSettings& Settings
+	, const FDistanceFieldAOObject* Objects
+	, int32 NumObjects
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, FDistanceFieldAOBuffer& OutBuffer
+	, FDistanceFieldAOStats* OutStats = NULL);
+
+/** Bilateral upsample of the reduced buffer to Width x Height, weighted by depth and normal similarity. */
+void UpsampleDistanceFieldAO(
+	const FDistanceFieldAOSettings& Settings
+	, const FDistanceFieldAOBuffer& Buffer
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, float* OutVisibility);
+
+#endif // !_DISTANCEFIELDAO
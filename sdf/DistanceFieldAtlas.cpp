@@ -0,0 +1,366 @@
+#include "DistanceFieldAtlas.h"
+#include "MeshUtilities.h"
+#include <algorithm>
+
+FTextureLayout3d::FTextureLayout3d(const FIntVector& InSize)
+	: Size(InSize)
+	, NumUsedTexels(0)
+{
+	AddNode(FIntVector(0, 0, 0), Size, INDEX_NONE);
+}
+
+int32 FTextureLayout3d::AddNode(const FIntVector& Min, const FIntVector& NodeSize, int32 Parent)
+{
+	FNode Node;
+	Node.Min = Min;
+	Node.Size = NodeSize;
+	Node.ChildA = INDEX_NONE;
+	Node.ChildB = INDEX_NONE;
+	Node.Parent = Parent;
+	Node.bUsed = false;
+
+	if (FreeNodes.size())
+	{
+		const int32 NodeIndex = FreeNodes.back();
+		FreeNodes.pop_back();
+		Nodes[NodeIndex] = Node;
+		return NodeIndex;
+	}
+	Nodes.push_back(Node);
+	return Nodes.size() - 1;
+}
+
+void FTextureLayout3d::FreeNode(int32 NodeIndex)
+{
+	FreeNodes.push_back(NodeIndex);
+}
+
+int32 FTextureLayout3d::FindFreeNode(int32 NodeIndex, const FIntVector& ElementSize) const
+{
+	const FNode& Node = Nodes[NodeIndex];
+	if (Node.Size.X < ElementSize.X || Node.Size.Y < ElementSize.Y || Node.Size.Z < ElementSize.Z)
+	{
+		return INDEX_NONE;
+	}
+
+	if (Node.IsLeaf())
+	{
+		return Node.bUsed ? INDEX_NONE : NodeIndex;
+	}
+
+	const int32 Found = FindFreeNode(Node.ChildA, ElementSize);
+	return Found != INDEX_NONE ? Found : FindFreeNode(Node.ChildB, ElementSize);
+}
+
+int32 FTextureLayout3d::FindUsedNode(int32 NodeIndex, const FIntVector& ElementMin, const FIntVector& ElementSize) const
+{
+	const FNode& Node = Nodes[NodeIndex];
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if (ElementMin(Axis) < Node.Min(Axis) || ElementMin(Axis) >= Node.Min(Axis) + Node.Size(Axis))
+		{
+			return INDEX_NONE;
+		}
+	}
+
+	if (Node.IsLeaf())
+	{
+		return Node.bUsed && Node.Min == ElementMin && Node.Size == ElementSize ? NodeIndex : INDEX_NONE;
+	}
+
+	const int32 Found = FindUsedNode(Node.ChildA, ElementMin, ElementSize);
+	return Found != INDEX_NONE ? Found : FindUsedNode(Node.ChildB, ElementMin, ElementSize);
+}
+
+bool FTextureLayout3d::AddElement(FIntVector& OutMin, const FIntVector& ElementSize)
+{
+	int32 NodeIndex = FindFreeNode(0, ElementSize);
+	if (NodeIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// Cut the free box along the axis with the most room left until the element fills it
+	for (;;)
+	{
+		const FNode Node = Nodes[NodeIndex];
+		int32 SplitAxis = INDEX_NONE;
+		int32 MaxLeft = 0;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const int32 Left = Node.Size(Axis) - ElementSize(Axis);
+			if (Left > MaxLeft)
+			{
+				MaxLeft = Left;
+				SplitAxis = Axis;
+			}
+		}
+
+		if (SplitAxis == INDEX_NONE)
+		{
+			break;
+		}
+
+		FIntVector SizeA = Node.Size;
+		FIntVector MinB = Node.Min;
+		FIntVector SizeB = Node.Size;
+		SizeA(SplitAxis) = ElementSize(SplitAxis);
+		MinB(SplitAxis) += ElementSize(SplitAxis);
+		SizeB(SplitAxis) -= ElementSize(SplitAxis);
+
+		const int32 ChildA = AddNode(Node.Min, SizeA, NodeIndex);
+		const int32 ChildB = AddNode(MinB, SizeB, NodeIndex);
+		Nodes[NodeIndex].ChildA = ChildA;
+		Nodes[NodeIndex].ChildB = ChildB;
+		NodeIndex = ChildA;
+	}
+
+	Nodes[NodeIndex].bUsed = true;
+	NumUsedTexels += ElementSize.X * ElementSize.Y * ElementSize.Z;
+	OutMin = Nodes[NodeIndex].Min;
+	return true;
+}
+
+bool FTextureLayout3d::RemoveElement(const FIntVector& ElementMin, const FIntVector& ElementSize)
+{
+	int32 NodeIndex = FindUsedNode(0, ElementMin, ElementSize);
+	if (NodeIndex == INDEX_NONE)
+	{
+		return false;
+	}
+
+	Nodes[NodeIndex].bUsed = false;
+	NumUsedTexels -= ElementSize.X * ElementSize.Y * ElementSize.Z;
+
+	// Merge free siblings back into their parent
+	for (int32 Parent = Nodes[NodeIndex].Parent; Parent != INDEX_NONE; Parent = Nodes[Parent].Parent)
+	{
+		const FNode& A = Nodes[Nodes[Parent].ChildA];
+		const FNode& B = Nodes[Nodes[Parent].ChildB];
+		if (!A.IsLeaf() || !B.IsLeaf() || A.bUsed || B.bUsed)
+		{
+			break;
+		}
+
+		FreeNode(Nodes[Parent].ChildA);
+		FreeNode(Nodes[Parent].ChildB);
+		Nodes[Parent].ChildA = INDEX_NONE;
+		Nodes[Parent].ChildB = INDEX_NONE;
+	}
+	return true;
+}
+
+FDistanceFieldAtlas::FDistanceFieldAtlas(const FIntVector& InPageSize, int32 InPadding)
+	: PageSize(InPageSize)
+	, Padding(InPadding)
+	, NumMoved(0)
+{
+}
+
+FDistanceFieldAtlas::~FDistanceFieldAtlas()
+{
+	for (uint32 PageIndex = 0; PageIndex < Pages.size(); PageIndex++)
+	{
+		delete Pages[PageIndex];
+	}
+}
+
+bool FDistanceFieldAtlas::Place(const FIntVector& PaddedSize, int32& OutPage, FIntVector& OutMin)
+{
+	if (PaddedSize.X > PageSize.X || PaddedSize.Y > PageSize.Y || PaddedSize.Z > PageSize.Z)
+	{
+		return false;
+	}
+
+	for (uint32 PageIndex = 0; PageIndex < Pages.size(); PageIndex++)
+	{
+		if (Pages[PageIndex]->Layout.AddElement(OutMin, PaddedSize))
+		{
+			OutPage = PageIndex;
+			return true;
+		}
+	}
+
+	Pages.push_back(new FPage(PageSize));
+	OutPage = Pages.size() - 1;
+	return Pages.back()->Layout.AddElement(OutMin, PaddedSize);
+}
+
+template<typename GetVoxelType>
+void FDistanceFieldAtlas::WriteVolume(int32 Page, const FIntVector& Min, const FIntVector& Size, GetVoxelType GetVoxel)
+{
+	SDFFloat* Voxels = Pages[Page]->Voxels.data();
+	for (int32 Z = -Padding; Z < Size.Z + Padding; Z++)
+	{
+		const int32 SourceZ = FMath::Clamp(Z, 0, Size.Z - 1);
+		for (int32 Y = -Padding; Y < Size.Y + Padding; Y++)
+		{
+			const int32 SourceY = FMath::Clamp(Y, 0, Size.Y - 1);
+			SDFFloat* Row = Voxels + ((Min.Z + Z) * PageSize.Y + Min.Y + Y) * PageSize.X + Min.X;
+			for (int32 X = -Padding; X < Size.X + Padding; X++)
+			{
+				Row[X] = GetVoxel(FMath::Clamp(X, 0, Size.X - 1), SourceY, SourceZ);
+			}
+		}
+	}
+
+	FDistanceFieldAtlasUpdate Update;
+	Update.Page = Page;
+	Update.Min = Min - FIntVector(Padding, Padding, Padding);
+	Update.Size = Size + FIntVector(Padding, Padding, Padding) * 2;
+	PendingUpdates.push_back(Update);
+}
+
+int32 FDistanceFieldAtlas::Allocate(const FDistanceFieldVolumeData& Volume)
+{
+	const SDFFloat* Data;
+	TArray<SDFFloat> Scratch;
+	const FIntVector Size = Volume.Size;
+	if (!Volume.GetDistanceFieldVolumeData(Data, Scratch) || Size.X * Size.Y * Size.Z == 0)
+	{
+		return INDEX_NONE;
+	}
+
+	FDistanceFieldAtlasAllocation Allocation;
+	if (!Place(Size + FIntVector(Padding, Padding, Padding) * 2, Allocation.Page, Allocation.Min))
+	{
+		return INDEX_NONE;
+	}
+	Allocation.Min = Allocation.Min + FIntVector(Padding, Padding, Padding);
+	Allocation.Size = Size;
+	Allocation.bAllocated = true;
+
+	WriteVolume(Allocation.Page, Allocation.Min, Size, [Data, &Size](int32 X, int32 Y, int32 Z)
+	{
+		return Data[(Z * Size.Y + Y) * Size.X + X];
+	});
+
+	int32 AllocationId = 0;
+	while (AllocationId < (int32)Allocations.size() && Allocations[AllocationId].bAllocated)
+	{
+		AllocationId++;
+	}
+	if (AllocationId == Allocations.size())
+	{
+		Allocations.push_back(Allocation);
+		DistanceScales.push_back(0);
+	}
+	Allocations[AllocationId] = Allocation;
+	DistanceScales[AllocationId] = Volume.LocalBoundingBox.GetExtent().GetMax();
+	return AllocationId;
+}
+
+void FDistanceFieldAtlas::Free(int32 AllocationId)
+{
+	FDistanceFieldAtlasAllocation& Allocation = Allocations[AllocationId];
+	if (Allocation.bAllocated)
+	{
+		Pages[Allocation.Page]->Layout.RemoveElement(
+			Allocation.Min - FIntVector(Padding, Padding, Padding),
+			Allocation.Size + FIntVector(Padding, Padding, Padding) * 2);
+		Allocation.bAllocated = false;
+	}
+}
+
+void FDistanceFieldAtlas::Defragment()
+{
+	TArray<int32> Live;
+	for (uint32 AllocationId = 0; AllocationId < Allocations.size(); AllocationId++)
+	{
+		if (Allocations[AllocationId].bAllocated)
+		{
+			Live.push_back(AllocationId);
+		}
+	}
+
+	// Largest first leaves the small ones to fill the gaps
+	std::sort(Live.begin(), Live.end(), [this](int32 A, int32 B)
+	{
+		const FIntVector& SizeA = Allocations[A].Size;
+		const FIntVector& SizeB = Allocations[B].Size;
+		const int32 VolumeA = SizeA.X * SizeA.Y * SizeA.Z;
+		const int32 VolumeB = SizeB.X * SizeB.Y * SizeB.Z;
+		return VolumeA != VolumeB ? VolumeA > VolumeB : A < B;
+	});
+
+	TArray<FPage*> OldPages;
+	OldPages.swap(Pages);
+	NumMoved = 0;
+	for (uint32 LiveIndex = 0; LiveIndex < Live.size(); LiveIndex++)
+	{
+		FDistanceFieldAtlasAllocation& Allocation = Allocations[Live[LiveIndex]];
+		const FDistanceFieldAtlasAllocation OldAllocation = Allocation;
+		Place(Allocation.Size + FIntVector(Padding, Padding, Padding) * 2, Allocation.Page, Allocation.Min);
+		Allocation.Min = Allocation.Min + FIntVector(Padding, Padding, Padding);
+
+		const SDFFloat* OldVoxels = OldPages[OldAllocation.Page]->Voxels.data();
+		const FIntVector& OldMin = OldAllocation.Min;
+		const FIntVector& OldPageSize = PageSize;
+		WriteVolume(Allocation.Page, Allocation.Min, Allocation.Size, [OldVoxels, &OldMin, &OldPageSize](int32 X, int32 Y, int32 Z)
+		{
+			return OldVoxels[((OldMin.Z + Z) * OldPageSize.Y + OldMin.Y + Y) * OldPageSize.X + OldMin.X + X];
+		});
+		NumMoved += Allocation.Page != OldAllocation.Page || !(Allocation.Min == OldAllocation.Min) ? 1 : 0;
+	}
+
+	for (uint32 PageIndex = 0; PageIndex < OldPages.size(); PageIndex++)
+	{
+		delete OldPages[PageIndex];
+	}
+
+	// The pages are new textures, upload them whole
+	PendingUpdates.clear();
+	for (uint32 PageIndex = 0; PageIndex < Pages.size(); PageIndex++)
+	{
+		FDistanceFieldAtlasUpdate Update;
+		Update.Page = PageIndex;
+		Update.Min = FIntVector(0, 0, 0);
+		Update.Size = PageSize;
+		PendingUpdates.push_back(Update);
+	}
+}
+
+FDistanceFieldAtlasUVW FDistanceFieldAtlas::GetUVW(int32 AllocationId) const
+{
+	// Texel centres of the volume, (I + .5) / Size, land on (Min + I + .5) / PageSize
+	const FDistanceFieldAtlasAllocation& Allocation = Allocations[AllocationId];
+	const FVector InvPageSize = FVector(1.0f) / FVector((float)PageSize.X, (float)PageSize.Y, (float)PageSize.Z);
+	FDistanceFieldAtlasUVW UVW;
+	UVW.Scale = FVector((float)Allocation.Size.X, (float)Allocation.Size.Y, (float)Allocation.Size.Z) * InvPageSize;
+	UVW.Bias = FVector((float)Allocation.Min.X, (float)Allocation.Min.Y, (float)Allocation.Min.Z) * InvPageSize;
+	UVW.Page = Allocation.Page;
+	UVW.DistanceScale = DistanceScales[AllocationId];
+	return UVW;
+}
+
+void FDistanceFieldAtlas::BuildUVWTable(const int32* AllocationIds, int32 NumAllocationIds, TArray<FDistanceFieldAtlasUVW>& OutTable) const
+{
+	OutTable.resize(NumAllocationIds);
+	for (int32 Index = 0; Index < NumAllocationIds; Index++)
+	{
+		OutTable[Index] = GetUVW(AllocationIds[Index]);
+	}
+}
+
+void FDistanceFieldAtlas::ConsumeUpdates(TArray<FDistanceFieldAtlasUpdate>& OutUpdates)
+{
+	OutUpdates.swap(PendingUpdates);
+	PendingUpdates.clear();
+}
+
+FDistanceFieldAtlasStats FDistanceFieldAtlas::GetStats() const
+{
+	FDistanceFieldAtlasStats Stats;
+	for (uint32 AllocationId = 0; AllocationId < Allocations.size(); AllocationId++)
+	{
+		Stats.NumAllocations += Allocations[AllocationId].bAllocated ? 1 : 0;
+	}
+	Stats.NumPages = Pages.size();
+	for (uint32 PageIndex = 0; PageIndex < Pages.size(); PageIndex++)
+	{
+		Stats.NumUsedVoxels += Pages[PageIndex]->Layout.GetNumUsedTexels();
+	}
+	Stats.NumPageVoxels = (SIZE_t)Pages.size() * PageSize.X * PageSize.Y * PageSize.Z;
+	Stats.NumMoved = NumMoved;
+	return Stats;
+}
@@ -0,0 +1,209 @@
+#ifndef _DISTANCEFIELDATLAS
+#define _DISTANCEFIELDATLAS
+#include "Config.h"
+#include "IntVector.h"
+#include "Vector.h"
+
+class FDistanceFieldVolumeData;
+
+/**
+* Packs boxes into a volume, a kd tree where every split cuts a free box along one axis.
+* Freed boxes merge back with their free sibling.
+*/
+class FTextureLayout3d
+{
+public:
+	explicit FTextureLayout3d(const FIntVector& InSize);
+
+	/** Returns false when no free box is large enough. */
+	bool AddElement(FIntVector& OutMin, const FIntVector& ElementSize);
+
+	/** Frees a box returned by AddElement, false if there is no such element. */
+	bool RemoveElement(const FIntVector& ElementMin, const FIntVector& ElementSize);
+
+	const FIntVector& GetSize() const
+	{
+		return Size;
+	}
+
+	int32 GetNumUsedTexels() const
+	{
+		return NumUsedTexels;
+	}
+
+private:
+	struct FNode
+	{
+		FIntVector Min;
+		FIntVector Size;
+		int32 ChildA;
+		int32 ChildB;
+		int32 Parent;
+		bool bUsed;
+
+		bool IsLeaf() const
+		{
+			return ChildA == INDEX_NONE;
+		}
+	};
+
+	int32 AddNode(const FIntVector& Min, const FIntVector& Size, int32 Parent);
+	void FreeNode(int32 NodeIndex);
+	int32 FindFreeNode(int32 NodeIndex, const FIntVector& ElementSize) const;
+	int32 FindUsedNode(int32 NodeIndex, const FIntVector& ElementMin, const FIntVector& ElementSize) const;
+
+	FIntVector Size;
+	int32 NumUsedTexels;
+	TArray<FNode> Nodes;
+	TArray<int32> FreeNodes;
+};
+
+/** Where a volume lives in the atlas. */
+struct FDistanceFieldAtlasAllocation
+{
+	int32 Page;
+
+	/** First voxel of the volume in the page, the padding is in front of it. */
+	FIntVector Min;
+
+	/** Voxels of the volume, without padding. */
+	FIntVector Size;
+
+	/** False once freed, the slot is reused by the next Allocate. */
+	bool bAllocated;
+};
+
+/**
+* Maps a volume's UVW in [0, 1] into its page: AtlasUVW = UVW * Scale + Bias.
+* Page is the atlas texture to bind, DistanceScale what the volume's values are multiplied by.
+*/
+struct FDistanceFieldAtlasUVW
+{
+	FVector Scale;
+	FVector Bias;
+	int32 Page;
+	float DistanceScale;
+};
+
+/** Region of a page that changed since the last ConsumeUpdates, to upload with LockBox. */
+struct FDistanceFieldAtlasUpdate
+{
+	int32 Page;
+	FIntVector Min;
+	FIntVector Size;
+};
+
+struct FDistanceFieldAtlasStats
+{
+	int32 NumAllocations;
+	int32 NumPages;
+
+	/** Voxels of the live allocations, padding included. */
+	SIZE_t NumUsedVoxels;
+
+	SIZE_t NumPageVoxels;
+
+	/** Allocations copied to a new place by the last Defragment. */
+	int32 NumMoved;
+
+	FDistanceFieldAtlasStats()
+		: NumAllocations(0)
+		, NumPages(0)
+		, NumUsedVoxels(0)
+		, NumPageVoxels(0)
+		, NumMoved(0)
+	{}
+};
+
+/**
+* Packs many distance field volumes into a few large volumes, so one texture can be bound for many objects.
+* Each volume is surrounded by Padding voxels copied from its edge, so trilinear filtering at the edge
+* matches the CLAMP addressing of a texture of its own.
+* Pages are opened as the existing ones fill up. Everything is CPU side, the renderer uploads the
+* regions returned by ConsumeUpdates.
+* Free only returns the space to its page, a page left empty stays open and keeps its index until Defragment repacks.
+*/
+class FDistanceFieldAtlas
+{
+public:
+
+	/**
+	* @param InPageSize	Voxels of each atlas volume
+	* @param InPadding	Voxels copied around each volume
+	*/
+	explicit FDistanceFieldAtlas(const FIntVector& InPageSize = FIntVector(256, 256, 256), int32 InPadding = 1);
+
+	~FDistanceFieldAtlas();
+
+	/** Copies the volume into a page and returns the allocation id, INDEX_NONE if it is larger than a page or has no voxels. */
+	int32 Allocate(const FDistanceFieldVolumeData& Volume);
+
+	void Free(int32 AllocationId);
+
+	/**
+	* Repacks every live allocation, largest first, into as few pages as it takes.
+	* Allocation ids are kept, their places and UVW change. Every page is queued for upload.
+	*/
+	void Defragment();
+
+	const FDistanceFieldAtlasAllocation& GetAllocation(int32 AllocationId) const
+	{
+		return Allocations[AllocationId];
+	}
+
+	FDistanceFieldAtlasUVW GetUVW(int32 AllocationId) const;
+
+	/** UVW scale and bias of many allocations, one entry per id, for a per instance constant table. */
+	void BuildUVWTable(const int32* AllocationIds, int32 NumAllocationIds, TArray<FDistanceFieldAtlasUVW>& OutTable) const;
+
+	int32 GetNumPages() const
+	{
+		return Pages.size();
+	}
+
+	const FIntVector& GetPageSize() const
+	{
+		return PageSize;
+	}
+
+	/** Page voxels, X fastest. */
+	const SDFFloat* GetPageData(int32 Page) const
+	{
+		return Pages[Page]->Voxels.data();
+	}
+
+	/** Regions written since the last call, cleared by it. */
+	void ConsumeUpdates(TArray<FDistanceFieldAtlasUpdate>& OutUpdates);
+
+	FDistanceFieldAtlasStats GetStats() const;
+
+private:
+	struct FPage
+	{
+		FTextureLayout3d Layout;
+		TArray<SDFFloat> Voxels;
+
+		explicit FPage(const FIntVector& Size)
+			: Layout(Size)
+		{
+			Voxels.resize(Size.X * Size.Y * Size.Z);
+		}
+	};
+
+	/** Places a padded box of PaddedSize, opening a page if none has room. */
+	bool Place(const FIntVector& PaddedSize, int32& OutPage, FIntVector& OutMin);
+
+	/** Writes Size voxels read through GetVoxel with the edge replicated into the padding around Min. */
+	template<typename GetVoxelType>
+	void WriteVolume(int32 Page, const FIntVector& Min, const FIntVector& Size, GetVoxelType GetVoxel);
+
+	FIntVector PageSize;
+	int32 Padding;
+	TArray<FPage*> Pages;
+	TArray<FDistanceFieldAtlasAllocation> Allocations;
+	TArray<float> DistanceScales;
+	TArray<FDistanceFieldAtlasUpdate> PendingUpdates;
+	int32 NumMoved;
+};
+
+#endif // !_DISTANCEFIELDATLAS
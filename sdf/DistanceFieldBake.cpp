@@ -0,0 +1,391 @@
+#include "DistanceFieldBake.h"
+#include "MeshUtilities.h"
+
+/** Runs FDistanceFieldBakeHandle::Run on the pool. */
+class FDistanceFieldBakeStarter
+{
+public:
+	FDistanceFieldBakeStarter(FDistanceFieldBakeHandle* InHandle)
+		: Handle(InHandle)
+	{}
+
+	void DoWork()
+	{
+		Handle->Run();
+	}
+
+private:
+	FDistanceFieldBakeHandle* Handle;
+};
+
+/** Pulls bricks of one pass until there are none left or the bake has to stop. */
+class FDistanceFieldBakeWorker
+{
+public:
+	FDistanceFieldBakeWorker(FDistanceFieldBakeHandle* InHandle, FDistanceFieldBakeHandle::FBakePass* InPass)
+		: Handle(InHandle)
+		, Pass(InPass)
+	{}
+
+	void DoWork()
+	{
+		const int32 NumPassBricks = Pass->CompletedBricks.size();
+		const bool bFinePass = Pass == &Handle->FinePass;
+
+		while (!Handle->ShouldStop(*Pass))
+		{
+			const int32 BrickIndex = Handle->NextBrick++;
+			if (BrickIndex >= NumPassBricks)
+			{
+				break;
+			}
+
+			if (Handle->BakeBrick(*Pass, BrickIndex))
+			{
+				Pass->CompletedBricks[BrickIndex] = 1;
+				if (bFinePass)
+				{
+					Handle->NumCompletedBricks++;
+				}
+			}
+		}
+
+		// Nothing may touch the handle after this, the last worker may finish the bake and free it
+		if (--Handle->NumActiveWorkers == 0)
+		{
+			Handle->EndPass(*Pass);
+		}
+	}
+
+private:
+	FDistanceFieldBakeHandle* Handle;
+	FDistanceFieldBakeHandle::FBakePass* Pass;
+};
+
+FDistanceFieldBakeHandle::FDistanceFieldBakeHandle(
+	MeshData& InLODModel
+	, const FBoxSphereBounds& InBounds
+	, const FDistanceFieldBakeSettings& InSettings
+	, FDistanceFieldVolumeData& InOutData)
+	: LODModel(InLODModel)
+	, Bounds(InBounds)
+	, Settings(InSettings)
+	, OutData(InOutData)
+	, Context(NULL)
+	, StartTime(std::chrono::steady_clock::now())
+	, FineStartSeconds(-1.0)
+	, EndSeconds(-1.0)
+	, State(DFBake_Running)
+	, bCancelRequested(false)
+	, NextBrick(0)
+	, NumBricks(0)
+	, NumCompletedBricks(0)
+	, NumActiveWorkers(0)
+{
+	StartTask = new FAsyncTask<FDistanceFieldBakeStarter>(this);
+	GetDistanceFieldThreadPool().AddQueuedWork(StartTask);
+}
+
+FDistanceFieldBakeHandle::~FDistanceFieldBakeHandle()
+{
+	Cancel();
+	// A bake still waiting for a thread never starts
+	if (GetDistanceFieldThreadPool().RetractQueuedWork(StartTask))
+	{
+		SetState(DFBake_Cancelled);
+	}
+	Wait();
+
+	FBakePass* Passes[2] = { &CoarsePass, &FinePass };
+	for (int32 PassIndex = 0; PassIndex < 2; PassIndex++)
+	{
+		for (uint32 WorkerIndex = 0; WorkerIndex < Passes[PassIndex]->Workers.size(); WorkerIndex++)
+		{
+			delete Passes[PassIndex]->Workers[WorkerIndex];
+		}
+	}
+	delete StartTask;
+	delete Context;
+}
+
+void FDistanceFieldBakeHandle::Cancel()
+{
+	bCancelRequested = true;
+}
+
+void FDistanceFieldBakeHandle::Wait()
+{
+	std::unique_lock<std::mutex> Lock(DoneMutex);
+	while (State == DFBake_Running)
+	{
+		DoneCondition.wait(Lock);
+	}
+}
+
+float FDistanceFieldBakeHandle::GetProgress() const
+{
+	const int32 Total = NumBricks;
+	return Total > 0 ? (float)NumCompletedBricks / Total : 0.0f;
+}
+
+double FDistanceFieldBakeHandle::GetElapsedSeconds() const
+{
+	const double End = EndSeconds;
+	if (End >= 0)
+	{
+		return End;
+	}
+
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+}
+
+double FDistanceFieldBakeHandle::GetEstimatedSecondsRemaining() const
+{
+	if (IsDone())
+	{
+		return 0;
+	}
+
+	const int32 Completed = NumCompletedBricks;
+	const double FineStart = FineStartSeconds;
+	if (Completed == 0 || FineStart < 0)
+	{
+		return -1;
+	}
+
+	return (GetElapsedSeconds() - FineStart) / Completed * (NumBricks - Completed);
+}
+
+void FDistanceFieldBakeHandle::SetState(EDistanceFieldBakeState NewState)
+{
+	EndSeconds = GetElapsedSeconds();
+
+	// Notified under the lock, so a waiter cannot free the handle before notify_all returned
+	std::lock_guard<std::mutex> Lock(DoneMutex);
+	State = NewState;
+	DoneCondition.notify_all();
+}
+
+bool FDistanceFieldBakeHandle::ShouldStop(const FBakePass& Pass) const
+{
+	if (bCancelRequested)
+	{
+		return true;
+	}
+
+	// The coarse pass always runs to completion so there is something to return
+	return Pass.bCheckDeadline && Settings.TimeBudget > 0 && GetElapsedSeconds() >= Settings.TimeBudget;
+}
+
+bool FDistanceFieldBakeHandle::BakeBrick(FBakePass& Pass, int32 BrickIndex)
+{
+	const FIntVector& Dimensions = Pass.Dimensions;
+	const FIntVector BrickMin(
+		BrickIndex % Pass.NumBricksPerAxis.X * BrickSize,
+		BrickIndex / Pass.NumBricksPerAxis.X % Pass.NumBricksPerAxis.Y * BrickSize,
+		BrickIndex / (Pass.NumBricksPerAxis.X * Pass.NumBricksPerAxis.Y) * BrickSize);
+	const FIntVector BrickMax(
+		FMath::Min(BrickMin.X + (int32)BrickSize, Dimensions.X),
+		FMath::Min(BrickMin.Y + (int32)BrickSize, Dimensions.Y),
+		FMath::Min(BrickMin.Z + (int32)BrickSize, Dimensions.Z));
+
+	const FBox& VolumeBounds = Context->VolumeBounds;
+	const FVector VoxelSize(Context->GetVoxelSize(Context->VolumeDimensions));
+	const float VoxelDiameter = (VoxelSize * Pass.SampleStep).Size();
+	const float InvMaxExtent = 1.0f / VolumeBounds.GetExtent().GetMax();
+
+	for (int32 ZIndex = BrickMin.Z; ZIndex < BrickMax.Z; ZIndex++)
+	{
+		for (int32 YIndex = BrickMin.Y; YIndex < BrickMax.Y; YIndex++)
+		{
+			if (ShouldStop(Pass))
+			{
+				return false;
+			}
+
+			float* Row = &Pass.Distances[(ZIndex * Dimensions.Y + YIndex) * Dimensions.X];
+			for (int32 XIndex = BrickMin.X; XIndex < BrickMax.X; XIndex++)
+			{
+				const FVector VoxelPosition = (FVector(XIndex, YIndex, ZIndex) * Pass.SampleStep + FVector(.5f)) * VoxelSize + VolumeBounds.Min;
+				Row[XIndex] = Context->ComputeDistance(VoxelPosition, VoxelDiameter) * InvMaxExtent;
+			}
+		}
+	}
+
+	return true;
+}
+
+void FDistanceFieldBakeHandle::BeginPass(FBakePass& Pass)
+{
+	NextBrick = 0;
+
+	// One worker per pool thread, other bakes' jobs queue behind them
+	FPersistentThreadPool& ThreadPool = GetDistanceFieldThreadPool();
+	const int32 NumWorkers = FMath::Clamp(ThreadPool.GetNumThreads(), 1, (int32)Pass.CompletedBricks.size());
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		Pass.Workers.push_back(new FAsyncTask<FDistanceFieldBakeWorker>(this, &Pass));
+	}
+
+	// Counted before any is queued, so an early finisher cannot end the pass
+	NumActiveWorkers = NumWorkers;
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		ThreadPool.AddQueuedWork(Pass.Workers[WorkerIndex]);
+	}
+}
+
+void FDistanceFieldBakeHandle::EndPass(FBakePass& Pass)
+{
+	if (bCancelRequested)
+	{
+		SetState(DFBake_Cancelled);
+	}
+	else if (&Pass == &CoarsePass)
+	{
+		FineStartSeconds = GetElapsedSeconds();
+		BeginPass(FinePass);
+	}
+	else
+	{
+		Finish();
+	}
+}
+
+void FDistanceFieldBakeHandle::Run()
+{
+	if (bCancelRequested)
+	{
+		SetState(DFBake_Cancelled);
+		return;
+	}
+
+	if (Settings.ResolutionScale <= 0)
+	{
+		SetState(DFBake_Completed);
+		return;
+	}
+
+	Context = new FMeshDistanceFieldBuildContext(LODModel, Bounds, Settings.ResolutionScale);
+
+	const FIntVector& Dimensions = Context->VolumeDimensions;
+	const int32 Downsample = FMath::Max(Settings.CoarseDownsample, 1);
+	FBakePass* Passes[2] = { &CoarsePass, &FinePass };
+	CoarsePass.Dimensions = FIntVector(
+		FMath::Max(FMath::DivideAndRoundUp(Dimensions.X, Downsample), 2),
+		FMath::Max(FMath::DivideAndRoundUp(Dimensions.Y, Downsample), 2),
+		FMath::Max(FMath::DivideAndRoundUp(Dimensions.Z, Downsample), 2));
+	CoarsePass.SampleStep = FVector(
+		(Dimensions.X - 1.0f) / (CoarsePass.Dimensions.X - 1),
+		(Dimensions.Y - 1.0f) / (CoarsePass.Dimensions.Y - 1),
+		(Dimensions.Z - 1.0f) / (CoarsePass.Dimensions.Z - 1));
+	CoarsePass.bCheckDeadline = false;
+	FinePass.Dimensions = Dimensions;
+	FinePass.SampleStep = FVector(1.0f);
+	FinePass.bCheckDeadline = true;
+
+	for (int32 PassIndex = 0; PassIndex < 2; PassIndex++)
+	{
+		FBakePass& Pass = *Passes[PassIndex];
+		Pass.NumBricksPerAxis = FIntVector(
+			FMath::DivideAndRoundUp(Pass.Dimensions.X, (int32)BrickSize),
+			FMath::DivideAndRoundUp(Pass.Dimensions.Y, (int32)BrickSize),
+			FMath::DivideAndRoundUp(Pass.Dimensions.Z, (int32)BrickSize));
+		Pass.Distances.resize(Pass.Dimensions.X * Pass.Dimensions.Y * Pass.Dimensions.Z);
+		Pass.CompletedBricks.resize(Pass.NumBricksPerAxis.X * Pass.NumBricksPerAxis.Y * Pass.NumBricksPerAxis.Z, 0);
+	}
+	NumBricks = FinePass.CompletedBricks.size();
+
+	BeginPass(CoarsePass);
+}
+
+void FDistanceFieldBakeHandle::Finish()
+{
+	const FIntVector& Dimensions = FinePass.Dimensions;
+	const FIntVector& CoarseDimensions = CoarsePass.Dimensions;
+	const bool bComplete = NumCompletedBricks == NumBricks;
+
+	// Unfinished bricks take the trilinear coarse distance at their voxel centers, the coarse samples span the same centers
+	for (int32 BrickIndex = 0; BrickIndex < (int32)FinePass.CompletedBricks.size(); BrickIndex++)
+	{
+		if (FinePass.CompletedBricks[BrickIndex])
+		{
+			continue;
+		}
+
+		const FIntVector BrickMin(
+			BrickIndex % FinePass.NumBricksPerAxis.X * BrickSize,
+			BrickIndex / FinePass.NumBricksPerAxis.X % FinePass.NumBricksPerAxis.Y * BrickSize,
+			BrickIndex / (FinePass.NumBricksPerAxis.X * FinePass.NumBricksPerAxis.Y) * BrickSize);
+
+		for (int32 ZIndex = BrickMin.Z; ZIndex < FMath::Min(BrickMin.Z + (int32)BrickSize, Dimensions.Z); ZIndex++)
+		{
+			for (int32 YIndex = BrickMin.Y; YIndex < FMath::Min(BrickMin.Y + (int32)BrickSize, Dimensions.Y); YIndex++)
+			{
+				for (int32 XIndex = BrickMin.X; XIndex < FMath::Min(BrickMin.X + (int32)BrickSize, Dimensions.X); XIndex++)
+				{
+					const FVector CoarseCoordinate = FVector(XIndex, YIndex, ZIndex) / CoarsePass.SampleStep;
+					const FIntVector Coarse0(
+						FMath::Min(FMath::FloorToInt(CoarseCoordinate.X), CoarseDimensions.X - 2),
+						FMath::Min(FMath::FloorToInt(CoarseCoordinate.Y), CoarseDimensions.Y - 2),
+						FMath::Min(FMath::FloorToInt(CoarseCoordinate.Z), CoarseDimensions.Z - 2));
+					const FVector Fraction = CoarseCoordinate - FVector(Coarse0.X, Coarse0.Y, Coarse0.Z);
+
+					float Corners[2][2];
+					for (int32 CornerZ = 0; CornerZ < 2; CornerZ++)
+					{
+						for (int32 CornerY = 0; CornerY < 2; CornerY++)
+						{
+							const float* CoarseRow = &CoarsePass.Distances[((Coarse0.Z + CornerZ) * CoarseDimensions.Y + Coarse0.Y + CornerY) * CoarseDimensions.X + Coarse0.X];
+							Corners[CornerZ][CornerY] = FMath::Lerp(CoarseRow[0], CoarseRow[1], Fraction.X);
+						}
+					}
+
+					FinePass.Distances[(ZIndex * Dimensions.Y + YIndex) * Dimensions.X + XIndex] = FMath::Lerp(
+						FMath::Lerp(Corners[0][0], Corners[0][1], Fraction.Y),
+						FMath::Lerp(Corners[1][0], Corners[1][1], Fraction.Y),
+						Fraction.Z);
+				}
+			}
+		}
+	}
+
+	bool bNegativeAtBorder = false;
+	for (int32 ZIndex = 0; ZIndex < Dimensions.Z && !bNegativeAtBorder; ZIndex++)
+	{
+		for (int32 YIndex = 0; YIndex < Dimensions.Y && !bNegativeAtBorder; YIndex++)
+		{
+			const bool bBorderRow = ZIndex == 0 || ZIndex == Dimensions.Z - 1 || YIndex == 0 || YIndex == Dimensions.Y - 1;
+			const int32 XStep = bBorderRow ? 1 : FMath::Max(Dimensions.X - 1, 1);
+			for (int32 XIndex = 0; XIndex < Dimensions.X; XIndex += XStep)
+			{
+				if (FinePass.Distances[(ZIndex * Dimensions.Y + YIndex) * Dimensions.X + XIndex] < 0)
+				{
+					bNegativeAtBorder = true;
+					break;
+				}
+			}
+		}
+	}
+
+	OutData.Size = Dimensions;
+	OutData.LocalBoundingBox = Context->VolumeBounds;
+	OutData.DistanceFieldVolume.resize(Dimensions.X * Dimensions.Y * Dimensions.Z);
+	ConvertFloatToSDFFloat(FinePass.Distances.data(), OutData.DistanceFieldVolume.data(), OutData.DistanceFieldVolume.size());
+	OutData.bMeshWasClosed = !bNegativeAtBorder;
+	OutData.bBuiltAsIfTwoSided = Settings.bGenerateAsIfTwoSided;
+	OutData.bMeshWasPlane = Context->bMeshWasPlane;
+
+	// Toss distance field if mesh was not closed
+	if (bNegativeAtBorder)
+	{
+		OutData.Size = FIntVector(0, 0, 0);
+		OutData.DistanceFieldVolume.clear();
+	}
+
+	OutData.Compress(Settings.Format);
+
+	TArray<float>().swap(CoarsePass.Distances);
+	TArray<float>().swap(FinePass.Distances);
+	SetState(bComplete ? DFBake_Completed : DFBake_Coarse);
+}
@@ -0,0 +1,177 @@
+#ifndef _DISTANCEFIELDBAKE
+#define _DISTANCEFIELDBAKE
+#include "Config.h"
+#include "Vector.h"
+#include "IntVector.h"
+#include "DistanceFieldFormat.h"
+#include "AsyncWork.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+struct MeshData;
+class FMeshDistanceFieldBuildContext;
+class FDistanceFieldBakeStarter;
+class FDistanceFieldBakeWorker;
+
+enum EDistanceFieldBakeState
+{
+	/** Bricks are still being baked. */
+	DFBake_Running,
+	/** Every brick was baked at full resolution. */
+	DFBake_Completed,
+	/** The deadline expired, unfinished bricks were filled from the coarse pass. */
+	DFBake_Coarse,
+	/** Cancelled before a result was produced, the output volume was left empty. */
+	DFBake_Cancelled,
+};
+
+struct FDistanceFieldBakeSettings
+{
+	float ResolutionScale;
+	bool bGenerateAsIfTwoSided;
+	EDistanceFieldFormat Format;
+
+	/** Seconds after the start at which the bake settles for the coarse result, 0 for no deadline. */
+	double TimeBudget;
+
+	/** The coarse pass bakes one voxel for every CoarseDownsample^3 voxels of the full volume. */
+	int32 CoarseDownsample;
+
+	FDistanceFieldBakeSettings()
+		: ResolutionScale(1.0f)
+		, bGenerateAsIfTwoSided(false)
+		, Format(DFF_Float16)
+		, TimeBudget(0)
+		, CoarseDownsample(4)
+	{}
+};
+
+/**
+* A distance field bake running in the background.
+* A coarse pass is baked first so a deadline always has a result to fall back on, then the full volume
+* is baked in bricks of BrickSize^3 voxels by workers that pull the next brick when done.
+* Every step runs as a job on GetDistanceFieldThreadPool, so any number of bakes share its threads,
+* and the last worker of a pass queues the next one instead of a thread waiting for it.
+* Cancellation and the deadline are checked between every row of voxels.
+*/
+class FDistanceFieldBakeHandle
+{
+public:
+
+	enum { BrickSize = 8 };
+
+	/**
+	* Queues the bake of LODModel into OutData, the time budget counts from here.
+	* LODModel, Bounds and OutData must outlive the handle, OutData must not be touched until IsDone.
+	*/
+	FDistanceFieldBakeHandle(
+		MeshData& LODModel
+		, const FBoxSphereBounds& Bounds
+		, const FDistanceFieldBakeSettings& Settings
+		, FDistanceFieldVolumeData& OutData);
+
+	/** Cancels the bake if it is still running and waits for its jobs. */
+	~FDistanceFieldBakeHandle();
+
+	/** Asks the workers to stop, the output is left empty unless the bake already finished. */
+	void Cancel();
+
+	/** Blocks until the bake has finished, been cancelled or run out of time. */
+	void Wait();
+
+	/** True once OutData is final and can be read. */
+	bool IsDone() const
+	{
+		return State != DFBake_Running;
+	}
+
+	EDistanceFieldBakeState GetState() const
+	{
+		return State;
+	}
+
+	/** Number of full resolution bricks, 0 until the volume layout is known. */
+	int32 GetNumBricks() const
+	{
+		return NumBricks;
+	}
+
+	int32 GetNumCompletedBricks() const
+	{
+		return NumCompletedBricks;
+	}
+
+	/** Fraction of full resolution bricks done, in [0, 1]. */
+	float GetProgress() const;
+
+	/** Time since the start, frozen once the bake is done. */
+	double GetElapsedSeconds() const;
+
+	/** Remaining time extrapolated from the full resolution bricks done so far, negative until the first one completes. */
+	double GetEstimatedSecondsRemaining() const;
+
+private:
+
+	friend class FDistanceFieldBakeStarter;
+	friend class FDistanceFieldBakeWorker;
+
+	/** One volume baked brick by brick, either the coarse pass or the full one. */
+	struct FBakePass
+	{
+		FIntVector Dimensions;
+
+		/** Distance between samples in full resolution voxels, the first and last samples land on the outer voxel centers. */
+		FVector SampleStep;
+
+		FIntVector NumBricksPerAxis;
+		TArray<float> Distances;
+		TArray<uint8> CompletedBricks;
+		bool bCheckDeadline;
+
+		/** Jobs pulling the bricks of this pass, the last one to run out of bricks ends the pass. */
+		TArray<FAsyncTask<FDistanceFieldBakeWorker>*> Workers;
+	};
+
+	/** First job: builds the context, then starts the coarse pass. */
+	void Run();
+	void BeginPass(FBakePass& Pass);
+	/** Called by the last worker of Pass, starts the fine pass or finishes the bake. */
+	void EndPass(FBakePass& Pass);
+	void Finish();
+	void SetState(EDistanceFieldBakeState NewState);
+
+	/** Bakes one brick, returns false when interrupted before the last row. */
+	bool BakeBrick(FBakePass& Pass, int32 BrickIndex);
+
+	/** True when the workers should stop taking or finishing bricks. */
+	bool ShouldStop(const FBakePass& Pass) const;
+
+	MeshData& LODModel;
+	const FBoxSphereBounds& Bounds;
+	FDistanceFieldBakeSettings Settings;
+	FDistanceFieldVolumeData& OutData;
+
+	const FMeshDistanceFieldBuildContext* Context;
+	FBakePass CoarsePass;
+	FBakePass FinePass;
+
+	std::chrono::steady_clock::time_point StartTime;
+	std::atomic<double> FineStartSeconds;
+	std::atomic<double> EndSeconds;
+	std::atomic<EDistanceFieldBakeState> State;
+	std::atomic<bool> bCancelRequested;
+	std::atomic<int32> NextBrick;
+	std::atomic<int32> NumBricks;
+	std::atomic<int32> NumCompletedBricks;
+	std::atomic<int32> NumActiveWorkers;
+
+	FAsyncTask<FDistanceFieldBakeStarter>* StartTask;
+
+	/** Signalled when State leaves DFBake_Running, after which no job touches the handle. */
+	std::mutex DoneMutex;
+	std::condition_variable DoneCondition;
+};
+
+#endif // !_DISTANCEFIELDBAKE
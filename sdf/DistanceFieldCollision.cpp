@@ -0,0 +1,492 @@
+#include "DistanceFieldCollision.h"
+#include "DistanceFieldSampler.h"
+#include "AsyncWork.h"
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+	/** Sphere tracing gives up after this many steps and reports no contact. */
+	const int32 MaxTraceSteps = 128;
+
+	/** Queries handed to a worker at a time. */
+	const int32 QueriesPerChunk = 64;
+
+	/** Queries covering more cells than this scan every instance. */
+	const int32 MaxQueryCells = 512;
+}
+
+FBox FDistanceFieldTransform::TransformBox(const FBox& Local) const
+{
+	const FVector Center = TransformPosition(Local.GetCenter());
+	const FVector Extent = Local.GetExtent() * Scale;
+	FVector WorldExtent;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		WorldExtent[Axis] = FMath::Abs(Axes[0][Axis]) * Extent.X + FMath::Abs(Axes[1][Axis]) * Extent.Y + FMath::Abs(Axes[2][Axis]) * Extent.Z;
+	}
+	return FBox(Center - WorldExtent, Center + WorldExtent);
+}
+
+/** Runs chunks of a batched query, pulled from a shared counter until none are left. */
+class FDistanceFieldCollisionTask
+{
+public:
+	FDistanceFieldCollisionTask(
+		const FDistanceFieldCollisionScene* InScene,
+		const FVector* InPositions,
+		float InMaxDistance,
+		FDistanceFieldPointResult* InPointResults,
+		const FDistanceFieldSphereSweep* InSweeps,
+		float InSkin,
+		FDistanceFieldSweepResult* InSweepResults,
+		int32 InNumQueries,
+		std::atomic<int32>* InNextChunk)
+		: Scene(InScene)
+		, Positions(InPositions)
+		, MaxDistance(InMaxDistance)
+		, PointResults(InPointResults)
+		, Sweeps(InSweeps)
+		, Skin(InSkin)
+		, SweepResults(InSweepResults)
+		, NumQueries(InNumQueries)
+		, NextChunk(InNextChunk)
+	{}
+
+	void DoWork()
+	{
+		for (int32 Start = (*NextChunk)++ * QueriesPerChunk; Start < NumQueries; Start = (*NextChunk)++ * QueriesPerChunk)
+		{
+			const int32 End = FMath::Min(Start + QueriesPerChunk, NumQueries);
+			for (int32 QueryIndex = Start; QueryIndex < End; QueryIndex++)
+			{
+				if (Positions)
+				{
+					Scene->QueryPoint(Positions[QueryIndex], MaxDistance, PointResults[QueryIndex]);
+				}
+				else
+				{
+					Scene->SweepSphere(Sweeps[QueryIndex], SweepResults[QueryIndex], Skin);
+				}
+			}
+		}
+	}
+
+private:
+	const FDistanceFieldCollisionScene* Scene;
+	const FVector* Positions;
+	float MaxDistance;
+	FDistanceFieldPointResult* PointResults;
+	const FDistanceFieldSphereSweep* Sweeps;
+	float Skin;
+	FDistanceFieldSweepResult* SweepResults;
+	int32 NumQueries;
+	std::atomic<int32>* NextChunk;
+};
+
+namespace
+{
+	void RunCollisionTasks(
+		const FDistanceFieldCollisionScene* Scene,
+		const FVector* Positions,
+		float MaxDistance,
+		FDistanceFieldPointResult* PointResults,
+		const FDistanceFieldSphereSweep* Sweeps,
+		float Skin,
+		FDistanceFieldSweepResult* SweepResults,
+		int32 NumQueries)
+	{
+		std::atomic<int32> NextChunk(0);
+		const int32 NumChunks = FMath::DivideAndRoundUp(NumQueries, QueriesPerChunk);
+		const int32 NumWorkers = FMath::Clamp(FMath::Min((int32)std::thread::hardware_concurrency(), NumChunks), 1, MAXTHREADNUM);
+		FQueuedThreadPool ThreadPool;
+		TArray<FAsyncTask<FDistanceFieldCollisionTask>*> AsyncTasks;
+
+		for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+		{
+			FAsyncTask<FDistanceFieldCollisionTask>* Task = new FAsyncTask<FDistanceFieldCollisionTask>(
+				Scene,
+				Positions,
+				MaxDistance,
+				PointResults,
+				Sweeps,
+				Skin,
+				SweepResults,
+				NumQueries,
+				&NextChunk);
+
+			ThreadPool.AddWork(Task);
+			AsyncTasks.push_back(Task);
+		}
+		ThreadPool.DoAllWork();
+
+		for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+		{
+			delete AsyncTasks[TaskIndex];
+		}
+	}
+}
+
+FDistanceFieldCollisionScene::FDistanceFieldCollisionScene(float InCellSize)
+	: CellSize(InCellSize)
+{
+	Buckets.resize(NumBuckets);
+}
+
+int32 FDistanceFieldCollisionScene::AddInstance(const FDistanceFieldSampler* Sampler, const FDistanceFieldTransform& Transform)
+{
+	int32 InstanceId = 0;
+	while (InstanceId < (int32)Instances.size() && Instances[InstanceId].bAllocated)
+	{
+		InstanceId++;
+	}
+
+	if (InstanceId == Instances.size())
+	{
+		Instances.push_back(FInstance());
+	}
+
+	FInstance& Instance = Instances[InstanceId];
+	Instance.Sampler = Sampler;
+	Instance.bAllocated = true;
+	Instance.bLinked = false;
+	UpdateInstance(InstanceId, Transform);
+	return InstanceId;
+}
+
+void FDistanceFieldCollisionScene::UpdateInstance(int32 InstanceId, const FDistanceFieldTransform& Transform)
+{
+	FInstance& Instance = Instances[InstanceId];
+	UnlinkInstance(InstanceId);
+
+	Instance.Transform = Transform;
+	Instance.WorldBounds = FBox(0);
+	if (Instance.Sampler->IsValid())
+	{
+		Instance.WorldBounds = Transform.TransformBox(Instance.Sampler->GetBox());
+		LinkInstance(InstanceId);
+	}
+}
+
+void FDistanceFieldCollisionScene::RemoveInstance(int32 InstanceId)
+{
+	UnlinkInstance(InstanceId);
+	Instances[InstanceId].bAllocated = false;
+	Instances[InstanceId].WorldBounds = FBox(0);
+}
+
+int32 FDistanceFieldCollisionScene::GetBucket(int32 X, int32 Y, int32 Z) const
+{
+	const uint32 Hash = (uint32)X * 73856093u ^ (uint32)Y * 19349663u ^ (uint32)Z * 83492791u;
+	return Hash & (NumBuckets - 1);
+}
+
+FIntVector FDistanceFieldCollisionScene::GetCell(const FVector& Position) const
+{
+	return FIntVector(
+		FMath::FloorToInt(Position.X / CellSize),
+		FMath::FloorToInt(Position.Y / CellSize),
+		FMath::FloorToInt(Position.Z / CellSize));
+}
+
+void FDistanceFieldCollisionScene::LinkInstance(int32 InstanceId)
+{
+	FInstance& Instance = Instances[InstanceId];
+	Instance.CellMin = GetCell(Instance.WorldBounds.Min);
+	Instance.CellMax = GetCell(Instance.WorldBounds.Max);
+	const FIntVector NumCells = Instance.CellMax - Instance.CellMin + FIntVector(1, 1, 1);
+	Instance.bOversized = NumCells.X * NumCells.Y * NumCells.Z > MaxCellsPerInstance;
+	Instance.bLinked = true;
+
+	if (Instance.bOversized)
+	{
+		OversizedInstances.push_back(InstanceId);
+		return;
+	}
+
+	for (int32 Z = Instance.CellMin.Z; Z <= Instance.CellMax.Z; Z++)
+	{
+		for (int32 Y = Instance.CellMin.Y; Y <= Instance.CellMax.Y; Y++)
+		{
+			for (int32 X = Instance.CellMin.X; X <= Instance.CellMax.X; X++)
+			{
+				Buckets[GetBucket(X, Y, Z)].push_back(InstanceId);
+			}
+		}
+	}
+}
+
+void FDistanceFieldCollisionScene::UnlinkInstance(int32 InstanceId)
+{
+	FInstance& Instance = Instances[InstanceId];
+	if (!Instance.bLinked)
+	{
+		return;
+	}
+	Instance.bLinked = false;
+
+	if (Instance.bOversized)
+	{
+		TArray<int32>::iterator Found = std::find(OversizedInstances.begin(), OversizedInstances.end(), InstanceId);
+		if (Found != OversizedInstances.end())
+		{
+			OversizedInstances.erase(Found);
+		}
+		return;
+	}
+
+	for (int32 Z = Instance.CellMin.Z; Z <= Instance.CellMax.Z; Z++)
+	{
+		for (int32 Y = Instance.CellMin.Y; Y <= Instance.CellMax.Y; Y++)
+		{
+			for (int32 X = Instance.CellMin.X; X <= Instance.CellMax.X; X++)
+			{
+				// Cells sharing a bucket hold the instance once per cell, remove one entry each
+				TArray<int32>& Bucket = Buckets[GetBucket(X, Y, Z)];
+				TArray<int32>::iterator Found = std::find(Bucket.begin(), Bucket.end(), InstanceId);
+				if (Found != Bucket.end())
+				{
+					*Found = Bucket.back();
+					Bucket.pop_back();
+				}
+			}
+		}
+	}
+}
+
+void FDistanceFieldCollisionScene::GatherInstances(const FBox& Bounds, TArray<int32>& OutInstances) const
+{
+	OutInstances.clear();
+	const FIntVector CellMin = GetCell(Bounds.Min);
+	const FIntVector CellMax = GetCell(Bounds.Max);
+	const FIntVector NumCells = CellMax - CellMin + FIntVector(1, 1, 1);
+
+	if (NumCells.X * NumCells.Y * NumCells.Z > MaxQueryCells)
+	{
+		for (uint32 InstanceId = 0; InstanceId < Instances.size(); InstanceId++)
+		{
+			if (Instances[InstanceId].bLinked && Instances[InstanceId].WorldBounds.Intersect(Bounds))
+			{
+				OutInstances.push_back(InstanceId);
+			}
+		}
+		return;
+	}
+
+	for (int32 Z = CellMin.Z; Z <= CellMax.Z; Z++)
+	{
+		for (int32 Y = CellMin.Y; Y <= CellMax.Y; Y++)
+		{
+			for (int32 X = CellMin.X; X <= CellMax.X; X++)
+			{
+				const TArray<int32>& Bucket = Buckets[GetBucket(X, Y, Z)];
+				for (uint32 EntryIndex = 0; EntryIndex < Bucket.size(); EntryIndex++)
+				{
+					if (Instances[Bucket[EntryIndex]].WorldBounds.Intersect(Bounds))
+					{
+						OutInstances.push_back(Bucket[EntryIndex]);
+					}
+				}
+			}
+		}
+	}
+
+	for (uint32 OversizedIndex = 0; OversizedIndex < OversizedInstances.size(); OversizedIndex++)
+	{
+		if (Instances[OversizedInstances[OversizedIndex]].WorldBounds.Intersect(Bounds))
+		{
+			OutInstances.push_back(OversizedInstances[OversizedIndex]);
+		}
+	}
+
+	std::sort(OutInstances.begin(), OutInstances.end());
+	OutInstances.erase(std::unique(OutInstances.begin(), OutInstances.end()), OutInstances.end());
+}
+
+float FDistanceFieldCollisionScene::SampleInstance(const FInstance& Instance, const FVector& Position, FVector* OutNormal) const
+{
+	const FVector LocalPosition = Instance.Transform.InverseTransformPosition(Position);
+	if (OutNormal)
+	{
+		*OutNormal = Instance.Transform.TransformVector(Instance.Sampler->SampleGradient(LocalPosition)).GetSafeNormal();
+	}
+	return Instance.Sampler->Sample(LocalPosition) * Instance.Transform.Scale;
+}
+
+float FDistanceFieldCollisionScene::GetClosestDistance(const TArray<int32>& Candidates, const FVector& Position, float MaxDistance, int32& OutInstanceId) const
+{
+	float MinDistance = MaxDistance;
+	OutInstanceId = INDEX_NONE;
+	for (uint32 CandidateIndex = 0; CandidateIndex < Candidates.size(); CandidateIndex++)
+	{
+		const FInstance& Instance = Instances[Candidates[CandidateIndex]];
+
+		// The box distance is a lower bound, skip instances that cannot get closer
+		if (MinDistance > 0 && Instance.WorldBounds.ComputeSquaredDistanceToPoint(Position) >= MinDistance * MinDistance)
+		{
+			continue;
+		}
+
+		const float Distance = SampleInstance(Instance, Position);
+		if (Distance < MinDistance)
+		{
+			MinDistance = Distance;
+			OutInstanceId = Candidates[CandidateIndex];
+		}
+	}
+	return MinDistance;
+}
+
+bool FDistanceFieldCollisionScene::QueryPoint(const FVector& Position, float MaxDistance, FDistanceFieldPointResult& OutResult) const
+{
+	TArray<int32> Candidates;
+	GatherInstances(FBox(Position, Position).ExpandBy(MaxDistance), Candidates);
+
+	OutResult.Distance = GetClosestDistance(Candidates, Position, MaxDistance, OutResult.InstanceId);
+	OutResult.Normal = FVector(0);
+	OutResult.ClosestPoint = Position;
+	if (OutResult.InstanceId == INDEX_NONE)
+	{
+		return false;
+	}
+
+	SampleInstance(Instances[OutResult.InstanceId], Position, &OutResult.Normal);
+	OutResult.ClosestPoint = Position - OutResult.Normal * OutResult.Distance;
+	return true;
+}
+
+float FDistanceFieldCollisionScene::GetDistance(const FVector& Position, float MaxDistance, int32* OutInstanceId) const
+{
+	TArray<int32> Candidates;
+	GatherInstances(FBox(Position, Position).ExpandBy(MaxDistance), Candidates);
+
+	int32 InstanceId;
+	const float Distance = GetClosestDistance(Candidates, Position, MaxDistance, InstanceId);
+	if (OutInstanceId)
+	{
+		*OutInstanceId = InstanceId;
+	}
+	return Distance;
+}
+
+bool FDistanceFieldCollisionScene::OverlapSphere(const FVector& Center, float Radius, int32* OutInstanceId) const
+{
+	int32 InstanceId;
+	const float Distance = GetDistance(Center, Radius, &InstanceId);
+	if (OutInstanceId)
+	{
+		*OutInstanceId = InstanceId;
+	}
+	return InstanceId != INDEX_NONE && Distance < Radius;
+}
+
+bool FDistanceFieldCollisionScene::OverlapCapsule(const FVector& A, const FVector& B, float Radius, int32* OutInstanceId, float Skin) const
+{
+	if (OutInstanceId)
+	{
+		*OutInstanceId = INDEX_NONE;
+	}
+
+	const FVector Delta = B - A;
+	const float Length = Delta.Size();
+	const FVector Direction = Length > SMALL_NUMBER ? Delta / Length : FVector(0);
+	const float Reach = Radius + Skin;
+
+	TArray<int32> Candidates;
+	FBox Bounds(A, A);
+	Bounds += B;
+	GatherInstances(Bounds.ExpandBy(Reach), Candidates);
+	if (Candidates.empty())
+	{
+		return false;
+	}
+
+	// Walks the whole segment looking for a distance within reach. Steps of the distance minus the reach skip only
+	// farther points; next to a grazing surface they are at least Skin long, which can miss a surface in the skin
+	// but never one inside the radius. Unlike a sweep, running along a surface never counts as touching it.
+	const float MinStep = FMath::Max(Skin, KINDA_SMALL_NUMBER);
+	float Travelled = 0;
+	for (;;)
+	{
+		int32 InstanceId;
+		const float Distance = GetClosestDistance(Candidates, A + Direction * Travelled, Length - Travelled + Reach, InstanceId);
+		if (InstanceId == INDEX_NONE)
+		{
+			// Nothing within reach of the rest of the segment
+			return false;
+		}
+		if (Distance <= Reach)
+		{
+			if (OutInstanceId)
+			{
+				*OutInstanceId = InstanceId;
+			}
+			return true;
+		}
+		if (Travelled >= Length)
+		{
+			return false;
+		}
+		Travelled = FMath::Min(Travelled + FMath::Max(Distance - Reach, MinStep), Length);
+	}
+}
+
+bool FDistanceFieldCollisionScene::SweepSphere(const FDistanceFieldSphereSweep& Sweep, FDistanceFieldSweepResult& OutResult, float Skin) const
+{
+	OutResult.Time = 1.0f;
+	OutResult.Position = Sweep.End;
+	OutResult.Normal = FVector(0);
+	OutResult.InstanceId = INDEX_NONE;
+
+	const FVector Delta = Sweep.End - Sweep.Start;
+	const float Length = Delta.Size();
+	const FVector Direction = Length > SMALL_NUMBER ? Delta / Length : FVector(0);
+	const float Reach = Sweep.Radius + Skin;
+
+	TArray<int32> Candidates;
+	FBox SweepBounds(Sweep.Start, Sweep.Start);
+	SweepBounds += Sweep.End;
+	GatherInstances(SweepBounds.ExpandBy(Reach), Candidates);
+	if (Candidates.empty())
+	{
+		return false;
+	}
+
+	// Steps of the distance to the closest surface minus the radius cannot pass through anything
+	float Travelled = 0;
+	int32 InstanceId = INDEX_NONE;
+	for (int32 StepIndex = 0; StepIndex < MaxTraceSteps; StepIndex++)
+	{
+		const FVector Position = Sweep.Start + Direction * Travelled;
+		const float Distance = GetClosestDistance(Candidates, Position, Length - Travelled + Reach, InstanceId);
+		if (InstanceId != INDEX_NONE && Distance <= Reach)
+		{
+			break;
+		}
+
+		// Nothing within reach of the rest of the sweep
+		if (Travelled >= Length || InstanceId == INDEX_NONE)
+		{
+			return false;
+		}
+		Travelled = FMath::Min(Travelled + Distance - Sweep.Radius, Length);
+	}
+
+	// Running out of steps while grazing a surface stops the sweep at the last position known to be clear,
+	// rather than letting it carry on to End unchecked
+	OutResult.Time = Length > SMALL_NUMBER ? Travelled / Length : 0.0f;
+	OutResult.Position = Sweep.Start + Direction * Travelled;
+	OutResult.InstanceId = InstanceId;
+	SampleInstance(Instances[InstanceId], OutResult.Position, &OutResult.Normal);
+	return true;
+}
+
+void FDistanceFieldCollisionScene::QueryPoints(const FVector* Positions, int32 NumPositions, float MaxDistance, FDistanceFieldPointResult* OutResults) const
+{
+	RunCollisionTasks(this, Positions, MaxDistance, OutResults, NULL, 0, NULL, NumPositions);
+}
+
+void FDistanceFieldCollisionScene::SweepSpheres(const FDistanceFieldSphereSweep* Sweeps, int32 NumSweeps, FDistanceFieldSweepResult* OutResults, float Skin) const
+{
+	RunCollisionTasks(this, NULL, 0, NULL, Sweeps, Skin, OutResults, NumSweeps);
+}
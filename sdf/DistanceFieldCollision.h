@@ -0,0 +1,196 @@
+#ifndef _DISTANCEFIELDCOLLISION
+#define _DISTANCEFIELDCOLLISION
+#include "Config.h"
+#include "IntVector.h"
+#include "Box.h"
+
+class FDistanceFieldSampler;
+
+/**
+* Rigid transform with uniform scale, local to world.
+* Distances scale with Scale alone, which keeps sampled distances exact in world space.
+*/
+struct FDistanceFieldTransform
+{
+	FVector Translation;
+
+	/** Unit world space directions of the local axes. */
+	FVector Axes[3];
+
+	float Scale;
+
+	explicit FDistanceFieldTransform(const FVector& InTranslation = FVector(0), float InScale = 1.0f)
+		: Translation(InTranslation)
+		, Scale(InScale)
+	{
+		Axes[0] = FVector(1, 0, 0);
+		Axes[1] = FVector(0, 1, 0);
+		Axes[2] = FVector(0, 0, 1);
+	}
+
+	FDistanceFieldTransform(const FVector& XAxis, const FVector& YAxis, const FVector& ZAxis, const FVector& InTranslation, float InScale = 1.0f)
+		: Translation(InTranslation)
+		, Scale(InScale)
+	{
+		Axes[0] = XAxis;
+		Axes[1] = YAxis;
+		Axes[2] = ZAxis;
+	}
+
+	FVector TransformPosition(const FVector& Local) const
+	{
+		return Translation + TransformVector(Local);
+	}
+
+	FVector TransformVector(const FVector& Local) const
+	{
+		return (Axes[0] * Local.X + Axes[1] * Local.Y + Axes[2] * Local.Z) * Scale;
+	}
+
+	FVector InverseTransformPosition(const FVector& World) const
+	{
+		return InverseTransformVector(World - Translation);
+	}
+
+	FVector InverseTransformVector(const FVector& World) const
+	{
+		return FVector(
+			FVector::DotProduct(World, Axes[0]),
+			FVector::DotProduct(World, Axes[1]),
+			FVector::DotProduct(World, Axes[2])) / Scale;
+	}
+
+	/** World box of a local box. */
+	FBox TransformBox(const FBox& Local) const;
+};
+
+/** Closest surface found by a point query. */
+struct FDistanceFieldPointResult
+{
+	/** World space distance, negative inside. */
+	float Distance;
+
+	/** World space unit normal of the closest instance, pointing away from its surface. */
+	FVector Normal;
+
+	/** Position moved onto the surface along Normal. */
+	FVector ClosestPoint;
+
+	/** INDEX_NONE when nothing was within the query's MaxDistance. */
+	int32 InstanceId;
+};
+
+/** A sphere moving from Start to End. */
+struct FDistanceFieldSphereSweep
+{
+	FVector Start;
+	FVector End;
+	float Radius;
+};
+
+struct FDistanceFieldSweepResult
+{
+	/** Fraction of the sweep at the first contact, 1 when nothing was hit. */
+	float Time;
+
+	/** Sphere center at Time. */
+	FVector Position;
+
+	/** World space unit normal at the contact. */
+	FVector Normal;
+
+	/** INDEX_NONE when nothing was hit. */
+	int32 InstanceId;
+};
+
+/**
+* Collision queries against distance field instances.
+* Instances are kept in a uniform grid over their world bounds, queries only sample the instances whose bounds they reach.
+* Queries are read only and can run from several threads, adding, updating and removing instances can not.
+*/
+class FDistanceFieldCollisionScene
+{
+public:
+
+	/** @param CellSize	World space size of the broadphase grid cells, around the size of a typical instance. */
+	explicit FDistanceFieldCollisionScene(float CellSize = 32.0f);
+
+	/** Returns the instance id. Instances whose volume has no voxels are kept but never collide. */
+	int32 AddInstance(const FDistanceFieldSampler* Sampler, const FDistanceFieldTransform& Transform);
+
+	void UpdateInstance(int32 InstanceId, const FDistanceFieldTransform& Transform);
+
+	void RemoveInstance(int32 InstanceId);
+
+	/** Closest instance surface within MaxDistance of Position, false when there is none. */
+	bool QueryPoint(const FVector& Position, float MaxDistance, FDistanceFieldPointResult& OutResult) const;
+
+	/** World space distance to the closest surface, MaxDistance when nothing is closer. */
+	float GetDistance(const FVector& Position, float MaxDistance, int32* OutInstanceId = NULL) const;
+
+	bool OverlapSphere(const FVector& Center, float Radius, int32* OutInstanceId = NULL) const;
+
+	/**
+	* True if the smallest distance along the capsule's segment is within Radius + Skin. The whole segment is walked,
+	* a surface the capsule runs alongside without reaching is not an overlap the way it blocks a sweep.
+	*/
+	bool OverlapCapsule(const FVector& A, const FVector& B, float Radius, int32* OutInstanceId = NULL, float Skin = 0.01f) const;
+
+	/**
+	* Time of impact by sphere tracing, contacts are found within Skin of the surface.
+	* A sweep grazing a surface for too many steps is reported blocked at the last position known to be clear.
+	*/
+	bool SweepSphere(const FDistanceFieldSphereSweep& Sweep, FDistanceFieldSweepResult& OutResult, float Skin = 0.01f) const;
+
+	/** QueryPoint for many points, spread over worker threads. */
+	void QueryPoints(const FVector* Positions, int32 NumPositions, float MaxDistance, FDistanceFieldPointResult* OutResults) const;
+
+	/** SweepSphere for many agents, spread over worker threads. */
+	void SweepSpheres(const FDistanceFieldSphereSweep* Sweeps, int32 NumSweeps, FDistanceFieldSweepResult* OutResults, float Skin = 0.01f) const;
+
+private:
+
+	struct FInstance
+	{
+		const FDistanceFieldSampler* Sampler;
+		FDistanceFieldTransform Transform;
+		FBox WorldBounds;
+
+		/** Broadphase cells the instance is linked into, unless it is in the oversized list. */
+		FIntVector CellMin;
+		FIntVector CellMax;
+		bool bOversized;
+		bool bLinked;
+
+		bool bAllocated;
+	};
+
+	/** Instances covering more cells than this are tested by every query instead. */
+	static const int32 MaxCellsPerInstance = 64;
+
+	static const int32 NumBuckets = 4096;
+
+	void LinkInstance(int32 InstanceId);
+	void UnlinkInstance(int32 InstanceId);
+
+	int32 GetBucket(int32 X, int32 Y, int32 Z) const;
+	FIntVector GetCell(const FVector& Position) const;
+
+	/** Allocated instances whose world bounds intersect Bounds, sorted and unique. */
+	void GatherInstances(const FBox& Bounds, TArray<int32>& OutInstances) const;
+
+	/** World space distance to one instance, its surface normal when OutNormal is set. */
+	float SampleInstance(const FInstance& Instance, const FVector& Position, FVector* OutNormal = NULL) const;
+
+	/** Min over Candidates, MaxDistance when none is closer. */
+	float GetClosestDistance(const TArray<int32>& Candidates, const FVector& Position, float MaxDistance, int32& OutInstanceId) const;
+
+	float CellSize;
+	TArray<FInstance> Instances;
+	TArray<TArray<int32> > Buckets;
+	TArray<int32> OversizedInstances;
+
+	friend class FDistanceFieldCollisionTask;
+};
+
+#endif // !_DISTANCEFIELDCOLLISION
@@ -0,0 +1,490 @@
+#include "DistanceFieldCulling.h"
+#include "AsyncWork.h"
+#include "sse.h"
+#include <atomic>
+
+namespace
+{
+	/** Screen rects are grown by this many pixels so rounding never drops a pixel's object. */
+	const float RectMarginPixels = 1.0f;
+
+	const float BigNumber = 3.40282e+038f;
+
+	const float MaxScreenCoordinate = 1e6f;
+
+	/** Shared by the two passes over the rows of tiles. */
+	struct FDistanceFieldCullingContext
+	{
+		const FDistanceFieldShadowView* View;
+		FVector Dir;
+		const float* DepthBuffer;
+		const FVector* NormalBuffer;
+		int32 Width;
+		int32 Height;
+		FDistanceFieldTileObjects* Tiles;
+
+		/** Objects in structure of arrays, padded to a multiple of four with rects no row overlaps. */
+		int32 NumPaddedObjects;
+		TArray<float> BoundsMin[3];
+		TArray<float> BoundsMax[3];
+		TArray<float> RectMinX;
+		TArray<float> RectMaxX;
+		TArray<float> RectMinY;
+		TArray<float> RectMaxY;
+
+		/** Per row of tiles, the list lengths and the lists back to back. */
+		TArray<TArray<int32> > RowCounts;
+		TArray<TArray<int32> > RowObjects;
+	};
+
+	/**
+	* IsSweptBoxOverlapping of one box swept along Dir against four boxes.
+	* Returns the lanes that overlap.
+	*/
+	FORCEINLINE VectorRegister SweptBoxOverlapping4(const FBox& Box, const FVector& Dir, const VectorRegister OtherMin[3], const VectorRegister OtherMax[3])
+	{
+		VectorRegister Mask = VectorCompareEQ(VectorZero(), VectorZero());
+		VectorRegister MinT = VectorZero();
+		VectorRegister MaxT = VectorSetFloat1(BigNumber);
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const VectorRegister BoxMin = VectorSetFloat1(Box.Min[Axis]);
+			const VectorRegister BoxMax = VectorSetFloat1(Box.Max[Axis]);
+			if (Dir[Axis] == 0)
+			{
+				Mask = VectorBitwiseAnd(Mask, VectorBitwiseAnd(VectorMask_LE(BoxMin, OtherMax[Axis]), VectorMask_GE(BoxMax, OtherMin[Axis])));
+				continue;
+			}
+
+			const VectorRegister D = VectorSetFloat1(Dir[Axis]);
+			const VectorRegister Near = Dir[Axis] > 0 ? VectorSubtract(OtherMin[Axis], BoxMax) : VectorSubtract(OtherMax[Axis], BoxMin);
+			const VectorRegister Far = Dir[Axis] > 0 ? VectorSubtract(OtherMax[Axis], BoxMin) : VectorSubtract(OtherMin[Axis], BoxMax);
+			MinT = VectorMax(MinT, VectorDivide(Near, D));
+			MaxT = VectorMin(MaxT, VectorDivide(Far, D));
+		}
+		return VectorBitwiseAnd(Mask, VectorMask_LE(MinT, MaxT));
+	}
+
+	/**
+	* Screen rects in tiles of four objects' bounds extruded along the light, clipped to the receivers' bounds.
+	* Lanes that can not reach a receiver get an empty rect.
+	*/
+	void ComputeObjectRects4(FDistanceFieldCullingContext& Context, const FBox& ReceiverBounds, int32 FirstObject)
+	{
+		const FDistanceFieldShadowView& View = *Context.View;
+		const FDistanceFieldTileObjects& Tiles = *Context.Tiles;
+		const FVector LightDirection = -Context.Dir;
+
+		VectorRegister ObjectMin[3];
+		VectorRegister ObjectMax[3];
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			ObjectMin[Axis] = VectorLoad(&Context.BoundsMin[Axis][FirstObject]);
+			ObjectMax[Axis] = VectorLoad(&Context.BoundsMax[Axis][FirstObject]);
+		}
+
+		// Range of the sweep along the light in which the box overlaps the receivers
+		VectorRegister Valid = VectorCompareEQ(VectorZero(), VectorZero());
+		VectorRegister MinT = VectorZero();
+		VectorRegister MaxT = VectorSetFloat1(BigNumber);
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const VectorRegister ReceiverMin = VectorSetFloat1(ReceiverBounds.Min[Axis]);
+			const VectorRegister ReceiverMax = VectorSetFloat1(ReceiverBounds.Max[Axis]);
+			if (LightDirection[Axis] == 0)
+			{
+				Valid = VectorBitwiseAnd(Valid, VectorBitwiseAnd(VectorMask_LE(ObjectMin[Axis], ReceiverMax), VectorMask_GE(ObjectMax[Axis], ReceiverMin)));
+				continue;
+			}
+
+			const VectorRegister L = VectorSetFloat1(LightDirection[Axis]);
+			const VectorRegister Near = LightDirection[Axis] > 0 ? VectorSubtract(ReceiverMin, ObjectMax[Axis]) : VectorSubtract(ReceiverMax, ObjectMin[Axis]);
+			const VectorRegister Far = LightDirection[Axis] > 0 ? VectorSubtract(ReceiverMax, ObjectMin[Axis]) : VectorSubtract(ReceiverMin, ObjectMax[Axis]);
+			MinT = VectorMax(MinT, VectorDivide(Near, L));
+			MaxT = VectorMin(MaxT, VectorDivide(Far, L));
+		}
+		Valid = VectorBitwiseAnd(Valid, VectorMask_LE(MinT, MaxT));
+		MaxT = VectorMax(MinT, MaxT);
+
+		VectorRegister ExtrudedMin[3];
+		VectorRegister ExtrudedMax[3];
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			const VectorRegister L = VectorSetFloat1(LightDirection[Axis]);
+			const VectorRegister Start = VectorMultiply(L, MinT);
+			const VectorRegister End = VectorMultiply(L, MaxT);
+			ExtrudedMin[Axis] = VectorMax(VectorAdd(ObjectMin[Axis], VectorMin(Start, End)), VectorSetFloat1(ReceiverBounds.Min[Axis]));
+			ExtrudedMax[Axis] = VectorMin(VectorAdd(ObjectMax[Axis], VectorMax(Start, End)), VectorSetFloat1(ReceiverBounds.Max[Axis]));
+		}
+
+		// Project the corners, a corner behind the eye makes the rect the whole screen
+		VectorRegister ScreenMin[2] = { VectorSetFloat1(BigNumber), VectorSetFloat1(BigNumber) };
+		VectorRegister ScreenMax[2] = { VectorSetFloat1(-BigNumber), VectorSetFloat1(-BigNumber) };
+		VectorRegister Behind = VectorZero();
+		const FVector* Axes[3] = { &View.Right, &View.Up, &View.Forward };
+		for (int32 Corner = 0; Corner < 8; Corner++)
+		{
+			VectorRegister Relative[3];
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Relative[Axis] = VectorSubtract((Corner >> Axis) & 1 ? ExtrudedMax[Axis] : ExtrudedMin[Axis], VectorSetFloat1(View.EyePosition[Axis]));
+			}
+
+			VectorRegister ViewSpace[3];
+			for (int32 ViewAxis = 0; ViewAxis < 3; ViewAxis++)
+			{
+				const FVector& A = *Axes[ViewAxis];
+				ViewSpace[ViewAxis] = VectorMultiplyAdd(Relative[2], VectorSetFloat1(A.Z),
+					VectorMultiplyAdd(Relative[1], VectorSetFloat1(A.Y), VectorMultiply(Relative[0], VectorSetFloat1(A.X))));
+			}
+
+			Behind = VectorBitwiseOr(Behind, VectorMask_LE(ViewSpace[2], VectorSetFloat1(SMALL_NUMBER)));
+			const VectorRegister InvZ = VectorDivide(VectorOne(), VectorMax(ViewSpace[2], VectorSetFloat1(SMALL_NUMBER)));
+			const VectorRegister NDCX = VectorMultiply(ViewSpace[0], VectorMultiply(InvZ, VectorSetFloat1(1.0f / View.TanHalfFovX)));
+			const VectorRegister NDCY = VectorMultiply(ViewSpace[1], VectorMultiply(InvZ, VectorSetFloat1(1.0f / View.TanHalfFovY)));
+
+			// Inverse of GetDistanceFieldShadowWorldPosition, in pixel indices
+			const VectorRegister PixelX = VectorSubtract(VectorMultiply(VectorAdd(NDCX, VectorOne()), VectorSetFloat1(0.5f * Context.Width)), VectorSetFloat1(0.5f));
+			const VectorRegister PixelY = VectorSubtract(VectorMultiply(VectorSubtract(VectorOne(), NDCY), VectorSetFloat1(0.5f * Context.Height)), VectorSetFloat1(0.5f));
+			ScreenMin[0] = VectorMin(ScreenMin[0], PixelX);
+			ScreenMax[0] = VectorMax(ScreenMax[0], PixelX);
+			ScreenMin[1] = VectorMin(ScreenMin[1], PixelY);
+			ScreenMax[1] = VectorMax(ScreenMax[1], PixelY);
+		}
+
+		const float TileSize[2] = { (float)Tiles.TileSizeX, (float)Tiles.TileSizeY };
+		const float NumTiles[2] = { (float)Tiles.NumTilesX, (float)Tiles.NumTilesY };
+		VectorRegister RectMin[2];
+		VectorRegister RectMax[2];
+		for (int32 Axis = 0; Axis < 2; Axis++)
+		{
+			const VectorRegister InvTileSize = VectorSetFloat1(1.0f / TileSize[Axis]);
+			const VectorRegister Margin = VectorSetFloat1(RectMarginPixels);
+			// Clamped first, corners close to the eye's plane project far outside the int range VectorFloor converts through
+			const VectorRegister Limit = VectorSetFloat1(MaxScreenCoordinate);
+			RectMin[Axis] = VectorFloor(VectorMultiply(VectorMin(VectorMax(VectorSubtract(ScreenMin[Axis], Margin), VectorNegate(Limit)), Limit), InvTileSize));
+			RectMax[Axis] = VectorFloor(VectorMultiply(VectorMin(VectorMax(VectorAdd(ScreenMax[Axis], Margin), VectorNegate(Limit)), Limit), InvTileSize));
+
+			// Off screen
+			Valid = VectorBitwiseAnd(Valid, VectorBitwiseOr(Behind, VectorBitwiseAnd(
+				VectorMask_LT(RectMin[Axis], VectorSetFloat1(NumTiles[Axis])), VectorMask_GE(RectMax[Axis], VectorZero()))));
+
+			RectMin[Axis] = VectorSelect(Behind, VectorZero(), VectorMax(RectMin[Axis], VectorZero()));
+			RectMax[Axis] = VectorSelect(Behind, VectorSetFloat1(NumTiles[Axis] - 1), VectorMin(RectMax[Axis], VectorSetFloat1(NumTiles[Axis] - 1)));
+		}
+
+		// Empty rects for the culled lanes
+		VectorStore(VectorSelect(Valid, RectMin[0], VectorSetFloat1(BigNumber)), &Context.RectMinX[FirstObject]);
+		VectorStore(VectorSelect(Valid, RectMax[0], VectorSetFloat1(-BigNumber)), &Context.RectMaxX[FirstObject]);
+		VectorStore(VectorSelect(Valid, RectMin[1], VectorSetFloat1(BigNumber)), &Context.RectMinY[FirstObject]);
+		VectorStore(VectorSelect(Valid, RectMax[1], VectorSetFloat1(-BigNumber)), &Context.RectMaxY[FirstObject]);
+	}
+}
+
+/** Builds the tile bounds or the lists of rows of tiles, pulled from a shared counter until none are left. */
+class FDistanceFieldCullingTask
+{
+public:
+	FDistanceFieldCullingTask(FDistanceFieldCullingContext* InContext, bool bInBuildLists, std::atomic<int32>* InNextRow)
+		: Context(InContext)
+		, bBuildLists(bInBuildLists)
+		, NextRow(InNextRow)
+		, NumTests(0)
+	{}
+
+	void DoWork()
+	{
+		for (int32 Y = (*NextRow)++; Y < Context->Tiles->NumTilesY; Y = (*NextRow)++)
+		{
+			if (bBuildLists)
+			{
+				BuildRowLists(Y);
+			}
+			else
+			{
+				BuildRowBounds(Y);
+			}
+		}
+	}
+
+	int32 NumTests;
+
+private:
+	void BuildRowBounds(int32 TileY)
+	{
+		FDistanceFieldTileObjects& Tiles = *Context->Tiles;
+		const int32 MinY = TileY * Tiles.TileSizeY;
+		const int32 MaxY = FMath::Min(MinY + Tiles.TileSizeY, Context->Height);
+		for (int32 TileX = 0; TileX < Tiles.NumTilesX; TileX++)
+		{
+			const int32 MinX = TileX * Tiles.TileSizeX;
+			const int32 MaxX = FMath::Min(MinX + Tiles.TileSizeX, Context->Width);
+			FBox Bounds(0);
+			for (int32 Y = MinY; Y < MaxY; Y++)
+			{
+				for (int32 X = MinX; X < MaxX; X++)
+				{
+					const int32 PixelIndex = Y * Context->Width + X;
+					if (Context->NormalBuffer && FVector::DotProduct(Context->NormalBuffer[PixelIndex], Context->Dir) < 0)
+					{
+						continue;
+					}
+					Bounds += GetDistanceFieldShadowWorldPosition(*Context->View, X, Y, Context->Width, Context->Height, Context->DepthBuffer[PixelIndex]);
+				}
+			}
+			Tiles.TileBounds[TileY * Tiles.NumTilesX + TileX] = Bounds;
+		}
+	}
+
+	void BuildRowLists(int32 TileY)
+	{
+		const FDistanceFieldTileObjects& Tiles = *Context->Tiles;
+
+		// Objects whose rect covers the row, their bounds copied to contiguous lanes
+		Candidates.clear();
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			CandidateMin[Axis].clear();
+			CandidateMax[Axis].clear();
+		}
+		CandidateRectMinX.clear();
+		CandidateRectMaxX.clear();
+
+		const VectorRegister Row = VectorSetFloat1((float)TileY);
+		for (int32 ObjectIndex = 0; ObjectIndex < Context->NumPaddedObjects; ObjectIndex += 4)
+		{
+			const VectorRegister Overlap = VectorBitwiseAnd(
+				VectorMask_LE(VectorLoad(&Context->RectMinY[ObjectIndex]), Row),
+				VectorMask_GE(VectorLoad(&Context->RectMaxY[ObjectIndex]), Row));
+			for (int32 Bits = VectorMaskBits(Overlap); Bits; Bits &= Bits - 1)
+			{
+				AddCandidate(ObjectIndex + appCountTrailingZeros(Bits));
+			}
+		}
+		while (Candidates.size() % 4)
+		{
+			AddCandidate(INDEX_NONE);
+		}
+
+		TArray<int32>& Counts = Context->RowCounts[TileY];
+		TArray<int32>& Objects = Context->RowObjects[TileY];
+		Counts.assign(Tiles.NumTilesX, 0);
+		Objects.clear();
+		for (int32 TileX = 0; TileX < Tiles.NumTilesX; TileX++)
+		{
+			const FBox& TileBounds = Tiles.TileBounds[TileY * Tiles.NumTilesX + TileX];
+			if (!TileBounds.IsValid)
+			{
+				continue;
+			}
+
+			const VectorRegister Column = VectorSetFloat1((float)TileX);
+			for (uint32 CandidateIndex = 0; CandidateIndex < Candidates.size(); CandidateIndex += 4)
+			{
+				VectorRegister Mask = VectorBitwiseAnd(
+					VectorMask_LE(VectorLoad(&CandidateRectMinX[CandidateIndex]), Column),
+					VectorMask_GE(VectorLoad(&CandidateRectMaxX[CandidateIndex]), Column));
+				if (!VectorMaskBits(Mask))
+				{
+					continue;
+				}
+
+				VectorRegister OtherMin[3];
+				VectorRegister OtherMax[3];
+				for (int32 Axis = 0; Axis < 3; Axis++)
+				{
+					OtherMin[Axis] = VectorLoad(&CandidateMin[Axis][CandidateIndex]);
+					OtherMax[Axis] = VectorLoad(&CandidateMax[Axis][CandidateIndex]);
+				}
+				Mask = VectorBitwiseAnd(Mask, SweptBoxOverlapping4(TileBounds, Context->Dir, OtherMin, OtherMax));
+				NumTests++;
+
+				for (int32 Bits = VectorMaskBits(Mask); Bits; Bits &= Bits - 1)
+				{
+					Objects.push_back(Candidates[CandidateIndex + appCountTrailingZeros(Bits)]);
+					Counts[TileX]++;
+				}
+			}
+		}
+	}
+
+	void AddCandidate(int32 ObjectIndex)
+	{
+		Candidates.push_back(ObjectIndex);
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			CandidateMin[Axis].push_back(ObjectIndex != INDEX_NONE ? Context->BoundsMin[Axis][ObjectIndex] : 0);
+			CandidateMax[Axis].push_back(ObjectIndex != INDEX_NONE ? Context->BoundsMax[Axis][ObjectIndex] : 0);
+		}
+		CandidateRectMinX.push_back(ObjectIndex != INDEX_NONE ? Context->RectMinX[ObjectIndex] : BigNumber);
+		CandidateRectMaxX.push_back(ObjectIndex != INDEX_NONE ? Context->RectMaxX[ObjectIndex] : -BigNumber);
+	}
+
+	FDistanceFieldCullingContext* Context;
+	bool bBuildLists;
+	std::atomic<int32>* NextRow;
+
+	TArray<int32> Candidates;
+	TArray<float> CandidateMin[3];
+	TArray<float> CandidateMax[3];
+	TArray<float> CandidateRectMinX;
+	TArray<float> CandidateRectMaxX;
+};
+
+namespace
+{
+	/** Returns the number of SIMD tests. */
+	int32 RunDistanceFieldCullingTasks(FDistanceFieldCullingContext& Context, bool bBuildLists)
+	{
+		std::atomic<int32> NextRow(0);
+		const int32 NumWorkers = FMath::Clamp((int32)std::thread::hardware_concurrency(), 1, MAXTHREADNUM);
+		FQueuedThreadPool ThreadPool;
+		TArray<FAsyncTask<FDistanceFieldCullingTask>*> AsyncTasks;
+
+		for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+		{
+			FAsyncTask<FDistanceFieldCullingTask>* Task = new FAsyncTask<FDistanceFieldCullingTask>(&Context, bBuildLists, &NextRow);
+			ThreadPool.AddWork(Task);
+			AsyncTasks.push_back(Task);
+		}
+		ThreadPool.DoAllWork();
+
+		int32 NumTests = 0;
+		for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+		{
+			NumTests += AsyncTasks[TaskIndex]->GetTask().NumTests;
+			delete AsyncTasks[TaskIndex];
+		}
+		return NumTests;
+	}
+}
+
+bool IsSweptBoxOverlapping(const FBox& Box, const FVector& Dir, const FBox& Other)
+{
+	float MinT = 0;
+	float MaxT = BigNumber;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if (Dir[Axis] == 0)
+		{
+			if (Box.Min[Axis] > Other.Max[Axis] || Box.Max[Axis] < Other.Min[Axis])
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float EnterT = (Other.Min[Axis] - Box.Max[Axis]) / Dir[Axis];
+		float ExitT = (Other.Max[Axis] - Box.Min[Axis]) / Dir[Axis];
+		if (EnterT > ExitT)
+		{
+			EnterT = (Other.Max[Axis] - Box.Min[Axis]) / Dir[Axis];
+			ExitT = (Other.Min[Axis] - Box.Max[Axis]) / Dir[Axis];
+		}
+		MinT = FMath::Max(MinT, EnterT);
+		MaxT = FMath::Min(MaxT, ExitT);
+	}
+	return MinT <= MaxT;
+}
+
+void CullDistanceFieldObjectsForLight(
+	const FDistanceFieldShadowView& View
+	, const FVector& LightDirection
+	, const FBox* ObjectBounds
+	, int32 NumObjects
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, int32 TileSizeX
+	, int32 TileSizeY
+	, FDistanceFieldTileObjects& OutTiles
+	, FDistanceFieldCullingStats* OutStats)
+{
+	OutTiles.TileSizeX = TileSizeX;
+	OutTiles.TileSizeY = TileSizeY;
+	OutTiles.NumTilesX = FMath::DivideAndRoundUp(Width, TileSizeX);
+	OutTiles.NumTilesY = FMath::DivideAndRoundUp(Height, TileSizeY);
+	const int32 NumTiles = OutTiles.NumTilesX * OutTiles.NumTilesY;
+	OutTiles.TileBounds.resize(NumTiles);
+
+	FDistanceFieldCullingContext Context;
+	Context.View = &View;
+	Context.Dir = -LightDirection;
+	Context.DepthBuffer = DepthBuffer;
+	Context.NormalBuffer = NormalBuffer;
+	Context.Width = Width;
+	Context.Height = Height;
+	Context.Tiles = &OutTiles;
+
+	RunDistanceFieldCullingTasks(Context, false);
+
+	FBox ReceiverBounds(0);
+	for (int32 TileIndex = 0; TileIndex < NumTiles; TileIndex++)
+	{
+		if (OutTiles.TileBounds[TileIndex].IsValid)
+		{
+			ReceiverBounds += OutTiles.TileBounds[TileIndex];
+		}
+	}
+
+	// Invalid padding boxes never reach a receiver
+	Context.NumPaddedObjects = ReceiverBounds.IsValid ? (NumObjects + 3) & ~3 : 0;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		Context.BoundsMin[Axis].assign(Context.NumPaddedObjects, BigNumber);
+		Context.BoundsMax[Axis].assign(Context.NumPaddedObjects, -BigNumber);
+	}
+	for (int32 ObjectIndex = 0; ObjectIndex < FMath::Min(NumObjects, Context.NumPaddedObjects); ObjectIndex++)
+	{
+		const FBox& Bounds = ObjectBounds[ObjectIndex];
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Context.BoundsMin[Axis][ObjectIndex] = Bounds.IsValid ? Bounds.Min[Axis] : BigNumber;
+			Context.BoundsMax[Axis][ObjectIndex] = Bounds.IsValid ? Bounds.Max[Axis] : -BigNumber;
+		}
+	}
+
+	Context.RectMinX.resize(Context.NumPaddedObjects);
+	Context.RectMaxX.resize(Context.NumPaddedObjects);
+	Context.RectMinY.resize(Context.NumPaddedObjects);
+	Context.RectMaxY.resize(Context.NumPaddedObjects);
+	for (int32 ObjectIndex = 0; ObjectIndex < Context.NumPaddedObjects; ObjectIndex += 4)
+	{
+		ComputeObjectRects4(Context, ReceiverBounds, ObjectIndex);
+	}
+
+	Context.RowCounts.resize(OutTiles.NumTilesY);
+	Context.RowObjects.resize(OutTiles.NumTilesY);
+	const int32 NumTests = RunDistanceFieldCullingTasks(Context, true);
+
+	OutTiles.Offsets.resize(NumTiles + 1);
+	OutTiles.Objects.clear();
+	int32 MaxTileObjects = 0;
+	for (int32 TileY = 0; TileY < OutTiles.NumTilesY; TileY++)
+	{
+		const TArray<int32>& Counts = Context.RowCounts[TileY];
+		for (int32 TileX = 0; TileX < OutTiles.NumTilesX; TileX++)
+		{
+			OutTiles.Offsets[TileY * OutTiles.NumTilesX + TileX] = OutTiles.Objects.size();
+			OutTiles.Objects.insert(OutTiles.Objects.end(), Counts.empty() ? 0 : Counts[TileX], 0);
+			MaxTileObjects = FMath::Max(MaxTileObjects, Counts.empty() ? 0 : Counts[TileX]);
+		}
+		const TArray<int32>& RowObjects = Context.RowObjects[TileY];
+		std::copy(RowObjects.begin(), RowObjects.end(), OutTiles.Objects.end() - RowObjects.size());
+	}
+	OutTiles.Offsets[NumTiles] = OutTiles.Objects.size();
+
+	if (OutStats)
+	{
+		FDistanceFieldCullingStats Stats;
+		for (int32 ObjectIndex = 0; ObjectIndex < FMath::Min(NumObjects, Context.NumPaddedObjects); ObjectIndex++)
+		{
+			Stats.NumVisibleObjects += Context.RectMinY[ObjectIndex] <= Context.RectMaxY[ObjectIndex] ? 1 : 0;
+		}
+		Stats.NumTests = NumTests * 4;
+		Stats.NumTileObjects = OutTiles.Objects.size();
+		Stats.MaxTileObjects = MaxTileObjects;
+		*OutStats = Stats;
+	}
+}
@@ -0,0 +1,92 @@
+#ifndef _DISTANCEFIELDCULLING
+#define _DISTANCEFIELDCULLING
+#include "Config.h"
+#include "Box.h"
+#include "DistanceFieldShadow.h"
+
+/** Tile size of the lists a single shadow pass reads per pixel. */
+#define DISTANCEFIELD_CULLING_TILE_SIZE 16
+
+/**
+* The objects that can shadow any pixel of each screen tile, for one light.
+* Lists are stored back to back, the objects of tile i are Objects[Offsets[i]] to Objects[Offsets[i + 1] - 1].
+*/
+struct FDistanceFieldTileObjects
+{
+	int32 TileSizeX;
+	int32 TileSizeY;
+	int32 NumTilesX;
+	int32 NumTilesY;
+
+	/** NumTilesX * NumTilesY + 1 entries. */
+	TArray<int32> Offsets;
+
+	/** Object indices, ascending within each tile. */
+	TArray<int32> Objects;
+
+	/** World bounds of the pixels of each tile facing the light, invalid when there are none. */
+	TArray<FBox> TileBounds;
+
+	int32 GetTileIndex(int32 X, int32 Y) const
+	{
+		return Y / TileSizeY * NumTilesX + X / TileSizeX;
+	}
+
+	int32 GetNumObjects(int32 TileIndex) const
+	{
+		return Offsets[TileIndex + 1] - Offsets[TileIndex];
+	}
+
+	const int32* GetObjects(int32 TileIndex) const
+	{
+		return Objects.data() + Offsets[TileIndex];
+	}
+};
+
+struct FDistanceFieldCullingStats
+{
+	/** Objects whose bounds extruded along the light reach any tile. */
+	int32 NumVisibleObjects;
+
+	/** Tile against object tests, four per SIMD test. */
+	int32 NumTests;
+
+	/** Total length of the lists. */
+	int32 NumTileObjects;
+
+	int32 MaxTileObjects;
+
+	FDistanceFieldCullingStats()
+		: NumVisibleObjects(0)
+		, NumTests(0)
+		, NumTileObjects(0)
+		, MaxTileObjects(0)
+	{}
+};
+
+/** Whether Box swept along Dir from t = 0 to infinity overlaps Other, one slab per axis. */
+bool IsSweptBoxOverlapping(const FBox& Box, const FVector& Dir, const FBox& Other);
+
+/**
+* Bins world bounds of objects into screen tiles of a linear depth buffer (view depth / far clip).
+* An object is listed for a tile when a ray from one of the tile's pixels towards the light can reach its bounds,
+* the same test the CPU shadow tracer uses per tile.
+* Objects are first reduced to the screen rect of their bounds extruded along the light, four at a time with SSE,
+* then rows of tiles are spread over worker threads and test the objects whose rect they overlap four at a time.
+* @param NormalBuffer	World normals, pixels facing away from the light are left out of the tile bounds. May be NULL.
+*/
+void CullDistanceFieldObjectsForLight(
+	const FDistanceFieldShadowView& View
+	, const FVector& LightDirection
+	, const FBox* ObjectBounds
+	, int32 NumObjects
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, int32 TileSizeX
+	, int32 TileSizeY
+	, FDistanceFieldTileObjects& OutTiles
+	, FDistanceFieldCullingStats* OutStats = NULL);
+
+#endif // !_DISTANCEFIELDCULLING
@@ -0,0 +1,321 @@
+#include "DistanceFieldFormat.h"
+#include "sse.h"
+
+namespace
+{
+	/** Unpacks 16 unorm8 codes to floats as Code * Scale + Bias. */
+	FORCEINLINE void DecodeUnorm8x16(const uint8* Src, VectorRegister Scale, VectorRegister Bias, float* Out)
+	{
+		const __m128i Zero = _mm_setzero_si128();
+		const __m128i Codes = _mm_loadu_si128((const __m128i*)Src);
+		const __m128i Lo = _mm_unpacklo_epi8(Codes, Zero);
+		const __m128i Hi = _mm_unpackhi_epi8(Codes, Zero);
+		VectorStore(VectorMultiplyAdd(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Lo, Zero)), Scale, Bias), Out + 0);
+		VectorStore(VectorMultiplyAdd(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Lo, Zero)), Scale, Bias), Out + 4);
+		VectorStore(VectorMultiplyAdd(_mm_cvtepi32_ps(_mm_unpacklo_epi16(Hi, Zero)), Scale, Bias), Out + 8);
+		VectorStore(VectorMultiplyAdd(_mm_cvtepi32_ps(_mm_unpackhi_epi16(Hi, Zero)), Scale, Bias), Out + 12);
+	}
+
+	FORCEINLINE float DecodeHalf(uint16 Encoded)
+	{
+		FFloat16 Value;
+		Value.Encoded = Encoded;
+		return Value.GetFloat();
+	}
+
+	FORCEINLINE uint16 EncodeHalf(float Value)
+	{
+		return FFloat16(Value).Encoded;
+	}
+}
+
+FCompressedDistanceFieldVolume::FCompressedDistanceFieldVolume()
+	: Format(DFF_Float16)
+	, Size(FIntVector(0, 0, 0))
+	, NumBlocks(FIntVector(0, 0, 0))
+	, Scale(1.0f)
+	, Bias(0.0f)
+{
+}
+
+void FCompressedDistanceFieldVolume::Empty()
+{
+	TArray<uint8>().swap(Data);
+	Size = NumBlocks = FIntVector(0, 0, 0);
+	Scale = 1.0f;
+	Bias = 0.0f;
+}
+
+void FCompressedDistanceFieldVolume::Encode(const float* Src, const FIntVector& InSize, EDistanceFieldFormat InFormat, FDistanceFieldCompressionStats* OutStats)
+{
+	const int32 NumVoxels = InSize.X * InSize.Y * InSize.Z;
+
+	Format = InFormat;
+	Size = InSize;
+	NumBlocks = FIntVector(0, 0, 0);
+	Scale = 1.0f;
+	Bias = 0.0f;
+	Data.clear();
+
+	if (Format == DFF_Float16)
+	{
+		Data.resize(NumVoxels * sizeof(FFloat16));
+		ConvertFloatToHalf(Src, (FFloat16*)Data.data(), NumVoxels);
+	}
+	else if (Format == DFF_Unorm8)
+	{
+		float MinValue = MAX_flt;
+		float MaxValue = -MAX_flt;
+		for (int32 Index = 0; Index < NumVoxels; Index++)
+		{
+			MinValue = FMath::Min(MinValue, Src[Index]);
+			MaxValue = FMath::Max(MaxValue, Src[Index]);
+		}
+
+		Bias = MinValue;
+		Scale = (MaxValue - MinValue) / 255.0f;
+		const float InvScale = Scale > 0 ? 1.0f / Scale : 0.0f;
+
+		Data.resize(NumVoxels);
+		for (int32 Index = 0; Index < NumVoxels; Index++)
+		{
+			Data[Index] = (uint8)FMath::Clamp(FMath::RoundToInt((Src[Index] - Bias) * InvScale), 0, 255);
+		}
+	}
+	else
+	{
+		EncodeBlocks(Src);
+	}
+
+	if (OutStats)
+	{
+		TArray<float> Decoded(NumVoxels);
+		Decode(Decoded.data());
+
+		double SumSquaredError = 0;
+		float MaxError = 0;
+		for (int32 Index = 0; Index < NumVoxels; Index++)
+		{
+			const float Error = FMath::Abs(Decoded[Index] - Src[Index]);
+			MaxError = FMath::Max(MaxError, Error);
+			SumSquaredError += (double)Error * Error;
+		}
+
+		OutStats->MaxError = MaxError;
+		OutStats->RMSError = NumVoxels > 0 ? (float)sqrt(SumSquaredError / NumVoxels) : 0.0f;
+		OutStats->SourceBytes = NumVoxels * sizeof(uint16);
+		OutStats->CompressedBytes = Data.size();
+	}
+}
+
+void FCompressedDistanceFieldVolume::EncodeBlocks(const float* Src)
+{
+	NumBlocks = FIntVector(
+		FMath::DivideAndRoundUp(Size.X, (int32)BlockSize),
+		FMath::DivideAndRoundUp(Size.Y, (int32)BlockSize),
+		FMath::DivideAndRoundUp(Size.Z, (int32)BlockSize));
+
+	Data.resize(NumBlocks.X * NumBlocks.Y * NumBlocks.Z * sizeof(FDistanceFieldBlock));
+	FDistanceFieldBlock* Blocks = (FDistanceFieldBlock*)Data.data();
+
+	for (int32 BlockZ = 0; BlockZ < NumBlocks.Z; BlockZ++)
+	{
+		for (int32 BlockY = 0; BlockY < NumBlocks.Y; BlockY++)
+		{
+			for (int32 BlockX = 0; BlockX < NumBlocks.X; BlockX++)
+			{
+				// Gather the block, replicating edge voxels so partial blocks do not widen the range
+				float Values[BlockVoxels];
+				float MinValue = MAX_flt;
+				float MaxValue = -MAX_flt;
+				for (int32 Z = 0; Z < BlockSize; Z++)
+				{
+					const int32 VolumeZ = FMath::Min(BlockZ * BlockSize + Z, Size.Z - 1);
+					for (int32 Y = 0; Y < BlockSize; Y++)
+					{
+						const int32 VolumeY = FMath::Min(BlockY * BlockSize + Y, Size.Y - 1);
+						for (int32 X = 0; X < BlockSize; X++)
+						{
+							const int32 VolumeX = FMath::Min(BlockX * BlockSize + X, Size.X - 1);
+							const float Value = Src[(VolumeZ * Size.Y + VolumeY) * Size.X + VolumeX];
+							Values[(Z * BlockSize + Y) * BlockSize + X] = Value;
+							MinValue = FMath::Min(MinValue, Value);
+							MaxValue = FMath::Max(MaxValue, Value);
+						}
+					}
+				}
+
+				FDistanceFieldBlock& Block = Blocks[(BlockZ * NumBlocks.Y + BlockY) * NumBlocks.X + BlockX];
+				Block.MinEncoded = EncodeHalf(MinValue);
+				Block.MaxEncoded = EncodeHalf(MaxValue);
+
+				// Quantize against the endpoints the decoder will actually see
+				const float DecodedMin = DecodeHalf(Block.MinEncoded);
+				const float DecodedMax = DecodeHalf(Block.MaxEncoded);
+				const float Range = DecodedMax - DecodedMin;
+				const float InvStep = Range > 0 ? (BlockLevels - 1) / Range : 0.0f;
+
+				for (int32 Group = 0; Group < BlockVoxels / 8; Group++)
+				{
+					uint32 Bits = 0;
+					for (int32 Lane = 0; Lane < 8; Lane++)
+					{
+						const int32 Level = FMath::Clamp(FMath::RoundToInt((Values[Group * 8 + Lane] - DecodedMin) * InvStep), 0, BlockLevels - 1);
+						Bits |= (uint32)Level << (Lane * 3);
+					}
+
+					Block.Indices[Group * 3 + 0] = (uint8)(Bits);
+					Block.Indices[Group * 3 + 1] = (uint8)(Bits >> 8);
+					Block.Indices[Group * 3 + 2] = (uint8)(Bits >> 16);
+				}
+			}
+		}
+	}
+}
+
+void FCompressedDistanceFieldVolume::DecodeBlock(int32 BlockIndex, float Out[BlockVoxels]) const
+{
+	const FDistanceFieldBlock& Block = ((const FDistanceFieldBlock*)Data.data())[BlockIndex];
+	const float MinValue = DecodeHalf(Block.MinEncoded);
+	const float MaxValue = DecodeHalf(Block.MaxEncoded);
+	const VectorRegister Base = VectorSetFloat1(MinValue);
+	const VectorRegister Step = VectorSetFloat1((MaxValue - MinValue) / (BlockLevels - 1));
+
+	for (int32 Group = 0; Group < BlockVoxels / 8; Group++)
+	{
+		const uint32 Bits = Block.Indices[Group * 3 + 0]
+			| ((uint32)Block.Indices[Group * 3 + 1] << 8)
+			| ((uint32)Block.Indices[Group * 3 + 2] << 16);
+
+		const __m128i Lo = _mm_set_epi32((Bits >> 9) & 7, (Bits >> 6) & 7, (Bits >> 3) & 7, Bits & 7);
+		const __m128i Hi = _mm_set_epi32((Bits >> 21) & 7, (Bits >> 18) & 7, (Bits >> 15) & 7, (Bits >> 12) & 7);
+		VectorStore(VectorMultiplyAdd(_mm_cvtepi32_ps(Lo), Step, Base), Out + Group * 8);
+		VectorStore(VectorMultiplyAdd(_mm_cvtepi32_ps(Hi), Step, Base), Out + Group * 8 + 4);
+	}
+}
+
+void FCompressedDistanceFieldVolume::Decode(float* Out) const
+{
+	const int32 NumVoxels = Size.X * Size.Y * Size.Z;
+
+	if (Format == DFF_Float16)
+	{
+		ConvertHalfToFloat((const FFloat16*)Data.data(), Out, NumVoxels);
+	}
+	else if (Format == DFF_Unorm8)
+	{
+		const VectorRegister ScaleVector = VectorSetFloat1(Scale);
+		const VectorRegister BiasVector = VectorSetFloat1(Bias);
+		int32 Index = 0;
+		for (; Index + 16 <= NumVoxels; Index += 16)
+		{
+			DecodeUnorm8x16(&Data[Index], ScaleVector, BiasVector, Out + Index);
+		}
+
+		for (; Index < NumVoxels; Index++)
+		{
+			Out[Index] = Data[Index] * Scale + Bias;
+		}
+	}
+	else
+	{
+		float Block[BlockVoxels];
+		for (int32 BlockZ = 0; BlockZ < NumBlocks.Z; BlockZ++)
+		{
+			for (int32 BlockY = 0; BlockY < NumBlocks.Y; BlockY++)
+			{
+				for (int32 BlockX = 0; BlockX < NumBlocks.X; BlockX++)
+				{
+					DecodeBlock((BlockZ * NumBlocks.Y + BlockY) * NumBlocks.X + BlockX, Block);
+
+					const int32 CountX = FMath::Min((int32)BlockSize, Size.X - BlockX * BlockSize);
+					const int32 CountY = FMath::Min((int32)BlockSize, Size.Y - BlockY * BlockSize);
+					const int32 CountZ = FMath::Min((int32)BlockSize, Size.Z - BlockZ * BlockSize);
+					for (int32 Z = 0; Z < CountZ; Z++)
+					{
+						for (int32 Y = 0; Y < CountY; Y++)
+						{
+							const float* Row = Block + (Z * BlockSize + Y) * BlockSize;
+							float* Dest = Out + ((BlockZ * BlockSize + Z) * Size.Y + BlockY * BlockSize + Y) * Size.X + BlockX * BlockSize;
+							if (CountX == BlockSize)
+							{
+								VectorStore(VectorLoad(Row), Dest);
+							}
+							else
+							{
+								for (int32 X = 0; X < CountX; X++)
+								{
+									Dest[X] = Row[X];
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void FCompressedDistanceFieldVolume::DecodeBrick(int32 X, int32 Y, int32 Z, float Out[BlockVoxels]) const
+{
+	// Aligned bricks map to exactly one block
+	if (Format == DFF_Block4x4x4
+		&& X % BlockSize == 0 && Y % BlockSize == 0 && Z % BlockSize == 0
+		&& X >= 0 && Y >= 0 && Z >= 0
+		&& X + BlockSize <= Size.X && Y + BlockSize <= Size.Y && Z + BlockSize <= Size.Z)
+	{
+		DecodeBlock(((Z / BlockSize) * NumBlocks.Y + Y / BlockSize) * NumBlocks.X + X / BlockSize, Out);
+		return;
+	}
+
+	const bool bRowsInside = Format == DFF_Float16 && X >= 0 && X + BlockSize <= Size.X;
+
+	for (int32 LocalZ = 0; LocalZ < BlockSize; LocalZ++)
+	{
+		for (int32 LocalY = 0; LocalY < BlockSize; LocalY++)
+		{
+			float* Row = Out + (LocalZ * BlockSize + LocalY) * BlockSize;
+			if (bRowsInside)
+			{
+				// Whole rows expand with the bulk converter, only Y and Z need clamping
+				const int32 VolumeY = FMath::Clamp(Y + LocalY, 0, Size.Y - 1);
+				const int32 VolumeZ = FMath::Clamp(Z + LocalZ, 0, Size.Z - 1);
+				ConvertHalfToFloat((const FFloat16*)Data.data() + (VolumeZ * Size.Y + VolumeY) * Size.X + X, Row, BlockSize);
+				continue;
+			}
+
+			for (int32 LocalX = 0; LocalX < BlockSize; LocalX++)
+			{
+				Row[LocalX] = GetVoxel(X + LocalX, Y + LocalY, Z + LocalZ);
+			}
+		}
+	}
+}
+
+float FCompressedDistanceFieldVolume::GetVoxel(int32 X, int32 Y, int32 Z) const
+{
+	X = FMath::Clamp(X, 0, Size.X - 1);
+	Y = FMath::Clamp(Y, 0, Size.Y - 1);
+	Z = FMath::Clamp(Z, 0, Size.Z - 1);
+
+	if (Format == DFF_Float16)
+	{
+		return DecodeHalf(((const uint16*)Data.data())[(Z * Size.Y + Y) * Size.X + X]);
+	}
+	else if (Format == DFF_Unorm8)
+	{
+		return Data[(Z * Size.Y + Y) * Size.X + X] * Scale + Bias;
+	}
+
+	const FDistanceFieldBlock& Block = ((const FDistanceFieldBlock*)Data.data())[((Z / BlockSize) * NumBlocks.Y + Y / BlockSize) * NumBlocks.X + X / BlockSize];
+	const int32 Voxel = ((Z % BlockSize) * BlockSize + Y % BlockSize) * BlockSize + X % BlockSize;
+	const int32 Group = Voxel / 8;
+	const uint32 Bits = Block.Indices[Group * 3 + 0]
+		| ((uint32)Block.Indices[Group * 3 + 1] << 8)
+		| ((uint32)Block.Indices[Group * 3 + 2] << 16);
+	const int32 Level = (Bits >> ((Voxel % 8) * 3)) & 7;
+
+	const float MinValue = DecodeHalf(Block.MinEncoded);
+	const float MaxValue = DecodeHalf(Block.MaxEncoded);
+	return MinValue + Level * (MaxValue - MinValue) / (BlockLevels - 1);
+}
@@ -0,0 +1,129 @@
+#ifndef _DISTANCEFIELDFORMAT
+#define _DISTANCEFIELDFORMAT
+#include "Config.h"
+#include "IntVector.h"
+#include "Float16.h"
+
+/**
+* Storage formats for the resident copy of a distance field volume.
+* All of them store volume space distances (distance / max extent of the volume bounds).
+*/
+enum EDistanceFieldFormat
+{
+	/** One half float per voxel, 2 bytes. This is what the bake produces. */
+	DFF_Float16,
+
+	/** One byte per voxel, remapped with a per-volume scale and bias. */
+	DFF_Unorm8,
+
+	/** 4x4x4 blocks of two half endpoints and 64 3-bit indices, 28 bytes per 64 voxels. */
+	DFF_Block4x4x4,
+};
+
+/** Error introduced by encoding a volume, reported at bake time. */
+struct FDistanceFieldCompressionStats
+{
+	/** Largest absolute error over all voxels, in volume space units. */
+	float MaxError;
+
+	/** Root mean square error over all voxels, in volume space units. */
+	float RMSError;
+
+	/** Bytes of the half float volume the encoding replaces. */
+	SIZE_t SourceBytes;
+
+	/** Bytes of the encoded volume. */
+	SIZE_t CompressedBytes;
+
+	FDistanceFieldCompressionStats()
+		: MaxError(0)
+		, RMSError(0)
+		, SourceBytes(0)
+		, CompressedBytes(0)
+	{}
+};
+
+/**
+* One block of DFF_Block4x4x4.
+* Voxel = Min + Index * (Max - Min) / 7, indices are packed 8 per 3 bytes in X, Y, Z order.
+*/
+struct FDistanceFieldBlock
+{
+	uint16 MinEncoded;
+	uint16 MaxEncoded;
+	uint8 Indices[24];
+};
+
+/**
+* Distance field volume held in one of the EDistanceFieldFormat encodings.
+* Voxels are addressed like FDistanceFieldVolumeData::DistanceFieldVolume, X fastest.
+*/
+class FCompressedDistanceFieldVolume
+{
+public:
+	enum
+	{
+		BlockSize = 4,
+		BlockVoxels = BlockSize * BlockSize * BlockSize,
+		BlockLevels = 8,
+	};
+
+	/** Encoding of Data. */
+	EDistanceFieldFormat Format;
+
+	/** Dimensions of the volume in voxels. */
+	FIntVector Size;
+
+	/** Number of blocks along each axis, only used by DFF_Block4x4x4. */
+	FIntVector NumBlocks;
+
+	/** DFF_Unorm8 decode: Value = Code * Scale + Bias. */
+	float Scale;
+	float Bias;
+
+	/** Encoded voxels or blocks. */
+	TArray<uint8> Data;
+
+	FCompressedDistanceFieldVolume();
+
+	/**
+	* Encodes a volume.
+	*
+	* @param Src			Size.X * Size.Y * Size.Z volume space distances
+	* @param InSize		Dimensions of Src
+	* @param InFormat		Encoding to use
+	* @param OutStats		Optional error report, computed by decoding the result
+	*/
+	void Encode(const float* Src, const FIntVector& InSize, EDistanceFieldFormat InFormat, FDistanceFieldCompressionStats* OutStats = NULL);
+
+	/** Decodes the whole volume into Size.X * Size.Y * Size.Z floats. */
+	void Decode(float* Out) const;
+
+	/**
+	* Decodes the 4x4x4 brick starting at voxel (X, Y, Z), X fastest.
+	* Voxels past the volume edge are clamped to the edge like a CLAMP sampler.
+	*/
+	void DecodeBrick(int32 X, int32 Y, int32 Z, float Out[BlockVoxels]) const;
+
+	/** Decodes a single voxel. */
+	float GetVoxel(int32 X, int32 Y, int32 Z) const;
+
+	bool IsValid() const
+	{
+		return !Data.empty();
+	}
+
+	SIZE_t GetResourceSize() const
+	{
+		return Data.capacity();
+	}
+
+	void Empty();
+
+private:
+
+	void EncodeBlocks(const float* Src);
+	void DecodeBlock(int32 BlockIndex, float Out[BlockVoxels]) const;
+};
+
+#endif // !_DISTANCEFIELDFORMAT
@@ -0,0 +1,233 @@
+#include "DistanceFieldMerge.h"
+#include "MeshUtilities.h"
+#include "DistanceFieldSampler.h"
+#include <algorithm>
+
+namespace
+{
+	/** A source volume placed in the merged space. */
+	struct FDistanceFieldMergeSource
+	{
+		FDistanceFieldSampler Sampler;
+		FVector Offset;
+
+		/** Returned everywhere when the source has no voxels. */
+		float FarDistance;
+
+		FDistanceFieldMergeSource(const FDistanceFieldVolumeData& Data, const FVector& InOffset, float InFarDistance)
+			: Sampler(Data)
+			, Offset(InOffset)
+			, FarDistance(InFarDistance)
+		{}
+
+		/** Distances at a list of merged space positions, LocalPositions is scratch space of the same size. */
+		void SampleBatch(const FVector* Positions, int32 NumPositions, FVector* LocalPositions, float* OutDistances) const
+		{
+			if (!Sampler.IsValid())
+			{
+				std::fill(OutDistances, OutDistances + NumPositions, FarDistance);
+				return;
+			}
+
+			for (int32 Index = 0; Index < NumPositions; Index++)
+			{
+				LocalPositions[Index] = Positions[Index] - Offset;
+			}
+			Sampler.SampleBatch(LocalPositions, NumPositions, OutDistances);
+		}
+	};
+
+	FORCEINLINE float CombineDistances(float A, float B, EDistanceFieldMergeOp Op, float SmoothRadius)
+	{
+		switch (Op)
+		{
+		case DFMerge_Subtract:
+			return FMath::Max(A, -B);
+		case DFMerge_Intersect:
+			return FMath::Max(A, B);
+		case DFMerge_SmoothUnion:
+			if (SmoothRadius > 0)
+			{
+				const float H = FMath::Clamp(.5f + .5f * (B - A) / SmoothRadius, 0.0f, 1.0f);
+				return FMath::Lerp(B, A, H) - SmoothRadius * H * (1 - H);
+			}
+			return FMath::Min(A, B);
+		default:
+			return FMath::Min(A, B);
+		}
+	}
+}
+
+class FDistanceFieldMergeAsyncTask
+{
+public:
+	FDistanceFieldMergeAsyncTask(
+		const FDistanceFieldMergeSource* InSourceA,
+		const FDistanceFieldMergeSource* InSourceB,
+		EDistanceFieldMergeOp InOp,
+		float InSmoothRadius,
+		FBox InVolumeBounds,
+		FIntVector InVolumeDimensions,
+		int32 InZIndex,
+		TArray<SDFFloat>* DistanceFieldVolume)
+		: SourceA(InSourceA)
+		, SourceB(InSourceB)
+		, Op(InOp)
+		, SmoothRadius(InSmoothRadius)
+		, VolumeBounds(InVolumeBounds)
+		, VolumeDimensions(InVolumeDimensions)
+		, ZIndex(InZIndex)
+		, OutDistanceFieldVolume(DistanceFieldVolume)
+	{}
+
+	void DoWork()
+	{
+		const FVector VoxelSize(VolumeBounds.GetSize() / FVector(VolumeDimensions.X, VolumeDimensions.Y, VolumeDimensions.Z));
+		const float InvMaxExtent = 1.0f / VolumeBounds.GetExtent().GetMax();
+		TArray<FVector> RowPositions(VolumeDimensions.X);
+		TArray<FVector> LocalPositions(VolumeDimensions.X);
+		TArray<float> DistancesA(VolumeDimensions.X);
+		TArray<float> DistancesB(VolumeDimensions.X);
+		TArray<float> RowDistances(VolumeDimensions.X);
+
+		for (int32 YIndex = 0; YIndex < VolumeDimensions.Y; YIndex++)
+		{
+			for (int32 XIndex = 0; XIndex < VolumeDimensions.X; XIndex++)
+			{
+				RowPositions[XIndex] = FVector(XIndex + .5f, YIndex + .5f, ZIndex + .5f) * VoxelSize + VolumeBounds.Min;
+			}
+
+			SourceA->SampleBatch(RowPositions.data(), VolumeDimensions.X, LocalPositions.data(), DistancesA.data());
+			SourceB->SampleBatch(RowPositions.data(), VolumeDimensions.X, LocalPositions.data(), DistancesB.data());
+			for (int32 XIndex = 0; XIndex < VolumeDimensions.X; XIndex++)
+			{
+				RowDistances[XIndex] = CombineDistances(DistancesA[XIndex], DistancesB[XIndex], Op, SmoothRadius) * InvMaxExtent;
+			}
+
+			const int32 RowIndex = (ZIndex * VolumeDimensions.Y + YIndex) * VolumeDimensions.X;
+			ConvertFloatToSDFFloat(RowDistances.data(), &(*OutDistanceFieldVolume)[RowIndex], VolumeDimensions.X);
+		}
+	}
+
+private:
+	const FDistanceFieldMergeSource* SourceA;
+	const FDistanceFieldMergeSource* SourceB;
+	EDistanceFieldMergeOp Op;
+	float SmoothRadius;
+	FBox VolumeBounds;
+	FIntVector VolumeDimensions;
+	int32 ZIndex;
+	TArray<SDFFloat>* OutDistanceFieldVolume;
+};
+
+void MergeDistanceFieldVolumes(
+	const FDistanceFieldVolumeData& A
+	, const FVector& OffsetA
+	, const FDistanceFieldVolumeData& B
+	, const FVector& OffsetB
+	, EDistanceFieldMergeOp Op
+	, float SmoothRadius
+	, int32 MaxNumVoxelsOneDim
+	, FDistanceFieldVolumeData& OutData)
+{
+	const bool bHasA = A.Size.X * A.Size.Y * A.Size.Z > 0;
+	const bool bHasB = B.Size.X * B.Size.Y * B.Size.Z > 0;
+	const FBox BoxA = A.LocalBoundingBox.ShiftBy(OffsetA);
+	const FBox BoxB = B.LocalBoundingBox.ShiftBy(OffsetB);
+
+	OutData.Size = FIntVector(0, 0, 0);
+	OutData.DistanceFieldVolume.clear();
+	OutData.CompressedVolume.Empty();
+	OutData.Format = DFF_Float16;
+	OutData.bBuiltAsIfTwoSided = A.bBuiltAsIfTwoSided || B.bBuiltAsIfTwoSided;
+	OutData.bMeshWasPlane = A.bMeshWasPlane && B.bMeshWasPlane;
+
+	// Work out the region that can hold surface for this operator
+	FBox VolumeBounds(0);
+	if (Op == DFMerge_Subtract || !bHasB)
+	{
+		VolumeBounds = bHasA ? BoxA : FBox(0);
+	}
+	else if (!bHasA)
+	{
+		VolumeBounds = Op == DFMerge_Intersect ? FBox(0) : BoxB;
+	}
+	else if (Op == DFMerge_Intersect)
+	{
+		if (BoxA.Intersect(BoxB))
+		{
+			VolumeBounds = FBox(BoxA.Min.ComponentMax(BoxB.Min), BoxA.Max.ComponentMin(BoxB.Max));
+		}
+	}
+	else
+	{
+		VolumeBounds = BoxA + BoxB;
+	}
+
+	if (Op == DFMerge_Intersect && !(bHasA && bHasB))
+	{
+		VolumeBounds = FBox(0);
+	}
+
+	// Every operator reads the sign of both inputs, B's inside is what Subtract carves out,
+	// so the result is only valid if both sources were closed; empty space has no inside to get wrong
+	OutData.bMeshWasClosed = (!bHasA || A.bMeshWasClosed) && (!bHasB || B.bMeshWasClosed);
+	if (!VolumeBounds.IsValid)
+	{
+		OutData.LocalBoundingBox = BoxA + BoxB;
+		return;
+	}
+
+	OutData.LocalBoundingBox = VolumeBounds;
+
+	// Keep the finest voxel size of the sources that contribute
+	float VoxelSize = MAX_flt;
+	if (bHasA)
+	{
+		VoxelSize = FMath::Min(VoxelSize, (A.LocalBoundingBox.GetSize() / FVector(A.Size.X, A.Size.Y, A.Size.Z)).GetMin());
+	}
+	if (bHasB && Op != DFMerge_Subtract)
+	{
+		VoxelSize = FMath::Min(VoxelSize, (B.LocalBoundingBox.GetSize() / FVector(B.Size.X, B.Size.Y, B.Size.Z)).GetMin());
+	}
+
+	const int32 MinNumVoxelsOneDim = 8;
+	const FVector DesiredDimensions(VolumeBounds.GetSize() / VoxelSize);
+	const FIntVector VolumeDimensions(
+		FMath::Clamp(FMath::CeilToInt(DesiredDimensions.X), MinNumVoxelsOneDim, MaxNumVoxelsOneDim),
+		FMath::Clamp(FMath::CeilToInt(DesiredDimensions.Y), MinNumVoxelsOneDim, MaxNumVoxelsOneDim),
+		FMath::Clamp(FMath::CeilToInt(DesiredDimensions.Z), MinNumVoxelsOneDim, MaxNumVoxelsOneDim));
+
+	// Large enough to never win a min, small enough to keep the smooth union finite
+	const float FarDistance = 4 * VolumeBounds.GetSize().Size() + 4 * SmoothRadius;
+	const FDistanceFieldMergeSource SourceA(A, OffsetA, FarDistance);
+	const FDistanceFieldMergeSource SourceB(B, OffsetB, FarDistance);
+
+	OutData.Size = VolumeDimensions;
+	OutData.DistanceFieldVolume.resize(VolumeDimensions.X * VolumeDimensions.Y * VolumeDimensions.Z);
+
+	FQueuedThreadPool ThreadPool;
+	TArray<FAsyncTask<FDistanceFieldMergeAsyncTask>*> AsyncTasks;
+
+	for (int32 ZIndex = 0; ZIndex < VolumeDimensions.Z; ZIndex++)
+	{
+		FAsyncTask<FDistanceFieldMergeAsyncTask>* Task = new FAsyncTask<FDistanceFieldMergeAsyncTask>(
+			&SourceA,
+			&SourceB,
+			Op,
+			SmoothRadius,
+			VolumeBounds,
+			VolumeDimensions,
+			ZIndex,
+			&OutData.DistanceFieldVolume);
+
+		ThreadPool.AddWork(Task);
+		AsyncTasks.push_back(Task);
+	}
+	ThreadPool.DoAllWork();
+
+	for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+	{
+		delete AsyncTasks[TaskIndex];
+	}
+}
@@ -0,0 +1,50 @@
+#ifndef _DISTANCEFIELDMERGE
+#define _DISTANCEFIELDMERGE
+#include "Config.h"
+
+/** How two distance fields are combined by MergeDistanceFieldVolumes. */
+enum EDistanceFieldMergeOp
+{
+	/** min(A, B) */
+	DFMerge_Union,
+
+	/** max(A, -B), carves B out of A. */
+	DFMerge_Subtract,
+
+	/** max(A, B) */
+	DFMerge_Intersect,
+
+	/** Polynomial smooth min, blends the surfaces within SmoothRadius of each other. */
+	DFMerge_SmoothUnion,
+};
+
+/**
+* Resamples two distance field volumes into one volume covering both.
+* Each source is placed at its offset, sampled trilinearly with the same texel clamping as the shadow shader
+* and the results are combined per voxel. Slices are resampled in parallel.
+*
+* The output box is the union of the source boxes (A's box for DFMerge_Subtract, the overlap for DFMerge_Intersect),
+* its voxel size is the finest of the two sources, capped to MaxNumVoxelsOneDim per axis.
+* A source without voxels (not baked, or baked at a zero resolution scale) is treated as empty space, the result
+* is marked closed if every source with voxels was.
+*
+* @param A				First volume, local space
+* @param OffsetA		Translation from A's local space to the merged space
+* @param B				Second volume, local space
+* @param OffsetB		Translation from B's local space to the merged space
+* @param Op				Combine operator
+* @param SmoothRadius	Blend distance in local space units for DFMerge_SmoothUnion
+* @param MaxNumVoxelsOneDim	Resolution cap per axis
+* @param OutData		Receives the merged volume, bounds and flags
+*/
+void MergeDistanceFieldVolumes(
+	const FDistanceFieldVolumeData& A
+	, const FVector& OffsetA
+	, const FDistanceFieldVolumeData& B
+	, const FVector& OffsetB
+	, EDistanceFieldMergeOp Op
+	, float SmoothRadius
+	, int32 MaxNumVoxelsOneDim
+	, FDistanceFieldVolumeData& OutData);
+
+#endif // !_DISTANCEFIELDMERGE
@@ -0,0 +1,1031 @@
+#include "DistanceFieldMesher.h"
+#include "DistanceFieldSampler.h"
+#include "MeshUtilities.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+	/** Corners of each cube face, counter clockwise seen from outside the cube. Corner bits are X, Y, Z. */
+	const int32 GCubeFaceCorners[6][4] =
+	{
+		{ 0, 2, 3, 1 },
+		{ 4, 5, 7, 6 },
+		{ 0, 1, 5, 4 },
+		{ 2, 6, 7, 3 },
+		{ 0, 4, 6, 2 },
+		{ 1, 3, 7, 5 },
+	};
+
+	/** Lower corner and axis of each cube edge, X edges first. */
+	const int32 GCubeEdges[12][2] =
+	{
+		{ 0, 0 }, { 2, 0 }, { 4, 0 }, { 6, 0 },
+		{ 0, 1 }, { 1, 1 }, { 4, 1 }, { 5, 1 },
+		{ 0, 2 }, { 1, 2 }, { 2, 2 }, { 3, 2 },
+	};
+
+	int32 GetCubeEdge(int32 CornerA, int32 CornerB)
+	{
+		const int32 Lower = FMath::Min(CornerA, CornerB);
+		const int32 Axis = (CornerA ^ CornerB) == 1 ? 0 : (CornerA ^ CornerB) == 2 ? 1 : 2;
+		for (int32 Edge = 0; Edge < 12; Edge++)
+		{
+			if (GCubeEdges[Edge][0] == Lower && GCubeEdges[Edge][1] == Axis)
+			{
+				return Edge;
+			}
+		}
+		return INDEX_NONE;
+	}
+
+	/**
+	* Marching cubes triangles per corner case, built from the faces rather than typed in.
+	* Walking each face counter clockwise from outside, the surface enters at an edge going from an outside corner to an inside one
+	* and is joined to the next edge where it leaves, which cuts off inside corners on ambiguous faces.
+	* Both cells sharing a face make the same choice, so the surface has no holes, and the joined edges form loops
+	* whose fans face away from the inside corners.
+	*/
+	struct FMarchingCubesTable
+	{
+		int8 NumTriangles[256];
+		int8 Triangles[256][30];
+
+		FMarchingCubesTable()
+		{
+			for (int32 Case = 0; Case < 256; Case++)
+			{
+				int32 NextEdge[12];
+				for (int32 Edge = 0; Edge < 12; Edge++)
+				{
+					NextEdge[Edge] = INDEX_NONE;
+				}
+
+				for (int32 Face = 0; Face < 6; Face++)
+				{
+					int32 Crossings[4];
+					bool bEntering[4];
+					int32 NumCrossings = 0;
+					for (int32 Side = 0; Side < 4; Side++)
+					{
+						const int32 CornerA = GCubeFaceCorners[Face][Side];
+						const int32 CornerB = GCubeFaceCorners[Face][(Side + 1) & 3];
+						const bool bInsideA = (Case >> CornerA & 1) != 0;
+						const bool bInsideB = (Case >> CornerB & 1) != 0;
+						if (bInsideA != bInsideB)
+						{
+							Crossings[NumCrossings] = GetCubeEdge(CornerA, CornerB);
+							bEntering[NumCrossings] = bInsideB;
+							NumCrossings++;
+						}
+					}
+
+					for (int32 Crossing = 0; Crossing < NumCrossings; Crossing++)
+					{
+						if (bEntering[Crossing])
+						{
+							NextEdge[Crossings[Crossing]] = Crossings[(Crossing + 1) % NumCrossings];
+						}
+					}
+				}
+
+				NumTriangles[Case] = 0;
+				bool bVisited[12] = { false };
+				for (int32 Start = 0; Start < 12; Start++)
+				{
+					if (NextEdge[Start] == INDEX_NONE || bVisited[Start])
+					{
+						continue;
+					}
+
+					int32 Loop[12];
+					int32 LoopSize = 0;
+					for (int32 Edge = Start; !bVisited[Edge]; Edge = NextEdge[Edge])
+					{
+						bVisited[Edge] = true;
+						Loop[LoopSize++] = Edge;
+					}
+
+					for (int32 Vertex = 1; Vertex + 1 < LoopSize; Vertex++)
+					{
+						int8* Triangle = Triangles[Case] + NumTriangles[Case] * 3;
+						Triangle[0] = Loop[0];
+						Triangle[1] = Loop[Vertex];
+						Triangle[2] = Loop[Vertex + 1];
+						NumTriangles[Case]++;
+					}
+				}
+			}
+		}
+	};
+
+	const FMarchingCubesTable& GetMarchingCubesTable()
+	{
+		static const FMarchingCubesTable Table;
+		return Table;
+	}
+
+	double GetSecondsSince(const std::chrono::steady_clock::time_point& Start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+	}
+
+	/** Solves the symmetric 3x3 system M X = B by Cramer's rule, false when M is close to singular. */
+	bool SolveSymmetric3x3(const double M[6], const double B[3], double X[3])
+	{
+		// M is XX, XY, XZ, YY, YZ, ZZ
+		const double C00 = M[3] * M[5] - M[4] * M[4];
+		const double C01 = M[2] * M[4] - M[1] * M[5];
+		const double C02 = M[1] * M[4] - M[2] * M[3];
+		const double Det = M[0] * C00 + M[1] * C01 + M[2] * C02;
+		if (FMath::Abs(Det) < 1e-12)
+		{
+			return false;
+		}
+
+		const double C11 = M[0] * M[5] - M[2] * M[2];
+		const double C12 = M[1] * M[2] - M[0] * M[4];
+		const double C22 = M[0] * M[3] - M[1] * M[1];
+		const double InvDet = 1.0 / Det;
+		X[0] = (C00 * B[0] + C01 * B[1] + C02 * B[2]) * InvDet;
+		X[1] = (C01 * B[0] + C11 * B[1] + C12 * B[2]) * InvDet;
+		X[2] = (C02 * B[0] + C12 * B[1] + C22 * B[2]) * InvDet;
+		return true;
+	}
+
+	/** Merges vertices that fall in the same WeldDistance cell and drops the triangles that collapse. */
+	int32 WeldVertices(FDistanceFieldMesh& Mesh, float WeldDistance)
+	{
+		const float InvDistance = 1.0f / WeldDistance;
+		std::unordered_map<uint64, int32> Cells;
+		TArray<int32> Remap(Mesh.Positions.size());
+		TArray<FVector> Positions;
+		Positions.reserve(Mesh.Positions.size());
+
+		for (uint32 VertexIndex = 0; VertexIndex < Mesh.Positions.size(); VertexIndex++)
+		{
+			const FVector& Position = Mesh.Positions[VertexIndex];
+			const uint64 Key =
+				((uint64)(FMath::FloorToInt(Position.X * InvDistance) & 0x1fffff))
+				| ((uint64)(FMath::FloorToInt(Position.Y * InvDistance) & 0x1fffff) << 21)
+				| ((uint64)(FMath::FloorToInt(Position.Z * InvDistance) & 0x1fffff) << 42);
+			std::pair<std::unordered_map<uint64, int32>::iterator, bool> Found = Cells.insert(std::make_pair(Key, (int32)Positions.size()));
+			if (Found.second)
+			{
+				Positions.push_back(Position);
+			}
+			Remap[VertexIndex] = Found.first->second;
+		}
+
+		TArray<uint32> Indices;
+		Indices.reserve(Mesh.Indices.size());
+		for (uint32 Index = 0; Index < Mesh.Indices.size(); Index += 3)
+		{
+			const uint32 A = Remap[Mesh.Indices[Index]];
+			const uint32 B = Remap[Mesh.Indices[Index + 1]];
+			const uint32 C = Remap[Mesh.Indices[Index + 2]];
+			if (A != B && B != C && C != A)
+			{
+				Indices.push_back(A);
+				Indices.push_back(B);
+				Indices.push_back(C);
+			}
+		}
+
+		const int32 NumWelded = Mesh.Positions.size() - Positions.size();
+		Mesh.Positions.swap(Positions);
+		Mesh.Indices.swap(Indices);
+		return NumWelded;
+	}
+
+	void ComputeNormals(FDistanceFieldMesh& Mesh, const FDistanceFieldSampler& Sampler)
+	{
+		Mesh.Normals.resize(Mesh.Positions.size());
+		if (Mesh.Positions.empty())
+		{
+			return;
+		}
+
+		Sampler.SampleGradientBatch(Mesh.Positions.data(), Mesh.Positions.size(), Mesh.Normals.data());
+		for (uint32 VertexIndex = 0; VertexIndex < Mesh.Normals.size(); VertexIndex++)
+		{
+			Mesh.Normals[VertexIndex] = Mesh.Normals[VertexIndex].GetSafeNormal();
+		}
+	}
+}
+
+/** Shared by the passes of one extraction, each pass fills per slice arrays so the result does not depend on the thread count. */
+struct FDistanceFieldMesherContext
+{
+	const FDistanceFieldSampler* Sampler;
+	const FMarchingCubesTable* Table;
+	const FDistanceFieldMeshSettings* Settings;
+	const float* Voxels;
+	FIntVector Size;
+	float IsoValue;
+	FVector VolumeMin;
+	FVector VoxelSize;
+
+	/** Marching cubes: vertex of each voxel edge, three per voxel. Dual contouring: vertex of each cell, indexed by its first voxel. */
+	TArray<int32> VertexIds;
+
+	/** Ids are local to the slice the edge or cell starts in, offset by SliceOffsets once every slice is done. */
+	TArray<TArray<FVector>> SlicePositions;
+	TArray<int32> SliceOffsets;
+	TArray<TArray<uint32>> SliceIndices;
+
+	/** Gathered vertices, read by the dual contouring triangles. */
+	const TArray<FVector>* MeshPositions;
+
+	FORCEINLINE int32 GetVoxelIndex(int32 X, int32 Y, int32 Z) const
+	{
+		return (Z * Size.Y + Y) * Size.X + X;
+	}
+
+	FORCEINLINE bool IsInside(int32 VoxelIndex) const
+	{
+		return Voxels[VoxelIndex] < IsoValue;
+	}
+
+	FORCEINLINE FVector GetVoxelPosition(int32 X, int32 Y, int32 Z) const
+	{
+		return VolumeMin + (FVector((float)X, (float)Y, (float)Z) + FVector(.5f)) * VoxelSize;
+	}
+
+	FORCEINLINE int32 GetAxisStride(int32 Axis) const
+	{
+		return Axis == 0 ? 1 : Axis == 1 ? Size.X : Size.X * Size.Y;
+	}
+
+	/** Where the surface crosses the edge from VoxelIndex along Axis, both ends must be on different sides. */
+	FVector GetEdgeCrossing(int32 X, int32 Y, int32 Z, int32 Axis) const
+	{
+		const int32 VoxelIndex = GetVoxelIndex(X, Y, Z);
+		const float Value0 = Voxels[VoxelIndex];
+		const float Value1 = Voxels[VoxelIndex + GetAxisStride(Axis)];
+		FVector Position = GetVoxelPosition(X, Y, Z);
+		Position[Axis] += (IsoValue - Value0) / (Value1 - Value0) * VoxelSize[Axis];
+		return Position;
+	}
+
+	void BuildEdgeVertices(int32 Z);
+	void BuildMarchingCubesTriangles(int32 Z);
+	void BuildCellVertices(int32 Z);
+	void BuildDualContouringTriangles(int32 Z);
+};
+
+void FDistanceFieldMesherContext::BuildEdgeVertices(int32 Z)
+{
+	TArray<FVector>& Positions = SlicePositions[Z];
+	for (int32 Y = 0; Y < Size.Y; Y++)
+	{
+		for (int32 X = 0; X < Size.X; X++)
+		{
+			const int32 VoxelIndex = GetVoxelIndex(X, Y, Z);
+			const bool bInside = IsInside(VoxelIndex);
+			const bool bHasNeighbor[3] = { X + 1 < Size.X, Y + 1 < Size.Y, Z + 1 < Size.Z };
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				int32& VertexId = VertexIds[VoxelIndex * 3 + Axis];
+				VertexId = INDEX_NONE;
+				if (bHasNeighbor[Axis] && IsInside(VoxelIndex + GetAxisStride(Axis)) != bInside)
+				{
+					VertexId = Positions.size();
+					Positions.push_back(GetEdgeCrossing(X, Y, Z, Axis));
+				}
+			}
+		}
+	}
+}
+
+void FDistanceFieldMesherContext::BuildMarchingCubesTriangles(int32 Z)
+{
+	TArray<uint32>& Indices = SliceIndices[Z];
+	for (int32 Y = 0; Y + 1 < Size.Y; Y++)
+	{
+		for (int32 X = 0; X + 1 < Size.X; X++)
+		{
+			int32 CornerIndices[8];
+			int32 Case = 0;
+			for (int32 Corner = 0; Corner < 8; Corner++)
+			{
+				CornerIndices[Corner] = GetVoxelIndex(X + (Corner & 1), Y + (Corner >> 1 & 1), Z + (Corner >> 2));
+				Case |= IsInside(CornerIndices[Corner]) << Corner;
+			}
+
+			const int8* Triangles = Table->Triangles[Case];
+			for (int32 Index = 0; Index < Table->NumTriangles[Case] * 3; Index++)
+			{
+				const int32 Corner = GCubeEdges[Triangles[Index]][0];
+				const int32 Axis = GCubeEdges[Triangles[Index]][1];
+				Indices.push_back(VertexIds[CornerIndices[Corner] * 3 + Axis] + SliceOffsets[Z + (Corner >> 2)]);
+			}
+		}
+	}
+}
+
+void FDistanceFieldMesherContext::BuildCellVertices(int32 Z)
+{
+	TArray<FVector>& Positions = SlicePositions[Z];
+	const double Regularization = Settings->QEFRegularization;
+	for (int32 Y = 0; Y + 1 < Size.Y; Y++)
+	{
+		for (int32 X = 0; X + 1 < Size.X; X++)
+		{
+			int32& VertexId = VertexIds[GetVoxelIndex(X, Y, Z)];
+			VertexId = INDEX_NONE;
+
+			int32 Case = 0;
+			for (int32 Corner = 0; Corner < 8; Corner++)
+			{
+				Case |= IsInside(GetVoxelIndex(X + (Corner & 1), Y + (Corner >> 1 & 1), Z + (Corner >> 2))) << Corner;
+			}
+			if (Case == 0 || Case == 255)
+			{
+				continue;
+			}
+
+			// Least squares point on the tangent planes of the crossings, relative to the cell center and pulled towards their mean
+			const FVector CellCenter = GetVoxelPosition(X, Y, Z) + VoxelSize * .5f;
+			double ATA[6] = { 0 };
+			double ATb[3] = { 0 };
+			FVector MassPoint(0);
+			int32 NumCrossings = 0;
+			for (int32 Edge = 0; Edge < 12; Edge++)
+			{
+				const int32 CornerA = GCubeEdges[Edge][0];
+				const int32 Axis = GCubeEdges[Edge][1];
+				const int32 CornerB = CornerA | (1 << Axis);
+				if ((Case >> CornerA & 1) == (Case >> CornerB & 1))
+				{
+					continue;
+				}
+
+				const FVector Crossing = GetEdgeCrossing(X + (CornerA & 1), Y + (CornerA >> 1 & 1), Z + (CornerA >> 2), Axis);
+				const FVector Point = Crossing - CellCenter;
+				MassPoint += Point;
+				NumCrossings++;
+
+				const FVector Normal = Sampler->SampleGradient(Crossing).GetSafeNormal();
+				const double D = FVector::DotProduct(Normal, Point);
+				ATA[0] += Normal.X * Normal.X;
+				ATA[1] += Normal.X * Normal.Y;
+				ATA[2] += Normal.X * Normal.Z;
+				ATA[3] += Normal.Y * Normal.Y;
+				ATA[4] += Normal.Y * Normal.Z;
+				ATA[5] += Normal.Z * Normal.Z;
+				ATb[0] += Normal.X * D;
+				ATb[1] += Normal.Y * D;
+				ATb[2] += Normal.Z * D;
+			}
+			MassPoint /= (float)NumCrossings;
+
+			ATA[0] += Regularization;
+			ATA[3] += Regularization;
+			ATA[5] += Regularization;
+			ATb[0] += Regularization * MassPoint.X;
+			ATb[1] += Regularization * MassPoint.Y;
+			ATb[2] += Regularization * MassPoint.Z;
+
+			double Solution[3];
+			FVector Point = MassPoint;
+			if (SolveSymmetric3x3(ATA, ATb, Solution))
+			{
+				Point = FVector((float)Solution[0], (float)Solution[1], (float)Solution[2]);
+			}
+
+			const FVector HalfCell = VoxelSize * .5f;
+			Point = FVector(
+				FMath::Clamp(Point.X, -HalfCell.X, HalfCell.X),
+				FMath::Clamp(Point.Y, -HalfCell.Y, HalfCell.Y),
+				FMath::Clamp(Point.Z, -HalfCell.Z, HalfCell.Z));
+
+			VertexId = Positions.size();
+			Positions.push_back(CellCenter + Point);
+		}
+	}
+}
+
+void FDistanceFieldMesherContext::BuildDualContouringTriangles(int32 Z)
+{
+	// Cells around an edge along each axis, counter clockwise around the axis, as offsets on the two other axes
+	const int32 QuadOffsets[4][2] = { { -1, -1 }, { 0, -1 }, { 0, 0 }, { -1, 0 } };
+
+	TArray<uint32>& Indices = SliceIndices[Z];
+	for (int32 Y = 0; Y < Size.Y; Y++)
+	{
+		for (int32 X = 0; X < Size.X; X++)
+		{
+			const int32 Voxel[3] = { X, Y, Z };
+			const int32 VoxelIndex = GetVoxelIndex(X, Y, Z);
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				const int32 AxisU = (Axis + 1) % 3;
+				const int32 AxisV = (Axis + 2) % 3;
+				if (Voxel[Axis] + 1 >= Size(Axis)
+					|| Voxel[AxisU] < 1 || Voxel[AxisU] + 1 >= Size(AxisU)
+					|| Voxel[AxisV] < 1 || Voxel[AxisV] + 1 >= Size(AxisV))
+				{
+					continue;
+				}
+
+				const bool bInside = IsInside(VoxelIndex);
+				if (IsInside(VoxelIndex + GetAxisStride(Axis)) == bInside)
+				{
+					continue;
+				}
+
+				uint32 Quad[4];
+				for (int32 Corner = 0; Corner < 4; Corner++)
+				{
+					int32 Cell[3] = { X, Y, Z };
+					Cell[AxisU] += QuadOffsets[Corner][0];
+					Cell[AxisV] += QuadOffsets[Corner][1];
+					Quad[Corner] = VertexIds[GetVoxelIndex(Cell[0], Cell[1], Cell[2])] + SliceOffsets[Cell[2]];
+				}
+
+				// The quad faces along the axis when the surface leaves the inside towards it
+				if (!bInside)
+				{
+					std::swap(Quad[1], Quad[3]);
+				}
+
+				// Split along the shorter diagonal
+				const TArray<FVector>& Positions = *MeshPositions;
+				const int32 Split = FVector::DistSquared(Positions[Quad[0]], Positions[Quad[2]]) <= FVector::DistSquared(Positions[Quad[1]], Positions[Quad[3]]) ? 0 : 1;
+				Indices.push_back(Quad[Split]);
+				Indices.push_back(Quad[Split + 1]);
+				Indices.push_back(Quad[Split + 2]);
+				Indices.push_back(Quad[Split]);
+				Indices.push_back(Quad[Split + 2]);
+				Indices.push_back(Quad[(Split + 3) & 3]);
+			}
+		}
+	}
+}
+
+/** Runs one pass of the extraction over slices until there are none left. */
+class FDistanceFieldMesherTask
+{
+public:
+	enum EPass
+	{
+		Pass_EdgeVertices,
+		Pass_MarchingCubesTriangles,
+		Pass_CellVertices,
+		Pass_DualContouringTriangles,
+	};
+
+	FDistanceFieldMesherTask(FDistanceFieldMesherContext* InContext, EPass InPass, int32 InNumSlices, std::atomic<int32>* InNextSlice)
+		: Context(InContext)
+		, Pass(InPass)
+		, NumSlices(InNumSlices)
+		, NextSlice(InNextSlice)
+	{}
+
+	void DoWork()
+	{
+		for (int32 Z = (*NextSlice)++; Z < NumSlices; Z = (*NextSlice)++)
+		{
+			switch (Pass)
+			{
+			case Pass_EdgeVertices: Context->BuildEdgeVertices(Z); break;
+			case Pass_MarchingCubesTriangles: Context->BuildMarchingCubesTriangles(Z); break;
+			case Pass_CellVertices: Context->BuildCellVertices(Z); break;
+			case Pass_DualContouringTriangles: Context->BuildDualContouringTriangles(Z); break;
+			}
+		}
+	}
+
+private:
+	FDistanceFieldMesherContext* Context;
+	EPass Pass;
+	int32 NumSlices;
+	std::atomic<int32>* NextSlice;
+};
+
+namespace
+{
+	void RunDistanceFieldMesherPass(FDistanceFieldMesherContext& Context, FDistanceFieldMesherTask::EPass Pass, int32 NumSlices)
+	{
+		std::atomic<int32> NextSlice(0);
+		const int32 NumWorkers = FMath::Clamp(FMath::Min((int32)std::thread::hardware_concurrency(), NumSlices), 1, MAXTHREADNUM);
+		FQueuedThreadPool ThreadPool;
+		TArray<FAsyncTask<FDistanceFieldMesherTask>*> AsyncTasks;
+
+		for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+		{
+			FAsyncTask<FDistanceFieldMesherTask>* Task = new FAsyncTask<FDistanceFieldMesherTask>(&Context, Pass, NumSlices, &NextSlice);
+			ThreadPool.AddWork(Task);
+			AsyncTasks.push_back(Task);
+		}
+		ThreadPool.DoAllWork();
+
+		for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+		{
+			delete AsyncTasks[TaskIndex];
+		}
+	}
+
+	/** Concatenates the slice vertices in slice order and records where each slice starts. */
+	void GatherSlicePositions(FDistanceFieldMesherContext& Context, TArray<FVector>& OutPositions)
+	{
+		const int32 NumSlices = Context.SlicePositions.size();
+		Context.SliceOffsets.resize(NumSlices + 1);
+		Context.SliceOffsets[0] = 0;
+		for (int32 Slice = 0; Slice < NumSlices; Slice++)
+		{
+			Context.SliceOffsets[Slice + 1] = Context.SliceOffsets[Slice] + Context.SlicePositions[Slice].size();
+		}
+
+		OutPositions.resize(Context.SliceOffsets[NumSlices]);
+		for (int32 Slice = 0; Slice < NumSlices; Slice++)
+		{
+			std::copy(Context.SlicePositions[Slice].begin(), Context.SlicePositions[Slice].end(), OutPositions.begin() + Context.SliceOffsets[Slice]);
+			TArray<FVector>().swap(Context.SlicePositions[Slice]);
+		}
+	}
+
+	void GatherSliceIndices(FDistanceFieldMesherContext& Context, TArray<uint32>& OutIndices)
+	{
+		SIZE_t NumIndices = 0;
+		for (uint32 Slice = 0; Slice < Context.SliceIndices.size(); Slice++)
+		{
+			NumIndices += Context.SliceIndices[Slice].size();
+		}
+
+		OutIndices.clear();
+		OutIndices.reserve(NumIndices);
+		for (uint32 Slice = 0; Slice < Context.SliceIndices.size(); Slice++)
+		{
+			OutIndices.insert(OutIndices.end(), Context.SliceIndices[Slice].begin(), Context.SliceIndices[Slice].end());
+		}
+	}
+}
+
+void ExtractDistanceFieldMesh(
+	const FDistanceFieldSampler& Sampler
+	, const FDistanceFieldMeshSettings& Settings
+	, FDistanceFieldMesh& OutMesh
+	, FDistanceFieldMeshStats* OutStats)
+{
+	const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+	FDistanceFieldMeshStats Stats;
+	OutMesh.Positions.clear();
+	OutMesh.Normals.clear();
+	OutMesh.Indices.clear();
+
+	const FIntVector& Size = Sampler.GetSize();
+	if (Sampler.IsValid() && Size.X > 1 && Size.Y > 1 && Size.Z > 1)
+	{
+		FDistanceFieldMesherContext Context;
+		Context.Sampler = &Sampler;
+		Context.Table = &GetMarchingCubesTable();
+		Context.Settings = &Settings;
+		Context.Voxels = Sampler.GetVoxels();
+		Context.Size = Size;
+		Context.IsoValue = Settings.IsoValue / Sampler.GetDistanceScale();
+		Context.VolumeMin = Sampler.GetBox().Min;
+		Context.VoxelSize = Sampler.GetBox().GetSize() / FVector((float)Size.X, (float)Size.Y, (float)Size.Z);
+		Context.MeshPositions = &OutMesh.Positions;
+
+		const int32 NumVoxels = Size.X * Size.Y * Size.Z;
+		if (Settings.Method == DFMesh_MarchingCubes)
+		{
+			Context.VertexIds.resize(NumVoxels * 3);
+			Context.SlicePositions.resize(Size.Z);
+			Context.SliceIndices.resize(Size.Z - 1);
+			RunDistanceFieldMesherPass(Context, FDistanceFieldMesherTask::Pass_EdgeVertices, Size.Z);
+			GatherSlicePositions(Context, OutMesh.Positions);
+			RunDistanceFieldMesherPass(Context, FDistanceFieldMesherTask::Pass_MarchingCubesTriangles, Size.Z - 1);
+		}
+		else
+		{
+			Context.VertexIds.resize(NumVoxels);
+			Context.SlicePositions.resize(Size.Z - 1);
+			Context.SliceIndices.resize(Size.Z);
+			RunDistanceFieldMesherPass(Context, FDistanceFieldMesherTask::Pass_CellVertices, Size.Z - 1);
+			GatherSlicePositions(Context, OutMesh.Positions);
+			RunDistanceFieldMesherPass(Context, FDistanceFieldMesherTask::Pass_DualContouringTriangles, Size.Z);
+		}
+		GatherSliceIndices(Context, OutMesh.Indices);
+		Stats.NumExtractedTriangles = OutMesh.Indices.size() / 3;
+
+		if (Settings.WeldDistance > 0)
+		{
+			Stats.NumWeldedVertices = WeldVertices(OutMesh, Settings.WeldDistance);
+		}
+		Stats.ExtractSeconds = GetSecondsSince(StartTime);
+
+		if (Settings.TriangleRatio < 1.0f)
+		{
+			const std::chrono::steady_clock::time_point DecimateStartTime = std::chrono::steady_clock::now();
+			DecimateDistanceFieldMesh(OutMesh, (int32)(OutMesh.Indices.size() / 3 * FMath::Max(Settings.TriangleRatio, 0.0f)));
+			Stats.DecimateSeconds = GetSecondsSince(DecimateStartTime);
+		}
+
+		ComputeNormals(OutMesh, Sampler);
+	}
+
+	Stats.NumVertices = OutMesh.Positions.size();
+	Stats.NumTriangles = OutMesh.Indices.size() / 3;
+	if (OutStats)
+	{
+		*OutStats = Stats;
+	}
+}
+
+namespace
+{
+	/** Sum of squared distances to planes, the upper half of a symmetric 4x4 matrix. */
+	struct FQuadric
+	{
+		double XX, XY, XZ, XW, YY, YZ, YW, ZZ, ZW, WW;
+
+		FQuadric()
+			: XX(0), XY(0), XZ(0), XW(0), YY(0), YZ(0), YW(0), ZZ(0), ZW(0), WW(0)
+		{}
+
+		void AddPlane(const FVector& Normal, float Distance, float Weight)
+		{
+			const double A = Normal.X, B = Normal.Y, C = Normal.Z, D = Distance;
+			XX += Weight * A * A; XY += Weight * A * B; XZ += Weight * A * C; XW += Weight * A * D;
+			YY += Weight * B * B; YZ += Weight * B * C; YW += Weight * B * D;
+			ZZ += Weight * C * C; ZW += Weight * C * D;
+			WW += Weight * D * D;
+		}
+
+		void operator+=(const FQuadric& Other)
+		{
+			XX += Other.XX; XY += Other.XY; XZ += Other.XZ; XW += Other.XW;
+			YY += Other.YY; YZ += Other.YZ; YW += Other.YW;
+			ZZ += Other.ZZ; ZW += Other.ZW;
+			WW += Other.WW;
+		}
+
+		double Evaluate(const FVector& P) const
+		{
+			const double X = P.X, Y = P.Y, Z = P.Z;
+			return X * (XX * X + 2 * (XY * Y + XZ * Z + XW))
+				+ Y * (YY * Y + 2 * (YZ * Z + YW))
+				+ Z * (ZZ * Z + 2 * ZW)
+				+ WW;
+		}
+	};
+
+	struct FEdgeCollapse
+	{
+		double Cost;
+		int32 Vertex0;
+		int32 Vertex1;
+		uint32 Version0;
+		uint32 Version1;
+		FVector Position;
+
+		bool operator>(const FEdgeCollapse& Other) const
+		{
+			return Cost > Other.Cost;
+		}
+	};
+
+	class FMeshDecimator
+	{
+	public:
+		FMeshDecimator(FDistanceFieldMesh& InMesh)
+			: Mesh(InMesh)
+			, NumLiveTriangles(InMesh.Indices.size() / 3)
+		{
+			const int32 NumVertices = Mesh.Positions.size();
+			Quadrics.resize(NumVertices);
+			VertexTriangles.resize(NumVertices);
+			VertexVersions.resize(NumVertices, 0);
+			bVertexRemoved.resize(NumVertices, 0);
+			bVertexLocked.resize(NumVertices, 0);
+			bTriangleRemoved.resize(NumLiveTriangles, 0);
+
+			for (int32 Triangle = 0; Triangle < NumLiveTriangles; Triangle++)
+			{
+				const uint32* Indices = &Mesh.Indices[Triangle * 3];
+				const FVector& A = Mesh.Positions[Indices[0]];
+				FVector Normal = FVector::CrossProduct(Mesh.Positions[Indices[1]] - A, Mesh.Positions[Indices[2]] - A);
+				const float DoubleArea = Normal.Size();
+				if (DoubleArea > 0)
+				{
+					Normal /= DoubleArea;
+					for (int32 Corner = 0; Corner < 3; Corner++)
+					{
+						Quadrics[Indices[Corner]].AddPlane(Normal, -FVector::DotProduct(Normal, A), DoubleArea * .5f);
+					}
+				}
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					VertexTriangles[Indices[Corner]].push_back(Triangle);
+				}
+			}
+
+			// An edge used by a single triangle lies on an open border, its vertices are locked so the border keeps its shape
+			for (int32 Triangle = 0; Triangle < NumLiveTriangles; Triangle++)
+			{
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					const uint32 Vertex0 = Mesh.Indices[Triangle * 3 + Corner];
+					const uint32 Vertex1 = Mesh.Indices[Triangle * 3 + (Corner + 1) % 3];
+					if (CountEdgeTriangles(Vertex0, Vertex1) == 1)
+					{
+						bVertexLocked[Vertex0] = 1;
+						bVertexLocked[Vertex1] = 1;
+					}
+				}
+			}
+
+			// Each edge shared by two triangles is seen once in each direction
+			for (int32 Triangle = 0; Triangle < NumLiveTriangles; Triangle++)
+			{
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					const uint32 Vertex0 = Mesh.Indices[Triangle * 3 + Corner];
+					const uint32 Vertex1 = Mesh.Indices[Triangle * 3 + (Corner + 1) % 3];
+					if (Vertex0 < Vertex1)
+					{
+						PushCollapse(Vertex0, Vertex1);
+					}
+				}
+			}
+		}
+
+		void Run(int32 TargetNumTriangles)
+		{
+			while (NumLiveTriangles > TargetNumTriangles && !Collapses.empty())
+			{
+				const FEdgeCollapse Collapse = Collapses.top();
+				Collapses.pop();
+				if (bVertexRemoved[Collapse.Vertex0] || bVertexRemoved[Collapse.Vertex1]
+					|| VertexVersions[Collapse.Vertex0] != Collapse.Version0
+					|| VertexVersions[Collapse.Vertex1] != Collapse.Version1)
+				{
+					continue;
+				}
+
+				if (CanCollapse(Collapse.Vertex0, Collapse.Vertex1, Collapse.Position))
+				{
+					ApplyCollapse(Collapse.Vertex0, Collapse.Vertex1, Collapse.Position);
+				}
+			}
+			Compact();
+		}
+
+	private:
+
+		int32 CountEdgeTriangles(int32 Vertex0, int32 Vertex1) const
+		{
+			const TArray<int32>& Triangles = VertexTriangles[Vertex0];
+			int32 NumTriangles = 0;
+			for (uint32 Index = 0; Index < Triangles.size(); Index++)
+			{
+				const uint32* Indices = &Mesh.Indices[Triangles[Index] * 3];
+				NumTriangles += (int32)Indices[0] == Vertex1 || (int32)Indices[1] == Vertex1 || (int32)Indices[2] == Vertex1;
+			}
+			return NumTriangles;
+		}
+
+		void PushCollapse(int32 Vertex0, int32 Vertex1)
+		{
+			// Border edges and chords between two border vertices would pull the border in
+			if (bVertexLocked[Vertex0] && bVertexLocked[Vertex1])
+			{
+				return;
+			}
+
+			FQuadric Quadric = Quadrics[Vertex0];
+			Quadric += Quadrics[Vertex1];
+
+			// The midpoint and the ends, which avoids solving for the minimum of a quadric that is often singular on flat regions.
+			// The midpoint wins ties so flat regions shrink evenly instead of into one vertex.
+			const FVector Candidates[3] =
+			{
+				(Mesh.Positions[Vertex0] + Mesh.Positions[Vertex1]) * .5f,
+				Mesh.Positions[Vertex0],
+				Mesh.Positions[Vertex1],
+			};
+
+			FEdgeCollapse Collapse;
+			Collapse.Cost = MAX_dbl;
+			for (int32 Candidate = 0; Candidate < 3; Candidate++)
+			{
+				// A locked vertex stays where it is, the free one collapses onto it
+				if ((bVertexLocked[Vertex0] && Candidate != 1) || (bVertexLocked[Vertex1] && Candidate != 2))
+				{
+					continue;
+				}
+
+				const double Cost = Quadric.Evaluate(Candidates[Candidate]);
+				if (Cost < Collapse.Cost)
+				{
+					Collapse.Cost = Cost;
+					Collapse.Position = Candidates[Candidate];
+				}
+			}
+
+			// Shorter edges go first among equal errors, which keeps triangles even where the error is 0
+			const double LengthSquared = FVector::DistSquared(Mesh.Positions[Vertex0], Mesh.Positions[Vertex1]);
+			Collapse.Cost += LengthSquared * LengthSquared * 1e-4;
+			Collapse.Vertex0 = Vertex0;
+			Collapse.Vertex1 = Vertex1;
+			Collapse.Version0 = VertexVersions[Vertex0];
+			Collapse.Version1 = VertexVersions[Vertex1];
+			Collapses.push(Collapse);
+		}
+
+		void GetNeighbors(int32 Vertex, TArray<int32>& OutNeighbors) const
+		{
+			OutNeighbors.clear();
+			const TArray<int32>& Triangles = VertexTriangles[Vertex];
+			for (uint32 Index = 0; Index < Triangles.size(); Index++)
+			{
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					const int32 Other = Mesh.Indices[Triangles[Index] * 3 + Corner];
+					if (Other != Vertex && std::find(OutNeighbors.begin(), OutNeighbors.end(), Other) == OutNeighbors.end())
+					{
+						OutNeighbors.push_back(Other);
+					}
+				}
+			}
+		}
+
+		/** Rejects collapses that pinch the surface (more than two shared neighbors) or turn a triangle over. */
+		bool CanCollapse(int32 Vertex0, int32 Vertex1, const FVector& Position)
+		{
+			GetNeighbors(Vertex0, Neighbors0);
+			GetNeighbors(Vertex1, Neighbors1);
+			int32 NumShared = 0;
+			for (uint32 Index = 0; Index < Neighbors0.size(); Index++)
+			{
+				NumShared += std::find(Neighbors1.begin(), Neighbors1.end(), Neighbors0[Index]) != Neighbors1.end();
+			}
+			if (NumShared > 2)
+			{
+				return false;
+			}
+
+			const int32 Vertices[2] = { Vertex0, Vertex1 };
+			for (int32 Side = 0; Side < 2; Side++)
+			{
+				const TArray<int32>& Triangles = VertexTriangles[Vertices[Side]];
+				for (uint32 Index = 0; Index < Triangles.size(); Index++)
+				{
+					const uint32* Indices = &Mesh.Indices[Triangles[Index] * 3];
+					FVector Corners[3];
+					bool bCollapsed = false;
+					for (int32 Corner = 0; Corner < 3; Corner++)
+					{
+						Corners[Corner] = Mesh.Positions[Indices[Corner]];
+						bCollapsed |= (int32)Indices[Corner] == Vertices[1 - Side];
+					}
+					if (bCollapsed)
+					{
+						continue;
+					}
+
+					const FVector OldNormal = FVector::CrossProduct(Corners[1] - Corners[0], Corners[2] - Corners[0]);
+					for (int32 Corner = 0; Corner < 3; Corner++)
+					{
+						if ((int32)Indices[Corner] == Vertices[Side])
+						{
+							Corners[Corner] = Position;
+						}
+					}
+					const FVector NewNormal = FVector::CrossProduct(Corners[1] - Corners[0], Corners[2] - Corners[0]);
+					if (FVector::DotProduct(OldNormal, NewNormal) <= .2f * OldNormal.Size() * NewNormal.Size())
+					{
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		void ApplyCollapse(int32 Vertex0, int32 Vertex1, const FVector& Position)
+		{
+			Mesh.Positions[Vertex0] = Position;
+			Quadrics[Vertex0] += Quadrics[Vertex1];
+			bVertexLocked[Vertex0] |= bVertexLocked[Vertex1];
+
+			const TArray<int32>& Triangles1 = VertexTriangles[Vertex1];
+			for (uint32 Index = 0; Index < Triangles1.size(); Index++)
+			{
+				const int32 Triangle = Triangles1[Index];
+				uint32* Indices = &Mesh.Indices[Triangle * 3];
+				if ((int32)Indices[0] == Vertex0 || (int32)Indices[1] == Vertex0 || (int32)Indices[2] == Vertex0)
+				{
+					bTriangleRemoved[Triangle] = 1;
+					NumLiveTriangles--;
+					continue;
+				}
+
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					if ((int32)Indices[Corner] == Vertex1)
+					{
+						Indices[Corner] = Vertex0;
+					}
+				}
+				VertexTriangles[Vertex0].push_back(Triangle);
+			}
+			TArray<int32>().swap(VertexTriangles[Vertex1]);
+			bVertexRemoved[Vertex1] = 1;
+			VertexVersions[Vertex0]++;
+
+			// Drop the removed triangles from every vertex that referenced them
+			GetNeighbors(Vertex0, Neighbors0);
+			Neighbors0.push_back(Vertex0);
+			for (uint32 Index = 0; Index < Neighbors0.size(); Index++)
+			{
+				TArray<int32>& Triangles = VertexTriangles[Neighbors0[Index]];
+				Triangles.erase(std::remove_if(Triangles.begin(), Triangles.end(), [this](int32 Triangle) { return bTriangleRemoved[Triangle] != 0; }), Triangles.end());
+			}
+
+			GetNeighbors(Vertex0, Neighbors0);
+			for (uint32 Index = 0; Index < Neighbors0.size(); Index++)
+			{
+				PushCollapse(Vertex0, Neighbors0[Index]);
+			}
+		}
+
+		void Compact()
+		{
+			TArray<int32> Remap(Mesh.Positions.size(), INDEX_NONE);
+			TArray<FVector> Positions;
+			TArray<uint32> Indices;
+			for (uint32 Triangle = 0; Triangle < bTriangleRemoved.size(); Triangle++)
+			{
+				if (bTriangleRemoved[Triangle])
+				{
+					continue;
+				}
+
+				for (int32 Corner = 0; Corner < 3; Corner++)
+				{
+					const uint32 Vertex = Mesh.Indices[Triangle * 3 + Corner];
+					if (Remap[Vertex] == INDEX_NONE)
+					{
+						Remap[Vertex] = Positions.size();
+						Positions.push_back(Mesh.Positions[Vertex]);
+					}
+					Indices.push_back(Remap[Vertex]);
+				}
+			}
+			Mesh.Positions.swap(Positions);
+			Mesh.Indices.swap(Indices);
+		}
+
+		FDistanceFieldMesh& Mesh;
+		int32 NumLiveTriangles;
+		TArray<FQuadric> Quadrics;
+		TArray<TArray<int32>> VertexTriangles;
+		TArray<uint32> VertexVersions;
+		TArray<uint8> bVertexRemoved;
+		TArray<uint8> bVertexLocked;
+		TArray<uint8> bTriangleRemoved;
+		TArray<int32> Neighbors0;
+		TArray<int32> Neighbors1;
+		std::priority_queue<FEdgeCollapse, TArray<FEdgeCollapse>, std::greater<FEdgeCollapse>> Collapses;
+	};
+}
+
+void DecimateDistanceFieldMesh(FDistanceFieldMesh& Mesh, int32 TargetNumTriangles, const FDistanceFieldSampler* Sampler)
+{
+	if ((int32)Mesh.Indices.size() / 3 > TargetNumTriangles)
+	{
+		FMeshDecimator Decimator(Mesh);
+		Decimator.Run(TargetNumTriangles);
+	}
+
+	if (Sampler)
+	{
+		ComputeNormals(Mesh, *Sampler);
+	}
+	else
+	{
+		Mesh.Normals.clear();
+	}
+}
+
+void ConvertDistanceFieldMesh(const FDistanceFieldMesh& Mesh, MeshData& OutMeshData)
+{
+	OutMeshData.Vertices = Mesh.Positions;
+	OutMeshData.UVs.assign(Mesh.Positions.size(), FVector2D(0, 0));
+	OutMeshData.Indices.resize(Mesh.Indices.size() / 3);
+	for (uint32 Triangle = 0; Triangle < OutMeshData.Indices.size(); Triangle++)
+	{
+		for (int32 Corner = 0; Corner < 3; Corner++)
+		{
+			OutMeshData.Indices[Triangle].indices[Corner] = Mesh.Indices[Triangle * 3 + Corner];
+		}
+		OutMeshData.Indices[Triangle].material = 0;
+	}
+	OutMeshData.Mats.resize(1);
+}
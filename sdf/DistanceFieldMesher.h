@@ -0,0 +1,102 @@
+#ifndef _DISTANCEFIELDMESHER
+#define _DISTANCEFIELDMESHER
+#include "Config.h"
+#include "Vector.h"
+
+class FDistanceFieldSampler;
+
+enum EDistanceFieldMeshMethod
+{
+	/** One vertex per voxel edge crossing the surface, smooth but rounds off sharp edges. */
+	DFMesh_MarchingCubes,
+
+	/** One vertex per cell placed on the tangent planes of its edge crossings, keeps sharp edges and corners. */
+	DFMesh_DualContouring,
+};
+
+struct FDistanceFieldMeshSettings
+{
+	EDistanceFieldMeshMethod Method;
+
+	/** Local space distance of the extracted surface, positive values inflate it. */
+	float IsoValue;
+
+	/** Vertices in the same cell of a grid this many local space units across are merged, 0 to keep them all. */
+	float WeldDistance;
+
+	/** Fraction of the extracted triangles to keep by quadric edge collapse, 1 to skip decimation. */
+	float TriangleRatio;
+
+	/** Dual contouring pull of each cell vertex towards the mean of its edge crossings, keeps flat regions stable. */
+	float QEFRegularization;
+
+	FDistanceFieldMeshSettings()
+		: Method(DFMesh_MarchingCubes)
+		, IsoValue(0)
+		, WeldDistance(0)
+		, TriangleRatio(1.0f)
+		, QEFRegularization(0.05f)
+	{}
+};
+
+struct FDistanceFieldMeshStats
+{
+	/** Triangles of the isosurface before welding and decimation. */
+	int32 NumExtractedTriangles;
+
+	/** Vertices merged into another by welding. */
+	int32 NumWeldedVertices;
+
+	int32 NumVertices;
+	int32 NumTriangles;
+
+	double ExtractSeconds;
+	double DecimateSeconds;
+
+	FDistanceFieldMeshStats()
+		: NumExtractedTriangles(0)
+		, NumWeldedVertices(0)
+		, NumVertices(0)
+		, NumTriangles(0)
+		, ExtractSeconds(0)
+		, DecimateSeconds(0)
+	{}
+};
+
+/**
+* Indexed triangle list in the local space of the volume.
+* cross(B - A, C - A) points out of the surface, which is front facing with the demo's clockwise culling.
+*/
+struct FDistanceFieldMesh
+{
+	TArray<FVector> Positions;
+
+	/** Unit gradient of the distance field at each position. */
+	TArray<FVector> Normals;
+
+	TArray<uint32> Indices;
+};
+
+/**
+* Extracts the IsoValue surface of a volume as a welded triangle mesh, e.g. to build a far LOD proxy from a bake.
+* Slices of the volume are spread over worker threads, vertices are shared through the voxel edge or cell they belong to,
+* so the surface is closed wherever the volume is.
+*/
+void ExtractDistanceFieldMesh(
+	const FDistanceFieldSampler& Sampler
+	, const FDistanceFieldMeshSettings& Settings
+	, FDistanceFieldMesh& OutMesh
+	, FDistanceFieldMeshStats* OutStats = NULL);
+
+/**
+* Quadric error edge collapse down to TargetNumTriangles.
+* Collapses that would fold a triangle over or pinch the surface are skipped, so the result can stay above the target.
+* Vertices on open borders, edges used by a single triangle, are kept in place.
+* Normals are resampled from the volume when a sampler is given.
+*/
+void DecimateDistanceFieldMesh(FDistanceFieldMesh& Mesh, int32 TargetNumTriangles, const FDistanceFieldSampler* Sampler = NULL);
+
+/** Copies positions and triangles into the MeshData the bake reads, all triangles use material 0. */
+void ConvertDistanceFieldMesh(const FDistanceFieldMesh& Mesh, MeshData& OutMeshData);
+
+#endif // !_DISTANCEFIELDMESHER
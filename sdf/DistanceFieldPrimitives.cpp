@@ -0,0 +1,181 @@
+#include "DistanceFieldPrimitives.h"
+#include "MeshUtilities.h"
+#include <atomic>
+
+FDistanceFieldPrimitive FDistanceFieldPrimitive::Box(float Width, float Height, float Depth)
+{
+	FDistanceFieldPrimitive Primitive;
+	Primitive.Type = DFPrim_Box;
+	Primitive.Extent = FVector(.5f * Width, .5f * Height, .5f * Depth);
+	Primitive.Radius = Primitive.TopRadius = Primitive.HalfHeight = 0;
+	return Primitive;
+}
+
+FDistanceFieldPrimitive FDistanceFieldPrimitive::Sphere(float Radius)
+{
+	FDistanceFieldPrimitive Primitive;
+	Primitive.Type = DFPrim_Sphere;
+	Primitive.Extent = FVector(Radius);
+	Primitive.Radius = Primitive.TopRadius = Radius;
+	Primitive.HalfHeight = Radius;
+	return Primitive;
+}
+
+FDistanceFieldPrimitive FDistanceFieldPrimitive::Cylinder(float BottomRadius, float TopRadius, float Height)
+{
+	FDistanceFieldPrimitive Primitive;
+	Primitive.Type = DFPrim_Cylinder;
+	Primitive.Radius = BottomRadius;
+	Primitive.TopRadius = TopRadius;
+	Primitive.HalfHeight = .5f * Height;
+	const float MaxRadius = FMath::Max(BottomRadius, TopRadius);
+	Primitive.Extent = FVector(MaxRadius, Primitive.HalfHeight, MaxRadius);
+	return Primitive;
+}
+
+FDistanceFieldPrimitive FDistanceFieldPrimitive::Grid(float Width, float Depth)
+{
+	FDistanceFieldPrimitive Primitive;
+	Primitive.Type = DFPrim_Grid;
+	Primitive.Extent = FVector(.5f * Width, 0, .5f * Depth);
+	Primitive.Radius = Primitive.TopRadius = Primitive.HalfHeight = 0;
+	return Primitive;
+}
+
+float FDistanceFieldPrimitive::GetDistance(const FVector& P) const
+{
+	switch (Type)
+	{
+	case DFPrim_Box:
+	{
+		const FVector Q = P.GetAbs() - Extent;
+		const float Outside = Q.ComponentMax(FVector(0)).Size();
+		const float Inside = FMath::Min(Q.GetMax(), 0.0f);
+		return Outside + Inside;
+	}
+	case DFPrim_Sphere:
+		return P.Size() - Radius;
+	case DFPrim_Cylinder:
+	{
+		// Capped cone in the (radial, height) half plane, distance to the nearer of the caps and the slanted side
+		const float QX = FMath::Sqrt(P.X * P.X + P.Z * P.Z);
+		const float QY = P.Y;
+		const float CapRadius = QY < 0 ? Radius : TopRadius;
+		const float CapX = QX - FMath::Min(QX, CapRadius);
+		const float CapY = FMath::Abs(QY) - HalfHeight;
+
+		const float SideX = TopRadius - Radius;
+		const float SideY = 2 * HalfHeight;
+		const float SideT = FMath::Clamp(((TopRadius - QX) * SideX + (HalfHeight - QY) * SideY) / (SideX * SideX + SideY * SideY), 0.0f, 1.0f);
+		const float ToSideX = QX - TopRadius + SideX * SideT;
+		const float ToSideY = QY - HalfHeight + SideY * SideT;
+
+		const float Sign = ToSideX < 0 && CapY < 0 ? -1.0f : 1.0f;
+		return Sign * FMath::Sqrt(FMath::Min(CapX * CapX + CapY * CapY, ToSideX * ToSideX + ToSideY * ToSideY));
+	}
+	case DFPrim_Grid:
+	{
+		const float DX = FMath::Max(FMath::Abs(P.X) - Extent.X, 0.0f);
+		const float DZ = FMath::Max(FMath::Abs(P.Z) - Extent.Z, 0.0f);
+		return FMath::Sqrt(DX * DX + P.Y * P.Y + DZ * DZ);
+	}
+	}
+	return MAX_flt;
+}
+
+FVector FDistanceFieldPrimitive::GetGradient(const FVector& P, float Step) const
+{
+	const float InvStep = .5f / Step;
+	return FVector(
+		GetDistance(FVector(P.X + Step, P.Y, P.Z)) - GetDistance(FVector(P.X - Step, P.Y, P.Z)),
+		GetDistance(FVector(P.X, P.Y + Step, P.Z)) - GetDistance(FVector(P.X, P.Y - Step, P.Z)),
+		GetDistance(FVector(P.X, P.Y, P.Z + Step)) - GetDistance(FVector(P.X, P.Y, P.Z - Step))) * InvStep;
+}
+
+FBox FDistanceFieldPrimitive::GetBounds() const
+{
+	return FBox(-Extent, Extent);
+}
+
+/** Rasterizes Z slices of a primitive volume until there are none left. */
+class FDistanceFieldPrimitiveTask
+{
+public:
+	FDistanceFieldPrimitiveTask(const FDistanceFieldPrimitive* InPrimitive, FDistanceFieldVolumeData* InOutData, std::atomic<int32>* InNextSlice)
+		: Primitive(InPrimitive)
+		, OutData(InOutData)
+		, NextSlice(InNextSlice)
+	{}
+
+	void DoWork()
+	{
+		const FIntVector& Size = OutData->Size;
+		const FBox& VolumeBounds = OutData->LocalBoundingBox;
+		const FVector VoxelSize = VolumeBounds.GetSize() / FVector(Size.X, Size.Y, Size.Z);
+		const float InvVolumeScale = 1.0f / VolumeBounds.GetExtent().GetMax();
+		TArray<float> RowDistances(Size.X);
+
+		for (int32 ZIndex = (*NextSlice)++; ZIndex < Size.Z; ZIndex = (*NextSlice)++)
+		{
+			for (int32 YIndex = 0; YIndex < Size.Y; YIndex++)
+			{
+				for (int32 XIndex = 0; XIndex < Size.X; XIndex++)
+				{
+					const FVector VoxelPosition = FVector(XIndex + .5f, YIndex + .5f, ZIndex + .5f) * VoxelSize + VolumeBounds.Min;
+					RowDistances[XIndex] = Primitive->GetDistance(VoxelPosition) * InvVolumeScale;
+				}
+
+				const int32 RowIndex = (ZIndex * Size.Y + YIndex) * Size.X;
+				ConvertFloatToSDFFloat(RowDistances.data(), &OutData->DistanceFieldVolume[RowIndex], Size.X);
+			}
+		}
+	}
+
+private:
+	const FDistanceFieldPrimitive* Primitive;
+	FDistanceFieldVolumeData* OutData;
+	std::atomic<int32>* NextSlice;
+};
+
+void GenerateDistanceFieldPrimitiveVolume(
+	const FDistanceFieldPrimitive& Primitive
+	, float DistanceFieldResolutionScale
+	, FDistanceFieldVolumeData& OutData)
+{
+	if (DistanceFieldResolutionScale <= 0)
+	{
+		return;
+	}
+
+	FBox VolumeBounds;
+	FIntVector VolumeDimensions;
+	GetDistanceFieldVolumeLayout(Primitive.GetBounds(), DistanceFieldResolutionScale, VolumeBounds, VolumeDimensions);
+
+	OutData.Size = VolumeDimensions;
+	OutData.LocalBoundingBox = VolumeBounds;
+	OutData.DistanceFieldVolume.clear();
+	OutData.DistanceFieldVolume.resize(VolumeDimensions.X * VolumeDimensions.Y * VolumeDimensions.Z);
+
+	std::atomic<int32> NextSlice(0);
+	const int32 NumWorkers = FMath::Clamp(FMath::Min((int32)std::thread::hardware_concurrency(), VolumeDimensions.Z), 1, MAXTHREADNUM);
+	FQueuedThreadPool ThreadPool;
+	TArray<FAsyncTask<FDistanceFieldPrimitiveTask>*> AsyncTasks;
+
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		FAsyncTask<FDistanceFieldPrimitiveTask>* Task = new FAsyncTask<FDistanceFieldPrimitiveTask>(&Primitive, &OutData, &NextSlice);
+		ThreadPool.AddWork(Task);
+		AsyncTasks.push_back(Task);
+	}
+	ThreadPool.DoAllWork();
+
+	for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+	{
+		delete AsyncTasks[TaskIndex];
+	}
+
+	// Analytic shapes are closed by construction, the grid is unsigned like a two sided bake of its triangles
+	OutData.bMeshWasClosed = true;
+	OutData.bBuiltAsIfTwoSided = Primitive.Type == DFPrim_Grid;
+	OutData.bMeshWasPlane = false;
+}
@@ -0,0 +1,58 @@
+#ifndef _DISTANCEFIELDPRIMITIVES
+#define _DISTANCEFIELDPRIMITIVES
+#include "Config.h"
+#include "Box.h"
+
+/** Shapes of GeometryGenerator, in the same local frame: centered on the origin, Y up. */
+enum EDistanceFieldPrimitiveType
+{
+	DFPrim_Box,
+	DFPrim_Sphere,
+	/** Capped cone along Y, a cylinder when both radii match. */
+	DFPrim_Cylinder,
+	/** Rectangle in the XZ plane, distances are unsigned like a two sided plane bake. */
+	DFPrim_Grid,
+};
+
+/**
+* A shape with a closed form distance, rasterized straight into a volume instead of ray cast baked from its triangles.
+* Build with the factory matching the GeometryGenerator call, e.g. Box(width, height, depth) for CreateBox.
+*/
+struct FDistanceFieldPrimitive
+{
+	EDistanceFieldPrimitiveType Type;
+
+	/** Half size of the box, or of the grid in X and Z. */
+	FVector Extent;
+
+	/** Sphere radius, cylinder bottom radius. */
+	float Radius;
+
+	float TopRadius;
+	float HalfHeight;
+
+	static FDistanceFieldPrimitive Box(float Width, float Height, float Depth);
+	static FDistanceFieldPrimitive Sphere(float Radius);
+	static FDistanceFieldPrimitive Cylinder(float BottomRadius, float TopRadius, float Height);
+	static FDistanceFieldPrimitive Grid(float Width, float Depth);
+
+	/** Exact local space distance, negative inside. */
+	float GetDistance(const FVector& LocalPosition) const;
+
+	/** Local space gradient of GetDistance by central differences Step apart, not normalized. */
+	FVector GetGradient(const FVector& LocalPosition, float Step = 1e-3f) const;
+
+	/** Local bounds of the shape, the volume is laid out around them like a bake around mesh bounds. */
+	FBox GetBounds() const;
+};
+
+/**
+* Fills OutData like GenerateSignedDistanceFieldVolumeData would for the primitive's mesh, same bounds, dimensions and
+* volume space encoding, with exact distances at the voxel centers. Slices are spread over worker threads.
+*/
+void GenerateDistanceFieldPrimitiveVolume(
+	const FDistanceFieldPrimitive& Primitive
+	, float DistanceFieldResolutionScale
+	, FDistanceFieldVolumeData& OutData);
+
+#endif // !_DISTANCEFIELDPRIMITIVES
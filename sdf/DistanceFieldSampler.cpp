@@ -0,0 +1,245 @@
+#include "DistanceFieldSampler.h"
+#include "MeshUtilities.h"
+
+FDistanceFieldSampler::FDistanceFieldSampler()
+	: Size(FIntVector(0, 0, 0))
+	, Box(0)
+	, VoxelsPerUnit(0)
+	, DistanceScale(0)
+{
+}
+
+FDistanceFieldSampler::FDistanceFieldSampler(const FDistanceFieldVolumeData& Data)
+{
+	Init(Data);
+}
+
+void FDistanceFieldSampler::Init(const FDistanceFieldVolumeData& Data)
+{
+	Size = Data.Size;
+	Box = Data.LocalBoundingBox;
+	DistanceScale = Data.LocalBoundingBox.GetExtent().GetMax();
+
+	const int32 NumVoxels = Size.X * Size.Y * Size.Z;
+	Voxels.resize(NumVoxels);
+	if (NumVoxels > 0)
+	{
+		if (!Data.DistanceFieldVolume.empty())
+		{
+			ConvertSDFFloatToFloat(Data.DistanceFieldVolume.data(), Voxels.data(), NumVoxels);
+		}
+		else
+		{
+			Data.CompressedVolume.Decode(Voxels.data());
+		}
+
+		VoxelsPerUnit = FVector(Size.X, Size.Y, Size.Z) / Box.GetSize();
+	}
+}
+
+float FDistanceFieldSampler::Sample(const FVector& LocalPosition) const
+{
+	return SampleVolume(LocalPosition) * DistanceScale + FMath::Sqrt(Box.ComputeSquaredDistanceToPoint(LocalPosition));
+}
+
+float FDistanceFieldSampler::SampleVoxelCoordinate(const FVector& VoxelCoordinate) const
+{
+	const float X = FMath::Clamp(VoxelCoordinate.X, 0.0f, (float)(Size.X - 1));
+	const float Y = FMath::Clamp(VoxelCoordinate.Y, 0.0f, (float)(Size.Y - 1));
+	const float Z = FMath::Clamp(VoxelCoordinate.Z, 0.0f, (float)(Size.Z - 1));
+
+	const int32 X0 = FMath::Min(FMath::FloorToInt(X), Size.X - 2);
+	const int32 Y0 = FMath::Min(FMath::FloorToInt(Y), Size.Y - 2);
+	const int32 Z0 = FMath::Min(FMath::FloorToInt(Z), Size.Z - 2);
+	const float FracX = X - X0;
+	const float FracY = Y - Y0;
+	const float FracZ = Z - Z0;
+
+	const float V00 = FMath::Lerp(GetVoxel(X0, Y0, Z0), GetVoxel(X0 + 1, Y0, Z0), FracX);
+	const float V10 = FMath::Lerp(GetVoxel(X0, Y0 + 1, Z0), GetVoxel(X0 + 1, Y0 + 1, Z0), FracX);
+	const float V01 = FMath::Lerp(GetVoxel(X0, Y0, Z0 + 1), GetVoxel(X0 + 1, Y0, Z0 + 1), FracX);
+	const float V11 = FMath::Lerp(GetVoxel(X0, Y0 + 1, Z0 + 1), GetVoxel(X0 + 1, Y0 + 1, Z0 + 1), FracX);
+	return FMath::Lerp(FMath::Lerp(V00, V10, FracY), FMath::Lerp(V01, V11, FracY), FracZ);
+}
+
+namespace
+{
+	/** FMath::Lerp order, A + Alpha * (B - A), so the lanes match the scalar path. */
+	FORCEINLINE VectorRegister VectorLerp(const VectorRegister& A, const VectorRegister& B, const VectorRegister& Alpha)
+	{
+		return VectorMultiplyAdd(Alpha, VectorSubtract(B, A), A);
+	}
+
+	/** Transposes up to four positions into one register per axis, missing ones repeat the last. */
+	FORCEINLINE void LoadPositions4(const FVector* Positions, int32 NumPositions, VectorRegister OutPosition[3])
+	{
+		MS_ALIGN(16) float Components[3][4];
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			const FVector& Position = Positions[FMath::Min(Lane, NumPositions - 1)];
+			Components[0][Lane] = Position.X;
+			Components[1][Lane] = Position.Y;
+			Components[2][Lane] = Position.Z;
+		}
+		OutPosition[0] = VectorLoadAligned(Components[0]);
+		OutPosition[1] = VectorLoadAligned(Components[1]);
+		OutPosition[2] = VectorLoadAligned(Components[2]);
+	}
+}
+
+VectorRegister FDistanceFieldSampler::SampleVoxelCoordinate4(const VectorRegister VoxelCoordinate[3]) const
+{
+	VectorRegister Fraction[3];
+	MS_ALIGN(16) int32 Base[3][4];
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		// Max first, it returns 0 for NaN
+		const VectorRegister Clamped = VectorMin(VectorMax(VoxelCoordinate[Axis], VectorZero()), VectorSetFloat1((float)(Size(Axis) - 1)));
+		const VectorRegister Floor = VectorMin(_mm_cvtepi32_ps(_mm_cvttps_epi32(Clamped)), VectorSetFloat1((float)(Size(Axis) - 2)));
+		Fraction[Axis] = VectorSubtract(Clamped, Floor);
+		_mm_store_si128((VectorRegisterInt*)Base[Axis], _mm_cvttps_epi32(Floor));
+	}
+
+	const int32 SizeX = Size.X;
+	const int32 SizeXY = Size.X * Size.Y;
+	MS_ALIGN(16) float Corners[8][4];
+	for (int32 Lane = 0; Lane < 4; Lane++)
+	{
+		const float* Voxel = &Voxels[Base[2][Lane] * SizeXY + Base[1][Lane] * SizeX + Base[0][Lane]];
+		Corners[0][Lane] = Voxel[0];
+		Corners[1][Lane] = Voxel[1];
+		Corners[2][Lane] = Voxel[SizeX];
+		Corners[3][Lane] = Voxel[SizeX + 1];
+		Corners[4][Lane] = Voxel[SizeXY];
+		Corners[5][Lane] = Voxel[SizeXY + 1];
+		Corners[6][Lane] = Voxel[SizeXY + SizeX];
+		Corners[7][Lane] = Voxel[SizeXY + SizeX + 1];
+	}
+
+	const VectorRegister V00 = VectorLerp(VectorLoadAligned(Corners[0]), VectorLoadAligned(Corners[1]), Fraction[0]);
+	const VectorRegister V10 = VectorLerp(VectorLoadAligned(Corners[2]), VectorLoadAligned(Corners[3]), Fraction[0]);
+	const VectorRegister V01 = VectorLerp(VectorLoadAligned(Corners[4]), VectorLoadAligned(Corners[5]), Fraction[0]);
+	const VectorRegister V11 = VectorLerp(VectorLoadAligned(Corners[6]), VectorLoadAligned(Corners[7]), Fraction[0]);
+	return VectorLerp(VectorLerp(V00, V10, Fraction[1]), VectorLerp(V01, V11, Fraction[1]), Fraction[2]);
+}
+
+VectorRegister FDistanceFieldSampler::SampleVolume4(const VectorRegister LocalPosition[3]) const
+{
+	VectorRegister VoxelCoordinate[3];
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		VoxelCoordinate[Axis] = VectorSubtract(
+			VectorMultiply(VectorSubtract(LocalPosition[Axis], VectorSetFloat1(Box.Min[Axis])), VectorSetFloat1(VoxelsPerUnit[Axis])),
+			VectorSetFloat1(.5f));
+	}
+	return SampleVoxelCoordinate4(VoxelCoordinate);
+}
+
+VectorRegister FDistanceFieldSampler::SampleTexture4(const VectorRegister UVW[3]) const
+{
+	VectorRegister VoxelCoordinate[3];
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		VoxelCoordinate[Axis] = VectorSubtract(VectorMultiply(UVW[Axis], VectorSetFloat1((float)Size(Axis))), VectorSetFloat1(.5f));
+	}
+	return SampleVoxelCoordinate4(VoxelCoordinate);
+}
+
+VectorRegister FDistanceFieldSampler::Sample4(const VectorRegister LocalPosition[3]) const
+{
+	// Only one of the two terms is positive per axis, like ComputeSquaredDistanceFromBoxToPoint
+	VectorRegister SquaredDistance = VectorZero();
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const VectorRegister Outside = VectorAdd(
+			VectorMax(VectorSubtract(VectorSetFloat1(Box.Min[Axis]), LocalPosition[Axis]), VectorZero()),
+			VectorMax(VectorSubtract(LocalPosition[Axis], VectorSetFloat1(Box.Max[Axis])), VectorZero()));
+		SquaredDistance = VectorMultiplyAdd(Outside, Outside, SquaredDistance);
+	}
+	return VectorMultiplyAdd(SampleVolume4(LocalPosition), VectorSetFloat1(DistanceScale), _mm_sqrt_ps(SquaredDistance));
+}
+
+FVector FDistanceFieldSampler::SampleGradient(const FVector& LocalPosition) const
+{
+	FVector Gradient;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const float Step = 1.0f / VoxelsPerUnit[Axis];
+		FVector Offset(0);
+		Offset[Axis] = Step;
+		Gradient[Axis] = (Sample(LocalPosition + Offset) - Sample(LocalPosition - Offset)) / (2 * Step);
+	}
+	return Gradient;
+}
+
+void FDistanceFieldSampler::SampleGradient4(const VectorRegister LocalPosition[3], VectorRegister OutGradient[3]) const
+{
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const float Step = 1.0f / VoxelsPerUnit[Axis];
+		VectorRegister Position[3] = { LocalPosition[0], LocalPosition[1], LocalPosition[2] };
+		Position[Axis] = VectorAdd(LocalPosition[Axis], VectorSetFloat1(Step));
+		const VectorRegister Forward = Sample4(Position);
+		Position[Axis] = VectorSubtract(LocalPosition[Axis], VectorSetFloat1(Step));
+		const VectorRegister Backward = Sample4(Position);
+		OutGradient[Axis] = VectorDivide(VectorSubtract(Forward, Backward), VectorSetFloat1(2 * Step));
+	}
+}
+
+void FDistanceFieldSampler::SampleBatch(const FVector* LocalPositions, int32 NumPositions, float* OutDistances) const
+{
+	int32 Index = 0;
+	for (; Index + 8 <= NumPositions; Index += 8)
+	{
+		VectorRegister Position0[3];
+		VectorRegister Position1[3];
+		LoadPositions4(LocalPositions + Index, 4, Position0);
+		LoadPositions4(LocalPositions + Index + 4, 4, Position1);
+		VectorStore(Sample4(Position0), OutDistances + Index);
+		VectorStore(Sample4(Position1), OutDistances + Index + 4);
+	}
+
+	for (; Index < NumPositions; Index += 4)
+	{
+		const int32 NumLanes = FMath::Min(NumPositions - Index, 4);
+		VectorRegister Position[3];
+		LoadPositions4(LocalPositions + Index, NumLanes, Position);
+		MS_ALIGN(16) float Distances[4];
+		VectorStoreAligned(Sample4(Position), Distances);
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			OutDistances[Index + Lane] = Distances[Lane];
+		}
+	}
+}
+
+void FDistanceFieldSampler::SampleGradientBatch(const FVector* LocalPositions, int32 NumPositions, FVector* OutGradients, float* OutDistances) const
+{
+	for (int32 Index = 0; Index < NumPositions; Index += 4)
+	{
+		const int32 NumLanes = FMath::Min(NumPositions - Index, 4);
+		VectorRegister Position[3];
+		LoadPositions4(LocalPositions + Index, NumLanes, Position);
+
+		MS_ALIGN(16) float Gradients[3][4];
+		VectorRegister Gradient[3];
+		SampleGradient4(Position, Gradient);
+		VectorStoreAligned(Gradient[0], Gradients[0]);
+		VectorStoreAligned(Gradient[1], Gradients[1]);
+		VectorStoreAligned(Gradient[2], Gradients[2]);
+		for (int32 Lane = 0; Lane < NumLanes; Lane++)
+		{
+			OutGradients[Index + Lane] = FVector(Gradients[0][Lane], Gradients[1][Lane], Gradients[2][Lane]);
+		}
+
+		if (OutDistances)
+		{
+			MS_ALIGN(16) float Distances[4];
+			VectorStoreAligned(Sample4(Position), Distances);
+			for (int32 Lane = 0; Lane < NumLanes; Lane++)
+			{
+				OutDistances[Index + Lane] = Distances[Lane];
+			}
+		}
+	}
+}
@@ -0,0 +1,115 @@
+#ifndef _DISTANCEFIELDSAMPLER
+#define _DISTANCEFIELDSAMPLER
+#include "Config.h"
+#include "IntVector.h"
+#include "Box.h"
+#include "sse.h"
+
+/**
+* CPU copy of a distance field volume expanded to floats for point queries.
+* Filtering matches TexSDF in the shaders: linear filtering with CLAMP addressing,
+* so positions are clamped to the outermost texel centers.
+* The *4 variants evaluate four points held one register per axis, the batch functions take point lists.
+*/
+class FDistanceFieldSampler
+{
+public:
+
+	FDistanceFieldSampler();
+
+	explicit FDistanceFieldSampler(const FDistanceFieldVolumeData& Data);
+
+	/** Decodes Data, from whichever copy of the volume is resident. */
+	void Init(const FDistanceFieldVolumeData& Data);
+
+	/** False when the source volume had no voxels, e.g. the mesh was not closed. */
+	bool IsValid() const
+	{
+		return !Voxels.empty();
+	}
+
+	/** Local space box the volume covers. */
+	const FBox& GetBox() const
+	{
+		return Box;
+	}
+
+	/**
+	* Local space distance at a local space position.
+	* Outside the box the distance to the box is added, which keeps the result a conservative bound.
+	*/
+	float Sample(const FVector& LocalPosition) const;
+
+	/** Volume space value at a local space position, outside the box the outermost texels are returned. */
+	float SampleVolume(const FVector& LocalPosition) const
+	{
+		return SampleVoxelCoordinate((LocalPosition - Box.Min) * VoxelsPerUnit - FVector(.5f));
+	}
+
+	/** Volume space value at a texture coordinate, computed like tex3D through TexSDF. */
+	float SampleTexture(const FVector& UVW) const
+	{
+		return SampleVoxelCoordinate(UVW * FVector(Size.X, Size.Y, Size.Z) - FVector(.5f));
+	}
+
+	/** Sample for four local space positions. */
+	VectorRegister Sample4(const VectorRegister LocalPosition[3]) const;
+
+	/** SampleVolume for four local space positions. */
+	VectorRegister SampleVolume4(const VectorRegister LocalPosition[3]) const;
+
+	/** SampleTexture for four texture coordinates. */
+	VectorRegister SampleTexture4(const VectorRegister UVW[3]) const;
+
+	/** Local space gradient of Sample by central differences one voxel apart, not normalized. */
+	FVector SampleGradient(const FVector& LocalPosition) const;
+
+	/** SampleGradient for four local space positions. */
+	void SampleGradient4(const VectorRegister LocalPosition[3], VectorRegister OutGradient[3]) const;
+
+	/** Sample for every position of the list, eight per iteration. */
+	void SampleBatch(const FVector* LocalPositions, int32 NumPositions, float* OutDistances) const;
+
+	/** SampleGradient for every position of the list, OutDistances is optional. */
+	void SampleGradientBatch(const FVector* LocalPositions, int32 NumPositions, FVector* OutGradients, float* OutDistances = NULL) const;
+
+	/** Decoded voxels, X fastest. */
+	const float* GetVoxels() const
+	{
+		return Voxels.data();
+	}
+
+	const FIntVector& GetSize() const
+	{
+		return Size;
+	}
+
+	/** Converts volume space values to local space distances, the largest extent of the box. */
+	float GetDistanceScale() const
+	{
+		return DistanceScale;
+	}
+
+protected:
+
+	/** Trilinear value at a position in voxels, 0 being the center of the first voxel. */
+	float SampleVoxelCoordinate(const FVector& VoxelCoordinate) const;
+
+	/** SampleVoxelCoordinate for four positions, NaN coordinates read the first voxel. */
+	VectorRegister SampleVoxelCoordinate4(const VectorRegister VoxelCoordinate[3]) const;
+
+	FORCEINLINE float GetVoxel(int32 X, int32 Y, int32 Z) const
+	{
+		return Voxels[(Z * Size.Y + Y) * Size.X + X];
+	}
+
+	TArray<float> Voxels;
+	FIntVector Size;
+	FBox Box;
+	FVector VoxelsPerUnit;
+
+	/** Converts volume space values back to local space distances. */
+	float DistanceScale;
+};
+
+#endif // !_DISTANCEFIELDSAMPLER
@@ -0,0 +1,439 @@
+#include "DistanceFieldShadow.h"
+#include "DistanceFieldSampler.h"
+#include "DistanceFieldCulling.h"
+#include "AsyncWork.h"
+#include <emmintrin.h>
+#include <atomic>
+
+namespace
+{
+	/** Tolerance of inBounds and IntersectBoundsCull in the shader. */
+	const float BoundsEpsilon = 1e-4f;
+
+	/** The shader's first step, in units of the largest extent, that keeps surfaces from shadowing themselves. */
+	const float StartOffset = 0.01f;
+
+	/** Kept well above BoundsEpsilon so rounding never culls a ray the shader would trace. */
+	const float BoundsCullMargin = 1e-2f;
+
+	const int32 TileSizeX = 64;
+	const int32 TileSizeY = 16;
+
+	FORCEINLINE bool InBounds(const FVector& Position, const FVector& Bounds)
+	{
+		return Position.X >= -BoundsEpsilon && Position.Y >= -BoundsEpsilon && Position.Z >= -BoundsEpsilon
+			&& Position.X <= Bounds.X && Position.Y <= Bounds.Y && Position.Z <= Bounds.Z;
+	}
+
+	/** IntersectBoundsCull of the shader, Start is relative to the volume's min corner. */
+	void IntersectBoundsCull(const FVector& Start, const FVector& Dir, FVector Bounds, FVector& OutI1, float& OutLength)
+	{
+		const FVector TMin = -Start / Dir;
+		const FVector TMax = (Bounds - Start) / Dir;
+		Bounds += FVector(BoundsEpsilon);
+		float MinT = 3.40282e+038f;
+		float MaxT = 0;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			if (InBounds(Start + TMin[Axis] * Dir, Bounds))
+			{
+				MinT = FMath::Min(TMin[Axis], MinT);
+				MaxT = FMath::Max(TMin[Axis], MaxT);
+			}
+
+			if (InBounds(Start + TMax[Axis] * Dir, Bounds))
+			{
+				MinT = FMath::Min(TMax[Axis], MinT);
+				MaxT = FMath::Max(TMax[Axis], MaxT);
+			}
+		}
+
+		MinT = FMath::Max(0.0f, MinT);
+		OutI1 = Start + Dir * MinT;
+		OutLength = MaxT - MinT;
+	}
+
+	FORCEINLINE __m128 Select(__m128 Mask, __m128 A, __m128 B)
+	{
+		return _mm_or_ps(_mm_and_ps(Mask, A), _mm_andnot_ps(Mask, B));
+	}
+
+	FORCEINLINE int32 CountLanes(__m128 Mask)
+	{
+		static const int32 NumBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+		return NumBits[_mm_movemask_ps(Mask)];
+	}
+
+	/** One object prepared for four lanes, in the shader's volume space where the min corner is the origin. */
+	struct FShadowObjectLanes
+	{
+		const FDistanceFieldSampler* Sampler;
+		FVector Offset;
+		FVector Bounds;
+		float BoundMax;
+
+		/** World box of the volume grown by the shader's tolerance, used to cull whole tiles. */
+		FBox WorldBox;
+
+		FVector InvBounds;
+
+		void Init(const FDistanceFieldShadowObject& Object)
+		{
+			Sampler = Object.Sampler;
+			Offset = Object.Position + Sampler->GetBox().Min;
+			Bounds = Sampler->GetBox().GetSize();
+			BoundMax = Sampler->GetDistanceScale();
+			WorldBox = FBox(Offset, Offset + Bounds).ExpandBy(BoundsCullMargin);
+			InvBounds = FVector(1.0f) / Bounds;
+		}
+
+		/** tex3D(TexSDF, Start * Scale) for four lanes. */
+		FORCEINLINE __m128 SampleTexture(const __m128 Start[3]) const
+		{
+			const __m128 UVW[3] = {
+				_mm_mul_ps(Start[0], _mm_set1_ps(InvBounds.X)),
+				_mm_mul_ps(Start[1], _mm_set1_ps(InvBounds.Y)),
+				_mm_mul_ps(Start[2], _mm_set1_ps(InvBounds.Z)) };
+			return Sampler->SampleTexture4(UVW);
+		}
+	};
+
+	/**
+	* The shader's PS for four lanes of one object.
+	* Position holds world positions, Active the lanes facing the light, the lanes' shadow factors are min-ed into Shadow.
+	*/
+	void TraceShadow4(const FShadowObjectLanes& Object, const FVector& Dir, const __m128 Position[3], __m128 Active, __m128& Shadow, int32& NumSteps)
+	{
+		const __m128 Zero = _mm_setzero_ps();
+		const __m128 Epsilon = _mm_set1_ps(-BoundsEpsilon);
+		__m128 Start[3];
+		__m128 DirV[3];
+		__m128 Bounds[3];
+		__m128 ExpandedBounds[3];
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Start[Axis] = _mm_sub_ps(Position[Axis], _mm_set1_ps(Object.Offset[Axis]));
+			DirV[Axis] = _mm_set1_ps(Dir[Axis]);
+			Bounds[Axis] = _mm_set1_ps(Object.Bounds[Axis]);
+			ExpandedBounds[Axis] = _mm_set1_ps(Object.Bounds[Axis] + BoundsEpsilon);
+		}
+
+		// IntersectBoundsCull
+		__m128 MinT = _mm_set1_ps(3.40282e+038f);
+		__m128 MaxT = Zero;
+		for (int32 Candidate = 0; Candidate < 6; Candidate++)
+		{
+			const int32 Axis = Candidate >> 1;
+			const __m128 Plane = Candidate & 1 ? Bounds[Axis] : Zero;
+			const __m128 T = _mm_div_ps(_mm_sub_ps(Plane, Start[Axis]), DirV[Axis]);
+
+			__m128 Inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int32 Component = 0; Component < 3; Component++)
+			{
+				const __m128 P = _mm_add_ps(Start[Component], _mm_mul_ps(T, DirV[Component]));
+				Inside = _mm_and_ps(Inside, _mm_and_ps(_mm_cmpge_ps(P, Epsilon), _mm_cmple_ps(P, ExpandedBounds[Component])));
+			}
+
+			MinT = Select(Inside, _mm_min_ps(T, MinT), MinT);
+			MaxT = Select(Inside, _mm_max_ps(T, MaxT), MaxT);
+		}
+		MinT = _mm_max_ps(Zero, MinT);
+		const __m128 Length = _mm_sub_ps(MaxT, MinT);
+
+		const float Origin = StartOffset * Object.BoundMax;
+		const __m128 SmallStep = _mm_div_ps(Length, _mm_set1_ps((float)DISTANCEFIELD_SHADOW_STEPS));
+		const __m128 BoundMax = _mm_set1_ps(Object.BoundMax);
+		const __m128 TotalSteps = _mm_set1_ps((float)DISTANCEFIELD_SHADOW_STEPS);
+		__m128 Len = _mm_set1_ps(Origin);
+		__m128 MinStep = _mm_set1_ps(Origin * DISTANCEFIELD_SHADOW_STEPS / Origin);
+		__m128 LaneShadow = _mm_set1_ps(1.0f);
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			Start[Axis] = _mm_add_ps(_mm_add_ps(Start[Axis], _mm_mul_ps(DirV[Axis], MinT)), _mm_mul_ps(_mm_set1_ps(Origin), DirV[Axis]));
+		}
+
+		for (int32 StepIndex = 0; StepIndex <= DISTANCEFIELD_SHADOW_STEPS; StepIndex++)
+		{
+			Active = _mm_and_ps(Active, _mm_cmplt_ps(Len, Length));
+			if (!_mm_movemask_ps(Active))
+			{
+				break;
+			}
+			NumSteps += CountLanes(Active);
+
+			__m128 Step = Object.SampleTexture(Start);
+			const __m128 Hit = _mm_and_ps(Active, _mm_cmple_ps(Step, Zero));
+			LaneShadow = Select(Hit, Zero, LaneShadow);
+			Active = _mm_andnot_ps(Hit, Active);
+
+			Step = _mm_mul_ps(Step, BoundMax);
+			MinStep = Select(Active, _mm_min_ps(MinStep, _mm_div_ps(_mm_mul_ps(Step, TotalSteps), Len)), MinStep);
+			Step = _mm_max_ps(Step, SmallStep);
+			Len = Select(Active, _mm_add_ps(Len, Step), Len);
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Start[Axis] = Select(Active, _mm_add_ps(Start[Axis], _mm_mul_ps(Step, DirV[Axis])), Start[Axis]);
+			}
+		}
+
+		LaneShadow = Select(_mm_cmplt_ps(MinStep, _mm_set1_ps(1.0f)), _mm_mul_ps(LaneShadow, MinStep), LaneShadow);
+		Shadow = _mm_min_ps(Shadow, LaneShadow);
+	}
+}
+
+/** Traces tiles of the buffer, pulled from a shared counter until none are left. */
+class FDistanceFieldShadowTask
+{
+public:
+	FDistanceFieldShadowTask(
+		const FDistanceFieldShadowView* InView,
+		const FVector* InLightDirection,
+		const TArray<FShadowObjectLanes>* InObjects,
+		const FDistanceFieldTileObjects* InTiles,
+		const float* InDepthBuffer,
+		const FVector* InNormalBuffer,
+		FIntVector InBufferSize,
+		std::atomic<int32>* InNextTile,
+		float* InOutShadow)
+		: View(InView)
+		, LightDirection(InLightDirection)
+		, Objects(InObjects)
+		, Tiles(InTiles)
+		, DepthBuffer(InDepthBuffer)
+		, NormalBuffer(InNormalBuffer)
+		, BufferSize(InBufferSize)
+		, NextTile(InNextTile)
+		, OutShadow(InOutShadow)
+	{}
+
+	void DoWork()
+	{
+		const int32 NumTilesX = Tiles->NumTilesX;
+		const int32 NumTiles = NumTilesX * Tiles->NumTilesY;
+		const FVector Dir = -*LightDirection;
+
+		for (int32 TileIndex = (*NextTile)++; TileIndex < NumTiles; TileIndex = (*NextTile)++)
+		{
+			const int32 MinX = TileIndex % NumTilesX * TileSizeX;
+			const int32 MinY = TileIndex / NumTilesX * TileSizeY;
+			const int32 MaxX = FMath::Min(MinX + TileSizeX, BufferSize.X);
+			const int32 MaxY = FMath::Min(MinY + TileSizeY, BufferSize.Y);
+
+			// Only the objects its rays towards the light can reach
+			const int32 NumTileObjects = Tiles->GetNumObjects(TileIndex);
+			const int32* TileObjects = Tiles->GetObjects(TileIndex);
+
+			int32 NumTilePixels = 0;
+			for (int32 Y = MinY; Y < MaxY; Y++)
+			{
+				for (int32 X = MinX; X < MaxX; X++)
+				{
+					const int32 PixelIndex = Y * BufferSize.X + X;
+					const FVector WorldPosition = GetDistanceFieldShadowWorldPosition(*View, X, Y, BufferSize.X, BufferSize.Y, DepthBuffer[PixelIndex]);
+					TilePositions[NumTilePixels++] = WorldPosition;
+				}
+			}
+
+			const int32 TileWidth = MaxX - MinX;
+			for (int32 Y = MinY; Y < MaxY; Y++)
+			{
+				for (int32 X = MinX; X < MaxX; X += 4)
+				{
+					MS_ALIGN(16) float Position[3][4];
+					MS_ALIGN(16) float Facing[4];
+					for (int32 Lane = 0; Lane < 4; Lane++)
+					{
+						const int32 PixelX = FMath::Min(X + Lane, MaxX - 1);
+						const int32 PixelIndex = Y * BufferSize.X + PixelX;
+						const FVector& WorldPosition = TilePositions[(Y - MinY) * TileWidth + PixelX - MinX];
+						Position[0][Lane] = WorldPosition.X;
+						Position[1][Lane] = WorldPosition.Y;
+						Position[2][Lane] = WorldPosition.Z;
+
+						// clip(dot(normalW, dir)) and lanes past the end of the tile
+						const bool bFacing = X + Lane < MaxX && FVector::DotProduct(NormalBuffer[PixelIndex], Dir) >= 0;
+						Facing[Lane] = bFacing ? 1.0f : 0.0f;
+						NumLitPixels += bFacing ? 1 : 0;
+					}
+
+					const __m128 PositionV[3] = { _mm_load_ps(Position[0]), _mm_load_ps(Position[1]), _mm_load_ps(Position[2]) };
+					const __m128 Active = _mm_cmpgt_ps(_mm_load_ps(Facing), _mm_setzero_ps());
+					__m128 Shadow = _mm_set1_ps(1.0f);
+					if (_mm_movemask_ps(Active))
+					{
+						for (int32 ObjectIndex = 0; ObjectIndex < NumTileObjects; ObjectIndex++)
+						{
+							TraceShadow4((*Objects)[TileObjects[ObjectIndex]], Dir, PositionV, Active, Shadow, NumSteps);
+						}
+					}
+
+					MS_ALIGN(16) float Result[4];
+					_mm_store_ps(Result, Shadow);
+					for (int32 Lane = 0; Lane < 4 && X + Lane < MaxX; Lane++)
+					{
+						OutShadow[Y * BufferSize.X + X + Lane] = Result[Lane];
+					}
+				}
+			}
+		}
+	}
+
+	int32 NumLitPixels = 0;
+	int32 NumSteps = 0;
+
+private:
+	const FDistanceFieldShadowView* View;
+	const FVector* LightDirection;
+	const TArray<FShadowObjectLanes>* Objects;
+	const FDistanceFieldTileObjects* Tiles;
+	const float* DepthBuffer;
+	const FVector* NormalBuffer;
+	FIntVector BufferSize;
+	std::atomic<int32>* NextTile;
+	float* OutShadow;
+
+	FVector TilePositions[TileSizeX * TileSizeY];
+};
+
+FVector GetDistanceFieldShadowWorldPosition(const FDistanceFieldShadowView& View, int32 X, int32 Y, int32 Width, int32 Height, float Depth)
+{
+	const float NDCX = (X + .5f) / Width * 2.0f - 1.0f;
+	const float NDCY = 1.0f - (Y + .5f) / Height * 2.0f;
+	const FVector Ray = View.Forward + View.Right * (NDCX * View.TanHalfFovX) + View.Up * (NDCY * View.TanHalfFovY);
+	return View.EyePosition + Ray * (Depth * View.FarClipDistance);
+}
+
+float TraceDistanceFieldShadow(
+	const FDistanceFieldShadowObject& Object
+	, const FVector& WorldPosition
+	, const FVector& WorldNormal
+	, const FVector& LightDirection
+	, int32* OutNumSteps)
+{
+	const FVector Dir = -LightDirection;
+	if (!Object.Sampler->IsValid() || FVector::DotProduct(WorldNormal, Dir) < 0)
+	{
+		return 1.0f;
+	}
+
+	const FDistanceFieldSampler& Sampler = *Object.Sampler;
+	const FVector Bounds = Sampler.GetBox().GetSize();
+	const FVector Scale = FVector(1.0f) / Bounds;
+	const float BoundMax = Sampler.GetDistanceScale();
+	const FVector PosSDF = WorldPosition - (Object.Position + Sampler.GetBox().Min);
+
+	FVector Start;
+	float Length;
+	IntersectBoundsCull(PosSDF, Dir, Bounds, Start, Length);
+
+	const float SmallStep = Length / DISTANCEFIELD_SHADOW_STEPS;
+	const float Origin = StartOffset * BoundMax;
+	Start += Origin * Dir;
+	float Len = Origin;
+	float MinStep = Origin * DISTANCEFIELD_SHADOW_STEPS / Len;
+	float Shadow = 1.0f;
+	int32 NumSteps = 0;
+
+	for (int32 StepIndex = 0; StepIndex <= DISTANCEFIELD_SHADOW_STEPS; StepIndex++)
+	{
+		if (Len >= Length)
+		{
+			break;
+		}
+
+		NumSteps++;
+		float Step = Sampler.SampleTexture(Start * Scale);
+		if (Step <= 0)
+		{
+			Shadow = 0.0f;
+			break;
+		}
+
+		Step *= BoundMax;
+		MinStep = FMath::Min(MinStep, Step * DISTANCEFIELD_SHADOW_STEPS / Len);
+		if (Step < SmallStep)
+		{
+			Step = SmallStep;
+		}
+		Len += Step;
+		Start += Step * Dir;
+	}
+
+	if (OutNumSteps)
+	{
+		*OutNumSteps += NumSteps;
+	}
+
+	if (MinStep < 1.0f)
+	{
+		Shadow *= MinStep;
+	}
+	return Shadow;
+}
+
+void ComputeDistanceFieldShadows(
+	const FDistanceFieldShadowView& View
+	, const FVector& LightDirection
+	, const FDistanceFieldShadowObject* Objects
+	, int32 NumObjects
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, float* OutShadow
+	, FDistanceFieldShadowStats* OutStats)
+{
+	TArray<FShadowObjectLanes> ObjectLanes;
+	for (int32 ObjectIndex = 0; ObjectIndex < NumObjects; ObjectIndex++)
+	{
+		if (Objects[ObjectIndex].Sampler->IsValid())
+		{
+			ObjectLanes.push_back(FShadowObjectLanes());
+			ObjectLanes.back().Init(Objects[ObjectIndex]);
+		}
+	}
+
+	TArray<FBox> ObjectBounds;
+	for (uint32 ObjectIndex = 0; ObjectIndex < ObjectLanes.size(); ObjectIndex++)
+	{
+		ObjectBounds.push_back(ObjectLanes[ObjectIndex].WorldBox);
+	}
+	FDistanceFieldTileObjects Tiles;
+	CullDistanceFieldObjectsForLight(View, LightDirection, ObjectBounds.data(), ObjectBounds.size(), DepthBuffer, NormalBuffer, Width, Height, TileSizeX, TileSizeY, Tiles);
+
+	std::atomic<int32> NextTile(0);
+	const int32 NumWorkers = FMath::Clamp((int32)std::thread::hardware_concurrency(), 1, MAXTHREADNUM);
+	FQueuedThreadPool ThreadPool;
+	TArray<FAsyncTask<FDistanceFieldShadowTask>*> AsyncTasks;
+
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		FAsyncTask<FDistanceFieldShadowTask>* Task = new FAsyncTask<FDistanceFieldShadowTask>(
+			&View,
+			&LightDirection,
+			&ObjectLanes,
+			&Tiles,
+			DepthBuffer,
+			NormalBuffer,
+			FIntVector(Width, Height, 1),
+			&NextTile,
+			OutShadow);
+
+		ThreadPool.AddWork(Task);
+		AsyncTasks.push_back(Task);
+	}
+	ThreadPool.DoAllWork();
+
+	FDistanceFieldShadowStats Stats;
+	for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+	{
+		Stats.NumLitPixels += AsyncTasks[TaskIndex]->GetTask().NumLitPixels;
+		Stats.NumSteps += AsyncTasks[TaskIndex]->GetTask().NumSteps;
+		delete AsyncTasks[TaskIndex];
+	}
+
+	if (OutStats)
+	{
+		*OutStats = Stats;
+	}
+}
@@ -0,0 +1,82 @@
+#ifndef _DISTANCEFIELDSHADOW
+#define _DISTANCEFIELDSHADOW
+#include "Config.h"
+#include "Vector.h"
+
+class FDistanceFieldSampler;
+
+/** Sphere trace steps of the PS in FX/SDFshadow.fx, TOTALSTEP. */
+#define DISTANCEFIELD_SHADOW_STEPS 32
+
+/**
+* Camera the depth buffer was rendered with.
+* World positions are rebuilt like SDFshadow.fx: EyePosition + ray * depth * FarClipDistance, with the ray scaled to a view depth of 1.
+*/
+struct FDistanceFieldShadowView
+{
+	FVector EyePosition;
+
+	/** Unit world space camera axes. */
+	FVector Right;
+	FVector Up;
+	FVector Forward;
+
+	float TanHalfFovX;
+	float TanHalfFovY;
+	float FarClipDistance;
+};
+
+/** A volume placed in the world by translation, as SDFShadowPass places the proxies. */
+struct FDistanceFieldShadowObject
+{
+	const FDistanceFieldSampler* Sampler;
+	FVector Position;
+};
+
+struct FDistanceFieldShadowStats
+{
+	/** Pixels facing the light, the others are clipped by the shader. */
+	int32 NumLitPixels;
+
+	/** Sphere trace steps summed over every pixel and object. */
+	int32 NumSteps;
+
+	FDistanceFieldShadowStats()
+		: NumLitPixels(0)
+		, NumSteps(0)
+	{}
+};
+
+/**
+* Shadow factor of one object at one world position, a scalar transcription of the shader's PS.
+* Returns 1 for pixels the shader would clip.
+*/
+float TraceDistanceFieldShadow(
+	const FDistanceFieldShadowObject& Object
+	, const FVector& WorldPosition
+	, const FVector& WorldNormal
+	, const FVector& LightDirection
+	, int32* OutNumSteps = NULL);
+
+/**
+* Shadow factors of every pixel of a linear depth buffer (view depth / far clip) and a world normal buffer.
+* Objects are combined with min, where the GPU runs one pass per object.
+* Four pixels are traced at once with SSE, tiles of the buffer are spread over worker threads
+* and skip the objects none of their rays towards the light can reach.
+*/
+void ComputeDistanceFieldShadows(
+	const FDistanceFieldShadowView& View
+	, const FVector& LightDirection
+	, const FDistanceFieldShadowObject* Objects
+	, int32 NumObjects
+	, const float* DepthBuffer
+	, const FVector* NormalBuffer
+	, int32 Width
+	, int32 Height
+	, float* OutShadow
+	, FDistanceFieldShadowStats* OutStats = NULL);
+
+/** World position of pixel (X, Y) rebuilt from its linear depth. */
+FVector GetDistanceFieldShadowWorldPosition(const FDistanceFieldShadowView& View, int32 X, int32 Y, int32 Width, int32 Height, float Depth);
+
+#endif // !_DISTANCEFIELDSHADOW
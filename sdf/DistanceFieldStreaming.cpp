@@ -0,0 +1,646 @@
+#include "DistanceFieldStreaming.h"
+#include "MeshUtilities.h"
+#include <algorithm>
+#include <stdio.h>
+
+namespace
+{
+	/** Halves a volume with a 2x2x2 box filter, odd edges replicate their last voxel. */
+	void DownsampleVolume(const TArray<float>& Src, const FIntVector& SrcSize, TArray<float>& Dest, FIntVector& DestSize)
+	{
+		DestSize = FIntVector(
+			FMath::DivideAndRoundUp(SrcSize.X, 2),
+			FMath::DivideAndRoundUp(SrcSize.Y, 2),
+			FMath::DivideAndRoundUp(SrcSize.Z, 2));
+		Dest.resize(DestSize.X * DestSize.Y * DestSize.Z);
+
+		for (int32 Z = 0; Z < DestSize.Z; Z++)
+		{
+			const int32 Z0 = Z * 2;
+			const int32 Z1 = FMath::Min(Z0 + 1, SrcSize.Z - 1);
+			for (int32 Y = 0; Y < DestSize.Y; Y++)
+			{
+				const int32 Y0 = Y * 2;
+				const int32 Y1 = FMath::Min(Y0 + 1, SrcSize.Y - 1);
+				const float* Rows[4] =
+				{
+					&Src[(Z0 * SrcSize.Y + Y0) * SrcSize.X],
+					&Src[(Z0 * SrcSize.Y + Y1) * SrcSize.X],
+					&Src[(Z1 * SrcSize.Y + Y0) * SrcSize.X],
+					&Src[(Z1 * SrcSize.Y + Y1) * SrcSize.X],
+				};
+				float* DestRow = &Dest[(Z * DestSize.Y + Y) * DestSize.X];
+				for (int32 X = 0; X < DestSize.X; X++)
+				{
+					const int32 X0 = X * 2;
+					const int32 X1 = FMath::Min(X0 + 1, SrcSize.X - 1);
+					float Sum = 0;
+					for (int32 Row = 0; Row < 4; Row++)
+					{
+						Sum += Rows[Row][X0] + Rows[Row][X1];
+					}
+					DestRow[X] = Sum * 0.125f;
+				}
+			}
+		}
+	}
+
+	/** Bytes the encoded voxels of a mip take in its format, 0 when its size or format is invalid. */
+	uint64 GetMipEncodedBytes(const FDistanceFieldFileMip& Mip)
+	{
+		if (Mip.Size[0] <= 0 || Mip.Size[1] <= 0 || Mip.Size[2] <= 0)
+		{
+			return 0;
+		}
+
+		const uint64 NumVoxels = (uint64)Mip.Size[0] * Mip.Size[1] * Mip.Size[2];
+		switch (Mip.Format)
+		{
+		case DFF_Float16:
+			return NumVoxels * sizeof(FFloat16);
+		case DFF_Unorm8:
+			return NumVoxels;
+		case DFF_Block4x4x4:
+		{
+			const int32 BlockSize = FCompressedDistanceFieldVolume::BlockSize;
+			return (uint64)FMath::DivideAndRoundUp(Mip.Size[0], BlockSize)
+				* FMath::DivideAndRoundUp(Mip.Size[1], BlockSize)
+				* FMath::DivideAndRoundUp(Mip.Size[2], BlockSize)
+				* sizeof(FDistanceFieldBlock);
+		}
+		default:
+			return 0;
+		}
+	}
+
+	/** Every mip must hold exactly the bytes its size and format need, after the header and inside the file. */
+	bool IsValidHeader(const FDistanceFieldFileHeader& Header, uint64 FileSize)
+	{
+		if (Header.Magic != DISTANCEFIELD_FILE_MAGIC
+			|| Header.Version != DISTANCEFIELD_FILE_VERSION
+			|| Header.NumMips <= 0
+			|| Header.NumMips > DISTANCEFIELD_FILE_MAX_MIPS)
+		{
+			return false;
+		}
+
+		for (int32 MipIndex = 0; MipIndex < Header.NumMips; MipIndex++)
+		{
+			const FDistanceFieldFileMip& Mip = Header.Mips[MipIndex];
+			const uint64 EncodedBytes = GetMipEncodedBytes(Mip);
+			if (EncodedBytes == 0
+				|| Mip.NumBytes != EncodedBytes
+				|| Mip.Offset < sizeof(FDistanceFieldFileHeader)
+				|| (uint64)Mip.Offset + Mip.NumBytes > FileSize)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/** Reads the header of an open volume file, false if it does not describe the file. */
+	bool ReadHeader(FILE* File, FDistanceFieldFileHeader& OutHeader)
+	{
+		if (fseek(File, 0, SEEK_END) != 0)
+		{
+			return false;
+		}
+
+		const long FileSize = ftell(File);
+		return FileSize >= 0
+			&& fseek(File, 0, SEEK_SET) == 0
+			&& fread(&OutHeader, sizeof(OutHeader), 1, File) == 1
+			&& IsValidHeader(OutHeader, (uint64)FileSize);
+	}
+
+	/** Resident bytes of a mip once loaded, FDistanceFieldVolumeData::GetResourceSize of the result. */
+	SIZE_t GetMipResourceSize(const FDistanceFieldFileMip& Mip)
+	{
+		const SIZE_t NumVoxels = (SIZE_t)Mip.Size[0] * Mip.Size[1] * Mip.Size[2];
+		return sizeof(FDistanceFieldVolumeData) + (Mip.Format == DFF_Float16 ? NumVoxels * sizeof(SDFFloat) : Mip.NumBytes);
+	}
+}
+
+bool SaveDistanceFieldVolume(const char* Filename, FDistanceFieldVolumeData& Volume, int32 NumMips)
+{
+	const SDFFloat* VolumeData = NULL;
+	TArray<SDFFloat> Scratch;
+	const int32 NumVoxels = Volume.GetDistanceFieldVolumeData(VolumeData, Scratch);
+	if (NumVoxels == 0)
+	{
+		return false;
+	}
+
+	FDistanceFieldFileHeader Header;
+	memset(&Header, 0, sizeof(Header));
+	Header.Magic = DISTANCEFIELD_FILE_MAGIC;
+	Header.Version = DISTANCEFIELD_FILE_VERSION;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		Header.LocalBoundsMin[Axis] = Volume.LocalBoundingBox.Min[Axis];
+		Header.LocalBoundsMax[Axis] = Volume.LocalBoundingBox.Max[Axis];
+	}
+	Header.bMeshWasClosed = Volume.bMeshWasClosed;
+	Header.bBuiltAsIfTwoSided = Volume.bBuiltAsIfTwoSided;
+	Header.bMeshWasPlane = Volume.bMeshWasPlane;
+
+	TArray<float> Level(NumVoxels);
+	ConvertSDFFloatToFloat(VolumeData, Level.data(), NumVoxels);
+	FIntVector LevelSize = Volume.Size;
+
+	FCompressedDistanceFieldVolume Encoded[DISTANCEFIELD_FILE_MAX_MIPS];
+	uint32 Offset = sizeof(FDistanceFieldFileHeader);
+	NumMips = FMath::Clamp(NumMips, 1, DISTANCEFIELD_FILE_MAX_MIPS);
+	for (int32 MipIndex = 0; MipIndex < NumMips; MipIndex++)
+	{
+		if (MipIndex > 0)
+		{
+			if (FMath::Min(LevelSize.X, FMath::Min(LevelSize.Y, LevelSize.Z)) < 8)
+			{
+				break;
+			}
+
+			TArray<float> NextLevel;
+			FIntVector NextSize;
+			DownsampleVolume(Level, LevelSize, NextLevel, NextSize);
+			Level.swap(NextLevel);
+			LevelSize = NextSize;
+		}
+
+		FCompressedDistanceFieldVolume& MipVolume = Encoded[MipIndex];
+		MipVolume.Encode(Level.data(), LevelSize, Volume.Format);
+
+		FDistanceFieldFileMip& Mip = Header.Mips[MipIndex];
+		Mip.Size[0] = LevelSize.X;
+		Mip.Size[1] = LevelSize.Y;
+		Mip.Size[2] = LevelSize.Z;
+		Mip.Format = MipVolume.Format;
+		Mip.Scale = MipVolume.Scale;
+		Mip.Bias = MipVolume.Bias;
+		Mip.Offset = Offset;
+		Mip.NumBytes = MipVolume.Data.size();
+		Offset += Mip.NumBytes;
+		Header.NumMips = MipIndex + 1;
+	}
+
+	FILE* File = fopen(Filename, "wb");
+	if (!File)
+	{
+		return false;
+	}
+
+	bool bWritten = fwrite(&Header, sizeof(Header), 1, File) == 1;
+	for (int32 MipIndex = 0; MipIndex < Header.NumMips && bWritten; MipIndex++)
+	{
+		const TArray<uint8>& Data = Encoded[MipIndex].Data;
+		bWritten = fwrite(Data.data(), 1, Data.size(), File) == Data.size();
+	}
+	fclose(File);
+	return bWritten;
+}
+
+bool LoadDistanceFieldFileHeader(const char* Filename, FDistanceFieldFileHeader& OutHeader)
+{
+	FILE* File = fopen(Filename, "rb");
+	if (!File)
+	{
+		return false;
+	}
+
+	const bool bRead = ReadHeader(File, OutHeader);
+	fclose(File);
+	return bRead;
+}
+
+FDistanceFieldVolumeData* LoadDistanceFieldVolume(const char* Filename, int32 MipIndex)
+{
+	FILE* File = fopen(Filename, "rb");
+	if (!File)
+	{
+		return NULL;
+	}
+
+	FDistanceFieldFileHeader Header;
+	if (!ReadHeader(File, Header) || MipIndex < 0 || MipIndex >= Header.NumMips)
+	{
+		fclose(File);
+		return NULL;
+	}
+
+	const FDistanceFieldFileMip& Mip = Header.Mips[MipIndex];
+	FCompressedDistanceFieldVolume Compressed;
+	Compressed.Format = (EDistanceFieldFormat)Mip.Format;
+	Compressed.Size = FIntVector(Mip.Size[0], Mip.Size[1], Mip.Size[2]);
+	Compressed.Scale = Mip.Scale;
+	Compressed.Bias = Mip.Bias;
+	if (Compressed.Format == DFF_Block4x4x4)
+	{
+		const int32 BlockSize = FCompressedDistanceFieldVolume::BlockSize;
+		Compressed.NumBlocks = FIntVector(
+			FMath::DivideAndRoundUp(Mip.Size[0], BlockSize),
+			FMath::DivideAndRoundUp(Mip.Size[1], BlockSize),
+			FMath::DivideAndRoundUp(Mip.Size[2], BlockSize));
+	}
+	Compressed.Data.resize(Mip.NumBytes);
+
+	const bool bRead = fseek(File, Mip.Offset, SEEK_SET) == 0
+		&& fread(Compressed.Data.data(), 1, Mip.NumBytes, File) == Mip.NumBytes;
+	fclose(File);
+	if (!bRead)
+	{
+		return NULL;
+	}
+
+	FBox Bounds(
+		FVector(Header.LocalBoundsMin[0], Header.LocalBoundsMin[1], Header.LocalBoundsMin[2]),
+		FVector(Header.LocalBoundsMax[0], Header.LocalBoundsMax[1], Header.LocalBoundsMax[2]));
+	FDistanceFieldVolumeData* Volume = new FDistanceFieldVolumeData(Bounds);
+	Volume->LocalBoundingBox = Bounds;
+	Volume->Size = Compressed.Size;
+	Volume->bMeshWasClosed = Header.bMeshWasClosed != 0;
+	Volume->bBuiltAsIfTwoSided = Header.bBuiltAsIfTwoSided != 0;
+	Volume->bMeshWasPlane = Header.bMeshWasPlane != 0;
+	Volume->Format = Compressed.Format;
+	std::swap(Volume->CompressedVolume, Compressed);
+
+	// Half floats are what the bake holds in DistanceFieldVolume, keep them there like Compress does
+	if (Volume->Format == DFF_Float16)
+	{
+		Volume->Decompress();
+		Volume->CompressedVolume.Empty();
+	}
+	return Volume;
+}
+
+/** Reads the requests of a batch until there are none left. */
+class FDistanceFieldStreamingTask
+{
+public:
+	FDistanceFieldStreamingTask(FDistanceFieldStreamingManager* InManager, TArray<FDistanceFieldStreamingManager::FLoadRequest>* InRequests, std::atomic<int32>* InNextRequest)
+		: Manager(InManager)
+		, Requests(InRequests)
+		, NextRequest(InNextRequest)
+	{}
+
+	void DoWork()
+	{
+		const int32 NumRequests = Requests->size();
+		for (int32 RequestIndex = (*NextRequest)++; RequestIndex < NumRequests; RequestIndex = (*NextRequest)++)
+		{
+			FDistanceFieldStreamingManager::FLoadRequest& Request = (*Requests)[RequestIndex];
+			Request.Result = LoadDistanceFieldVolume(Request.Filename.c_str(), Request.MipIndex);
+		}
+
+		// The streaming thread frees the task once the last one is counted
+		std::lock_guard<std::mutex> Lock(Manager->Mutex);
+		Manager->NumActiveTasks--;
+		Manager->Condition.notify_all();
+	}
+
+private:
+	FDistanceFieldStreamingManager* Manager;
+	TArray<FDistanceFieldStreamingManager::FLoadRequest>* Requests;
+	std::atomic<int32>* NextRequest;
+};
+
+FDistanceFieldStreamingManager::FDistanceFieldStreamingManager(const FDistanceFieldStreamingSettings& InSettings)
+	: Settings(InSettings)
+	, Frame(0)
+	, InFlightBytes(0)
+	, NumLoading(0)
+	, NumActiveTasks(0)
+	, bStopRequested(false)
+	, ThreadPool(FMath::Clamp(InSettings.NumWorkers, 1, MAXTHREADNUM))
+{
+	StreamingThread = std::thread(&FDistanceFieldStreamingManager::Run, this);
+}
+
+FDistanceFieldStreamingManager::~FDistanceFieldStreamingManager()
+{
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		bStopRequested = true;
+	}
+	Condition.notify_all();
+	StreamingThread.join();
+
+	for (uint32 LoadIndex = 0; LoadIndex < CompletedLoads.size(); LoadIndex++)
+	{
+		delete CompletedLoads[LoadIndex].Result;
+	}
+	for (uint32 VolumeIndex = 0; VolumeIndex < Volumes.size(); VolumeIndex++)
+	{
+		delete Volumes[VolumeIndex].Resident;
+	}
+}
+
+void FDistanceFieldStreamingManager::Run()
+{
+	for (;;)
+	{
+		TArray<FLoadRequest> Batch;
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			Condition.wait(Lock, [this]() { return bStopRequested || !PendingLoads.empty(); });
+			if (bStopRequested)
+			{
+				return;
+			}
+			Batch.swap(PendingLoads);
+			NumLoading = Batch.size();
+		}
+
+		std::atomic<int32> NextRequest(0);
+		const int32 NumWorkers = FMath::Min(ThreadPool.GetNumThreads(), (int32)Batch.size());
+		TArray<FAsyncTask<FDistanceFieldStreamingTask>*> AsyncTasks;
+		for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+		{
+			AsyncTasks.push_back(new FAsyncTask<FDistanceFieldStreamingTask>(this, &Batch, &NextRequest));
+		}
+
+		// Counted before any is queued, so an early finisher cannot end the wait
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			NumActiveTasks = NumWorkers;
+		}
+		for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+		{
+			ThreadPool.AddQueuedWork(AsyncTasks[WorkerIndex]);
+		}
+		{
+			std::unique_lock<std::mutex> Lock(Mutex);
+			Condition.wait(Lock, [this]() { return NumActiveTasks == 0; });
+		}
+
+		for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+		{
+			delete AsyncTasks[TaskIndex];
+		}
+
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			CompletedLoads.insert(CompletedLoads.end(), Batch.begin(), Batch.end());
+			NumLoading = 0;
+		}
+		Condition.notify_all();
+	}
+}
+
+void FDistanceFieldStreamingManager::Flush()
+{
+	std::unique_lock<std::mutex> Lock(Mutex);
+	Condition.wait(Lock, [this]() { return PendingLoads.empty() && NumLoading == 0; });
+}
+
+int32 FDistanceFieldStreamingManager::RegisterVolume(const char* Filename)
+{
+	FVolume Volume;
+	if (!LoadDistanceFieldFileHeader(Filename, Volume.Header))
+	{
+		return INDEX_NONE;
+	}
+
+	Volume.Filename = Filename;
+	Volume.Resident = NULL;
+	Volume.ResidentMip = INDEX_NONE;
+	Volume.ResidentBytes = 0;
+	Volume.WantedMip = INDEX_NONE;
+	Volume.LoadingMip = INDEX_NONE;
+	Volume.LoadingBytes = 0;
+	Volume.Priority = 0;
+	Volume.LastWantedFrame = 0;
+	Volumes.push_back(Volume);
+	return Volumes.size() - 1;
+}
+
+int32 FDistanceFieldStreamingManager::AddInstance(int32 VolumeId, const FBox& WorldBounds)
+{
+	FInstance Instance;
+	Instance.VolumeId = VolumeId;
+	Instance.WorldBounds = WorldBounds;
+
+	if (FreeInstances.size())
+	{
+		const int32 InstanceId = FreeInstances.back();
+		FreeInstances.pop_back();
+		Instances[InstanceId] = Instance;
+		return InstanceId;
+	}
+	Instances.push_back(Instance);
+	return Instances.size() - 1;
+}
+
+void FDistanceFieldStreamingManager::RemoveInstance(int32 InstanceId)
+{
+	Instances[InstanceId].VolumeId = INDEX_NONE;
+	FreeInstances.push_back(InstanceId);
+}
+
+int32 FDistanceFieldStreamingManager::ComputeWantedMip(const FVolume& Volume, float ScreenSize) const
+{
+	if (!Settings.bUseMips)
+	{
+		return 0;
+	}
+
+	const float WantedVoxels = ScreenSize * Settings.VoxelsPerPixel;
+	for (int32 MipIndex = Volume.Header.NumMips - 1; MipIndex > 0; MipIndex--)
+	{
+		const int32* Size = Volume.Header.Mips[MipIndex].Size;
+		if (FMath::Max(Size[0], FMath::Max(Size[1], Size[2])) >= WantedVoxels)
+		{
+			return MipIndex;
+		}
+	}
+	return 0;
+}
+
+void FDistanceFieldStreamingManager::Evict(FVolume& Volume)
+{
+	Stats.ResidentBytes -= Volume.ResidentBytes;
+	Stats.NumEvictions++;
+	delete Volume.Resident;
+	Volume.Resident = NULL;
+	Volume.ResidentMip = INDEX_NONE;
+	Volume.ResidentBytes = 0;
+}
+
+bool FDistanceFieldStreamingManager::MakeRoom(SIZE_t NumBytes)
+{
+	while (Stats.ResidentBytes + InFlightBytes + NumBytes > Settings.BudgetBytes)
+	{
+		FVolume* Oldest = NULL;
+		for (uint32 VolumeIndex = 0; VolumeIndex < Volumes.size(); VolumeIndex++)
+		{
+			FVolume& Volume = Volumes[VolumeIndex];
+			if (Volume.Resident && Volume.LastWantedFrame != Frame && (!Oldest || Volume.LastWantedFrame < Oldest->LastWantedFrame))
+			{
+				Oldest = &Volume;
+			}
+		}
+
+		if (!Oldest)
+		{
+			return false;
+		}
+		Evict(*Oldest);
+	}
+	return true;
+}
+
+void FDistanceFieldStreamingManager::ApplyCompletedLoads()
+{
+	TArray<FLoadRequest> Completed;
+	{
+		std::lock_guard<std::mutex> Lock(Mutex);
+		Completed.swap(CompletedLoads);
+	}
+
+	for (uint32 LoadIndex = 0; LoadIndex < Completed.size(); LoadIndex++)
+	{
+		const FLoadRequest& Request = Completed[LoadIndex];
+		FVolume& Volume = Volumes[Request.VolumeId];
+		InFlightBytes -= Volume.LoadingBytes;
+		Volume.LoadingMip = INDEX_NONE;
+		Volume.LoadingBytes = 0;
+
+		if (!Request.Result)
+		{
+			Stats.NumFailedLoads++;
+			continue;
+		}
+
+		// Replaces the coarser copy that was used while this one streamed in
+		if (Volume.Resident)
+		{
+			Stats.ResidentBytes -= Volume.ResidentBytes;
+			delete Volume.Resident;
+		}
+		Volume.Resident = Request.Result;
+		Volume.ResidentMip = Request.MipIndex;
+		Volume.ResidentBytes = Request.Result->GetResourceSize();
+		Stats.ResidentBytes += Volume.ResidentBytes;
+		Stats.NumLoads++;
+		Stats.BytesStreamed += sizeof(FDistanceFieldFileHeader) + Volume.Header.Mips[Request.MipIndex].NumBytes;
+	}
+}
+
+void FDistanceFieldStreamingManager::Update(const FVector& ViewOrigin, float ScreenMultiple)
+{
+	Frame++;
+	ApplyCompletedLoads();
+
+	for (uint32 VolumeIndex = 0; VolumeIndex < Volumes.size(); VolumeIndex++)
+	{
+		Volumes[VolumeIndex].Priority = 0;
+		Volumes[VolumeIndex].WantedMip = INDEX_NONE;
+	}
+
+	// Screen size of the bounding sphere, clamped to the sphere radius so the view inside the bounds gets the largest size
+	for (uint32 InstanceIndex = 0; InstanceIndex < Instances.size(); InstanceIndex++)
+	{
+		const FInstance& Instance = Instances[InstanceIndex];
+		if (Instance.VolumeId == INDEX_NONE)
+		{
+			continue;
+		}
+
+		const float Radius = Instance.WorldBounds.GetExtent().Size();
+		const float Distance = FMath::Sqrt(Instance.WorldBounds.ComputeSquaredDistanceToPoint(ViewOrigin));
+		const float ScreenSize = 2.0f * Radius * ScreenMultiple / FMath::Max(Distance, Radius);
+		FVolume& Volume = Volumes[Instance.VolumeId];
+		Volume.Priority = FMath::Max(Volume.Priority, ScreenSize);
+	}
+
+	TArray<int32> WantedVolumes;
+	for (uint32 VolumeIndex = 0; VolumeIndex < Volumes.size(); VolumeIndex++)
+	{
+		FVolume& Volume = Volumes[VolumeIndex];
+		if (Volume.Priority >= Settings.MinScreenSize)
+		{
+			Volume.WantedMip = ComputeWantedMip(Volume, Volume.Priority);
+			Volume.LastWantedFrame = Frame;
+			WantedVolumes.push_back(VolumeIndex);
+		}
+	}
+	std::sort(WantedVolumes.begin(), WantedVolumes.end(), [this](int32 A, int32 B)
+	{
+		return Volumes[A].Priority > Volumes[B].Priority;
+	});
+
+	int32 NumInFlight = 0;
+	for (uint32 VolumeIndex = 0; VolumeIndex < Volumes.size(); VolumeIndex++)
+	{
+		NumInFlight += Volumes[VolumeIndex].LoadingMip != INDEX_NONE;
+	}
+
+	TArray<FLoadRequest> NewLoads;
+	for (uint32 WantedIndex = 0; WantedIndex < WantedVolumes.size(); WantedIndex++)
+	{
+		const int32 VolumeId = WantedVolumes[WantedIndex];
+		FVolume& Volume = Volumes[VolumeId];
+		if (Volume.Resident && Volume.ResidentMip <= Volume.WantedMip)
+		{
+			Stats.NumHits++;
+			continue;
+		}
+
+		Stats.NumMisses++;
+		if (Volume.LoadingMip != INDEX_NONE || NumInFlight >= Settings.MaxLoadsInFlight)
+		{
+			continue;
+		}
+
+		const SIZE_t NumBytes = GetMipResourceSize(Volume.Header.Mips[Volume.WantedMip]);
+		if (!MakeRoom(NumBytes))
+		{
+			Stats.NumDeferred++;
+			continue;
+		}
+
+		FLoadRequest Request;
+		Request.VolumeId = VolumeId;
+		Request.MipIndex = Volume.WantedMip;
+		Request.Filename = Volume.Filename;
+		Request.Result = NULL;
+		NewLoads.push_back(Request);
+
+		Volume.LoadingMip = Volume.WantedMip;
+		Volume.LoadingBytes = NumBytes;
+		InFlightBytes += NumBytes;
+		NumInFlight++;
+	}
+
+	// Loads can land larger than estimated, settle back under the budget with what is not wanted
+	MakeRoom(0);
+
+	if (NewLoads.size())
+	{
+		{
+			std::lock_guard<std::mutex> Lock(Mutex);
+			PendingLoads.insert(PendingLoads.end(), NewLoads.begin(), NewLoads.end());
+		}
+		Condition.notify_all();
+	}
+}
+
+FDistanceFieldStreamingStats FDistanceFieldStreamingManager::GetStats() const
+{
+	FDistanceFieldStreamingStats Result = Stats;
+	Result.NumResident = 0;
+	Result.NumInFlight = 0;
+	for (uint32 VolumeIndex = 0; VolumeIndex < Volumes.size(); VolumeIndex++)
+	{
+		Result.NumResident += Volumes[VolumeIndex].Resident != NULL;
+		Result.NumInFlight += Volumes[VolumeIndex].LoadingMip != INDEX_NONE;
+	}
+	return Result;
+}
+
+void FDistanceFieldStreamingManager::ResetStats()
+{
+	const SIZE_t ResidentBytes = Stats.ResidentBytes;
+	Stats = FDistanceFieldStreamingStats();
+	Stats.ResidentBytes = ResidentBytes;
+}
@@ -0,0 +1,246 @@
+#ifndef _DISTANCEFIELDSTREAMING
+#define _DISTANCEFIELDSTREAMING
+#include "Config.h"
+#include "Box.h"
+#include "IntVector.h"
+#include "DistanceFieldFormat.h"
+#include "AsyncWork.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define DISTANCEFIELD_FILE_MAGIC 0x56464453
+#define DISTANCEFIELD_FILE_VERSION 1
+#define DISTANCEFIELD_FILE_MAX_MIPS 4
+
+/** One level of a volume file, mip 0 is the baked resolution and every next one halves it. */
+struct FDistanceFieldFileMip
+{
+	int32 Size[3];
+	int32 Format;
+	float Scale;
+	float Bias;
+
+	/** Where the encoded voxels of the level start in the file and how many bytes they take. */
+	uint32 Offset;
+	uint32 NumBytes;
+};
+
+/**
+* Header of a volume file, followed by the encoded voxels of each mip.
+* Voxels are stored as FCompressedDistanceFieldVolume::Data in the volume's resident format,
+* so a level is read with a single seek and read and needs no conversion.
+*/
+struct FDistanceFieldFileHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	float LocalBoundsMin[3];
+	float LocalBoundsMax[3];
+	uint8 bMeshWasClosed;
+	uint8 bBuiltAsIfTwoSided;
+	uint8 bMeshWasPlane;
+	uint8 Pad;
+	int32 NumMips;
+	FDistanceFieldFileMip Mips[DISTANCEFIELD_FILE_MAX_MIPS];
+};
+
+/**
+* Writes Volume with up to NumMips levels in its resident format, each mip box filtered from the previous one.
+* Mips stop once an axis would fall under 4 voxels.
+*/
+bool SaveDistanceFieldVolume(const char* Filename, FDistanceFieldVolumeData& Volume, int32 NumMips = 1);
+
+/** Reads only the header, false if the file is missing, not a volume file of this version or too short for its mips. */
+bool LoadDistanceFieldFileHeader(const char* Filename, FDistanceFieldFileHeader& OutHeader);
+
+/** Reads one mip of a volume file, the caller deletes the result. NULL on failure. */
+FDistanceFieldVolumeData* LoadDistanceFieldVolume(const char* Filename, int32 MipIndex = 0);
+
+struct FDistanceFieldStreamingSettings
+{
+	/** Bytes the resident volumes may take, see FDistanceFieldVolumeData::GetResourceSize. */
+	SIZE_t BudgetBytes;
+
+	/** Loads queued on the streaming thread at once. */
+	int32 MaxLoadsInFlight;
+
+	/** Worker threads the manager reads volume files on, created with it. */
+	int32 NumWorkers;
+
+	/** Instances whose bounds cover fewer pixels across are not requested. */
+	float MinScreenSize;
+
+	/** The coarsest mip with at least this many voxels per pixel of screen size is requested. */
+	float VoxelsPerPixel;
+
+	bool bUseMips;
+
+	FDistanceFieldStreamingSettings()
+		: BudgetBytes(64 * 1024 * 1024)
+		, MaxLoadsInFlight(16)
+		, NumWorkers(4)
+		, MinScreenSize(4.0f)
+		, VoxelsPerPixel(0.25f)
+		, bUseMips(true)
+	{}
+};
+
+/** Counters since the last ResetStats, a hit or miss is one volume wanted by one Update. */
+struct FDistanceFieldStreamingStats
+{
+	int32 NumHits;
+	int32 NumMisses;
+	int32 NumLoads;
+	int32 NumFailedLoads;
+	int32 NumEvictions;
+
+	/** Wanted volumes that could not be queued because the budget was held by volumes wanted by the same Update. */
+	int32 NumDeferred;
+
+	uint64 BytesStreamed;
+
+	/** Current state, not reset. */
+	SIZE_t ResidentBytes;
+	int32 NumResident;
+	int32 NumInFlight;
+
+	FDistanceFieldStreamingStats()
+		: NumHits(0)
+		, NumMisses(0)
+		, NumLoads(0)
+		, NumFailedLoads(0)
+		, NumEvictions(0)
+		, NumDeferred(0)
+		, BytesStreamed(0)
+		, ResidentBytes(0)
+		, NumResident(0)
+		, NumInFlight(0)
+	{}
+};
+
+/**
+* Keeps the distance field volumes the view needs resident under a byte budget.
+* Every Update ranks the volumes by the largest screen size of their instances, which accounts for both
+* distance and bounds size, requests the missing ones in that order and evicts the least recently wanted.
+* Volume files are read by a background thread, batches of them spread over the manager's FPersistentThreadPool.
+* A volume keeps its resident mip while a finer one streams in.
+*/
+class FDistanceFieldStreamingManager
+{
+public:
+
+	explicit FDistanceFieldStreamingManager(const FDistanceFieldStreamingSettings& InSettings = FDistanceFieldStreamingSettings());
+
+	/** Stops the streaming thread, dropping queued loads. */
+	~FDistanceFieldStreamingManager();
+
+	/** Reads the header of a volume file, returns the volume id or INDEX_NONE. */
+	int32 RegisterVolume(const char* Filename);
+
+	/** Places a volume in the world, returns the instance id. */
+	int32 AddInstance(int32 VolumeId, const FBox& WorldBounds);
+
+	void RemoveInstance(int32 InstanceId);
+
+	/**
+	* Applies finished loads, ranks the volumes for the view and queues loads and evictions.
+	* @param ScreenMultiple	Screen height in pixels / (2 * tan(vertical half FOV)), pixels per unit of size at distance 1
+	*/
+	void Update(const FVector& ViewOrigin, float ScreenMultiple);
+
+	/** Blocks until every queued load has been read, the results are applied by the next Update. */
+	void Flush();
+
+	/** Resident copy of a volume, NULL when none. Valid until the next Update. */
+	FDistanceFieldVolumeData* GetVolume(int32 VolumeId) const
+	{
+		return Volumes[VolumeId].Resident;
+	}
+
+	/** Mip of the resident copy, INDEX_NONE when none. */
+	int32 GetResidentMip(int32 VolumeId) const
+	{
+		return Volumes[VolumeId].ResidentMip;
+	}
+
+	/** Mip the last Update asked for, INDEX_NONE when no instance was large enough on screen. */
+	int32 GetWantedMip(int32 VolumeId) const
+	{
+		return Volumes[VolumeId].WantedMip;
+	}
+
+	const FDistanceFieldFileHeader& GetHeader(int32 VolumeId) const
+	{
+		return Volumes[VolumeId].Header;
+	}
+
+	FDistanceFieldStreamingStats GetStats() const;
+
+	void ResetStats();
+
+private:
+
+	friend class FDistanceFieldStreamingTask;
+
+	struct FVolume
+	{
+		std::string Filename;
+		FDistanceFieldFileHeader Header;
+		FDistanceFieldVolumeData* Resident;
+		int32 ResidentMip;
+		SIZE_t ResidentBytes;
+		int32 WantedMip;
+		int32 LoadingMip;
+		SIZE_t LoadingBytes;
+		float Priority;
+		uint32 LastWantedFrame;
+	};
+
+	struct FInstance
+	{
+		int32 VolumeId;
+		FBox WorldBounds;
+	};
+
+	struct FLoadRequest
+	{
+		int32 VolumeId;
+		int32 MipIndex;
+		std::string Filename;
+		FDistanceFieldVolumeData* Result;
+	};
+
+	void Run();
+	void ApplyCompletedLoads();
+	int32 ComputeWantedMip(const FVolume& Volume, float ScreenSize) const;
+
+	/** Evicts volumes not wanted this frame, least recently wanted first, until NumBytes more fit. */
+	bool MakeRoom(SIZE_t NumBytes);
+
+	void Evict(FVolume& Volume);
+
+	FDistanceFieldStreamingSettings Settings;
+	TArray<FVolume> Volumes;
+	TArray<FInstance> Instances;
+	TArray<int32> FreeInstances;
+	uint32 Frame;
+	SIZE_t InFlightBytes;
+	FDistanceFieldStreamingStats Stats;
+
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	TArray<FLoadRequest> PendingLoads;
+	TArray<FLoadRequest> CompletedLoads;
+	int32 NumLoading;
+
+	/** Pool tasks still reading the current batch. */
+	int32 NumActiveTasks;
+	bool bStopRequested;
+	FPersistentThreadPool ThreadPool;
+	std::thread StreamingThread;
+};
+
+#endif // !_DISTANCEFIELDSTREAMING
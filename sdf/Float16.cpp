@@ -0,0 +1,168 @@
+#include "Float16.h"
+#include <emmintrin.h>
+#include <immintrin.h>
+#include <intrin.h>
+
+namespace
+{
+	/** F16C needs the CPU bit and the OS saving YMM state, the instructions are VEX encoded. */
+	bool DetectF16C()
+	{
+		int CPUInfo[4];
+		__cpuid(CPUInfo, 1);
+		const bool bOSXSAVE = (CPUInfo[2] & (1 << 27)) != 0;
+		const bool bF16C = (CPUInfo[2] & (1 << 29)) != 0;
+		return bOSXSAVE && bF16C && (_xgetbv(0) & 6) == 6;
+	}
+
+	const bool GHasF16C = DetectF16C();
+
+	/** Four floats to four halves in the low 16 bits of each lane, round to nearest even. */
+	FORCEINLINE __m128i FloatToHalfSSE2(__m128 F)
+	{
+		const __m128i SignMask = _mm_set1_epi32(0x80000000);
+		const __m128i F16Max = _mm_set1_epi32((127 + 16) << 23);			// Everything from here on becomes infinity
+		const __m128i NaNBit = _mm_set1_epi32(0x200);
+		const __m128i InfinityAsF16 = _mm_set1_epi32(0x7c00);
+		const __m128i MinNormal = _mm_set1_epi32((127 - 14) << 23);			// Smallest float that gives a normalized half
+		const __m128i SubnormalMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+		const __m128i NormalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));	// Rebias the exponent and round the mantissa
+
+		const __m128 Sign = _mm_and_ps(_mm_castsi128_ps(SignMask), F);
+		const __m128 AbsF = _mm_xor_ps(F, Sign);
+		const __m128i AbsInt = _mm_castps_si128(AbsF);
+
+		const __m128i IsNaN = _mm_castps_si128(_mm_cmpunord_ps(AbsF, AbsF));
+		const __m128i IsRegular = _mm_cmpgt_epi32(F16Max, AbsInt);
+		const __m128i InfOrNaN = _mm_or_si128(_mm_and_si128(IsNaN, NaNBit), InfinityAsF16);
+		const __m128i IsSubnormal = _mm_cmpgt_epi32(MinNormal, AbsInt);
+
+		// Subnormal results, the float adder does the rounding
+		const __m128i Subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(AbsF, _mm_castsi128_ps(SubnormalMagic))), SubnormalMagic);
+
+		// Normal results, bias towards rounding up when the half mantissa is odd
+		const __m128i MantissaOdd = _mm_srai_epi32(_mm_slli_epi32(AbsInt, 31 - 13), 31);
+		const __m128i Normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(AbsInt, NormalBias), MantissaOdd), 13);
+
+		const __m128i NonSpecial = _mm_or_si128(_mm_and_si128(Subnormal, IsSubnormal), _mm_andnot_si128(IsSubnormal, Normal));
+		const __m128i Joined = _mm_or_si128(_mm_and_si128(NonSpecial, IsRegular), _mm_andnot_si128(IsRegular, InfOrNaN));
+
+		// Arithmetic shift keeps negative lanes in int16 range so a saturating pack leaves them intact
+		return _mm_or_si128(Joined, _mm_srai_epi32(_mm_castps_si128(Sign), 16));
+	}
+
+	/** Four halves in the low 16 bits of each lane to four floats. */
+	FORCEINLINE __m128 HalfToFloatSSE2(__m128i H)
+	{
+		const __m128i NoSignMask = _mm_set1_epi32(0x7fff);
+		const __m128 Magic = _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23));
+		const __m128i WasInfNaN = _mm_set1_epi32(0x7bff);
+		const __m128 InfNaNExponent = _mm_castsi128_ps(_mm_set1_epi32(255 << 23));
+
+		const __m128i ExponentMantissa = _mm_and_si128(NoSignMask, H);
+		const __m128i Sign = _mm_slli_epi32(_mm_xor_si128(H, ExponentMantissa), 16);
+
+		// Scaling by 2^(127-15) rebiases the exponent and normalizes subnormals in one go
+		const __m128 Scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(ExponentMantissa, 13)), Magic);
+		const __m128 InfNaN = _mm_and_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(ExponentMantissa, WasInfNaN)), InfNaNExponent);
+		return _mm_or_ps(Scaled, _mm_or_ps(_mm_castsi128_ps(Sign), InfNaN));
+	}
+
+	struct FConvertSSE2
+	{
+		static FORCEINLINE void FloatToHalf8(const float* Src, FFloat16* Dest)
+		{
+			const __m128i Lo = FloatToHalfSSE2(_mm_loadu_ps(Src));
+			const __m128i Hi = FloatToHalfSSE2(_mm_loadu_ps(Src + 4));
+			_mm_storeu_si128((__m128i*)Dest, _mm_packs_epi32(Lo, Hi));
+		}
+
+		static FORCEINLINE void HalfToFloat8(const FFloat16* Src, float* Dest)
+		{
+			const __m128i Halves = _mm_loadu_si128((const __m128i*)Src);
+			const __m128i Zero = _mm_setzero_si128();
+			_mm_storeu_ps(Dest, HalfToFloatSSE2(_mm_unpacklo_epi16(Halves, Zero)));
+			_mm_storeu_ps(Dest + 4, HalfToFloatSSE2(_mm_unpackhi_epi16(Halves, Zero)));
+		}
+	};
+
+	struct FConvertF16C
+	{
+		static FORCEINLINE void FloatToHalf8(const float* Src, FFloat16* Dest)
+		{
+			const __m128i Lo = _mm_cvtps_ph(_mm_loadu_ps(Src), 0);
+			const __m128i Hi = _mm_cvtps_ph(_mm_loadu_ps(Src + 4), 0);
+			_mm_storeu_si128((__m128i*)Dest, _mm_unpacklo_epi64(Lo, Hi));
+		}
+
+		static FORCEINLINE void HalfToFloat8(const FFloat16* Src, float* Dest)
+		{
+			const __m128i Halves = _mm_loadu_si128((const __m128i*)Src);
+			_mm_storeu_ps(Dest, _mm_cvtph_ps(Halves));
+			_mm_storeu_ps(Dest + 4, _mm_cvtph_ps(_mm_unpackhi_epi64(Halves, Halves)));
+		}
+	};
+
+	template<typename TConvert>
+	void ConvertFloatToHalfRows(const float* Src, FFloat16* Dest, int32 Count)
+	{
+		int32 Index = 0;
+		for (; Index + 8 <= Count; Index += 8)
+		{
+			TConvert::FloatToHalf8(Src + Index, Dest + Index);
+		}
+
+		// Pad the tail so it rounds exactly like the body
+		if (Index < Count)
+		{
+			float PaddedSrc[8] = { 0 };
+			FFloat16 PaddedDest[8];
+			memcpy(PaddedSrc, Src + Index, (Count - Index) * sizeof(float));
+			TConvert::FloatToHalf8(PaddedSrc, PaddedDest);
+			memcpy(Dest + Index, PaddedDest, (Count - Index) * sizeof(FFloat16));
+		}
+	}
+
+	template<typename TConvert>
+	void ConvertHalfToFloatRows(const FFloat16* Src, float* Dest, int32 Count)
+	{
+		int32 Index = 0;
+		for (; Index + 8 <= Count; Index += 8)
+		{
+			TConvert::HalfToFloat8(Src + Index, Dest + Index);
+		}
+
+		if (Index < Count)
+		{
+			FFloat16 PaddedSrc[8];
+			float PaddedDest[8];
+			memcpy(PaddedSrc, Src + Index, (Count - Index) * sizeof(FFloat16));
+			TConvert::HalfToFloat8(PaddedSrc, PaddedDest);
+			memcpy(Dest + Index, PaddedDest, (Count - Index) * sizeof(float));
+		}
+	}
+}
+
+void ConvertFloatToHalf(const float* Src, FFloat16* Dest, int32 Count)
+{
+	if (GHasF16C)
+	{
+		ConvertFloatToHalfRows<FConvertF16C>(Src, Dest, Count);
+	}
+	else
+	{
+		ConvertFloatToHalfRows<FConvertSSE2>(Src, Dest, Count);
+	}
+}
+
+void ConvertHalfToFloat(const FFloat16* Src, float* Dest, int32 Count)
+{
+	if (GHasF16C)
+	{
+		ConvertHalfToFloatRows<FConvertF16C>(Src, Dest, Count);
+	}
+	else
+	{
+		ConvertHalfToFloatRows<FConvertSSE2>(Src, Dest, Count);
+	}
+}
@@ -3,6 +3,7 @@
 #define _FLOAT16
 #include "Float32.h"
 #include "MathUtil.h"
+#include <string.h>
 /**
 * 16 bit float components and conversion
 *
@@ -198,4 +199,33 @@ FORCEINLINE float FFloat16::GetFloat() const
 	return Result.FloatValue;
 }
 
+/**
+* Converts Count floats to half floats, rounding to nearest even.
+* Uses F16C when the CPU supports it and an SSE2 fallback otherwise, both produce identical results.
+*/
+void ConvertFloatToHalf(const float* Src, FFloat16* Dest, int32 Count);
+
+/** Converts Count half floats to floats. */
+void ConvertHalfToFloat(const FFloat16* Src, float* Dest, int32 Count);
+
+/** Converts a row of floats to SDFFloat, see ConvertFloatToHalf. */
+FORCEINLINE void ConvertFloatToSDFFloat(const float* Src, SDFFloat* Dest, int32 Count)
+{
+#ifdef _HALF
+	ConvertFloatToHalf(Src, Dest, Count);
+#else
+	memcpy(Dest, Src, Count * sizeof(float));
+#endif // _HALF
+}
+
+/** Converts a row of SDFFloat to floats. */
+FORCEINLINE void ConvertSDFFloatToFloat(const SDFFloat* Src, float* Dest, int32 Count)
+{
+#ifdef _HALF
+	ConvertHalfToFloat(Src, Dest, Count);
+#else
+	memcpy(Dest, Src, Count * sizeof(float));
+#endif // _HALF
+}
+
 #endif
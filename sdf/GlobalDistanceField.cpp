@@ -0,0 +1,470 @@
+#include "GlobalDistanceField.h"
+#include "DistanceFieldSampler.h"
+#include "AsyncWork.h"
+#include <atomic>
+
+namespace
+{
+	FORCEINLINE int32 WrapCoordinate(int32 Coordinate, int32 Resolution)
+	{
+		const int32 Wrapped = Coordinate % Resolution;
+		return Wrapped < 0 ? Wrapped + Resolution : Wrapped;
+	}
+
+	FORCEINLINE int32 GetStorageIndex(int32 X, int32 Y, int32 Z, int32 Resolution)
+	{
+		return (WrapCoordinate(Z, Resolution) * Resolution + WrapCoordinate(Y, Resolution)) * Resolution + WrapCoordinate(X, Resolution);
+	}
+
+	FORCEINLINE FIntVector FloorToVoxel(const FVector& Position, float VoxelSize)
+	{
+		return FIntVector(
+			FMath::FloorToInt(Position.X / VoxelSize),
+			FMath::FloorToInt(Position.Y / VoxelSize),
+			FMath::FloorToInt(Position.Z / VoxelSize));
+	}
+
+	FORCEINLINE bool BoxesOverlap(const FIntVector& MinA, const FIntVector& MaxA, const FIntVector& MinB, const FIntVector& MaxB)
+	{
+		return MinA.X < MaxB.X && MinB.X < MaxA.X
+			&& MinA.Y < MaxB.Y && MinB.Y < MaxA.Y
+			&& MinA.Z < MaxB.Z && MinB.Z < MaxA.Z;
+	}
+
+	/** Splits the box [Min, Max) minus [CutMin, CutMax) into at most 6 boxes, appended to OutMins and OutMaxs. */
+	void SubtractBox(FIntVector Min, FIntVector Max, const FIntVector& CutMin, const FIntVector& CutMax,
+		TArray<FIntVector>& OutMins, TArray<FIntVector>& OutMaxs)
+	{
+		if (!BoxesOverlap(Min, Max, CutMin, CutMax))
+		{
+			OutMins.push_back(Min);
+			OutMaxs.push_back(Max);
+			return;
+		}
+
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			if (Min(Axis) < CutMin(Axis))
+			{
+				FIntVector PartMax = Max;
+				PartMax(Axis) = CutMin(Axis);
+				OutMins.push_back(Min);
+				OutMaxs.push_back(PartMax);
+				Min(Axis) = CutMin(Axis);
+			}
+			if (Max(Axis) > CutMax(Axis))
+			{
+				FIntVector PartMin = Min;
+				PartMin(Axis) = CutMax(Axis);
+				OutMins.push_back(PartMin);
+				OutMaxs.push_back(Max);
+				Max(Axis) = CutMax(Axis);
+			}
+		}
+		// What is left lies inside the cut
+	}
+}
+
+/** What the composite tasks of one Update share. */
+struct FGlobalDistanceFieldCompositeContext
+{
+	/** One Z slice of a region. */
+	struct FSlice
+	{
+		int32 RegionIndex;
+		int32 ZIndex;
+	};
+
+	FGlobalDistanceField* Field;
+	/** Per region, the instances whose bounds reach it. */
+	TArray<TArray<int32> > CulledInstances;
+	TArray<FSlice> Slices;
+	std::atomic<int32> NextSlice;
+
+	/** Tasks still pulling slices, Update waits on Condition until none is left. */
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	int32 NumActiveTasks;
+};
+
+/** Composites Z slices of the regions, pulled from a shared counter until none are left. */
+class FGlobalDistanceFieldCompositeTask
+{
+public:
+	FGlobalDistanceFieldCompositeTask(FGlobalDistanceFieldCompositeContext* InContext)
+		: Context(InContext)
+		, NumInstanceSamples(0)
+	{}
+
+	void DoWork()
+	{
+		const int32 NumSlices = Context->Slices.size();
+		for (int32 SliceIndex = Context->NextSlice++; SliceIndex < NumSlices; SliceIndex = Context->NextSlice++)
+		{
+			const FGlobalDistanceFieldCompositeContext::FSlice& Slice = Context->Slices[SliceIndex];
+			CompositeSlice(Slice.RegionIndex, Slice.ZIndex);
+		}
+
+		// Update frees the task once the last one is counted
+		std::lock_guard<std::mutex> Lock(Context->Mutex);
+		Context->NumActiveTasks--;
+		Context->Condition.notify_all();
+	}
+
+	int32 GetNumInstanceSamples() const
+	{
+		return NumInstanceSamples;
+	}
+
+private:
+	void CompositeSlice(int32 RegionIndex, int32 ZIndex)
+	{
+		FGlobalDistanceField* Field = Context->Field;
+		const FGlobalDistanceField::FRegion& Region = Field->Regions[RegionIndex];
+		FGlobalDistanceFieldCascade& Cascade = Field->Cascades[Region.CascadeIndex];
+		const int32 Resolution = Field->Resolution;
+		const float VoxelSize = Cascade.VoxelSize;
+
+		// Narrow the region's list to the slice, then to each row, so the voxel loop only sees nearby instances
+		const FBox SliceBounds = FBox(
+			FVector(Region.Min.X, Region.Min.Y, ZIndex) * VoxelSize,
+			FVector(Region.Max.X, Region.Max.Y, ZIndex + 1) * VoxelSize).ExpandBy(Cascade.MaxDistance);
+		TArray<int32> SliceInstances;
+		CullInstances(Context->CulledInstances[RegionIndex], SliceBounds, SliceInstances);
+
+		TArray<int32> RowInstances;
+		for (int32 YIndex = Region.Min.Y; YIndex < Region.Max.Y; YIndex++)
+		{
+			const FBox RowBounds = FBox(
+				FVector(Region.Min.X, YIndex, ZIndex) * VoxelSize,
+				FVector(Region.Max.X, YIndex + 1, ZIndex + 1) * VoxelSize).ExpandBy(Cascade.MaxDistance);
+			RowInstances.clear();
+			CullInstances(SliceInstances, RowBounds, RowInstances);
+
+			for (int32 XIndex = Region.Min.X; XIndex < Region.Max.X; XIndex++)
+			{
+				const FVector VoxelPosition = FVector(XIndex + .5f, YIndex + .5f, ZIndex + .5f) * VoxelSize;
+				float MinDistance = Cascade.MaxDistance;
+
+				for (uint32 CulledIndex = 0; CulledIndex < RowInstances.size(); CulledIndex++)
+				{
+					const FDistanceFieldInstance& Instance = Field->Instances[RowInstances[CulledIndex]];
+
+					// The box distance is a lower bound, skip instances that cannot get closer
+					if (Instance.WorldBounds.ComputeSquaredDistanceToPoint(VoxelPosition) >= MinDistance * MinDistance)
+					{
+						continue;
+					}
+
+					const float Distance = Instance.Sampler->Sample((VoxelPosition - Instance.Position) / Instance.Scale) * Instance.Scale;
+					MinDistance = FMath::Min(MinDistance, Distance);
+					NumInstanceSamples++;
+				}
+
+				Cascade.Distances[GetStorageIndex(XIndex, YIndex, ZIndex, Resolution)] = FMath::Max(MinDistance, -Cascade.MaxDistance);
+			}
+		}
+	}
+
+	void CullInstances(const TArray<int32>& Source, const FBox& Bounds, TArray<int32>& OutInstances) const
+	{
+		for (uint32 SourceIndex = 0; SourceIndex < Source.size(); SourceIndex++)
+		{
+			if (Context->Field->Instances[Source[SourceIndex]].WorldBounds.Intersect(Bounds))
+			{
+				OutInstances.push_back(Source[SourceIndex]);
+			}
+		}
+	}
+
+	FGlobalDistanceFieldCompositeContext* Context;
+	int32 NumInstanceSamples;
+};
+
+FGlobalDistanceField::FGlobalDistanceField(int32 NumCascades, int32 InResolution, float InnerVoxelSize, float MaxDistanceInVoxels)
+	: Resolution(InResolution)
+{
+	Cascades.resize(NumCascades);
+	for (int32 CascadeIndex = 0; CascadeIndex < NumCascades; CascadeIndex++)
+	{
+		FGlobalDistanceFieldCascade& Cascade = Cascades[CascadeIndex];
+		Cascade.VoxelSize = InnerVoxelSize * (1 << CascadeIndex);
+		Cascade.MaxDistance = Cascade.VoxelSize * MaxDistanceInVoxels;
+		Cascade.Origin = FIntVector(0, 0, 0);
+		Cascade.Distances.resize(Resolution * Resolution * Resolution, Cascade.MaxDistance);
+		Cascade.bValid = false;
+	}
+}
+
+int32 FGlobalDistanceField::AddInstance(const FDistanceFieldSampler* Sampler, const FVector& Position, float Scale)
+{
+	int32 InstanceId = 0;
+	while (InstanceId < (int32)Instances.size() && Instances[InstanceId].bAllocated)
+	{
+		InstanceId++;
+	}
+
+	if (InstanceId == Instances.size())
+	{
+		Instances.push_back(FDistanceFieldInstance());
+	}
+
+	FDistanceFieldInstance& Instance = Instances[InstanceId];
+	Instance.Sampler = Sampler;
+	Instance.bAllocated = true;
+	Instance.WorldBounds = FBox(0);
+	UpdateInstance(InstanceId, Position, Scale);
+	return InstanceId;
+}
+
+void FGlobalDistanceField::UpdateInstance(int32 InstanceId, const FVector& Position, float Scale)
+{
+	FDistanceFieldInstance& Instance = Instances[InstanceId];
+	if (Instance.WorldBounds.IsValid)
+	{
+		PendingDirtyBounds.push_back(Instance.WorldBounds);
+	}
+
+	Instance.Position = Position;
+	Instance.Scale = Scale;
+	Instance.WorldBounds = FBox(0);
+	if (Instance.Sampler->IsValid())
+	{
+		const FBox& LocalBox = Instance.Sampler->GetBox();
+		Instance.WorldBounds = FBox(LocalBox.Min * Scale + Position, LocalBox.Max * Scale + Position);
+		PendingDirtyBounds.push_back(Instance.WorldBounds);
+	}
+}
+
+void FGlobalDistanceField::RemoveInstance(int32 InstanceId)
+{
+	FDistanceFieldInstance& Instance = Instances[InstanceId];
+	if (Instance.WorldBounds.IsValid)
+	{
+		PendingDirtyBounds.push_back(Instance.WorldBounds);
+	}
+
+	Instance.bAllocated = false;
+	Instance.WorldBounds = FBox(0);
+}
+
+void FGlobalDistanceField::Invalidate()
+{
+	for (uint32 CascadeIndex = 0; CascadeIndex < Cascades.size(); CascadeIndex++)
+	{
+		Cascades[CascadeIndex].bValid = false;
+	}
+}
+
+void FGlobalDistanceField::AddRegion(int32 CascadeIndex, const FIntVector& Min, const FIntVector& Max, const FIntVector& Origin)
+{
+	const FIntVector ClampedMin(FMath::Max(Min.X, Origin.X), FMath::Max(Min.Y, Origin.Y), FMath::Max(Min.Z, Origin.Z));
+	const FIntVector ClampedMax(
+		FMath::Min(Max.X, Origin.X + Resolution),
+		FMath::Min(Max.Y, Origin.Y + Resolution),
+		FMath::Min(Max.Z, Origin.Z + Resolution));
+
+	if (!(ClampedMin.X < ClampedMax.X && ClampedMin.Y < ClampedMax.Y && ClampedMin.Z < ClampedMax.Z))
+	{
+		return;
+	}
+
+	// Two slices writing the same voxel would race, so cut away what earlier regions already composite
+	TArray<FIntVector> PieceMins(1, ClampedMin);
+	TArray<FIntVector> PieceMaxs(1, ClampedMax);
+	TArray<FIntVector> NextMins;
+	TArray<FIntVector> NextMaxs;
+	for (uint32 RegionIndex = 0; RegionIndex < Regions.size() && !PieceMins.empty(); RegionIndex++)
+	{
+		const FRegion& Existing = Regions[RegionIndex];
+		if (Existing.CascadeIndex != CascadeIndex)
+		{
+			continue;
+		}
+
+		NextMins.clear();
+		NextMaxs.clear();
+		for (uint32 PieceIndex = 0; PieceIndex < PieceMins.size(); PieceIndex++)
+		{
+			SubtractBox(PieceMins[PieceIndex], PieceMaxs[PieceIndex], Existing.Min, Existing.Max, NextMins, NextMaxs);
+		}
+		PieceMins.swap(NextMins);
+		PieceMaxs.swap(NextMaxs);
+	}
+
+	for (uint32 PieceIndex = 0; PieceIndex < PieceMins.size(); PieceIndex++)
+	{
+		FRegion Region;
+		Region.CascadeIndex = CascadeIndex;
+		Region.Min = PieceMins[PieceIndex];
+		Region.Max = PieceMaxs[PieceIndex];
+		Regions.push_back(Region);
+	}
+}
+
+void FGlobalDistanceField::AddScrolledRegions(int32 CascadeIndex, const FIntVector& OldOrigin, const FIntVector& NewOrigin)
+{
+	const FIntVector NewMax = NewOrigin + FIntVector(Resolution);
+
+	// One slab per axis that moved, covering the voxels that were outside the old window.
+	// Where slabs meet along the edges AddRegion keeps the voxels in the first one only.
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		const int32 Delta = NewOrigin(Axis) - OldOrigin(Axis);
+		if (Delta == 0)
+		{
+			continue;
+		}
+
+		FIntVector SlabMin = NewOrigin;
+		FIntVector SlabMax = NewMax;
+		if (Delta > 0)
+		{
+			SlabMin(Axis) = FMath::Max(NewOrigin(Axis), OldOrigin(Axis) + Resolution);
+		}
+		else
+		{
+			SlabMax(Axis) = FMath::Min(NewMax(Axis), OldOrigin(Axis));
+		}
+
+		AddRegion(CascadeIndex, SlabMin, SlabMax, NewOrigin);
+	}
+}
+
+void FGlobalDistanceField::Update(const FVector& CameraPosition)
+{
+	Regions.clear();
+	Stats = FGlobalDistanceFieldStats();
+
+	for (uint32 CascadeIndex = 0; CascadeIndex < Cascades.size(); CascadeIndex++)
+	{
+		FGlobalDistanceFieldCascade& Cascade = Cascades[CascadeIndex];
+		const FIntVector NewOrigin = FloorToVoxel(CameraPosition, Cascade.VoxelSize) - FIntVector(Resolution / 2);
+
+		if (!Cascade.bValid)
+		{
+			AddRegion(CascadeIndex, NewOrigin, NewOrigin + FIntVector(Resolution), NewOrigin);
+		}
+		else
+		{
+			AddScrolledRegions(CascadeIndex, Cascade.Origin, NewOrigin);
+
+			// Instance edits affect voxels up to MaxDistance away from their bounds
+			for (uint32 DirtyIndex = 0; DirtyIndex < PendingDirtyBounds.size(); DirtyIndex++)
+			{
+				const FBox DirtyBounds = PendingDirtyBounds[DirtyIndex].ExpandBy(Cascade.MaxDistance);
+				const FIntVector DirtyMin = FloorToVoxel(DirtyBounds.Min, Cascade.VoxelSize);
+				const FIntVector DirtyMax = FloorToVoxel(DirtyBounds.Max, Cascade.VoxelSize) + FIntVector(1);
+				AddRegion(CascadeIndex, DirtyMin, DirtyMax, NewOrigin);
+			}
+		}
+
+		Cascade.Origin = NewOrigin;
+		Cascade.bValid = true;
+	}
+	PendingDirtyBounds.clear();
+
+	// Cull instances per region, every slice of a region shares the list
+	FGlobalDistanceFieldCompositeContext Context;
+	Context.Field = this;
+	Context.CulledInstances.resize(Regions.size());
+	for (uint32 RegionIndex = 0; RegionIndex < Regions.size(); RegionIndex++)
+	{
+		const FRegion& Region = Regions[RegionIndex];
+		const FGlobalDistanceFieldCascade& Cascade = Cascades[Region.CascadeIndex];
+		const FBox RegionBounds = FBox(
+			FVector(Region.Min.X, Region.Min.Y, Region.Min.Z) * Cascade.VoxelSize,
+			FVector(Region.Max.X, Region.Max.Y, Region.Max.Z) * Cascade.VoxelSize).ExpandBy(Cascade.MaxDistance);
+
+		for (uint32 InstanceIndex = 0; InstanceIndex < Instances.size(); InstanceIndex++)
+		{
+			const FDistanceFieldInstance& Instance = Instances[InstanceIndex];
+			if (Instance.bAllocated && Instance.WorldBounds.IsValid && Instance.WorldBounds.Intersect(RegionBounds))
+			{
+				Context.CulledInstances[RegionIndex].push_back(InstanceIndex);
+			}
+		}
+
+		Stats.NumVoxelsComposited += (Region.Max.X - Region.Min.X) * (Region.Max.Y - Region.Min.Y) * (Region.Max.Z - Region.Min.Z);
+
+		for (int32 ZIndex = Region.Min.Z; ZIndex < Region.Max.Z; ZIndex++)
+		{
+			FGlobalDistanceFieldCompositeContext::FSlice Slice;
+			Slice.RegionIndex = (int32)RegionIndex;
+			Slice.ZIndex = ZIndex;
+			Context.Slices.push_back(Slice);
+		}
+	}
+	Stats.NumRegions = Regions.size();
+
+	if (Context.Slices.empty())
+	{
+		return;
+	}
+
+	// A few long lived tasks on the shared pool instead of threads and a task per slice every frame
+	FPersistentThreadPool& ThreadPool = GetDistanceFieldThreadPool();
+	const int32 NumWorkers = FMath::Clamp(ThreadPool.GetNumThreads(), 1, (int32)Context.Slices.size());
+	TArray<FAsyncTask<FGlobalDistanceFieldCompositeTask>*> AsyncTasks;
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		AsyncTasks.push_back(new FAsyncTask<FGlobalDistanceFieldCompositeTask>(&Context));
+	}
+
+	// Counted before any is queued, so an early finisher cannot end the wait
+	Context.NextSlice = 0;
+	{
+		std::lock_guard<std::mutex> Lock(Context.Mutex);
+		Context.NumActiveTasks = NumWorkers;
+	}
+	for (int32 WorkerIndex = 0; WorkerIndex < NumWorkers; WorkerIndex++)
+	{
+		ThreadPool.AddQueuedWork(AsyncTasks[WorkerIndex]);
+	}
+	{
+		std::unique_lock<std::mutex> Lock(Context.Mutex);
+		Context.Condition.wait(Lock, [&Context]() { return Context.NumActiveTasks == 0; });
+	}
+
+	for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+	{
+		Stats.NumInstanceSamples += AsyncTasks[TaskIndex]->GetTask().GetNumInstanceSamples();
+		delete AsyncTasks[TaskIndex];
+	}
+}
+
+float FGlobalDistanceField::Sample(const FVector& WorldPosition) const
+{
+	for (uint32 CascadeIndex = 0; CascadeIndex < Cascades.size(); CascadeIndex++)
+	{
+		const FGlobalDistanceFieldCascade& Cascade = Cascades[CascadeIndex];
+		if (!Cascade.bValid)
+		{
+			continue;
+		}
+
+		// Both trilinear taps have to be inside the window
+		const FVector VoxelCoordinate = WorldPosition / Cascade.VoxelSize - FVector(.5f);
+		const FIntVector Voxel0 = FloorToVoxel(VoxelCoordinate, 1.0f);
+		if (Voxel0.X < Cascade.Origin.X || Voxel0.Y < Cascade.Origin.Y || Voxel0.Z < Cascade.Origin.Z
+			|| Voxel0.X + 1 >= Cascade.Origin.X + Resolution
+			|| Voxel0.Y + 1 >= Cascade.Origin.Y + Resolution
+			|| Voxel0.Z + 1 >= Cascade.Origin.Z + Resolution)
+		{
+			continue;
+		}
+
+		const float FracX = VoxelCoordinate.X - Voxel0.X;
+		const float FracY = VoxelCoordinate.Y - Voxel0.Y;
+		const float FracZ = VoxelCoordinate.Z - Voxel0.Z;
+		const float* Distances = Cascade.Distances.data();
+
+		const float V00 = FMath::Lerp(Distances[GetStorageIndex(Voxel0.X, Voxel0.Y, Voxel0.Z, Resolution)], Distances[GetStorageIndex(Voxel0.X + 1, Voxel0.Y, Voxel0.Z, Resolution)], FracX);
+		const float V10 = FMath::Lerp(Distances[GetStorageIndex(Voxel0.X, Voxel0.Y + 1, Voxel0.Z, Resolution)], Distances[GetStorageIndex(Voxel0.X + 1, Voxel0.Y + 1, Voxel0.Z, Resolution)], FracX);
+		const float V01 = FMath::Lerp(Distances[GetStorageIndex(Voxel0.X, Voxel0.Y, Voxel0.Z + 1, Resolution)], Distances[GetStorageIndex(Voxel0.X + 1, Voxel0.Y, Voxel0.Z + 1, Resolution)], FracX);
+		const float V11 = FMath::Lerp(Distances[GetStorageIndex(Voxel0.X, Voxel0.Y + 1, Voxel0.Z + 1, Resolution)], Distances[GetStorageIndex(Voxel0.X + 1, Voxel0.Y + 1, Voxel0.Z + 1, Resolution)], FracX);
+		return FMath::Lerp(FMath::Lerp(V00, V10, FracY), FMath::Lerp(V01, V11, FracY), FracZ);
+	}
+
+	return Cascades.empty() ? 0.0f : Cascades.back().MaxDistance;
+}
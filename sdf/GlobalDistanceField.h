@@ -0,0 +1,146 @@
+#ifndef _GLOBALDISTANCEFIELD
+#define _GLOBALDISTANCEFIELD
+#include "Config.h"
+#include "IntVector.h"
+#include "Box.h"
+
+class FDistanceFieldSampler;
+
+/** A distance field volume placed in the world with a translation and uniform scale. */
+struct FDistanceFieldInstance
+{
+	/** Decoded volume, owned by the caller and shareable between instances. */
+	const FDistanceFieldSampler* Sampler;
+
+	FVector Position;
+	float Scale;
+
+	/** World space box of the volume. */
+	FBox WorldBounds;
+
+	/** False once removed, the slot is reused by the next AddInstance. */
+	bool bAllocated;
+};
+
+/** One clipmap level, a cube of Resolution^3 voxels addressed toroidally so scrolling never moves memory. */
+struct FGlobalDistanceFieldCascade
+{
+	/** World space size of a voxel. */
+	float VoxelSize;
+
+	/** Distances are clamped to +-MaxDistance, the band instances are composited within. */
+	float MaxDistance;
+
+	/** World voxel coordinate of the first voxel of the window, the window is [Origin, Origin + Resolution). */
+	FIntVector Origin;
+
+	/** World space distances, world voxel V is stored at (V mod Resolution). */
+	TArray<float> Distances;
+
+	/** False until the first full composite. */
+	bool bValid;
+};
+
+/** Work done by the last FGlobalDistanceField::Update. */
+struct FGlobalDistanceFieldStats
+{
+	int32 NumRegions;
+	int32 NumVoxelsComposited;
+	int32 NumInstanceSamples;
+
+	FGlobalDistanceFieldStats()
+		: NumRegions(0)
+		, NumVoxelsComposited(0)
+		, NumInstanceSamples(0)
+	{}
+};
+
+/**
+* Camera centred clipmap of the union of every instance's distance field.
+* Each cascade doubles the voxel size of the previous one. Update scrolls the cascades with the camera
+* and recomposites only the slabs that scrolled into view and the regions touched by changed instances.
+*/
+class FGlobalDistanceField
+{
+public:
+
+	/**
+	* @param NumCascades			Number of clipmap levels
+	* @param Resolution				Voxels per axis in every cascade
+	* @param InnerVoxelSize			World space voxel size of cascade 0
+	* @param MaxDistanceInVoxels	Distance band of each cascade, in its own voxels
+	*/
+	FGlobalDistanceField(int32 NumCascades = 4, int32 Resolution = 64, float InnerVoxelSize = 1.0f, float MaxDistanceInVoxels = 4.0f);
+
+	/** Returns the instance id. */
+	int32 AddInstance(const FDistanceFieldSampler* Sampler, const FVector& Position, float Scale = 1.0f);
+
+	void UpdateInstance(int32 InstanceId, const FVector& Position, float Scale = 1.0f);
+
+	void RemoveInstance(int32 InstanceId);
+
+	/** Forces a full recomposite of every cascade on the next Update. */
+	void Invalidate();
+
+	/** Scrolls the cascades to CameraPosition and recomposites what changed, in parallel. */
+	void Update(const FVector& CameraPosition);
+
+	/** Trilinear world space distance from the finest cascade that contains Position, clamped to that cascade's band. */
+	float Sample(const FVector& WorldPosition) const;
+
+	const FDistanceFieldInstance& GetInstance(int32 InstanceId) const
+	{
+		return Instances[InstanceId];
+	}
+
+	int32 GetNumCascades() const
+	{
+		return Cascades.size();
+	}
+
+	int32 GetResolution() const
+	{
+		return Resolution;
+	}
+
+	const FGlobalDistanceFieldCascade& GetCascade(int32 CascadeIndex) const
+	{
+		return Cascades[CascadeIndex];
+	}
+
+	const FGlobalDistanceFieldStats& GetStats() const
+	{
+		return Stats;
+	}
+
+private:
+
+	/** A box of world voxel coordinates in one cascade, Max exclusive. */
+	struct FRegion
+	{
+		int32 CascadeIndex;
+		FIntVector Min;
+		FIntVector Max;
+	};
+
+	/**
+	* Queues the part of the box inside the cascade window that no queued region of the cascade covers yet,
+	* so no two regions overlap and their slices can be composited in parallel.
+	*/
+	void AddRegion(int32 CascadeIndex, const FIntVector& Min, const FIntVector& Max, const FIntVector& Origin);
+	void AddScrolledRegions(int32 CascadeIndex, const FIntVector& OldOrigin, const FIntVector& NewOrigin);
+
+	friend class FGlobalDistanceFieldCompositeTask;
+
+	int32 Resolution;
+	TArray<FGlobalDistanceFieldCascade> Cascades;
+	TArray<FDistanceFieldInstance> Instances;
+
+	/** World space boxes changed by instance edits since the last Update. */
+	TArray<FBox> PendingDirtyBounds;
+
+	TArray<FRegion> Regions;
+	FGlobalDistanceFieldStats Stats;
+};
+
+#endif // !_GLOBALDISTANCEFIELD
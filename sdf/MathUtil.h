@@ -311,6 +311,13 @@ namespace FMath{
 	{
 		return Dividend / Divisor;
 	}
+
+	/** Performs a linear interpolation between two values, Alpha ranges from 0-1 */
+	template <class T, class U>
+	static FORCEINLINE T Lerp(const T& A, const T& B, const U& Alpha)
+	{
+		return (T)(A + Alpha * (B - A));
+	}
 }
 
 
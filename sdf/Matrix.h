@@ -218,7 +218,7 @@ public:
 	}
 };
 
-MS_ALIGN(16) const FMatrix FMatrix::Identity = 
+MS_ALIGN(16) SELECTANY const FMatrix FMatrix::Identity = 
 FMatrix(
 FVector4( 1, 0, 0, 0 ), 
 FVector4( 0, 1, 0, 0 ),
@@ -0,0 +1,429 @@
+#include "MeshUtilities.h"
+#include <chrono>
+
+void GenerateStratifiedUniformHemisphereSamples(int32 NumThetaSteps, int32 NumPhiSteps, FRandomStream& RandomStream, TArray<FVector4>& Samples)
+{
+	Samples.clear();
+	Samples.reserve(NumThetaSteps * NumPhiSteps);
+	for (int32 ThetaIndex = 0; ThetaIndex < NumThetaSteps; ThetaIndex++)
+	{
+		for (int32 PhiIndex = 0; PhiIndex < NumPhiSteps; PhiIndex++)
+		{
+			const float U1 = RandomStream.GetFraction();
+			const float U2 = RandomStream.GetFraction();
+
+			const float Fraction1 = (ThetaIndex + U1) / (float)NumThetaSteps;
+			const float Fraction2 = (PhiIndex + U2) / (float)NumPhiSteps;
+
+			const float R = FMath::Sqrt(1.0f - Fraction1 * Fraction1);
+
+			const float Phi = 2.0f * (float)PI * Fraction2;
+			// Convert to Cartesian
+			Samples.push_back(FVector4(FMath::Cos(Phi) * R, FMath::Sin(Phi) * R, Fraction1));
+		}
+	}
+}
+
+float FMeshDistanceFieldBuildContext::ComputeDistance(const FVector& VoxelPosition, float VoxelDiameter, FDistanceFieldBuildStats* Stats) const
+{
+	FMeshBuildDataProvider kDOPDataProvider(kDopTree);
+	float MinDistance = VolumeMaxDistance;
+	int32 Hit = 0;
+	int32 HitBack = 0;
+
+	for (uint32 SampleIndex = 0; SampleIndex < SampleDirections.size(); SampleIndex++)
+	{
+		const FVector RayDirection = SampleDirections[SampleIndex];
+
+		if (FMath::LineBoxIntersection(VolumeBounds, VoxelPosition, VoxelPosition + RayDirection * VolumeMaxDistance, RayDirection))
+		{
+			FkHitResult Result;
+
+			TkDOPLineCollisionCheck<const FMeshBuildDataProvider, uint32> kDOPCheck(
+				VoxelPosition,
+				VoxelPosition + RayDirection * VolumeMaxDistance,
+				true,
+				kDOPDataProvider,
+				&Result, 
+				*Materials);
+
+			bool bHit = kDopTree.LineCheck(kDOPCheck);
+
+			if (Stats)
+			{
+				Stats->NumRays++;
+				Stats->NumNodesVisited += kDOPCheck.NumNodesVisited;
+				Stats->NumTriangleBatchesTested += kDOPCheck.NumTriangleBatchesTested;
+			}
+
+			if (bHit)
+			{
+				Hit++;
+
+				const FVector HitNormal = kDOPCheck.GetHitNormal();
+
+				if (FVector::DotProduct(RayDirection, HitNormal) > 0
+					// MaterialIndex on the build triangles was set to 1 if two-sided, or 0 if one-sided
+					&& kDOPCheck.Result->Item == 0)
+				{
+					HitBack++;
+				}
+
+				const float CurrentDistance = VolumeMaxDistance * Result.Time;
+
+				if (CurrentDistance < MinDistance)
+				{
+					MinDistance = CurrentDistance;
+				}
+			}
+		}
+	}
+
+	const float UnsignedDistance = MinDistance;
+
+	// Consider this voxel 'inside' an object if more than 50% of the rays hit back faces
+	MinDistance *= (Hit == 0 || HitBack < SampleDirections.size() * .5f) ? 1 : -1;
+
+	// If we are very close to a surface and nearly all of our rays hit backfaces, treat as inside
+	// This is important for one sided planes
+	if (UnsignedDistance < VoxelDiameter && HitBack > .95f * Hit)
+	{
+		MinDistance = -UnsignedDistance;
+	}
+
+	return MinDistance;
+}
+
+void FMeshDistanceFieldAsyncTask::DoWork()
+{
+	const FBox& VolumeBounds = Context->VolumeBounds;
+	const FIntVector& VolumeDimensions = Context->VolumeDimensions;
+	const FVector DistanceFieldVoxelSize(Context->GetVoxelSize(VolumeDimensions));
+	const float VoxelDiameter = DistanceFieldVoxelSize.Size();
+	TArray<float> RowDistances(VolumeDimensions.X);
+
+	for (int32 YIndex = 0; YIndex < VolumeDimensions.Y; YIndex++)
+	{
+		for (int32 XIndex = 0; XIndex < VolumeDimensions.X; XIndex++)
+		{
+			const FVector VoxelPosition = FVector(XIndex + .5f, YIndex + .5f, ZIndex + .5f) * DistanceFieldVoxelSize + VolumeBounds.Min;
+			const float MinDistance = Context->ComputeDistance(VoxelPosition, VoxelDiameter, &Stats);
+			const float VolumeSpaceDistance = MinDistance / VolumeBounds.GetExtent().GetMax();
+
+			if (MinDistance < 0 &&
+				(XIndex == 0 || XIndex == VolumeDimensions.X - 1 ||
+				YIndex == 0 || YIndex == VolumeDimensions.Y - 1 ||
+				ZIndex == 0 || ZIndex == VolumeDimensions.Z - 1))
+			{
+				bNegativeAtBorder = true;
+			}
+
+			RowDistances[XIndex] = VolumeSpaceDistance;
+		}
+
+		const int32 RowIndex = (ZIndex * VolumeDimensions.Y + YIndex) * VolumeDimensions.X;
+		ConvertFloatToSDFFloat(RowDistances.data(), &(*OutDistanceFieldVolume)[RowIndex], VolumeDimensions.X);
+	}
+	Stats.NumVoxels += VolumeDimensions.X * VolumeDimensions.Y;
+}
+
+
+void GenerateBoxSphereBounds(FBoxSphereBounds* bounds, const MeshData* LODModel)
+{
+	FVector minv(MAX_FLT), maxv(-MAX_FLT);
+	const TArray<FVector> &vertices = LODModel->Vertices;
+	for (uint32 i = 0; i < vertices.size(); i++){
+		const FVector &V = vertices[i];
+		minv.X = FMath::Min(minv.X, V.X);
+		minv.Y = FMath::Min(minv.Y, V.Y);
+		minv.Z = FMath::Min(minv.Z, V.Z);
+		maxv.X = FMath::Max(maxv.X, V.X);
+		maxv.Y = FMath::Max(maxv.Y, V.Y);
+		maxv.Z = FMath::Max(maxv.Z, V.Z);
+	}
+	bounds->Origin = (maxv + minv) * 0.5f;
+	bounds->BoxExtent = (maxv - minv) * 0.5f;
+	bounds->SphereRadius = bounds->BoxExtent.Size();;
+}
+
+FMeshDistanceFieldBuildContext::FMeshDistanceFieldBuildContext(
+	MeshData& LODModel
+	, const FBoxSphereBounds& Bounds
+	, float DistanceFieldResolutionScale)
+{
+	Materials = &LODModel.Mats;
+	const TArray<FVector>& PositionVertexBuffer = LODModel.Vertices;
+	const TArray<FMaterial>& mats = LODModel.Mats;
+	const TArray<FVector2D>& uvs = LODModel.UVs;
+	const MeshTries & Tries = LODModel.Indices;
+	TArray<FkDOPBuildCollisionTriangle<uint32> > BuildTriangles;
+
+	FVector BoundsSize = Bounds.GetBox().GetExtent() * 2;
+	float MaxDimension = FMath::Max(FMath::Max(BoundsSize.X, BoundsSize.Y), BoundsSize.Z);
+
+	// Consider the mesh a plane if it is very flat
+	bMeshWasPlane = BoundsSize.Z * 100 < MaxDimension
+		// And it lies mostly on the origin
+		&& Bounds.Origin.Z - Bounds.BoxExtent.Z < KINDA_SMALL_NUMBER
+		&& Bounds.Origin.Z + Bounds.BoxExtent.Z > -KINDA_SMALL_NUMBER;
+
+	for (uint32 i = 0; i < Tries.size(); i ++)
+	{
+		FVector V0 = PositionVertexBuffer[Tries[i].indices[2]];
+		FVector V1 = PositionVertexBuffer[Tries[i].indices[1]];
+		FVector V2 = PositionVertexBuffer[Tries[i].indices[0]];
+
+		if (bMeshWasPlane)
+		{
+			// Flatten out the mesh into an actual plane, this will allow us to manipulate the component's Z scale at runtime without artifacts
+			V0.Z = 0;
+			V1.Z = 0;
+			V2.Z = 0;
+		}
+
+		const FVector LocalNormal = ((V1 - V2) ^ (V0 - V2)).GetSafeNormal();
+
+		// No degenerates
+		if (LocalNormal.IsUnit())
+		{
+			bool bTriangleIsOpaqueOrMasked = true;
+
+			// 				for (int32 SectionIndex = 0; SectionIndex < LODModel.Sections.Num(); SectionIndex++)
+			// 				{
+			// 					const FStaticMeshSection& Section = LODModel.Sections[SectionIndex];
+			// 
+			// 					if ((uint32)i >= Section.FirstIndex && (uint32)i < Section.FirstIndex + Section.NumTriangles * 3)
+			// 					{
+			// 						if (MaterialBlendModes.IsValidIndex(Section.MaterialIndex))
+			// 						{
+			// 							bTriangleIsOpaqueOrMasked = !IsTranslucentBlendMode(MaterialBlendModes[Section.MaterialIndex]);
+			// 						}
+			// 
+			// 						break;
+			// 					}
+			// 				}
+
+			if (mats[Tries[i].material].alphaTest)
+			{
+				BuildTriangles.push_back(FkDOPBuildCollisionTriangle<uint32>(
+					Tries[i].material,
+					V0,
+					V1,
+					V2,
+					uvs[Tries[i].indices[0]],
+					uvs[Tries[i].indices[1]],
+					uvs[Tries[i].indices[2]]));
+			}
+			else
+			{
+				BuildTriangles.push_back(FkDOPBuildCollisionTriangle<uint32>(
+					Tries[i].material,
+					V0,
+					V1,
+					V2,
+					FVector2D(0, 0),
+					FVector2D(0, 0),
+					FVector2D(0, 0)));
+			}
+		}
+		
+	}
+
+	kDopTree.Build(BuildTriangles);
+
+	//@todo - project setting
+	const int32 NumVoxelDistanceSamples = 1200;
+	const int32 NumThetaSteps = FMath::TruncToInt(FMath::Sqrt(NumVoxelDistanceSamples / (2.0f * (float)PI)));
+	const int32 NumPhiSteps = FMath::TruncToInt(NumThetaSteps * (float)PI);
+	FRandomStream RandomStream(0);
+	GenerateStratifiedUniformHemisphereSamples(NumThetaSteps, NumPhiSteps, RandomStream, SampleDirections);
+	TArray<FVector4> OtherHemisphereSamples;
+	GenerateStratifiedUniformHemisphereSamples(NumThetaSteps, NumPhiSteps, RandomStream, OtherHemisphereSamples);
+
+	for (uint32 i = 0; i < OtherHemisphereSamples.size(); i++)
+	{
+		FVector4 Sample = OtherHemisphereSamples[i];
+		Sample.Z *= -1;
+		SampleDirections.push_back(Sample);
+	}
+
+	GetDistanceFieldVolumeLayout(Bounds.GetBox(), DistanceFieldResolutionScale, VolumeBounds, VolumeDimensions);
+	VolumeMaxDistance = VolumeBounds.GetExtent().Size();
+}
+
+void GetDistanceFieldVolumeLayout(const FBox& MeshBounds, float DistanceFieldResolutionScale, FBox& OutVolumeBounds, FIntVector& OutDimensions)
+{
+	// Meshes with explicit artist-specified scale can go higher
+	const int32 MaxNumVoxelsOneDim = DistanceFieldResolutionScale <= 1 ? 64 : 128;
+	const int32 MinNumVoxelsOneDim = 8;
+
+	//@todo - project setting
+	const float NumVoxelsPerLocalSpaceUnit = .1f * DistanceFieldResolutionScale;
+
+	const float MaxOriginalExtent = MeshBounds.GetExtent().GetMax();
+	// Expand so that the edges of the volume are guaranteed to be outside of the mesh
+	const FVector NewExtent(MeshBounds.GetExtent() + FVector(.2f * MaxOriginalExtent));
+	OutVolumeBounds = FBox(MeshBounds.GetCenter() - NewExtent, MeshBounds.GetCenter() + NewExtent);
+
+	const FVector DesiredDimensions(OutVolumeBounds.GetSize() * FVector(NumVoxelsPerLocalSpaceUnit));
+
+// 	const FIntVector VolumeDimensions(
+// 		FMath::Clamp(FMath::TruncToInt(DesiredDimensions.X), MinNumVoxelsOneDim, MaxNumVoxelsOneDim),
+// 		FMath::Clamp(FMath::TruncToInt(DesiredDimensions.Y), MinNumVoxelsOneDim, MaxNumVoxelsOneDim),
+// 		FMath::Clamp(FMath::TruncToInt(DesiredDimensions.Z), MinNumVoxelsOneDim, MaxNumVoxelsOneDim));
+
+	int32 i32 = FMath::Max3(
+		FMath::Clamp(FMath::TruncToInt(DesiredDimensions.X), MinNumVoxelsOneDim, MaxNumVoxelsOneDim),
+		FMath::Clamp(FMath::TruncToInt(DesiredDimensions.Y), MinNumVoxelsOneDim, MaxNumVoxelsOneDim),
+		FMath::Clamp(FMath::TruncToInt(DesiredDimensions.Z), MinNumVoxelsOneDim, MaxNumVoxelsOneDim));
+	OutDimensions = FIntVector(i32);
+}
+
+void GenerateSignedDistanceFieldVolumeData(
+	MeshData& LODModel
+	//,const TArray<EBlendMode>& MaterialBlendModes
+	, const FBoxSphereBounds& Bounds
+	, float DistanceFieldResolutionScale
+	, bool bGenerateAsIfTwoSided
+	, FDistanceFieldVolumeData& OutData
+	, FDistanceFieldBuildStats* OutStats)
+{
+	if (DistanceFieldResolutionScale > 0)
+	{
+		FQueuedThreadPool ThreadPool;
+		const std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+		const FMeshDistanceFieldBuildContext Context(LODModel, Bounds, DistanceFieldResolutionScale);
+		const FIntVector VolumeDimensions = Context.VolumeDimensions;
+		const std::chrono::steady_clock::time_point BuiltTime = std::chrono::steady_clock::now();
+
+		OutData.Size = VolumeDimensions;
+		OutData.LocalBoundingBox = Context.VolumeBounds;
+		OutData.DistanceFieldVolume.clear();
+		OutData.DistanceFieldVolume.resize(VolumeDimensions.X * VolumeDimensions.Y * VolumeDimensions.Z, FFloat16(0));
+
+		TArray<FAsyncTask<FMeshDistanceFieldAsyncTask>*> AsyncTasks;
+
+		for (int32 ZIndex = 0; ZIndex < VolumeDimensions.Z; ZIndex++)
+		{
+			FAsyncTask<FMeshDistanceFieldAsyncTask>* Task = new FAsyncTask<class FMeshDistanceFieldAsyncTask>(
+				&Context,
+				ZIndex,
+				&OutData.DistanceFieldVolume);
+
+			ThreadPool.AddWork(Task);
+			//Task->StartBackgroundTask(&ThreadPool);
+			AsyncTasks.push_back(Task);
+		}
+		ThreadPool.DoAllWork();
+		bool bNegativeAtBorder = false;
+		FDistanceFieldBuildStats Stats;
+
+		for (uint32 TaskIndex = 0; TaskIndex < AsyncTasks.size(); TaskIndex++)
+		{
+			FAsyncTask<FMeshDistanceFieldAsyncTask>* Task = AsyncTasks[TaskIndex];
+			bNegativeAtBorder = bNegativeAtBorder || Task->GetTask().WasNegativeAtBorder();
+			Stats.Add(Task->GetTask().GetStats());
+			delete Task;
+		}
+
+		if (OutStats)
+		{
+			const std::chrono::steady_clock::time_point EndTime = std::chrono::steady_clock::now();
+			Stats.BuildSeconds = std::chrono::duration<double>(BuiltTime - StartTime).count();
+			Stats.BakeSeconds = std::chrono::duration<double>(EndTime - BuiltTime).count();
+			*OutStats = Stats;
+		}
+
+		OutData.bMeshWasClosed = !bNegativeAtBorder;
+		OutData.bBuiltAsIfTwoSided = bGenerateAsIfTwoSided;
+		OutData.bMeshWasPlane = Context.bMeshWasPlane;
+
+		// Toss distance field if mesh was not closed
+		if (bNegativeAtBorder)
+		{
+			OutData.Size = FIntVector(0, 0, 0);
+			OutData.DistanceFieldVolume.clear();
+		}
+	}
+}
+
+void FDistanceFieldVolumeData::Compress(EDistanceFieldFormat InFormat)
+{
+	if (DistanceFieldVolume.empty() && CompressedVolume.IsValid())
+	{
+		Decompress();
+	}
+
+	const int32 NumVoxels = DistanceFieldVolume.size();
+	CompressionStats = FDistanceFieldCompressionStats();
+	CompressionStats.SourceBytes = CompressionStats.CompressedBytes = NumVoxels * sizeof(uint16);
+	Format = InFormat;
+
+#ifdef _HALF
+	// The bake already stores half floats, keep them as they are
+	if (InFormat == DFF_Float16)
+	{
+		CompressedVolume.Empty();
+		return;
+	}
+#endif // _HALF
+
+	if (NumVoxels == 0)
+	{
+		CompressedVolume.Empty();
+		return;
+	}
+
+	TArray<float> SourceVolume(NumVoxels);
+	ConvertSDFFloatToFloat(DistanceFieldVolume.data(), SourceVolume.data(), NumVoxels);
+
+	CompressedVolume.Encode(SourceVolume.data(), Size, InFormat, &CompressionStats);
+	TArray<SDFFloat>().swap(DistanceFieldVolume);
+}
+
+void FDistanceFieldVolumeData::Decompress()
+{
+	DecodeVolume(DistanceFieldVolume);
+}
+
+void FDistanceFieldVolumeData::DecodeVolume(TArray<SDFFloat>& Out) const
+{
+	const int32 NumVoxels = Size.X * Size.Y * Size.Z;
+	TArray<float> DecodedVolume(NumVoxels);
+	CompressedVolume.Decode(DecodedVolume.data());
+
+	Out.resize(NumVoxels);
+	ConvertFloatToSDFFloat(DecodedVolume.data(), Out.data(), NumVoxels);
+}
+
+void FDistanceFieldVolumeData::DecodeBrick(int32 X, int32 Y, int32 Z, float Out[FCompressedDistanceFieldVolume::BlockVoxels]) const
+{
+	const int32 BrickSize = FCompressedDistanceFieldVolume::BlockSize;
+	if (DistanceFieldVolume.empty())
+	{
+		CompressedVolume.DecodeBrick(X, Y, Z, Out);
+		return;
+	}
+
+	for (int32 LocalZ = 0; LocalZ < BrickSize; LocalZ++)
+	{
+		const int32 VolumeZ = FMath::Clamp(Z + LocalZ, 0, Size.Z - 1);
+		for (int32 LocalY = 0; LocalY < BrickSize; LocalY++)
+		{
+			const int32 VolumeY = FMath::Clamp(Y + LocalY, 0, Size.Y - 1);
+			const SDFFloat* SrcRow = &DistanceFieldVolume[(VolumeZ * Size.Y + VolumeY) * Size.X];
+			float* Row = Out + (LocalZ * BrickSize + LocalY) * BrickSize;
+			if (X >= 0 && X + BrickSize <= Size.X)
+			{
+				ConvertSDFFloatToFloat(SrcRow + X, Row, BrickSize);
+			}
+			else
+			{
+				for (int32 LocalX = 0; LocalX < BrickSize; LocalX++)
+				{
+					Row[LocalX] = SrcRow[FMath::Clamp(X + LocalX, 0, Size.X - 1)];
+				}
+			}
+		}
+	}
+}
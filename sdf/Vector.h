@@ -1062,16 +1062,16 @@ FORCEINLINE float ComputeSquaredDistanceFromBoxToPoint(const FVector& Mins, cons
 }
 
 /** A zero vector (0,0,0) */
-const FVector FVector::ZeroVector = FVector(0);
+SELECTANY const FVector FVector::ZeroVector = FVector(0);
 
 /** World up vector (0,0,1) */
-const FVector FVector::UpVector = FVector(0, 0, 1);
+SELECTANY const FVector FVector::UpVector = FVector(0, 0, 1);
 
 /** Unreal forward vector (1,0,0) */
-const FVector FVector::ForwardVector = FVector(1, 0, 0);
+SELECTANY const FVector FVector::ForwardVector = FVector(1, 0, 0);
 
 /** Unreal right vector (0,1,0) */
-const FVector FVector::RightVector = FVector(0, 1, 0);
+SELECTANY const FVector FVector::RightVector = FVector(0, 1, 0);
 
 
 inline FVector FVector::RotateAngleAxis(const float AngleDeg, const FVector& Axis) const
@@ -199,28 +199,16 @@ static const VectorRegister VectorNegativeOne = MakeVectorRegister(-1.0f, -1.0f,
 FORCEINLINE VectorRegister alphaCheck(
 	TArray<FMaterial>& mat, const uint32 playload[], VectorRegister u, VectorRegister v)
 {
-	float width[4], height[4], cnt[4];
 	int noTest[4] = {0, 0, 0, 0};
 	for (int i = 0; i < 4; i++)
 	{
 		if (playload[i] != -1)
 		{
-			width[i] = mat[playload[i]].diffuse.width;
-			cnt[i] = mat[playload[i]].diffuse.byteCount;
-			height[i] = mat[playload[i]].diffuse.height;
 			noTest[i] = -(!mat[playload[i]].alphaTest);
 		}
 	}
-	VectorRegister cntVec = VectorLoad(cnt);
-	VectorRegister widthVec = VectorMultiply(cntVec, VectorLoad(width));
-	VectorRegister heightVec = VectorLoad(height);
 	VectorRegister noTestVec = VectorLoad((float*)noTest);
 
-	VectorRegister offset = VectorMultiplyAdd(
-		widthVec,
-		VectorMultiply(heightVec, v),
-		VectorMultiply(widthVec, u)
-		);
 	VectorRegister ugez = VectorMask_GE(u, VectorZero());
 	VectorRegister ule1 = VectorMask_LE(u, VectorOne());
 	VectorRegister vgez = VectorMask_GE(v, VectorZero());
@@ -235,7 +223,12 @@ FORCEINLINE VectorRegister alphaCheck(
 	{
 		if (playload[i] != -1 && valid.m128_f32[i])
 		{
-			alphaTestRes[i] = mat[playload[i]].SampleAlphaTest(offset.m128_f32[i]);
+			// Texel under (u, v), u = 1 and v = 1 fall in the last column and row
+			const FTexture& diffuse = mat[playload[i]].diffuse;
+			const int32 x = FMath::Clamp(FMath::FloorToInt(u.m128_f32[i] * diffuse.width), 0, diffuse.width - 1);
+			const int32 y = FMath::Clamp(FMath::FloorToInt(v.m128_f32[i] * diffuse.height), 0, diffuse.height - 1);
+			const int32 widthBytes = diffuse.width * diffuse.byteCount;
+			alphaTestRes[i] = mat[playload[i]].SampleAlphaTest(widthBytes * y + x * diffuse.byteCount);
 		}
 	}
 	return VectorBitwiseOr(VectorLoad((float*)alphaTestRes), noTestVec);
@@ -251,7 +244,7 @@ FORCEINLINE VectorRegister alphaCheck(
 * @param IntersectionTime	[in/out] Best intersection time so far (0..1), as in: IntersectionPoint = Start + IntersectionTime * Dir.
 * @return			Index (0-3) to specify which of the 4 triangles the line intersected, or -1 if none was found.
 */
-int32 appLineCheckTriangleSOA(
+inline int32 appLineCheckTriangleSOA(
 	const FVector3SOA& Start, const FVector3SOA& End, const FVector3SOA& Dir, 
 	const FTriangleSOA& Triangle4, float& InOutIntersectionTime, TArray<FMaterial>& alphaCheckMat
 	)
@@ -836,6 +829,7 @@ struct TkDOPNode
 	bool LineCheck(TkDOPLineCollisionCheck<COLL_DATA_PROVIDER, KDOP_IDX_TYPE>& Check, TTraversalHistory<KDOP_IDX_TYPE> History) const
 	{
 		bool bHit = 0;
+		Check.NumNodesVisited++;
 		// If this is a node, check the two child nodes and pick the closest one
 		// to recursively check against and only check the second one if there is
 		// not a hit or the hit returned is further out than the second node
@@ -917,6 +911,7 @@ struct TkDOPNode
 		TTraversalHistory<KDOP_IDX_TYPE> History, int32* NodeHit) const
 	{
 		bool bHit = 0;
+		Check.NumNodesVisited++;
 		// If this is a node, check the two child nodes and pick the closest one
 		// to recursively check against and only check the second one if there is
 		// not a hit or the hit returned is further out than the second node
@@ -992,6 +987,7 @@ struct TkDOPNode
 	{
 		// Assume a miss
 		bool bHit = false;
+		Check.NumTriangleBatchesTested += t.NumTriangles;
 		for (KDOP_IDX_TYPE SOAIndex = t.StartIndex; SOAIndex < (t.StartIndex + t.NumTriangles); SOAIndex++)
 		{
 			const FTriangleSOA& TriangleSOA = Check.SOATriangles[SOAIndex];
@@ -1167,6 +1163,10 @@ public TkDOPCollisionCheck<COLL_DATA_PROVIDER, KDOP_IDX_TYPE>
 	TArray<FMaterial> &AlphaCheckMat;
 
 	int matID;
+
+	/** Nodes entered and groups of four triangles tested by this check, for profiling the tree. */
+	int32 NumNodesVisited;
+	int32 NumTriangleBatchesTested;
 	/**
 	* Sets up the FkDOPLineCollisionCheck structure for performing line checks
 	* against a kDOPTree. Initializes all of the variables that are used
@@ -1191,7 +1191,9 @@ public TkDOPCollisionCheck<COLL_DATA_PROVIDER, KDOP_IDX_TYPE>
 		End(InEnd),
 		bFindClosestIntersection(bInbFindClosestIntersection),
 		HitNodeIndex(0xFFFFFFFF),
-		AlphaCheckMat(alphaCheckMat)
+		AlphaCheckMat(alphaCheckMat),
+		NumNodesVisited(0),
+		NumTriangleBatchesTested(0)
 	{
 			const FMatrix& WorldToLocal = TkDOPCollisionCheck<COLL_DATA_PROVIDER, KDOP_IDX_TYPE>::CollDataProvider.GetWorldToLocal();
 			// Move start and end to local space